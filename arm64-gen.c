@@ -36,6 +36,21 @@
 /* define if return values need to be extended explicitely
    at caller side (for interfacing with non-Swirl compilers) */
 #define PROMOTE_RET
+
+/* __builtin_popcount & co are open coded */
+#define CONFIG_SWIRL_BITOPS
+/* atomic operations are open coded */
+#define CONFIG_SWIRL_ATOMIC
+/* 128-bit vector operations use NEON */
+#define CONFIG_SWIRL_SIMD
+/* struct copies and clears up to that size are open coded */
+#define CONFIG_SWIRL_STRUCT_COPY 128
+/* with -O, calls in tail position may be jumps */
+#define CONFIG_SWIRL_TAILCALL
+/* thread-local variables (ELF only) */
+#if !defined SWIRL_TARGET_PE && !defined SWIRL_TARGET_MACHO
+# define CONFIG_SWIRL_THREAD_LOCAL
+#endif
 /******************************************************/
 #else /* ! TARGET_DEFS_ONLY */
 /******************************************************/
@@ -79,8 +94,8 @@ ST_DATA const int reg_classes[NB_REGS] = {
 };
 
 #if defined(CONFIG_SWIRL_BCHECK)
-static addr_t func_bound_offset;
-static unsigned long func_bound_ind;
+static ST_TLS addr_t func_bound_offset;
+static ST_TLS unsigned long func_bound_ind;
 ST_DATA int func_bound_add_epilog;
 #endif
 
@@ -261,6 +276,7 @@ static int arm64_type_size(int t)
     case VT_DOUBLE: return 3;
     case VT_LDOUBLE: return 4;
     case VT_BOOL: return 0;
+    case VT_QVEC: return 4;
     }
     assert(0);
     return 0;
@@ -541,7 +557,7 @@ ST_FUNC void load(int r, SValue *sv)
 
     if (svr < VT_CONST) {
         if (IS_FREG(r) && IS_FREG(svr))
-            if (svtt == VT_LDOUBLE)
+            if (svtt == VT_LDOUBLE || svtt == VT_QVEC)
                 o(0x4ea01c00 | fltr(r) | fltr(svr) << 5);
                     // mov v(r).16b,v(svr).16b
             else
@@ -554,6 +570,9 @@ ST_FUNC void load(int r, SValue *sv)
     }
 
     if (svr == VT_LOCAL) {
+#ifdef CONFIG_SWIRL_TAILCALL
+        func_addr_taken = 1;
+#endif
         if (-svcul < 0x1000)
             o(0xd10003a0 | intr(r) | -svcul << 10); // sub x(r),x29,#...
         else {
@@ -661,6 +680,36 @@ static void arm64_gen_bl_or_b(int b)
     }
 }
 
+#ifdef CONFIG_SWIRL_TAILCALL
+/* pairs of (site, relocation offset or -1) */
+static ST_TLS int *tail_sites, nb_tail_sites;
+
+static void arm64_gen_tail_site(void)
+{
+    int rel = -1;
+    if ((nb_tail_sites & 15) == 0)
+        tail_sites = swirl_realloc(tail_sites,
+            (nb_tail_sites + 16) * 2 * sizeof *tail_sites);
+    if ((vtop->r & (VT_VALMASK | VT_LVAL)) == VT_CONST && (vtop->r & VT_SYM)) {
+        o(0xd503201f); // nop
+        o(0xd503201f); // nop
+        greloca(cur_text_section, vtop->sym, ind, R_AARCH64_CALL26, 0);
+        rel = cur_text_section->reloc->data_offset - sizeof(ElfW_Rel);
+        o(0x94000000); // bl .
+    }
+    else {
+        // x30 is restored before the jump
+        o(0xaa0003f0 | intr(gv(RC_R30)) << 16); // mov x16,x30
+        o(0xd503201f); // nop
+        o(0xd503201f); // nop
+        o(0xd63f0200); // blr x16
+    }
+    tail_sites[2 * nb_tail_sites] = ind - 12;
+    tail_sites[2 * nb_tail_sites + 1] = rel;
+    ++nb_tail_sites;
+}
+#endif
+
 #if defined(CONFIG_SWIRL_BCHECK)
 
 static void gen_bounds_call(int v)
@@ -734,6 +783,15 @@ static int arm64_hfa_aux(CType *type, int *fsize, int num)
         *fsize = n;
         return num + 1;
     }
+    else if ((type->t & VT_BTYPE) == VT_STRUCT
+             && IS_VECTOR(type->ref->type.t)) {
+        // short vectors are a single d or q register
+        int n = type->ref->c;
+        if ((n != 8 && n != 16) || num >= 4 || (*fsize && *fsize != n))
+            return -1;
+        *fsize = n;
+        return num + 1;
+    }
     else if ((type->t & VT_BTYPE) == VT_STRUCT) {
         int is_struct = 0; // rather than union
         Sym *field;
@@ -965,6 +1023,11 @@ ST_FUNC void gfunc_call(int nb_args)
     unsigned long *a, *a1;
     unsigned long stack;
     int i;
+#ifdef CONFIG_SWIRL_TAILCALL
+    int tail = tail_call;
+
+    tail_call = 0;
+#endif
 
 #ifdef CONFIG_SWIRL_BCHECK
     if (swirl_state->do_bounds_check)
@@ -1096,6 +1159,11 @@ ST_FUNC void gfunc_call(int nb_args)
     }
 
     save_regs(0);
+#ifdef CONFIG_SWIRL_TAILCALL
+    if (tail && !stack)
+        arm64_gen_tail_site();
+    else
+#endif
     arm64_gen_bl_or_b(0);
     --vtop;
     if (stack & 0xfff)
@@ -1135,10 +1203,10 @@ ST_FUNC void gfunc_call(int nb_args)
     swirl_free(t);
 }
 
-static unsigned long arm64_func_va_list_stack;
-static int arm64_func_va_list_gr_offs;
-static int arm64_func_va_list_vr_offs;
-static int arm64_func_sub_sp_offset;
+static ST_TLS unsigned long arm64_func_va_list_stack;
+static ST_TLS int arm64_func_va_list_gr_offs;
+static ST_TLS int arm64_func_va_list_vr_offs;
+static ST_TLS int arm64_func_sub_sp_offset;
 
 ST_FUNC void gfunc_prolog(Sym *func_sym)
 {
@@ -1389,10 +1457,32 @@ ST_FUNC void gfunc_return(CType *func_type)
 
 ST_FUNC void gfunc_epilog(void)
 {
+#ifdef CONFIG_SWIRL_TAILCALL
+    int i;
+#endif
 #ifdef CONFIG_SWIRL_BCHECK
     if (swirl_state->do_bounds_check)
         gen_bounds_epilog();
 #endif
+#ifdef CONFIG_SWIRL_TAILCALL
+    // Calls in tail position leave the function first, unless the
+    // callee might see its frame:
+    for (i = 0; i < nb_tail_sites && !func_addr_taken; i++) {
+        unsigned char *ptr = cur_text_section->data + tail_sites[2 * i];
+        int rel = tail_sites[2 * i + 1];
+        write32le(ptr, 0x910003bf); // mov sp,x29
+        write32le(ptr + 4, 0xa8ce7bfd); // ldp x29,x30,[sp],#224
+        if (rel < 0)
+            write32le(ptr + 8, 0xd61f0200); // br x16
+        else {
+            ElfW_Rel *r = (ElfW_Rel *)(cur_text_section->reloc->data + rel);
+            r->r_info = ELFW(R_INFO)(ELFW(R_SYM)(r->r_info), R_AARCH64_JUMP26);
+            write32le(ptr + 8, 0x14000000); // b .
+        }
+    }
+    swirl_free(tail_sites);
+    tail_sites = NULL, nb_tail_sites = 0;
+#endif
 
     if (loc) {
         // Insert instructions to subtract size of stack frame from SP.
@@ -1541,6 +1631,109 @@ static int arm64_iconst(uint64_t *val, SValue *sv)
     return 1;
 }
 
+static void arm64_gen_shifti(int op, uint32_t l, int n, uint32_t x, uint32_t a)
+{
+    uint32_t w = 32 << l;
+    if (!n)
+        return;
+    if (op == TOK_SHL)
+        o(0x53000000 | l << 31 | l << 22 | x | a << 5 |
+          (w - n) << 16 | (w - 1 - n) << 10); // lsl
+    else
+        o(0x13000000 | (op == TOK_SHR) << 30 | l << 31 | l << 22 |
+          x | a << 5 | n << 16 | (w - 1) << 10); // lsr/asr
+}
+
+// x = a * val for val = (2^n +- 1) << k
+static int arm64_gen_mulc(uint32_t l, int64_t val, uint32_t x, uint32_t a)
+{
+    int n, k = 0;
+
+    if (val <= 0)
+        return 0;
+    while (!(val & 1))
+        val >>= 1, k++;
+    if (val == 1)
+        return 0;
+    if (!((val - 1) & (val - 2))) {
+        for (n = 0; (int64_t)1 << n != val - 1; n++)
+            ;
+        o(0x0b000000 | l << 31 | x | a << 5 | a << 16 | n << 10); // add
+    } else if (!((val + 1) & val)) {
+        for (n = 0; (int64_t)1 << n != val + 1; n++)
+            ;
+        o(0x4b0003e0 | l << 31 | 30 | a << 16); // neg x30
+        o(0x0b000000 | l << 31 | x | 30 << 5 | a << 16 | n << 10); // add
+    } else
+        return 0;
+    arm64_gen_shifti(TOK_SHL, l, k, x, x);
+    return 1;
+}
+
+// x = a / val or a % val with a high multiply, x30 holds the quotient.
+// For the remainder x must differ from a.
+static int arm64_gen_divmodc(int op, uint32_t l, uint64_t val,
+                             uint32_t x, uint32_t a)
+{
+    int bits = 32 << l, k, s, sgn = op != TOK_UDIV && op != TOK_UMOD;
+    int64_t d = l ? val : sgn ? (int64_t)(int32_t)val : (int64_t)(uint32_t)val;
+    uint64_t m, ad = !sgn || d > 0 ? d : -d;
+
+    if (d == 0 || d == 1 ||
+        (sgn && (d == -1 || ad == (uint64_t)1 << (bits - 1))))
+        return 0;
+    if (sgn && !(ad & (ad - 1))) {
+        // (a + (a < 0 ? 2^k - 1 : 0)) >> k
+        for (k = 0; (uint64_t)1 << k != ad; k++)
+            ;
+        arm64_gen_shifti(TOK_SAR, l, bits - 1, 30, a);
+        o(0x0b400000 | l << 31 | 30 | a << 5 | (uint32_t)30 << 16 |
+          (bits - k) << 10); // add x30, a, x30, lsr #(bits - k)
+        arm64_gen_shifti(TOK_SAR, l, k, 30, 30);
+        if (d < 0)
+            o(0x4b0003e0 | l << 31 | 30 | (uint32_t)30 << 16); // neg
+    } else if (!sgn) {
+        int add = gen_divmagic(d, bits, 0, &m, &s);
+        arm64_movimm(30, m);
+        if (l)
+            o(0x9bc07c00 | 30 | a << 5 | (uint32_t)30 << 16); // umulh
+        else {
+            o(0x9ba07c00 | 30 | a << 5 | (uint32_t)30 << 16); // umull
+            arm64_gen_shifti(TOK_SHR, 1, add ? 32 : 32 + s, 30, 30);
+        }
+        if (add) {
+            o(0x4b000000 | l << 31 | x | a << 5 | (uint32_t)30 << 16); // sub
+            o(0x0b400000 | l << 31 | 30 | 30 << 5 | x << 16 |
+              1 << 10); // add x30, x30, x, lsr #1
+            arm64_gen_shifti(TOK_SHR, l, s - 1, 30, 30);
+        } else if (l)
+            arm64_gen_shifti(TOK_SHR, l, s, 30, 30);
+    } else {
+        gen_divmagic(d, bits, 1, &m, &s);
+        arm64_movimm(30, m);
+        if (l)
+            o(0x9b407c00 | 30 | a << 5 | (uint32_t)30 << 16); // smulh
+        else {
+            o(0x9b207c00 | 30 | a << 5 | (uint32_t)30 << 16); // smull
+            arm64_gen_shifti(TOK_SAR, 1, 32, 30, 30);
+        }
+        if (d > 0 && m >> (bits - 1))
+            o(0x0b000000 | l << 31 | 30 | 30 << 5 | a << 16); // add
+        if (d < 0 && !(m >> (bits - 1)))
+            o(0x4b000000 | l << 31 | 30 | 30 << 5 | a << 16); // sub
+        arm64_gen_shifti(TOK_SAR, l, s, 30, 30);
+        o(0x0b400000 | l << 31 | 30 | 30 << 5 | (uint32_t)30 << 16 |
+          (bits - 1) << 10); // add x30, x30, x30, lsr #(bits - 1)
+    }
+    if (op == '%' || op == TOK_UMOD) {
+        arm64_movimm(x, l ? d : (uint32_t)d);
+        o(0x1b008000 | l << 31 | x | (uint32_t)30 << 5 |
+          x << 16 | a << 10); // msub
+    } else
+        o(0x2a0003e0 | l << 31 | x | (uint32_t)30 << 16); // mov
+    return 1;
+}
+
 static int arm64_gen_opic(int op, uint32_t l, int rev, uint64_t val,
                           uint32_t x, uint32_t a)
 {
@@ -1616,6 +1809,16 @@ static int arm64_gen_opic(int op, uint32_t l, int rev, uint64_t val,
         return 1;
     }
 
+    case '*':
+        return arm64_gen_mulc(l, l ? val : (int32_t)val, x, a);
+
+    case '/':
+    case '%':
+    case TOK_PDIV:
+    case TOK_UDIV:
+    case TOK_UMOD:
+        return !rev && arm64_gen_divmodc(op, l, val, x, a);
+
     }
     return 0;
 }
@@ -1636,9 +1839,13 @@ static void arm64_gen_opil(int op, uint32_t l)
         if (arm64_iconst(&val, &vtop[-1])) {
             gv(RC_INT);
             a = intr(vtop[0].r);
-            --vtop;
-            x = get_reg(RC_INT);
-            ++vtop;
+            if (op == '%' || op == TOK_UMOD)
+                x = get_reg(RC_INT); // must not be a
+            else {
+                --vtop;
+                x = get_reg(RC_INT);
+                ++vtop;
+            }
             if (arm64_gen_opic(op, l, rev, val, intr(x), a)) {
                 vtop[0].r = x;
                 vswap();
@@ -1881,6 +2088,391 @@ ST_FUNC void gen_cvt_csti(int t)
         | r | r << 5); // [su]xt[bh] w(r),w(r)
 }
 
+/* __builtin_popcount, clz, ctz, ffs, parity or bswap32 ('op' is the
+   int flavour) on the int or long long in vtop */
+ST_FUNC int gen_bitop(int op)
+{
+    uint32_t sf = (vtop->type.t & VT_BTYPE) == VT_LLONG;
+    uint32_t r = intr(gv(RC_INT)), f;
+
+    switch (op) {
+    case TOK_builtin_popcount:
+    case TOK_builtin_parity:
+        --vtop;
+        f = fltr(get_reg(RC_FLOAT));
+        ++vtop;
+        o((sf ? 0x9e670000 : 0x1e270000) | f | r << 5); // fmov [sd](f),[wx](r)
+        o(0x0e205800 | f | f << 5); // cnt v(f).8b,v(f).8b
+        o(0x0e31b800 | f | f << 5); // addv b(f),v(f).8b
+        o(0x1e260000 | r | f << 5); // fmov w(r),s(f)
+        if (op == TOK_builtin_parity)
+            o(0x12000000 | r | r << 5); // and w(r),w(r),#1
+        break;
+    case TOK_builtin_ffs:
+        o(0x7100001f | sf << 31 | r << 5); // cmp [wx](r),#0
+    case TOK_builtin_ctz:
+        o(0x5ac00000 | sf << 31 | r | r << 5); // rbit [wx](r),[wx](r)
+    case TOK_builtin_clz:
+        o(0x5ac01000 | sf << 31 | r | r << 5); // clz [wx](r),[wx](r)
+        if (op == TOK_builtin_ffs) {
+            o(0x11000400 | r | r << 5); // add w(r),w(r),#1
+            o(0x1a9f1000 | r | r << 5); // csel w(r),w(r),wzr,ne
+        }
+        break;
+    default:
+        o((sf ? 0xdac00c00 : 0x5ac00800) | r | r << 5); // rev [wx](r),[wx](r)
+        break;
+    }
+    return 1;
+}
+
+/* ------------------------------------------------------------ */
+/* NEON forms of the vector_size operations on 128-bit vectors with
+   elements of type 't'.  vtop[-1] is a vector, vtop another one or the
+   int count of a shift.  Returns 0 if there is no short sequence. */
+
+ST_FUNC int gen_opv(int op, int t)
+{
+    int bt = t & VT_BTYPE, scalar, swap = 0, inv = 0, neg = 0;
+    uint32_t sz, q, ins = 0, r, r2, c;
+
+    sz = bt == VT_BYTE ? 0 : bt == VT_SHORT ? 1 :
+         bt == VT_INT || bt == VT_FLOAT ? 2 : 3;
+    q = sz << 22;
+    scalar = (vtop->type.t & VT_BTYPE) != VT_STRUCT;
+    if (is_float(bt)) {
+        q = (bt == VT_DOUBLE) << 22;
+        switch (op) {
+        case '+': ins = 0x4e20d400; break; // fadd
+        case '-': ins = 0x4ea0d400; break; // fsub
+        case '*': ins = 0x6e20dc00; break; // fmul
+        case '/': ins = 0x6e20fc00; break; // fdiv
+        case TOK_NE: inv = 1; /* fall through */
+        case TOK_EQ: ins = 0x4e20e400; break; // fcmeq
+        case TOK_LT: swap = 1; /* fall through */
+        case TOK_GT: ins = 0x6ea0e400; break; // fcmgt
+        case TOK_LE: swap = 1; /* fall through */
+        case TOK_GE: ins = 0x6e20e400; break; // fcmge
+        default: return 0;
+        }
+    } else {
+        switch (op) {
+        case '+': ins = 0x4e208400; break; // add
+        case '-': ins = 0x6e208400; break; // sub
+        case '*': ins = sz < 3 ? 0x4e209c00 : 0; break; // mul
+        case '&': ins = 0x4e201c00, q = 0; break; // and
+        case '|': ins = 0x4ea01c00, q = 0; break; // orr
+        case '^': ins = 0x6e201c00, q = 0; break; // eor
+        case TOK_SHR: neg = 1; /* fall through */
+        case TOK_SHL: ins = 0x6e204400; break; // ushl
+        case TOK_SAR: neg = 1, ins = 0x4e204400; break; // sshl
+        case TOK_NE: inv = 1; /* fall through */
+        case TOK_EQ: ins = 0x6e208c00; break; // cmeq
+        case TOK_LT: swap = 1; /* fall through */
+        case TOK_GT: ins = 0x4e203400; break; // cmgt
+        case TOK_LE: swap = 1; /* fall through */
+        case TOK_GE: ins = 0x4e203c00; break; // cmge
+        case TOK_ULT: swap = 1; /* fall through */
+        case TOK_UGT: ins = 0x6e203400; break; // cmhi
+        case TOK_ULE: swap = 1; /* fall through */
+        case TOK_UGE: ins = 0x6e203c00; break; // cmhs
+        }
+        if (!ins)
+            return 0;
+    }
+
+    if (swap)
+        vswap();
+    vtop[-1].type.t = VT_QVEC;
+    if (scalar) {
+        c = vtop->c.i;
+        if ((vtop->r & (VT_VALMASK | VT_LVAL | VT_SYM)) == VT_CONST
+            && (neg ? c - 1 < 8u << sz : c < 8u << sz)) {
+            // shift by an immediate
+            vtop--;
+            r = fltr(gv(RC_FLOAT));
+            if (neg)
+                o((ins == 0x4e204400 ? 0x4f000400 : 0x6f000400) |
+                  ((16 << sz) - c) << 16 | r | r << 5); // [us]shr
+            else
+                o(0x4f005400 | ((8 << sz) + c) << 16 | r | r << 5); // shl
+            return 1;
+        }
+        gv2(RC_FLOAT, RC_INT);
+        r = fltr(vtop[-1].r);
+        r2 = fltr(get_reg(RC_FLOAT));
+        o(0x4e000c00 | 1 << (16 + sz) | r2 | intr(vtop->r) << 5);
+        // dup v(r2),[wx](count)
+    } else {
+        vtop->type.t = VT_QVEC;
+        gv2(RC_FLOAT, RC_FLOAT);
+        r = fltr(vtop[-1].r);
+        r2 = fltr(vtop->r);
+    }
+    if (neg)
+        o(0x6e20b800 | q | r2 | r2 << 5); // neg v(r2),v(r2)
+    o(ins | q | r2 << 16 | r << 5 | r);
+    if (inv)
+        o(0x6e205800 | r | r << 5); // mvn v(r).16b,v(r).16b
+    vtop--;
+    return 1;
+}
+
+/* ------------------------------------------------------------ */
+/* atomic operations on the object of type 't' (a char, short, int or
+   long long for all but plain loads and stores) pointed to by vtop[-1],
+   or by vtop for loads.  Read-modify-write is an ld[a]xr/st[l]xr loop
+   with w30 for the status */
+
+static uint32_t arm64_atomic_sz(int t)
+{
+    int bt = t & VT_BTYPE;
+    return bt == VT_BYTE ? 0 : bt == VT_SHORT ? 1 : bt == VT_LLONG ? 3 : 2;
+}
+
+/* the pointer in vtop is replaced by the old value in 'r' */
+static void gen_atomic_result(int r, int t)
+{
+    vtop->r = r;
+    vtop->r2 = VT_CONST;
+    vtop->type.t = VT_INT;
+    if (((t & VT_BTYPE) == VT_BYTE || (t & VT_BTYPE) == VT_SHORT)
+        && !(t & VT_UNSIGNED))
+        gen_cvt_csti(t); /* the loads zero extend */
+    vtop->type.t = t;
+}
+
+/* a scratch register, kept on the stack until the caller drops it */
+static int gen_atomic_reg(void)
+{
+    int r = get_reg(RC_INT);
+    vpushi(0);
+    vtop->r = r;
+    return r;
+}
+
+/* ld[a]xr r, [p] and st[l]xr w30, v, [p] */
+static void gen_atomic_ldx(uint32_t sz, int order, uint32_t r, uint32_t p)
+{
+    o(0x085f7c00 | sz << 30 | (order != MO_RELAXED && order != MO_RELEASE) << 15
+      | p << 5 | r);
+}
+
+static void gen_atomic_stx(uint32_t sz, int order, uint32_t v, uint32_t p)
+{
+    o(0x08007c00 | sz << 30 | (order >= MO_RELEASE) << 15 | 30 << 16
+      | p << 5 | v);
+}
+
+ST_FUNC void gen_atomic_load(int t, int order)
+{
+    uint32_t p;
+    int r;
+
+    if (is_float(t) || order == MO_RELAXED) {
+        if (order == MO_SEQ_CST)
+            gen_atomic_fence(order);
+        indir();
+        gv(is_float(t) ? RC_FLOAT : RC_INT);
+        gen_atomic_fence(order);
+        return;
+    }
+    p = intr(gv(RC_INT));
+    r = get_reg(RC_INT);
+    o(0x08dffc00 | arm64_atomic_sz(t) << 30 | p << 5 | intr(r)); // ldar
+    gen_atomic_result(r, t);
+}
+
+ST_FUNC void gen_atomic_store(int t, int order)
+{
+    uint32_t p, v;
+
+    if (is_float(t) || order == MO_RELAXED) {
+        if (order != MO_RELAXED)
+            gen_atomic_fence(MO_SEQ_CST);
+        vswap();
+        indir();
+        vswap();
+        vstore();
+        vpop();
+        if (order == MO_SEQ_CST)
+            gen_atomic_fence(order);
+        return;
+    }
+    gv2(RC_INT, RC_INT);
+    p = intr(vtop[-1].r);
+    v = intr(vtop->r);
+    o(0x089ffc00 | arm64_atomic_sz(t) << 30 | p << 5 | v); // stlr
+    vtop -= 2;
+}
+
+ST_FUNC int gen_atomic_rmw(int op, int t, int order)
+{
+    uint32_t sz = arm64_atomic_sz(t), sf = sz == 3, p, v, n;
+    int r, a;
+
+    gv2(RC_INT, RC_INT);
+    p = intr(vtop[-1].r);
+    v = intr(vtop->r);
+    r = gen_atomic_reg();
+    n = op == '=' ? v : intr(gen_atomic_reg());
+    vtop -= 1 + (op != '=');
+    a = ind;
+    gen_atomic_ldx(sz, order, intr(r), p);
+    switch (op) {
+    case '+':
+        o(0x0b000000 | sf << 31 | v << 16 | intr(r) << 5 | n); // add
+        break;
+    case '-':
+        o(0x4b000000 | sf << 31 | v << 16 | intr(r) << 5 | n); // sub
+        break;
+    case '|':
+        o(0x2a000000 | sf << 31 | v << 16 | intr(r) << 5 | n); // orr
+        break;
+    case '^':
+        o(0x4a000000 | sf << 31 | v << 16 | intr(r) << 5 | n); // eor
+        break;
+    case '&':
+    case '~':
+        o(0x0a000000 | sf << 31 | v << 16 | intr(r) << 5 | n); // and
+        if (op == '~')
+            o(0x2a2003e0 | sf << 31 | n << 16 | n); // mvn
+        break;
+    }
+    gen_atomic_stx(sz, order, n, p);
+    o(0x35000000 | ((a - ind) >> 2 & 0x7ffff) << 5 | 30); // cbnz w30,a
+    vtop--;
+    gen_atomic_result(r, t);
+    return 1;
+}
+
+ST_FUNC void gen_atomic_cas(int t, int order)
+{
+    uint32_t sz = arm64_atomic_sz(t), p, e, d;
+    int r, a;
+
+    vrotb(3);
+    gv(RC_INT);
+    vrotb(3);
+    gv(RC_INT);
+    vrotb(3);
+    gv(RC_INT);
+    p = intr(vtop[-2].r);
+    e = intr(vtop[-1].r);
+    d = intr(vtop->r);
+    r = gen_atomic_reg();
+    vtop--;
+    a = ind;
+    gen_atomic_ldx(sz, order, intr(r), p);
+    if (sz < 2)
+        o(0x6b20001f | sz << 13 | e << 16 | intr(r) << 5); // cmp w(r),w(e),uxt[bh]
+    else
+        o(0x6b00001f | (sz == 3) << 31 | e << 16 | intr(r) << 5); // cmp
+    o(0x54000061); // b.ne .+12
+    gen_atomic_stx(sz, order, d, p);
+    o(0x35000000 | ((a - ind) >> 2 & 0x7ffff) << 5 | 30); // cbnz w30,a
+    vtop -= 2;
+    gen_atomic_result(r, t);
+}
+
+ST_FUNC void gen_atomic_fence(int order)
+{
+    if (order == MO_ACQUIRE || order == MO_CONSUME)
+        o(0xd50339bf); // dmb ishld
+    else if (order != MO_RELAXED)
+        o(0xd5033bbf); // dmb ish
+}
+
+// Copy 'size' bytes from the address in vtop to the address in
+// vtop[-1], 16 at a time with ldp/stp, and pop both.  The last move
+// may overlap the one before.
+ST_FUNC void gen_struct_copy(int size)
+{
+    uint32_t d, s, r;
+    int c, sz;
+
+    gv2(RC_INT, RC_INT);
+    d = intr(vtop[-1].r);
+    s = intr(vtop->r);
+    r = intr(get_reg(RC_INT));
+    for (c = 0; c + 16 <= size; c += 16) {
+        o(0xa9400000 | c / 8 << 15 | r << 10 | s << 5 | 30); // ldp x30,x(r),[x(s),#(c)]
+        o(0xa9000000 | c / 8 << 15 | r << 10 | d << 5 | 30); // stp x30,x(r),[x(d),#(c)]
+    }
+    for (sz = 3; 1 << sz > size; sz--)
+        ;
+    for (; c < size; c += 1 << sz) {
+        if (c + (1 << sz) > size)
+            c = size - (1 << sz);
+        arm64_ldrx(0, sz, r, s, c);
+        arm64_strx(sz, r, d, c);
+    }
+    vtop -= 2;
+}
+
+// Clear 'size' bytes at the address in vtop and pop it:
+ST_FUNC void gen_struct_zero(int size)
+{
+    uint32_t d = intr(gv(RC_INT));
+    int c, sz;
+
+    for (c = 0; c + 16 <= size; c += 16)
+        o(0xa9007c00 | c / 8 << 15 | d << 5 | 31); // stp xzr,xzr,[x(d),#(c)]
+    for (sz = 3; 1 << sz > size; sz--)
+        ;
+    for (; c < size; c += 1 << sz) {
+        if (c + (1 << sz) > size)
+            c = size - (1 << sz);
+        arm64_strx(sz, 31, d, c); // str xzr
+    }
+    vtop--;
+}
+
+#ifdef CONFIG_SWIRL_THREAD_LOCAL
+// Push the address of the thread-local 'sym' in this thread:
+ST_FUNC void gen_tls_addr(Sym *sym, int model)
+{
+    int r;
+    uint32_t x;
+
+    if (model == TLS_GD) {
+        save_regs(0);
+        greloca(cur_text_section, sym, ind, R_AARCH64_TLSGD_ADR_PAGE21, 0);
+        o(0x90000000); // adrp x0, :tlsgd:sym
+        greloca(cur_text_section, sym, ind, R_AARCH64_TLSGD_ADD_LO12_NC, 0);
+        o(0x91000000); // add x0, x0, :tlsgd_lo12:sym
+        greloca(cur_text_section, external_helper_sym(TOK___tls_get_addr),
+                ind, R_AARCH64_CALL26, 0);
+        o(0x94000000); // bl __tls_get_addr
+        o(0xd503201f); // nop, for linker relaxation
+        r = REG_IRET;
+    } else {
+        r = get_reg(RC_INT);
+        x = intr(r);
+        if (model == TLS_IE) {
+            greloca(cur_text_section, sym, ind,
+                    R_AARCH64_TLSIE_ADR_GOTTPREL_PAGE21, 0);
+            o(0x90000000 | x); // adrp xr, :gottprel:sym
+            greloca(cur_text_section, sym, ind,
+                    R_AARCH64_TLSIE_LD64_GOTTPREL_LO12_NC, 0);
+            o(0xf9400000 | x | x << 5); // ldr xr, [xr, :gottprel_lo12:sym]
+            o(0xd53bd05e); // mrs x30, tpidr_el0
+            o(0x8b1e0000 | x | x << 5); // add xr, xr, x30
+        } else {
+            o(0xd53bd040 | x); // mrs xr, tpidr_el0
+            greloca(cur_text_section, sym, ind,
+                    R_AARCH64_TLSLE_ADD_TPREL_HI12, 0);
+            o(0x91400000 | x | x << 5); // add xr, xr, :tprel_hi12:sym
+            greloca(cur_text_section, sym, ind,
+                    R_AARCH64_TLSLE_ADD_TPREL_LO12_NC, 0);
+            o(0x91000000 | x | x << 5); // add xr, xr, :tprel_lo12_nc:sym
+        }
+    }
+    vpushi(0);
+    vtop->r = r;
+}
+#endif
+
 ST_FUNC void gen_cvt_itof(int t)
 {
     if (t == VT_LDOUBLE) {
@@ -8,6 +8,9 @@
 #define R_GLOB_DAT R_AARCH64_GLOB_DAT
 #define R_COPY     R_AARCH64_COPY
 #define R_RELATIVE R_AARCH64_RELATIVE
+#define R_DTPMOD   R_AARCH64_TLS_DTPMOD64
+#define R_DTPOFF   R_AARCH64_TLS_DTPREL64
+#define R_TPOFF    R_AARCH64_TLS_TPREL64
 
 #define R_NUM      R_AARCH64_NUM
 
@@ -44,6 +47,15 @@ int code_reloc (int reloc_type)
         case R_AARCH64_LDST8_ABS_LO12_NC:
         case R_AARCH64_GLOB_DAT:
         case R_AARCH64_COPY:
+        case R_AARCH64_TLSGD_ADR_PAGE21:
+        case R_AARCH64_TLSGD_ADD_LO12_NC:
+        case R_AARCH64_TLSIE_ADR_GOTTPREL_PAGE21:
+        case R_AARCH64_TLSIE_LD64_GOTTPREL_LO12_NC:
+        case R_AARCH64_TLSLE_ADD_TPREL_HI12:
+        case R_AARCH64_TLSLE_ADD_TPREL_LO12_NC:
+        case R_AARCH64_TLS_DTPMOD64:
+        case R_AARCH64_TLS_DTPREL64:
+        case R_AARCH64_TLS_TPREL64:
             return 0;
 
         case R_AARCH64_JUMP26:
@@ -75,6 +87,11 @@ int gotplt_entry_type (int reloc_type)
         case R_AARCH64_GLOB_DAT:
         case R_AARCH64_JUMP_SLOT:
         case R_AARCH64_COPY:
+        case R_AARCH64_TLSLE_ADD_TPREL_HI12:
+        case R_AARCH64_TLSLE_ADD_TPREL_LO12_NC:
+        case R_AARCH64_TLS_DTPMOD64:
+        case R_AARCH64_TLS_DTPREL64:
+        case R_AARCH64_TLS_TPREL64:
             return NO_GOTPLT_ENTRY;
 
         case R_AARCH64_ABS32:
@@ -86,6 +103,14 @@ int gotplt_entry_type (int reloc_type)
         case R_AARCH64_ADR_GOT_PAGE:
         case R_AARCH64_LD64_GOT_LO12_NC:
             return ALWAYS_GOTPLT_ENTRY;
+
+        case R_AARCH64_TLSIE_ADR_GOTTPREL_PAGE21:
+        case R_AARCH64_TLSIE_LD64_GOTTPREL_LO12_NC:
+            return TLS_IE_GOT_ENTRY;
+
+        case R_AARCH64_TLSGD_ADR_PAGE21:
+        case R_AARCH64_TLSGD_ADD_LO12_NC:
+            return TLS_GD_GOT_ENTRY;
     }
     return -1;
 }
@@ -294,6 +319,59 @@ void relocate(SwirlState *s1, ElfW_Rel *rel, int type, unsigned char *ptr, addr_
                        ((s1->got->sh_addr +
                          get_sym_attr(s1, sym_index, 0)->got_offset) & 0xff8) << 7));
             return;
+        case R_AARCH64_TLSGD_ADR_PAGE21:
+            val = s1->got->sh_addr +
+                get_sym_attr(s1, sym_index, 0)->tls_gd_offset;
+            goto tls_page;
+        case R_AARCH64_TLSIE_ADR_GOTTPREL_PAGE21:
+            val = s1->got->sh_addr +
+                get_sym_attr(s1, sym_index, 0)->tls_ie_offset;
+        tls_page: {
+            uint64_t off = (val >> 12) - (addr >> 12);
+            if ((off + ((uint64_t)1 << 20)) >> 21)
+                swirl_error("R_AARCH64_TLS page relocation failed");
+            write32le(ptr, ((read32le(ptr) & 0x9f00001f) |
+                            (off & 0x1ffffc) << 3 | (off & 3) << 29));
+            return;
+        }
+        case R_AARCH64_TLSGD_ADD_LO12_NC:
+            write32le(ptr,
+                      ((read32le(ptr) & 0xffc003ff) |
+                       ((s1->got->sh_addr +
+                         get_sym_attr(s1, sym_index, 0)->tls_gd_offset) & 0xfff) << 10));
+            return;
+        case R_AARCH64_TLSIE_LD64_GOTTPREL_LO12_NC:
+            write32le(ptr,
+                      ((read32le(ptr) & 0xfff803ff) |
+                       ((s1->got->sh_addr +
+                         get_sym_attr(s1, sym_index, 0)->tls_ie_offset) & 0xff8) << 7));
+            return;
+        case R_AARCH64_TLSLE_ADD_TPREL_HI12:
+        case R_AARCH64_TLSLE_ADD_TPREL_LO12_NC:
+            if (s1->output_type != SWIRL_OUTPUT_EXE)
+                swirl_error("local-exec TLS access needs an executable, "
+                            "recompile with -fPIC");
+            val = tls_tpoff(s1, val);
+            if (type == R_AARCH64_TLSLE_ADD_TPREL_HI12) {
+                if (val >> 24)
+                    swirl_error("R_AARCH64_TLSLE_ADD_TPREL_HI12 relocation failed");
+                val >>= 12;
+            }
+            write32le(ptr, ((read32le(ptr) & 0xffc003ff) |
+                            (val & 0xfff) << 10));
+            return;
+        case R_AARCH64_TLS_DTPMOD64:
+            write64le(ptr, tls_module(s1));
+            return;
+        case R_AARCH64_TLS_DTPREL64:
+            add64le(ptr, tls_dtpoff(s1, val));
+            return;
+        case R_AARCH64_TLS_TPREL64:
+            if (s1->output_type != SWIRL_OUTPUT_EXE)
+                swirl_error("initial-exec TLS access needs an executable, "
+                            "recompile with -fPIC");
+            write64le(ptr, tls_tpoff(s1, val));
+            return;
         case R_AARCH64_COPY:
             return;
         case R_AARCH64_GLOB_DAT:
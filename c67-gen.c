@@ -158,11 +158,11 @@ do {\
 } while (0)
 
 /******************************************************/
-static unsigned long func_sub_sp_offset;
-static int func_ret_sub;
+static ST_TLS unsigned long func_sub_sp_offset;
+static ST_TLS int func_ret_sub;
 
-static BOOL C67_invert_test;
-static int C67_compare_reg;
+static ST_TLS BOOL C67_invert_test;
+static ST_TLS int C67_compare_reg;
 
 #ifdef ASSEMBLY_LISTING_C67
 FILE *f = NULL;
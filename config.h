@@ -0,0 +1,11 @@
+/* Automatically generated by configure - do not modify */
+#ifndef CONFIG_SWIRLDIR
+# define CONFIG_SWIRLDIR "/usr/local/lib/swirl"
+#endif
+#ifndef CONFIG_SWIRL_PREDEFS
+# define CONFIG_SWIRL_PREDEFS 1
+#endif
+#define SWIRL_VERSION "1.0.0"
+#define GCC_MAJOR 12
+#define GCC_MINOR 2
+#define CC_NAME CC_gcc
@@ -0,0 +1,25 @@
+# Automatically generated by configure - do not modify
+prefix=/usr/local
+bindir=$(DESTDIR)/usr/local/bin
+swirldir=$(DESTDIR)/usr/local/lib/swirl
+libdir=$(DESTDIR)/usr/local/lib
+includedir=$(DESTDIR)/usr/local/include
+mandir=$(DESTDIR)/usr/local/share/man
+infodir=$(DESTDIR)/usr/local/share/info
+docdir=$(DESTDIR)/usr/local/share/doc
+CC=gcc
+CC_NAME=gcc
+GCC_MAJOR=12
+GCC_MINOR=2
+AR=ar
+STRIP=strip -s -R .comment -R .note
+CFLAGS=-Wall -O2 -Wdeclaration-after-statement -fno-strict-aliasing -Wno-pointer-sign -Wno-sign-compare -Wno-unused-result -Wno-format-truncation
+LDFLAGS=
+LIBSUF=.a
+EXESUF=
+DLLSUF=.so
+NATIVE_DEFINES+=-DCONFIG_TRIPLET="\"x86_64-linux-gnu\""
+ARCH=x86_64
+TARGETOS=Linux
+VERSION = 1.0.0
+TOPSRC=$(TOP)
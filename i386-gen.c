@@ -59,6 +59,16 @@ enum {
    at caller side (for interfacing with non-SWIRL compilers) */
 #define PROMOTE_RET
 
+/* no CONFIG_SWIRL_PEEPHOLE: the jump shortening of x86_64-gen.c decodes
+   x86_64 instructions only.  Here forward jumps keep their rel32. */
+
+/* __builtin_popcount & co are open coded */
+#define CONFIG_SWIRL_BITOPS
+/* atomic operations are open coded */
+#define CONFIG_SWIRL_ATOMIC
+/* struct copies and clears up to that size are open coded */
+#define CONFIG_SWIRL_STRUCT_COPY 64
+
 /******************************************************/
 #else /* ! TARGET_DEFS_ONLY */
 /******************************************************/
@@ -81,11 +91,11 @@ ST_DATA const int reg_classes[NB_REGS] = {
     /* st0 */ RC_FLOAT | RC_ST0,
 };
 
-static unsigned long func_sub_sp_offset;
-static int func_ret_sub;
+static ST_TLS unsigned long func_sub_sp_offset;
+static ST_TLS int func_ret_sub;
 #ifdef CONFIG_SWIRL_BCHECK
-static addr_t func_bound_offset;
-static unsigned long func_bound_ind;
+static ST_TLS addr_t func_bound_offset;
+static ST_TLS unsigned long func_bound_ind;
 ST_DATA int func_bound_add_epilog;
 static void gen_bounds_prolog(void);
 static void gen_bounds_epilog(void);
@@ -1007,6 +1017,228 @@ ST_FUNC void gen_cvt_csti(int t)
         );
 }
 
+/* __builtin_popcount, clz, ctz, ffs, parity or bswap32 ('op' is the
+   int flavour) on the value in vtop.  Returns 0 to have it done by
+   libswirl1. */
+ST_FUNC int gen_bitop(int op)
+{
+    int r, r2;
+
+    if ((vtop->type.t & VT_BTYPE) == VT_LLONG
+        || (op == TOK_builtin_popcount && !swirl_state->popcnt))
+        return 0;
+    r = gv(RC_INT);
+    if (op == TOK_builtin_bswap32) {
+        o(0xc80f + r * 0x100); /* bswap r */
+        return 1;
+    }
+    r2 = get_reg(RC_INT);
+    switch (op) {
+    case TOK_builtin_popcount:
+        o(0xb80ff3); /* popcnt r, r2 */
+        break;
+    case TOK_builtin_clz:
+        if (swirl_state->lzcnt) {
+            o(0xbd0ff3); /* lzcnt r, r2 */
+            break;
+        }
+        o(0xbd0f); /* bsr r, r2 */
+        o(0xc0 + r + r2 * 8);
+        o(0xf083 + r2 * 0x100); /* xor $31, r2 */
+        g(31);
+        vtop->r = r2;
+        return 1;
+    case TOK_builtin_ctz:
+        o(0xbc0ff3); /* tzcnt r, r2, which is bsf on old cpus */
+        break;
+    case TOK_builtin_ffs:
+        o(0xbc0f); /* bsf r, r2 */
+        o(0xc0 + r + r2 * 8);
+        o(0x0575); /* jne 1f */
+        o(0xb8 + r2); /* mov $-1, r2 */
+        gen_le32(-1);
+        o(0x40 + r2); /* 1: inc r2 */
+        vtop->r = r2;
+        return 1;
+    default: /* parity */
+        o(0xc089 + (r * 8 + r2) * 0x100); /* mov r, r2 */
+        o(0xe8c1 + r2 * 0x100); /* shr $16, r2 */
+        g(16);
+        o(0xc031 + (r2 * 8 + r) * 0x100); /* xor r2, r */
+        o(0xc089 + (r * 8 + r2) * 0x100);
+        o(0xe8c1 + r2 * 0x100);
+        g(8);
+        o(0xc031 + (r2 * 8 + r) * 0x100); /* PF is the parity of the low byte */
+        o(0x9b0f); /* setnp r2 */
+        o(0xc0 + r2);
+        o(0xb60f); /* movzbl r2, r2 */
+        o(0xc0 + r2 * 9);
+        vtop->r = r2;
+        return 1;
+    }
+    o(0xc0 + r + r2 * 8);
+    vtop->r = r2;
+    return 1;
+}
+
+/* ------------------------------------------------------------ */
+/* atomic operations on the object of type 't' (a char, short or int for
+   all but plain loads and stores) pointed to by vtop[-1], or by vtop for
+   loads.  The pointer goes to %ecx, the operand to %edx and the expected
+   value of cmpxchg to %eax */
+
+/* [lock] opc %dl/%dx/%edx, (%ecx) */
+static void gen_atomic_insn(int opc, int t)
+{
+    int bt = t & VT_BTYPE;
+
+    if (opc != 0x86) /* xchg with memory is always locked */
+        o(0xf0);
+    if (bt == VT_SHORT)
+        o(0x66);
+    if (bt != VT_BYTE)
+        opc += opc > 0xff ? 0x100 : 1;
+    o(opc);
+    o(0x11);
+}
+
+/* the pointer in vtop is replaced by the old value in 'r' */
+static void gen_atomic_result(int r, int t)
+{
+    vtop->r = r;
+    vtop->r2 = VT_CONST;
+    vtop->type.t = VT_INT;
+    if ((t & VT_BTYPE) == VT_BYTE || (t & VT_BTYPE) == VT_SHORT)
+        gen_cvt_csti(t);
+    vtop->type.t = t;
+}
+
+ST_FUNC void gen_atomic_load(int t, int order)
+{
+    /* plain loads are acquire loads on x86 */
+    indir();
+    gv(is_float(t) ? RC_FLOAT : RC_INT);
+}
+
+ST_FUNC void gen_atomic_store(int t, int order)
+{
+    if (order == MO_SEQ_CST && !is_float(t)) {
+        gv2(RC_ECX, RC_EDX);
+        gen_atomic_insn(0x86, t); /* xchg */
+        vtop -= 2;
+        return;
+    }
+    vswap();
+    indir();
+    vswap();
+    vstore();
+    vpop();
+    gen_atomic_fence(order);
+}
+
+ST_FUNC int gen_atomic_rmw(int op, int t, int order)
+{
+    if (op != '=' && op != '+' && op != '-')
+        return 0; /* the caller loops with cmpxchg */
+    gv2(RC_ECX, RC_EDX);
+    if (op == '-')
+        o(0xdaf7); /* neg %edx */
+    gen_atomic_insn(op == '=' ? 0x86 : 0xc00f, t); /* xchg or xadd */
+    vtop--;
+    gen_atomic_result(TREG_EDX, t);
+    return 1;
+}
+
+ST_FUNC void gen_atomic_cas(int t, int order)
+{
+    vrotb(3);
+    gv(RC_ECX);
+    vrotb(3);
+    gv(RC_EAX);
+    vrotb(3);
+    gv(RC_EDX);
+    gen_atomic_insn(0xb00f, t); /* cmpxchg */
+    vtop -= 2;
+    gen_atomic_result(TREG_EAX, t);
+}
+
+ST_FUNC void gen_atomic_fence(int order)
+{
+    /* only stores followed by loads can be reordered */
+    if (order == MO_SEQ_CST) {
+        o(0x240c83f0); /* lock orl $0, (%esp) */
+        g(0);
+    }
+}
+
+/* op with register 'r' and the memory 'c' bytes after the address in
+   'sv', a local variable or a register */
+static void gen_mem_op(int pfx, int op, int r, SValue *sv, int c)
+{
+    if (pfx)
+        o(pfx);
+    o(op);
+    if (sv->r == VT_LOCAL) {
+        gen_modrm(r, VT_LOCAL, NULL, sv->c.i + c);
+        return;
+    }
+    /* no %esp or %ebp in RC_INT, hence no sib */
+    r = r << 3 | sv->r;
+    if (c == 0)
+        g(r);
+    else if (c == (char)c)
+        g(0x40 | r), g(c);
+    else
+        g(0x80 | r), gen_le32(c);
+}
+
+/* copy 'size' bytes with the widest moves that fit, the last one
+   overlapping the one before if needed.  s == NULL clears with the
+   zero in 'r'. */
+static void gen_moves(int size, int r, SValue *d, SValue *s)
+{
+    int n, c;
+
+    for (n = 4; n > size; n >>= 1)
+        ;
+    for (c = 0; c < size; c += n) {
+        if (c + n > size)
+            c = size - n;
+        if (s)
+            gen_mem_op(n == 2 ? 0x66 : 0, n == 1 ? 0xb60f : 0x8b, r, s, c);
+        gen_mem_op(n == 2 ? 0x66 : 0, n == 1 ? 0x88 : 0x89, r, d, c);
+    }
+}
+
+/* copy 'size' bytes from the address in vtop to the address in
+   vtop[-1] and pop both */
+ST_FUNC void gen_struct_copy(int size)
+{
+    /* locals are addressed through %ebp */
+    if (vtop[-1].r != VT_LOCAL) {
+        vswap();
+        gv(RC_INT);
+        vswap();
+    }
+    if (vtop->r != VT_LOCAL)
+        gv(RC_INT);
+    gen_moves(size, get_reg(RC_INT), vtop - 1, vtop);
+    vtop -= 2;
+}
+
+/* clear 'size' bytes at the address in vtop and pop it */
+ST_FUNC void gen_struct_zero(int size)
+{
+    int r;
+
+    if (vtop->r != VT_LOCAL)
+        gv(RC_INT);
+    r = get_reg(RC_INT);
+    o(0xc031 + r * 0x900); /* xor %r, %r */
+    gen_moves(size, r, vtop, NULL);
+    vtop--;
+}
+
 /* computed goto support */
 ST_FUNC void ggoto(void)
 {
@@ -57,6 +57,12 @@
     #define __ORDER_LITTLE_ENDIAN__ 1234
     #define __ORDER_BIG_ENDIAN__ 4321
     #define __BYTE_ORDER__ __ORDER_LITTLE_ENDIAN__
+    #define __ATOMIC_RELAXED 0
+    #define __ATOMIC_CONSUME 1
+    #define __ATOMIC_ACQUIRE 2
+    #define __ATOMIC_RELEASE 3
+    #define __ATOMIC_ACQ_REL 4
+    #define __ATOMIC_SEQ_CST 5
 #if defined _WIN32
     #define __WCHAR_TYPE__ unsigned short
     #define __WINT_TYPE__ unsigned short
@@ -69,7 +75,9 @@
 #endif
 
     #if __STDC_VERSION__ == 201112L
+#if !defined __i386__ && !defined __x86_64__ && !defined __aarch64__
     # define __STDC_NO_ATOMICS__ 1
+#endif
     # define __STDC_NO_COMPLEX__ 1
     # define __STDC_NO_THREADS__ 1
 #if !defined _WIN32
@@ -79,7 +79,7 @@ union float_long {
 };
 
 /* doesn't support several builtin supports for now */
-#if !defined __x86_64__ && !defined __arm__
+#if !defined __x86_64__ && !defined __arm__ && !defined __riscv
 
 /* use gcc/swirl intrinsic? */
 #if defined __i386__
@@ -598,6 +598,85 @@ long long __fixxfdi (long double a1)
 }
 #endif /* !ARM */
 
+/* __builtin_popcount & co, when not open coded */
+int __popcountsi2(unsigned int a)
+{
+    int n = 0;
+    for (; a; a &= a - 1)
+        n++;
+    return n;
+}
+
+int __popcountdi2(unsigned long long a)
+{
+    return __popcountsi2(a) + __popcountsi2(a >> 32);
+}
+
+int __clzsi2(unsigned int a)
+{
+    int n = 0;
+    if (!(a & 0xffff0000)) n += 16, a <<= 16;
+    if (!(a & 0xff000000)) n += 8, a <<= 8;
+    if (!(a & 0xf0000000)) n += 4, a <<= 4;
+    if (!(a & 0xc0000000)) n += 2, a <<= 2;
+    if (!(a & 0x80000000)) n += 1, a <<= 1;
+    return n + !a;
+}
+
+int __clzdi2(unsigned long long a)
+{
+    return a >> 32 ? __clzsi2(a >> 32) : 32 + __clzsi2(a);
+}
+
+int __ctzsi2(unsigned int a)
+{
+    int n = 0;
+    if (!(a & 0xffff)) n += 16, a >>= 16;
+    if (!(a & 0xff)) n += 8, a >>= 8;
+    if (!(a & 0xf)) n += 4, a >>= 4;
+    if (!(a & 0x3)) n += 2, a >>= 2;
+    if (!(a & 0x1)) n += 1, a >>= 1;
+    return n + !a;
+}
+
+int __ctzdi2(unsigned long long a)
+{
+    return (unsigned)a ? __ctzsi2(a) : 32 + __ctzsi2(a >> 32);
+}
+
+int __ffssi2(unsigned int a)
+{
+    return a ? __ctzsi2(a) + 1 : 0;
+}
+
+int __ffsdi2(unsigned long long a)
+{
+    return a ? __ctzdi2(a) + 1 : 0;
+}
+
+int __paritysi2(unsigned int a)
+{
+    a ^= a >> 16;
+    a ^= a >> 8;
+    a ^= a >> 4;
+    return 0x6996 >> (a & 15) & 1;
+}
+
+int __paritydi2(unsigned long long a)
+{
+    return __paritysi2(a ^ a >> 32);
+}
+
+unsigned int __bswapsi2(unsigned int a)
+{
+    return a >> 24 | (a >> 8 & 0xff00) | (a & 0xff00) << 8 | a << 24;
+}
+
+unsigned long long __bswapdi2(unsigned long long a)
+{
+    return (unsigned long long)__bswapsi2(a) << 32 | __bswapsi2(a >> 32);
+}
+
 #if defined __x86_64__
 /* float constants used for unary minus operation */
 const float __mzerosf = -0.0;
@@ -52,10 +52,11 @@
 
 /* XXX: get rid of this ASAP (or maybe not) */
 ST_DATA struct SwirlState *swirl_state;
+ST_DATA unsigned obj_cache_hits, obj_cache_misses;
+ST_DATA unsigned mem_nb_allocs;
 
-#ifdef MEM_DEBUG
-static int nb_states;
-#endif
+/* states of this thread, the include cache goes with the last one */
+static ST_TLS int nb_states;
 
 /********************************************************/
 #ifdef _WIN32
@@ -102,7 +103,8 @@ BOOL WINAPI DllMain (HINSTANCE hDll, DWORD dwReason, LPVOID lpReserved)
 #endif
 
 /********************************************************/
-#if CONFIG_SWIRL_SEMLOCK == 0
+#if CONFIG_SWIRL_SEMLOCK == 0 || CONFIG_SWIRL_TLS
+/* no lock needed when the compiler state is thread local */
 #define WAIT_SEM()
 #define POST_SEM()
 #elif defined _WIN32
@@ -222,6 +224,7 @@ PUB_FUNC void *swirl_malloc(unsigned long size)
     ptr = malloc(size);
     if (!ptr && size)
         _swirl_error("memory full (malloc)");
+    ++mem_nb_allocs;
     return ptr;
 }
 
@@ -237,6 +240,8 @@ PUB_FUNC void *swirl_mallocz(unsigned long size)
 PUB_FUNC void *swirl_realloc(void *ptr, unsigned long size)
 {
     void *ptr1;
+    if (!ptr)
+        ++mem_nb_allocs;
     ptr1 = realloc(ptr, size);
     if (!ptr1 && size)
         _swirl_error("memory full (realloc)");
@@ -324,6 +329,7 @@ PUB_FUNC void *swirl_malloc_debug(unsigned long size, const char *file, int line
     mem_cur_size += size;
     if (mem_cur_size > mem_max_size)
         mem_max_size = mem_cur_size;
+    ++mem_nb_allocs;
 
     return MEM_USER_PTR(header);
 }
@@ -530,6 +536,8 @@ static void error1(int mode, const char *fmt, va_list ap)
             return;
         if (s1->warn_error)
             mode = ERROR_ERROR;
+        else
+            s1->nb_warnings++;
     }
 
     f = NULL;
@@ -621,12 +629,16 @@ PUB_FUNC void _swirl_warning(const char *fmt, ...)
 /********************************************************/
 /* I/O layer */
 
+#ifndef _WIN32
+# include <sys/mman.h>
+#endif
+
 ST_FUNC void swirl_open_bf(SwirlState *s1, const char *filename, int initlen)
 {
     BufferedFile *bf;
     int buflen = initlen ? initlen : IO_BUF_SIZE;
 
-    bf = swirl_mallocz(sizeof(BufferedFile) + buflen);
+    bf = swirl_mallocz(sizeof(BufferedFile) + buflen + IO_BUF_PAD);
     bf->buf_ptr = bf->buffer;
     bf->buf_end = bf->buffer + initlen;
     bf->buf_end[0] = CH_EOB; /* put eob symbol */
@@ -647,16 +659,56 @@ ST_FUNC void swirl_close(void)
 {
     SwirlState *s1 = swirl_state;
     BufferedFile *bf = file;
-    if (bf->fd > 0) {
+    if (bf->fd > 0)
         close(bf->fd);
+    if (bf->fd > 0 || bf->tcp)
         total_lines += bf->line_num;
-    }
+#ifndef _WIN32
+    if (bf->map)
+        munmap(bf->map, bf->map_size);
+#endif
     if (bf->true_filename != bf->filename)
         swirl_free(bf->true_filename);
     file = bf->prev;
     swirl_free(bf);
 }
 
+/* scan big files in place rather than read() them in IO_BUF_SIZE chunks.
+   The file is mapped copy-on-write since the lexer may put back a char,
+   and is followed by at least one zero byte for the CH_EOB. */
+ST_FUNC void swirl_map(SwirlState *s1, BufferedFile *bf)
+{
+#ifndef _WIN32
+    struct stat st;
+    size_t size, pagesize;
+    unsigned char *p;
+
+    if (fstat(bf->fd, &st) < 0 || !S_ISREG(st.st_mode)
+        || st.st_size < MMAP_MIN_SIZE)
+        return;
+    pagesize = sysconf(_SC_PAGESIZE);
+    size = (st.st_size + pagesize) & ~(pagesize - 1);
+    /* reserve the room with the extra page, then map the file over it */
+    p = mmap(NULL, size, PROT_READ | PROT_WRITE,
+             MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED)
+        return;
+    if (mmap(p, st.st_size, PROT_READ | PROT_WRITE,
+             MAP_PRIVATE | MAP_FIXED, bf->fd, 0) == MAP_FAILED) {
+        munmap(p, size);
+        return;
+    }
+    /* read() sees the end of file from now on */
+    lseek(bf->fd, 0, SEEK_END);
+    bf->map = p;
+    bf->map_size = size;
+    bf->buf_ptr = p;
+    bf->buf_end = p + st.st_size;
+    *bf->buf_end = CH_EOB;
+    total_bytes += st.st_size;
+#endif
+}
+
 static int _swirl_open(SwirlState *s1, const char *filename)
 {
     int fd;
@@ -680,34 +732,202 @@ ST_FUNC int swirl_open(SwirlState *s1, const char *filename)
     return 0;
 }
 
+/* copy a file, into a temporary first so that readers never see it
+   half written */
+ST_FUNC int swirl_copy_file(SwirlState *s1, const char *from, const char *to)
+{
+    char tmp[1024], buf[IO_BUF_SIZE];
+    int fd, fo, n, ret, phase;
+
+    fd = open(from, O_RDONLY | O_BINARY);
+    if (fd < 0)
+        return -1;
+    phase = swirl_bench(s1, BENCH_OUTPUT);
+    snprintf(tmp, sizeof tmp, "%s.tmp%d", to, (int)getpid());
+    fo = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_BINARY, 0666);
+    ret = -1;
+    if (fo >= 0) {
+        while ((n = read(fd, buf, sizeof buf)) > 0)
+            if (write(fo, buf, n) != n)
+                break;
+        ret = n;
+        if (close(fo) < 0)
+            ret = -1;
+#ifdef _WIN32
+        unlink(to);
+#endif
+        if (ret == 0 && rename(tmp, to) < 0)
+            ret = -1;
+        if (ret < 0)
+            unlink(tmp);
+        else if (s1->verbose)
+            printf("<- %s\n", to);
+    }
+    close(fd);
+    swirl_bench(s1, phase);
+    return ret;
+}
+
+/* -fcache-dir: the key starts with a hash of the file the compiler
+   runs from, so that a rebuilt compiler does not see the objects of
+   the old one.  If that file cannot be read, nothing is cached.  Once
+   per thread, returns non zero on failure. */
+static int swirl_cache_id(uint64_t *h)
+{
+    static ST_TLS uint64_t id[2];
+    static ST_TLS int done;
+    const char *v = "swirl " SWIRL_VERSION;
+    char path[1024], buf[4096];
+    int fd, n;
+
+    if (!done) {
+        uint64_t t[2] = { h[0], h[1] };
+        path[0] = 0;
+#ifdef _WIN32
+        GetModuleFileNameA(swirl_module, path, sizeof path);
+#else
+# ifndef CONFIG_SWIRL_STATIC
+        {
+            Dl_info info, exe;
+            if (dladdr((void *)swirl_cache_id, &info) && info.dli_fname
+#  ifdef __linux__
+                /* for the main program, that is argv[0] only */
+                && !(dladdr((void *)getauxval(AT_PHDR), &exe)
+                     && exe.dli_fbase == info.dli_fbase)
+#  endif
+                )
+                pstrcpy(path, sizeof path, info.dli_fname);
+        }
+# endif
+# ifdef __linux__
+        if (!path[0])
+            pstrcpy(path, sizeof path, "/proc/self/exe");
+# endif
+#endif
+        done = -1;
+        fd = path[0] ? open(path, O_RDONLY | O_BINARY) : -1;
+        if (fd >= 0) {
+            swirl_hash(t, v, strlen(v) + 1);
+            while ((n = read(fd, buf, sizeof buf)) > 0)
+                swirl_hash(t, buf, n);
+            if (n == 0)
+                id[0] = t[0], id[1] = t[1], done = 1;
+            close(fd);
+        }
+    }
+    h[0] = id[0], h[1] = id[1];
+    return done < 0;
+}
+
+static void swirl_cache_error(void *opaque, const char *msg)
+{
+}
+
+/* -fcache-dir: hash the preprocessed file and look for its object.
+   Diagnostics are left to the compilation proper, and with errors
+   there is nothing to look for. */
+static void swirl_cache_lookup(SwirlState *s1, int filetype, const char *filename)
+{
+    uint64_t h[2] = { 0xcbf29ce484222325ull, 0x84222325cbf29ce4ull };
+    void (*error_func)(void *opaque, const char *msg) = s1->error_func;
+    void *error_opaque = s1->error_opaque;
+    int nb_errors = s1->nb_errors, nb_warnings = s1->nb_warnings;
+    jmp_buf saved_jmp_buf;
+    char buf[1024];
+    int fd, phase, ret;
+
+    fd = open(filename, O_RDONLY | O_BINARY);
+    if (fd < 0)
+        return;
+    if (swirl_cache_id(h)) {
+        close(fd);
+        return;
+    }
+    phase = swirl_bench(s1, BENCH_PP);
+    swirl_hash(h, &s1->output_format, sizeof s1->output_format);
+    swirl_hash(h, s1->cache_opts.data, s1->cache_opts.size);
+    swirl_hash(h, s1->cmdline_defs.data, s1->cmdline_defs.size);
+    swirl_hash(h, s1->cmdline_incl.data, s1->cmdline_incl.size);
+    swirl_hash(h, filename, strlen(filename) + 1);
+    if (s1->do_debug && getcwd(buf, sizeof buf))
+        swirl_hash(h, buf, strlen(buf) + 1);
+
+    memcpy(saved_jmp_buf, s1->error_jmp_buf, sizeof saved_jmp_buf);
+    s1->error_func = swirl_cache_error;
+    ret = 1;
+    if (setjmp(s1->error_jmp_buf) == 0) {
+        swirl_open_bf(s1, filename, 0);
+        file->fd = fd;
+        preprocess_start(s1, filetype);
+        swirlgen_init(s1);
+        swirl_preprocess_hash(s1, h);
+        ret = s1->nb_errors != nb_errors;
+    }
+    swirlgen_finish(s1);
+    preprocess_end(s1);
+    memcpy(s1->error_jmp_buf, saved_jmp_buf, sizeof saved_jmp_buf);
+    s1->error_func = error_func;
+    s1->error_opaque = error_opaque;
+    s1->nb_errors = nb_errors;
+    s1->nb_warnings = nb_warnings;
+    swirl_bench(s1, phase);
+    if (ret)
+        return;
+
+#ifdef _WIN32
+    mkdir(s1->cache_dir);
+#else
+    mkdir(s1->cache_dir, 0777);
+#endif
+    snprintf(buf, sizeof buf, "%s/%016llx%016llx.o", s1->cache_dir,
+             (unsigned long long)h[0], (unsigned long long)h[1]);
+    s1->cache_obj = swirl_strdup(buf);
+    s1->cache_hit = access(buf, R_OK) == 0;
+    if (s1->cache_hit)
+        ++obj_cache_hits;
+    else
+        ++obj_cache_misses;
+}
+
 /* compile the file opened in 'file'. Return non zero if errors. */
 static int swirl_compile(SwirlState *s1, int filetype, const char *str, int fd)
 {
+    int phase;
+
     /* Here we enter the code section where we use the global variables for
        parsing and code generation (swirlpp.c, swirlgen.c, <target>-gen.c).
-       Other threads need to wait until we're done.
-
-       Alternatively we could use thread local storage for those global
-       variables, which may or may not have advantages */
+       With CONFIG_SWIRL_TLS these are thread local, otherwise other
+       threads need to wait until we're done. */
 
     swirl_enter_state(s1);
+    phase = swirl_bench(s1, s1->output_type == SWIRL_OUTPUT_PREPROCESS
+                            ? BENCH_PP : BENCH_GEN);
 
     if (setjmp(s1->error_jmp_buf) == 0) {
         s1->error_set_jmp_enabled = 1;
         s1->nb_errors = 0;
+        s1->nb_warnings = 0;
 
+        swirlelf_begin_file(s1);
         if (fd == -1) {
             int len = strlen(str);
             swirl_open_bf(s1, "<string>", len);
             memcpy(file->buffer, str, len);
         } else {
+            if (s1->cache_obj)
+                swirl_error("cannot use -fcache-dir with more than one file");
+            if (s1->cache_dir && s1->output_type == SWIRL_OUTPUT_OBJ
+                && !s1->option_r && !s1->pch_file
+                && !(filetype & (AFF_TYPE_ASM | AFF_TYPE_ASMPP | AFF_TYPE_CHDR)))
+                swirl_cache_lookup(s1, filetype, str);
             swirl_open_bf(s1, str, 0);
             file->fd = fd;
         }
 
-        swirlelf_begin_file(s1);
         preprocess_start(s1, filetype);
         swirlgen_init(s1);
+        if (s1->pch_file && !(filetype & (AFF_TYPE_ASM | AFF_TYPE_ASMPP)))
+            swirl_pch_load(s1);
         if (s1->output_type == SWIRL_OUTPUT_PREPROCESS) {
             swirl_preprocess(s1);
         } else if (filetype & (AFF_TYPE_ASM | AFF_TYPE_ASMPP)) {
@@ -716,8 +936,10 @@ static int swirl_compile(SwirlState *s1, int filetype, const char *str, int fd)
 #else
             swirl_error_noabort("asm not supported");
 #endif
-        } else {
+        } else if (!s1->cache_hit) {
             swirlgen_compile(s1);
+            if ((filetype & AFF_TYPE_CHDR) && s1->output_type == SWIRL_OUTPUT_OBJ)
+                swirl_pch_save(s1);
         }
     }
     s1->error_set_jmp_enabled = 0;
@@ -725,7 +947,9 @@ static int swirl_compile(SwirlState *s1, int filetype, const char *str, int fd)
     preprocess_end(s1);
     swirl_exit_state();
 
+    swirl_bench(s1, BENCH_SYMS);
     swirlelf_end_file(s1);
+    swirl_bench(s1, phase);
     return s1->nb_errors != 0 ? -1 : 0;
 }
 
@@ -759,9 +983,7 @@ LIBSWIRLAPI SwirlState *swirl_new(void)
     s = swirl_mallocz(sizeof(SwirlState));
     if (!s)
         return NULL;
-#ifdef MEM_DEBUG
     ++nb_states;
-#endif
 
 #undef gnu_ext
 
@@ -769,6 +991,11 @@ LIBSWIRLAPI SwirlState *swirl_new(void)
     s->swirl_ext = 1;
     s->nocommon = 1;
     s->dollars_in_identifiers = 1; /*on by default like in gcc/clang*/
+    s->jump_tables = 1;
+    s->sibling_calls = 1;
+    s->rotate_loops = 1;
+    s->inline_functions = 1;
+    s->loop_patterns = 1;
     s->cversion = 199901; /* default unless -std=c11 is supplied */
     s->warn_implicit_function_declaration = 1;
     s->ms_extensions = 1;
@@ -827,16 +1054,23 @@ LIBSWIRLAPI void swirl_delete(SwirlState *s1)
     dynarray_reset(&s1->argv, &s1->argc);
     cstr_free(&s1->cmdline_defs);
     cstr_free(&s1->cmdline_incl);
+    swirl_free(s1->pch_file);
+    cstr_free(&s1->pch_out);
+    swirl_free(s1->cache_dir);
+    cstr_free(&s1->cache_opts);
+    swirl_free(s1->cache_obj);
 #ifdef SWIRL_IS_NATIVE
     /* free runtime memory */
     swirl_run_free(s1);
 #endif
 
     swirl_free(s1);
+    if (0 == --nb_states) {
+        pp_cache_free();
 #ifdef MEM_DEBUG
-    if (0 == --nb_states)
         swirl_memcheck();
 #endif
+    }
 }
 
 LIBSWIRLAPI int swirl_set_output_type(SwirlState *s, int output_type)
@@ -954,8 +1188,9 @@ ST_FUNC int swirl_add_file_internal(SwirlState *s1, const char *filename, int fl
     s1->current_filename = filename;
     if (flags & AFF_TYPE_BIN) {
         ElfW(Ehdr) ehdr;
-        int obj_type;
+        int obj_type, phase;
 
+        phase = swirl_bench(s1, BENCH_LOAD);
         obj_type = swirl_object_type(fd, &ehdr);
         lseek(fd, 0, SEEK_SET);
 
@@ -1015,6 +1250,7 @@ ST_FUNC int swirl_add_file_internal(SwirlState *s1, const char *filename, int fl
             break;
         }
         close(fd);
+        swirl_bench(s1, phase);
     } else {
         /* update target deps */
         dynarray_add(&s1->target_deps, &s1->nb_target_deps, swirl_strdup(filename));
@@ -1038,6 +1274,8 @@ LIBSWIRLAPI int swirl_add_file(SwirlState *s, const char *filename)
                 filetype = AFF_TYPE_ASM;
             else if (!PATHCMP(ext, "c") || !PATHCMP(ext, "i"))
                 filetype = AFF_TYPE_C;
+            else if (!PATHCMP(ext, "h"))
+                filetype = AFF_TYPE_C | AFF_TYPE_CHDR;
             else
                 filetype |= AFF_TYPE_BIN;
         } else {
@@ -1519,9 +1757,11 @@ enum {
     SWIRL_OPTION_O,
     SWIRL_OPTION_mfloat_abi,
     SWIRL_OPTION_m,
+    SWIRL_OPTION_fcache_dir,
     SWIRL_OPTION_f,
     SWIRL_OPTION_isystem,
     SWIRL_OPTION_iwithprefix,
+    SWIRL_OPTION_include_pch,
     SWIRL_OPTION_include,
     SWIRL_OPTION_nostdinc,
     SWIRL_OPTION_nostdlib,
@@ -1539,7 +1779,8 @@ enum {
     SWIRL_OPTION_x,
     SWIRL_OPTION_ar,
     SWIRL_OPTION_impdef,
-    SWIRL_OPTION_C
+    SWIRL_OPTION_C,
+    SWIRL_OPTION_j
 };
 
 #define SWIRL_OPTION_HAS_ARG 0x0001
@@ -1559,7 +1800,7 @@ static const SWIRLOption swirl_options[] = {
     { "L", SWIRL_OPTION_L, SWIRL_OPTION_HAS_ARG },
     { "B", SWIRL_OPTION_B, SWIRL_OPTION_HAS_ARG },
     { "l", SWIRL_OPTION_l, SWIRL_OPTION_HAS_ARG },
-    { "bench", SWIRL_OPTION_bench, 0 },
+    { "bench", SWIRL_OPTION_bench, SWIRL_OPTION_HAS_ARG | SWIRL_OPTION_NOSEP },
 #ifdef CONFIG_SWIRL_BACKTRACE
     { "bt", SWIRL_OPTION_bt, SWIRL_OPTION_HAS_ARG | SWIRL_OPTION_NOSEP },
 #endif
@@ -1591,8 +1832,10 @@ static const SWIRLOption swirl_options[] = {
     { "mfloat-abi", SWIRL_OPTION_mfloat_abi, SWIRL_OPTION_HAS_ARG },
 #endif
     { "m", SWIRL_OPTION_m, SWIRL_OPTION_HAS_ARG | SWIRL_OPTION_NOSEP },
+    { "fcache-dir=", SWIRL_OPTION_fcache_dir, SWIRL_OPTION_HAS_ARG | SWIRL_OPTION_NOSEP },
     { "f", SWIRL_OPTION_f, SWIRL_OPTION_HAS_ARG | SWIRL_OPTION_NOSEP },
     { "isystem", SWIRL_OPTION_isystem, SWIRL_OPTION_HAS_ARG },
+    { "include-pch", SWIRL_OPTION_include_pch, SWIRL_OPTION_HAS_ARG },
     { "include", SWIRL_OPTION_include, SWIRL_OPTION_HAS_ARG },
     { "nostdinc", SWIRL_OPTION_nostdinc, 0 },
     { "nostdlib", SWIRL_OPTION_nostdlib, 0 },
@@ -1608,6 +1851,7 @@ static const SWIRLOption swirl_options[] = {
     { "impdef", SWIRL_OPTION_impdef, 0},
 #endif
     { "C", SWIRL_OPTION_C, 0},
+    { "j", SWIRL_OPTION_j, SWIRL_OPTION_HAS_ARG | SWIRL_OPTION_NOSEP },
     { NULL, 0, 0 },
 };
 
@@ -1629,6 +1873,15 @@ static const FlagDef options_f[] = {
     { offsetof(SwirlState, leading_underscore), 0, "leading-underscore" },
     { offsetof(SwirlState, ms_extensions), 0, "ms-extensions" },
     { offsetof(SwirlState, dollars_in_identifiers), 0, "dollars-in-identifiers" },
+    { offsetof(SwirlState, mmap_input), 0, "mmap" },
+    { offsetof(SwirlState, jump_tables), 0, "jump-tables" },
+    { offsetof(SwirlState, sibling_calls), 0, "optimize-sibling-calls" },
+    { offsetof(SwirlState, omit_frame_pointer), 0, "omit-frame-pointer" },
+    { offsetof(SwirlState, rotate_loops), 0, "rotate-loops" },
+    { offsetof(SwirlState, inline_functions), 0, "inline-functions" },
+    { offsetof(SwirlState, loop_patterns), 0, "tree-loop-distribute-patterns" },
+    { offsetof(SwirlState, pic), 0, "PIC" },
+    { offsetof(SwirlState, pic), 0, "pic" },
     { 0, 0, NULL }
 };
 
@@ -1636,6 +1889,11 @@ static const FlagDef options_m[] = {
     { offsetof(SwirlState, ms_bitfields), 0, "ms-bitfields" },
 #ifdef SWIRL_TARGET_X86_64
     { offsetof(SwirlState, nosse), FD_INVERT, "sse" },
+    { offsetof(SwirlState, norelax), FD_INVERT, "relax" },
+#endif
+#if defined SWIRL_TARGET_I386 || defined SWIRL_TARGET_X86_64
+    { offsetof(SwirlState, popcnt), 0, "popcnt" },
+    { offsetof(SwirlState, lzcnt), 0, "lzcnt" },
 #endif
     { 0, 0, NULL }
 };
@@ -1769,6 +2027,16 @@ reparse:
             break;
         }
 
+        switch(popt->index) {
+        case SWIRL_OPTION_o: case SWIRL_OPTION_MD: case SWIRL_OPTION_MF:
+        case SWIRL_OPTION_v: case SWIRL_OPTION_j: case SWIRL_OPTION_bench:
+        case SWIRL_OPTION_fcache_dir:
+            break;
+        default:
+            /* for -fcache-dir, options that may change the object */
+            cstr_printf(&s->cache_opts, "%s %s\n", r, optarg);
+        }
+
         switch(popt->index) {
         case SWIRL_OPTION_HELP:
             x = OPT_HELP;
@@ -1800,7 +2068,13 @@ reparse:
             s->option_pthread = 1;
             break;
         case SWIRL_OPTION_bench:
-            s->do_bench = 1;
+            if (*optarg == 0)
+                s->do_bench = 1;
+            else if (!strcmp(optarg, "=json"))
+                s->do_bench = 2;
+            else
+                goto unsupported_option;
+            swirl_bench(s, BENCH_OTHER);
             break;
 #ifdef CONFIG_SWIRL_BACKTRACE
         case SWIRL_OPTION_bt:
@@ -1869,6 +2143,10 @@ reparse:
         case SWIRL_OPTION_include:
             cstr_printf(&s->cmdline_incl, "#include \"%s\"\n", optarg);
             break;
+        case SWIRL_OPTION_include_pch:
+            swirl_free(s->pch_file);
+            s->pch_file = swirl_strdup(optarg);
+            break;
         case SWIRL_OPTION_nostdinc:
             s->nostdinc = 1;
             break;
@@ -1886,6 +2164,10 @@ reparse:
             do ++s->verbose; while (*optarg++ == 'v');
             ++noaction;
             break;
+        case SWIRL_OPTION_fcache_dir:
+            swirl_free(s->cache_dir);
+            s->cache_dir = swirl_strdup(optarg);
+            break;
         case SWIRL_OPTION_f:
             if (set_flag(s, options_f, optarg) < 0)
                 goto unsupported_option;
@@ -1943,13 +2225,23 @@ reparse:
         case SWIRL_OPTION_MF:
             s->deps_outfile = swirl_strdup(optarg);
             break;
+        case SWIRL_OPTION_j:
+            /* -jN or -j N, -j alone is one job per cpu */
+            if (!*optarg && optind < argc && argv[optind][0]
+                && !argv[optind][strspn(argv[optind], "0123456789")])
+                optarg = argv[optind++];
+            x = atoi(optarg);
+            s->nb_jobs = x > 0 ? x : -1;
+            break;
         case SWIRL_OPTION_dumpversion:
             printf ("%s\n", SWIRL_VERSION);
             exit(0);
             break;
         case SWIRL_OPTION_x:
             x = 0;
-            if (*optarg == 'c')
+            if (!strcmp(optarg, "c-header"))
+                x = AFF_TYPE_C | AFF_TYPE_CHDR;
+            else if (*optarg == 'c')
                 x = AFF_TYPE_C;
             else if (*optarg == 'a')
                 x = AFF_TYPE_ASMPP;
@@ -1962,7 +2254,8 @@ reparse:
             s->filetype = x | (s->filetype & ~AFF_TYPE_MASK);
             break;
         case SWIRL_OPTION_O:
-            s->optimize = atoi(optarg);
+            /* -O, -Os ... mean -O1 */
+            s->optimize = isnum(*optarg) ? atoi(optarg) : 1;
             break;
         case SWIRL_OPTION_print_search_dirs:
             x = OPT_PRINT_DIRS;
@@ -2018,12 +2311,97 @@ LIBSWIRLAPI void swirl_set_options(SwirlState *s, const char *r)
     dynarray_reset(&argv, &argc);
 }
 
+#ifndef _WIN32
+# include <sys/resource.h>
+#endif
+
+/* -bench: charge the time since the last call to the current phase and
+   continue with 'phase'.  Return the previous phase. */
+ST_FUNC int swirl_bench(SwirlState *s1, int phase)
+{
+    int p = s1->bench_phase;
+    uint64_t t;
+#ifdef _WIN32
+    LARGE_INTEGER c, f;
+#else
+    struct timeval tv;
+    struct rusage ru;
+#endif
+
+    if (!s1->do_bench)
+        return 0;
+#ifdef _WIN32
+    QueryPerformanceCounter(&c), QueryPerformanceFrequency(&f);
+    t = c.QuadPart / f.QuadPart * 1000000
+      + c.QuadPart % f.QuadPart * 1000000 / f.QuadPart;
+#else
+    gettimeofday(&tv, NULL);
+    t = tv.tv_sec * (uint64_t)1000000 + tv.tv_usec;
+#endif
+    if (s1->bench_clock)
+        s1->bench_time[p] += t - s1->bench_clock;
+    s1->bench_clock = t;
+    s1->bench_phase = phase;
+#ifndef _WIN32
+    /* not when switching between parser and preprocessor per token */
+    if (p > BENCH_GEN || phase > BENCH_GEN) {
+        getrusage(RUSAGE_SELF, &ru);
+# ifdef __APPLE__
+        ru.ru_maxrss >>= 10;
+# endif
+        if (ru.ru_maxrss > s1->bench_mem[p])
+            s1->bench_mem[p] = ru.ru_maxrss;
+        /* the preprocessor runs interleaved with the parser */
+        if (p == BENCH_GEN && ru.ru_maxrss > s1->bench_mem[BENCH_PP])
+            s1->bench_mem[BENCH_PP] = ru.ru_maxrss;
+    }
+#endif
+    return p;
+}
+
+static const char bench_names[BENCH_NB][8] = {
+    "other", "pp", "gen", "inline", "syms", "load", "reloc", "output"
+};
+
+static double tok_hash_load(SwirlState *s1)
+{
+    return tok_hash_size ? (double)total_idents / tok_hash_size : 0;
+}
+
 PUB_FUNC void swirl_print_stats(SwirlState *s1, unsigned total_time)
 {
+    int i;
+
+    swirl_bench(s1, BENCH_OTHER);
     if (total_time < 1)
         total_time = 1;
     if (total_bytes < 1)
         total_bytes = 1;
+    if (s1->do_bench == 2) {
+        /* -bench=json, on one line */
+        fprintf(stderr, "{\"version\": \"%s\", \"time_ms\": %u, "
+                        "\"idents\": %d, \"lines\": %d, \"bytes\": %d, "
+                        "\"tokens\": %d, \"syms\": %d, \"relocs\": %d, "
+                        "\"allocs\": %u, \"text\": %d, \"data\": %d, "
+                        "\"bss\": %d, "
+                        "\"include_cache\": {\"hits\": %u, \"misses\": %u}, "
+                        "\"object_cache\": {\"hits\": %u, \"misses\": %u}, "
+                        "\"ident_hash\": {\"buckets\": %u, \"load\": %0.2f, "
+                        "\"lookups\": %u, \"probes\": %u}, "
+                        "\"phases\": {",
+           SWIRL_VERSION, total_time, total_idents, total_lines,
+           total_bytes, total_tokens, total_syms, s1->total_relocs,
+           mem_nb_allocs, s1->total_output[0], s1->total_output[1],
+           s1->total_output[2], pp_cache_hits, pp_cache_misses,
+           obj_cache_hits, obj_cache_misses,
+           tok_hash_size, tok_hash_load(s1), tok_hash_lookups, tok_hash_probes);
+        for (i = 0; i < BENCH_NB; i++)
+            fprintf(stderr, "%s\"%s\": {\"ms\": %0.3f, \"peak_kb\": %u}",
+               i ? ", " : "", bench_names[i],
+               (double)s1->bench_time[i] / 1000, s1->bench_mem[i]);
+        fprintf(stderr, "}}\n");
+        return;
+    }
     fprintf(stderr, "* %d idents, %d lines, %d bytes\n"
                     "* %0.3f s, %u lines/s, %0.1f MB/s\n",
            total_idents, total_lines, total_bytes,
@@ -2032,6 +2410,24 @@ PUB_FUNC void swirl_print_stats(SwirlState *s1, unsigned total_time)
            (double)total_bytes/1000/total_time);
     fprintf(stderr, "* text %d, data %d, bss %d bytes\n",
            s1->total_output[0], s1->total_output[1], s1->total_output[2]);
+    fprintf(stderr, "* %d tokens, %d syms, %d relocs, %u allocs\n",
+           total_tokens, total_syms, s1->total_relocs, mem_nb_allocs);
+    for (i = 0; i < BENCH_NB; i++)
+        if (s1->bench_time[i])
+            fprintf(stderr, "* %-7s %8.3f ms %8u kB peak\n", bench_names[i],
+               (double)s1->bench_time[i] / 1000, s1->bench_mem[i]);
+    if (obj_cache_hits + obj_cache_misses)
+        fprintf(stderr, "* object cache %u hits, %u misses\n",
+           obj_cache_hits, obj_cache_misses);
+    if (pp_cache_hits + pp_cache_misses)
+        fprintf(stderr, "* include cache %u hits, %u misses (%u%%)\n",
+           pp_cache_hits, pp_cache_misses,
+           pp_cache_hits * 100 / (pp_cache_hits + pp_cache_misses));
+    if (tok_hash_lookups)
+        fprintf(stderr, "* ident hash %u buckets, load %0.2f, "
+                        "%0.2f probes/lookup\n",
+           tok_hash_size, tok_hash_load(s1),
+           (double)tok_hash_probes / tok_hash_lookups);
 #ifdef MEM_DEBUG
     fprintf(stderr, "* %d bytes memory used\n", mem_max_size);
 #endif
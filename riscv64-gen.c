@@ -75,8 +75,8 @@ ST_DATA const int reg_classes[NB_REGS] = {
 };
 
 #if defined(CONFIG_SWIRL_BCHECK)
-static addr_t func_bound_offset;
-static unsigned long func_bound_ind;
+static ST_TLS addr_t func_bound_offset;
+static ST_TLS unsigned long func_bound_ind;
 ST_DATA int func_bound_add_epilog;
 #endif
 
@@ -166,7 +166,7 @@ ST_FUNC void gsym_addr(int t_, int a_)
 
 static int load_symofs(int r, SValue *sv, int forstore)
 {
-    static Sym label;
+    static ST_TLS Sym label;
     int rr, doload = 0;
     int fc = sv->c.i, v = sv->r & VT_VALMASK;
     if (sv->r & VT_SYM) {
@@ -459,7 +459,7 @@ static void gen_bounds_prolog(void)
 
 static void gen_bounds_epilog(void)
 {
-    static Sym label;
+    static ST_TLS Sym label;
     addr_t saved_ind;
     addr_t *bounds_ptr;
     Sym *sym_data;
@@ -769,7 +769,7 @@ done:
    swirl_free(info);
 }
 
-static int func_sub_sp_offset, num_va_regs, func_va_list_ofs;
+static ST_TLS int func_sub_sp_offset, num_va_regs, func_va_list_ofs;
 
 ST_FUNC void gfunc_prolog(Sym *func_sym)
 {
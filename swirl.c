@@ -56,6 +56,9 @@ static const char help[] =
     "  -Bdir        set swirl's private include/library dir\n"
     "  -MD          generate dependency file for make\n"
     "  -MF file     specify dependency file name\n"
+#ifndef _WIN32
+    "  -j[N]        with -c: compile N files in parallel (default: cpus)\n"
+#endif
 #if defined(SWIRL_TARGET_I386) || defined(SWIRL_TARGET_X86_64)
     "  -m32/64      defer to i386/x86_64 cross compiler\n"
 #endif
@@ -72,9 +75,13 @@ static const char help2[] =
     "  -P -P1                        with -E: no/alternative #line output\n"
     "  -dD -dM                       with -E: output #define directives\n"
     "  -pthread                      same as -D_REENTRANT and -lpthread\n"
-    "  -On                           same as -D__OPTIMIZE__ for n > 0\n"
+    "  -On                           for n > 0: -D__OPTIMIZE__, locals in registers\n"
     "  -Wp,-opt                      same as -opt\n"
     "  -include file                 include 'file' above each input file\n"
+    "  -include-pch file             start from the state saved in 'file'\n"
+    "  -x c-header file.h            with -c: write a precompiled header\n"
+    "  -fcache-dir=dir               with -c: reuse objects kept in 'dir'\n"
+    "  -bench=json                   print -bench statistics as JSON\n"
     "  -isystem dir                  add 'dir' to system include path\n"
     "  -static                       link to static libraries (not recommended)\n"
     "  -dumpversion                  print version\n"
@@ -95,6 +102,14 @@ static const char help2[] =
     "  leading-underscore            decorate extern symbols\n"
     "  ms-extensions                 allow anonymous struct in struct\n"
     "  dollars-in-identifiers        allow '$' in C symbols\n"
+    "  mmap                          map big source files instead of reading\n"
+    "  jump-tables                   use jump tables for dense switches\n"
+    "  optimize-sibling-calls        turn 'return f();' into a jump (-O)\n"
+    "  omit-frame-pointer            no frame for small leaf functions\n"
+    "  rotate-loops                  test loop conditions at the bottom (-O)\n"
+    "  inline-functions              expand calls to small static functions (-O)\n"
+    "  tree-loop-distribute-patterns copy/fill loops call memmove/memset (-O)\n"
+    "  PIC pic                       position independent thread-local accesses\n"
     "-m... target specific options:\n"
     "  ms-bitfields                  use MSVC bitfield layout\n"
 #ifdef SWIRL_TARGET_ARM
@@ -102,6 +117,10 @@ static const char help2[] =
 #endif
 #ifdef SWIRL_TARGET_X86_64
     "  no-sse                        disable floats on x86_64\n"
+    "  no-relax                      no short jumps on x86_64\n"
+#endif
+#if defined SWIRL_TARGET_I386 || defined SWIRL_TARGET_X86_64
+    "  popcnt, lzcnt                 use these instructions for builtins\n"
 #endif
     "-Wl,... linker options:\n"
     "  -nostdlib                     do not link with standard crt/libs\n"
@@ -227,6 +246,9 @@ static char *default_outputfile(SwirlState *s, const char *first_file)
         strcpy(ext, ".exe");
     else
 #endif
+    if (s->pch_out.size)
+        snprintf(buf, sizeof(buf), "%s.pch", name);
+    else
     if (s->output_type == SWIRL_OUTPUT_OBJ && !s->option_r && *ext)
         strcpy(ext, ".o");
     else
@@ -247,8 +269,8 @@ static unsigned getclock_ms(void)
 
 int main(int argc0, char **argv0)
 {
-    SwirlState *s, *s1;
-    int ret, opt, n = 0, t = 0, done;
+    SwirlState *s, *s1, *prev = NULL;
+    int ret, opt, n = 0, t = 0, done, job = 0;
     unsigned start_time = 0;
     const char *first_file;
     int argc; char **argv;
@@ -257,6 +279,8 @@ int main(int argc0, char **argv0)
 redo:
     argc = argc0, argv = argv0;
     s = s1 = swirl_new();
+    if (prev)
+        swirl_delete(prev); /* after swirl_new(), to keep the include cache */
     opt = swirl_parse_args(s, &argc, &argv, 1);
 
     if (n == 0) {
@@ -308,6 +332,20 @@ redo:
 
         if (s->do_bench)
             start_time = getclock_ms();
+
+#ifndef _WIN32
+        if (s->nb_jobs && s->nb_jobs != 1 && s->nb_files > 1
+            && s->output_type == SWIRL_OUTPUT_OBJ && !s->option_r) {
+            n = swirl_tool_jobs(s, &ret);
+            if (n < 0) {
+                swirl_delete(s);
+                return ret;
+            }
+            job = 1; /* child: compile only files[n] */
+            if (s->do_bench)
+                start_time = getclock_ms();
+        }
+#endif
     }
 
     set_environment(s);
@@ -364,13 +402,17 @@ redo:
         }
     }
 
-    if (s->do_bench && done && !(t | ret))
+    /* with -j, each job reports for its file, in command line order */
+    if (s->do_bench && (done || job) && !(t | ret))
         swirl_print_stats(s, getclock_ms() - start_time);
+    if (!job && (!done || t)) {
+        /* compile more files with -c, or run more tests with -dt -run */
+        prev = s;
+        goto redo;
+    }
     swirl_delete(s);
-    if (!done)
-        goto redo; /* compile more files with -c */
-    if (t)
-        goto redo; /* run more tests with -dt -run */
+    if (job)
+        return ret;
     if (ppfp && ppfp != stdout)
         fclose(ppfp);
     return ret;
@@ -20,6 +20,7 @@
 #include <errno.h>
 #include <math.h>
 #include <fcntl.h>
+#include <sys/stat.h>
 #include <setjmp.h>
 #include <time.h>
 
@@ -28,6 +29,9 @@
 # include <sys/time.h>
 # ifndef CONFIG_SWIRL_STATIC
 #  include <dlfcn.h>
+#  ifdef __linux__
+#   include <sys/auxv.h>
+#  endif
 # endif
 /* XXX: need to define this to use them in non ISOC99 context */
 extern float strtof (const char *__nptr, char **__endptr);
@@ -352,14 +356,36 @@ extern long double strtold (const char *__nptr, char **__endptr);
 # define CONFIG_SWIRL_SEMLOCK 1
 #endif
 
+/* keep the global variables of the preprocessor, parser and code
+   generators in thread local storage, such that threads with their
+   own SwirlState can compile at the same time.  Otherwise they have
+   to wait for each other in swirl_enter_state(). */
+#ifndef CONFIG_SWIRL_TLS
+# if CONFIG_SWIRL_SEMLOCK && (defined __GNUC__ || defined _MSC_VER \
+    || (defined __SWIRLC__ && (defined __x86_64__ || defined __aarch64__) \
+        && !defined _WIN32 && !defined __APPLE__))
+#  define CONFIG_SWIRL_TLS 1
+# else
+#  define CONFIG_SWIRL_TLS 0
+# endif
+#endif
+
+#if !CONFIG_SWIRL_TLS
+# define ST_TLS
+#elif defined _MSC_VER
+# define ST_TLS __declspec(thread)
+#else
+# define ST_TLS __thread
+#endif
+
 #if ONE_SOURCE
 #define ST_INLN static inline
 #define ST_FUNC static
-#define ST_DATA static
+#define ST_DATA static ST_TLS
 #else
 #define ST_INLN
 #define ST_FUNC
-#define ST_DATA extern
+#define ST_DATA extern ST_TLS
 #endif
 
 #ifdef SWIRL_PROFILE /* profile all functions */
@@ -436,7 +462,7 @@ extern long double strtold (const char *__nptr, char **__endptr);
 #define TOKSTR_MAX_SIZE     256
 #define PACK_STACK_SIZE     8
 
-#define TOK_HASH_SIZE       16384 /* must be a power of two */
+#define TOK_HASH_SIZE       16384 /* initial size, must be a power of two */
 #define TOK_ALLOC_INCR      512  /* must be a power of two */
 #define TOK_MAX_SIZE        4 /* token max size in int unit when stored in string */
 
@@ -448,6 +474,7 @@ typedef struct TokenSym {
     struct Sym *sym_struct; /* direct pointer to structure */
     struct Sym *sym_identifier; /* direct pointer to identifier */
     int tok; /* token number */
+    unsigned hash; /* full hash of str, see tok_hash() */
     int len;
     char str[1];
 } TokenSym;
@@ -511,7 +538,8 @@ struct SymAttr {
     nodecorate  : 1,
     dllimport   : 1,
     addrtaken   : 1,
-    xxxx        : 3; /* not used */
+    regvar      : 1, /* local lives in a callee-saved register */
+    xxxx        : 2; /* not used */
 };
 
 /* function attributes or temporary attributes for parsing */
@@ -524,7 +552,11 @@ struct FuncAttr {
     func_dtor   : 1, /* attribute((destructor)) */
     func_args   : 8, /* PE __stdcall args */
     func_alwinl : 1, /* always_inline */
-    xxxx        : 15;
+    func_noinline : 1, /* noinline */
+    func_inl    : 1, /* body kept in an InlineFunc */
+    func_cold   : 1, /* attribute((cold)) */
+    func_rtwice : 1, /* attribute((returns_twice)) */
+    xxxx        : 11;
 };
 
 /* symbol management */
@@ -622,6 +654,8 @@ typedef struct DLLReference {
 #define TYPE_DIRECT    2 /* type with variable */
 
 #define IO_BUF_SIZE 8192
+#define IO_BUF_PAD 16 /* after the CH_EOB, for the 16 byte loads of lex_scan() */
+#define MMAP_MIN_SIZE (16 * IO_BUF_SIZE) /* smaller files are read() */
 
 typedef struct BufferedFile {
     uint8_t *buf_ptr;
@@ -634,6 +668,12 @@ typedef struct BufferedFile {
     int ifndef_macro_saved; /* saved ifndef_macro */
     int *ifdef_stack_ptr; /* ifdef_stack value at the start of the file */
     int include_next_index; /* next search path */
+    struct TokenCache *tc; /* replay tokens from the include cache */
+    const int *tcp, *tc_end;
+    const int *tc_dir; /* the '#' of the current directive */
+    int tc_line;
+    unsigned char *map; /* the file mapped by swirl_map(), or NULL */
+    size_t map_size;
     char filename[1024];    /* filename */
     char *true_filename; /* filename not modified by # line directive */
     unsigned char unget[4];
@@ -666,12 +706,15 @@ typedef struct AttributeDef {
     int alias_target; /* token */
     int asm_label; /* associated asm label */
     char attr_mode; /* __attribute__((__mode__(...))) */
+    int vector_size; /* __attribute__((vector_size(...))) */
 } AttributeDef;
 
 /* inline functions */
 typedef struct InlineFunc {
     TokenString *func_str;
     Sym *sym;
+    int expanded; /* calls expanded in place so far (-O) */
+    char done; /* code generated already, tokens kept for inlining */
     char filename[1];
 } InlineFunc;
 
@@ -715,11 +758,19 @@ struct sym_attr {
     unsigned plt_offset;
     int plt_sym;
     int dyn_index;
+    unsigned tls_ie_offset; /* GOT slot holding the TP offset */
+    unsigned tls_gd_offset; /* GOT slot pair (module, DTP offset) */
 #ifdef SWIRL_TARGET_ARM
     unsigned char plt_thumb_stub:1;
 #endif
 };
 
+/* -bench: phases the compilation time is charged to */
+enum {
+    BENCH_OTHER, BENCH_PP, BENCH_GEN, BENCH_INLINE, BENCH_SYMS,
+    BENCH_LOAD, BENCH_RELOC, BENCH_OUTPUT, BENCH_NB
+};
+
 struct SwirlState {
     unsigned char verbose; /* if true, display some information during compilation */
     unsigned char nostdinc; /* if true, no standard headers are added */
@@ -729,7 +780,7 @@ struct SwirlState {
     unsigned char rdynamic; /* if true, all symbols are exported */
     unsigned char symbolic; /* if true, resolve symbols in the current module first */
     unsigned char filetype; /* file type for compilation (NONE,C,ASM) */
-    unsigned char optimize; /* only to #define __OPTIMIZE__ */
+    unsigned char optimize; /* -O level: __OPTIMIZE__, registers for locals */
     unsigned char option_pthread; /* -pthread option */
     unsigned char enable_new_dtags; /* -Wl,--enable-new-dtags */
     unsigned int  cversion; /* supported C ISO version, 199901 (the default), 201112, ... */
@@ -748,6 +799,14 @@ struct SwirlState {
     unsigned char leading_underscore;
     unsigned char ms_extensions; /* allow nested named struct w/o identifier behave like unnamed */
     unsigned char dollars_in_identifiers;  /* allows '$' char in identifiers */
+    unsigned char mmap_input; /* map big source files instead of read() */
+    unsigned char jump_tables; /* lower dense switches to a jump table */
+    unsigned char sibling_calls; /* -O: calls in tail position become jumps */
+    unsigned char omit_frame_pointer; /* leaf functions get no frame */
+    unsigned char rotate_loops; /* -O: test loop conditions at the bottom */
+    unsigned char inline_functions; /* -O: expand calls to small static functions */
+    unsigned char loop_patterns; /* -O: copy and fill loops use memmove/memset */
+    unsigned char pic; /* -fPIC: general-dynamic thread-local accesses */
     unsigned char ms_bitfields; /* if true, emulate MS algorithm for aligning bitfields */
 
     /* warning switches */
@@ -788,6 +847,11 @@ struct SwirlState {
 #endif
 #ifdef SWIRL_TARGET_X86_64
     unsigned char nosse; /* For -mno-sse support. */
+    unsigned char norelax; /* -mno-relax: keep jumps as they are generated */
+#endif
+#if defined SWIRL_TARGET_I386 || defined SWIRL_TARGET_X86_64
+    unsigned char popcnt; /* -mpopcnt: may use popcnt */
+    unsigned char lzcnt; /* -mlzcnt: may use lzcnt */
 #endif
 
     /* array of all loaded dlls (including those referenced by loaded dlls) */
@@ -813,6 +877,15 @@ struct SwirlState {
     CString cmdline_defs;
     /* -include options */
     CString cmdline_incl;
+    /* -include-pch option */
+    char *pch_file;
+    /* precompiled header from 'swirl -c file.h', written by swirl_output_file */
+    CString pch_out;
+    /* -fcache-dir option, options that go into the key, object of this file */
+    char *cache_dir;
+    CString cache_opts;
+    char *cache_obj;
+    unsigned char cache_hit;
 
     /* error handling */
     void *error_opaque;
@@ -820,6 +893,7 @@ struct SwirlState {
     int error_set_jmp_enabled;
     jmp_buf error_jmp_buf;
     int nb_errors;
+    int nb_warnings;
 
     /* output file for preprocessing (-E) */
     FILE *ppfp;
@@ -868,6 +942,7 @@ struct SwirlState {
     /* got & plt handling */
     Section *got;
     Section *plt;
+    unsigned tls_ld_offset; /* GOT slot pair (module, 0) for local-dynamic TLS */
 
     /* predefined sections */
     Section *text_section, *data_section, *data_ro_section, *bss_section;
@@ -931,6 +1006,7 @@ struct SwirlState {
     const char *runtime_main;
     void **runtime_mem;
     int nb_runtime_mem;
+    void *run_tls; /* -run: thread-local storage descriptor */
 #endif
 
 #ifdef CONFIG_SWIRL_BACKTRACE
@@ -944,6 +1020,13 @@ struct SwirlState {
     int total_lines;
     int total_bytes;
     int total_output[3];
+    int total_tokens;
+    int total_syms;
+    int total_relocs;
+    int bench_phase;
+    uint64_t bench_clock;
+    uint64_t bench_time[BENCH_NB]; /* microseconds */
+    unsigned bench_mem[BENCH_NB]; /* peak RSS in kB at the end */
 
     /* option -dnum (for general development purposes) */
     int g_debug;
@@ -957,15 +1040,16 @@ struct SwirlState {
     int nb_libraries; /* number of libs thereof */
     char *outfile; /* output filename */
     unsigned char option_r; /* option -r */
-    unsigned char do_bench; /* option -bench */
+    unsigned char do_bench; /* option -bench, 2 for -bench=json */
     int gen_deps; /* option -MD  */
     char *deps_outfile; /* option -MF */
+    int nb_jobs; /* option -j, -1 means one per cpu */
     int argc;
     char **argv;
 };
 
 struct filespec {
-    char type;
+    int type;
     char name[1];
 };
 
@@ -999,6 +1083,7 @@ struct filespec {
 #define VT_DOUBLE           9  /* IEEE double */
 #define VT_LDOUBLE         10  /* IEEE long double */
 #define VT_BOOL            11  /* ISOC99 boolean type */
+#define VT_QVEC            12  /* 128-bit vector in a SIMD register */
 #define VT_QLONG           13  /* 128-bit integer. Only used for x86-64 ABI */
 #define VT_QFLOAT          14  /* 128-bit float. Only used for x86-64 ABI */
 
@@ -1016,7 +1101,9 @@ struct filespec {
 #define VT_STATIC  0x00002000  /* static variable */
 #define VT_TYPEDEF 0x00004000  /* typedef definition */
 #define VT_INLINE  0x00008000  /* inline definition */
-/* currently unused: 0x000[1248]0000  */
+#define VT_ATOMIC  0x00010000  /* _Atomic qualifier */
+#define VT_TLS     0x00020000  /* _Thread_local storage */
+/* currently unused: 0x000[48]0000  */
 
 #define VT_STRUCT_SHIFT 20     /* shift for bitfield shift values (32 - 2*6) */
 #define VT_STRUCT_MASK (((1U << (6+6)) - 1) << VT_STRUCT_SHIFT | VT_BITFIELD)
@@ -1026,13 +1113,15 @@ struct filespec {
 #define VT_UNION    (1 << VT_STRUCT_SHIFT | VT_STRUCT)
 #define VT_ENUM     (2 << VT_STRUCT_SHIFT) /* integral type is an enum really */
 #define VT_ENUM_VAL (3 << VT_STRUCT_SHIFT) /* integral type is an enum constant really */
+#define VT_VECTOR   (4 << VT_STRUCT_SHIFT | VT_STRUCT) /* vector_size type (ref->type.t) */
 
 #define IS_ENUM(t) ((t & VT_STRUCT_MASK) == VT_ENUM)
 #define IS_ENUM_VAL(t) ((t & VT_STRUCT_MASK) == VT_ENUM_VAL)
 #define IS_UNION(t) ((t & (VT_STRUCT_MASK|VT_BTYPE)) == VT_UNION)
+#define IS_VECTOR(t) ((t & (VT_STRUCT_MASK|VT_BTYPE)) == VT_VECTOR)
 
 /* type mask (except storage) */
-#define VT_STORAGE (VT_EXTERN | VT_STATIC | VT_TYPEDEF | VT_INLINE)
+#define VT_STORAGE (VT_EXTERN | VT_STATIC | VT_TYPEDEF | VT_INLINE | VT_TLS)
 #define VT_TYPE (~(VT_STORAGE|VT_STRUCT_MASK))
 
 /* symbol was created by swirlasm.c first */
@@ -1089,6 +1178,7 @@ struct filespec {
 #define TOK_PLCHLDR 0xa4 /* placeholder token as defined in C99 */
 #define TOK_NOSUBST 0xa5 /* means following token has already been pp'd */
 #define TOK_PPJOIN  0xa6 /* A '##' in the right position to mean pasting */
+#define TOK_PPPRAGMA 0xa7 /* #pragma to be applied when saved tokens are read */
 
 /* assignment operators */
 #define TOK_A_ADD   0xb0
@@ -1229,6 +1319,8 @@ enum swirl_token {
 /* ------------ libswirl.c ------------ */
 
 ST_DATA struct SwirlState *swirl_state;
+ST_DATA unsigned obj_cache_hits, obj_cache_misses;
+ST_DATA unsigned mem_nb_allocs;
 
 /* public functions currently used by the swirl main function */
 ST_FUNC char *pstrcpy(char *buf, size_t buf_size, const char *s);
@@ -1280,9 +1372,11 @@ ST_FUNC void cstr_reset(CString *cstr);
 
 ST_FUNC void swirl_open_bf(SwirlState *s1, const char *filename, int initlen);
 ST_FUNC int swirl_open(SwirlState *s1, const char *filename);
+ST_FUNC void swirl_map(SwirlState *s1, BufferedFile *bf);
 ST_FUNC void swirl_close(void);
 
 ST_FUNC int swirl_add_file_internal(SwirlState *s1, const char *filename, int flags);
+ST_FUNC int swirl_copy_file(SwirlState *s1, const char *from, const char *to);
 /* flags: */
 #define AFF_PRINT_ERROR     0x10 /* print error if file not found */
 #define AFF_REFERENCED_DLL  0x20 /* load a referenced dll from another dll */
@@ -1294,7 +1388,8 @@ ST_FUNC int swirl_add_file_internal(SwirlState *s1, const char *filename, int fl
 #define AFF_TYPE_ASM    2
 #define AFF_TYPE_ASMPP  4
 #define AFF_TYPE_LIB    8
-#define AFF_TYPE_MASK   (15 | AFF_TYPE_BIN)
+#define AFF_TYPE_CHDR   0x100 /* with AFF_TYPE_C: header to precompile */
+#define AFF_TYPE_MASK   (15 | AFF_TYPE_BIN | AFF_TYPE_CHDR)
 /* values from swirl_object_type(...) */
 #define AFF_BINTYPE_REL 1
 #define AFF_BINTYPE_DYN 2
@@ -1316,6 +1411,7 @@ ST_FUNC void swirl_add_btstub(SwirlState *s1);
 ST_FUNC void swirl_add_pragma_libs(SwirlState *s1);
 PUB_FUNC int swirl_add_library_err(SwirlState *s, const char *f);
 PUB_FUNC void swirl_print_stats(SwirlState *s, unsigned total_time);
+ST_FUNC int swirl_bench(SwirlState *s1, int phase);
 PUB_FUNC int swirl_parse_args(SwirlState *s, int *argc, char ***argv, int optind);
 #ifdef _WIN32
 ST_FUNC char *normalize_slashes(char *path);
@@ -1343,10 +1439,13 @@ ST_DATA const int *macro_ptr;
 ST_DATA int parse_flags;
 ST_DATA int tok_flags;
 ST_DATA CString tokcstr; /* current parsed string, if any */
+ST_DATA TokenString *pp_pragma_str; /* saved block that receives #pragma pack/comment */
 
 /* display benchmark infos */
 ST_DATA int tok_ident;
 ST_DATA TokenSym **table_ident;
+ST_DATA unsigned pp_cache_hits, pp_cache_misses;
+ST_DATA unsigned tok_hash_size, tok_hash_lookups, tok_hash_probes;
 
 #define TOK_FLAG_BOL   0x0001 /* beginning of line before */
 #define TOK_FLAG_BOF   0x0002 /* beginning of file before */
@@ -1376,10 +1475,12 @@ ST_FUNC void end_macro(void);
 ST_FUNC int set_idnum(int c, int val);
 ST_INLN void tok_str_new(TokenString *s);
 ST_FUNC TokenString *tok_str_alloc(void);
+ST_FUNC int *tok_str_realloc(TokenString *s, int new_size);
 ST_FUNC void tok_str_free(TokenString *s);
 ST_FUNC void tok_str_free_str(int *str);
 ST_FUNC void tok_str_add(TokenString *s, int t);
 ST_FUNC void tok_str_add_tok(TokenString *s);
+ST_FUNC int tok_str_get(const int **pp, CValue *cv);
 ST_INLN void define_push(int v, int macro_type, int *str, Sym *first_arg);
 ST_FUNC void define_undef(Sym *s);
 ST_INLN Sym *define_find(int v);
@@ -1396,6 +1497,14 @@ ST_FUNC void preprocess_end(SwirlState *s1);
 ST_FUNC void swirlpp_new(SwirlState *s);
 ST_FUNC void swirlpp_delete(SwirlState *s);
 ST_FUNC int swirl_preprocess(SwirlState *s1);
+ST_FUNC void swirl_hash(uint64_t *h, const void *p, int n);
+ST_FUNC void swirl_preprocess_hash(SwirlState *s1, uint64_t *h);
+ST_FUNC void swirl_pch_save(SwirlState *s1);
+ST_FUNC void swirl_pch_load(SwirlState *s1);
+ST_FUNC int swirl_output_pch(SwirlState *s1, const char *filename);
+ST_FUNC void pch_put(CString *cs, int v);
+ST_FUNC int pch_check_toks(const int *p, int len);
+ST_FUNC void pp_cache_free(void);
 ST_FUNC void skip(int c);
 ST_FUNC NORETURN void expect(const char *msg);
 
@@ -1434,7 +1543,15 @@ ST_DATA int nocode_wanted; /* true if no code generation wanted for an expressio
 ST_DATA int global_expr;  /* true if compound literals must be allocated globally (used during initializers parsing */
 ST_DATA CType func_vt; /* current function return type (used by return instruction) */
 ST_DATA int func_var; /* true if current function is variadic */
+ST_DATA int func_regvars; /* true if locals of current function may live in registers */
 ST_DATA int func_vc;
+#ifdef CONFIG_SWIRL_TAILCALL
+ST_DATA int tail_call; /* the next gfunc_call() is 'return f(...);' */
+ST_DATA int func_addr_taken; /* the address of a local may have escaped */
+#endif
+#ifdef CONFIG_SWIRL_NOFRAME
+ST_DATA int func_noframe; /* no call so far: the function may do without a frame */
+#endif
 ST_DATA const char *funcname;
 
 ST_FUNC void swirl_debug_start(SwirlState *s1);
@@ -1444,11 +1561,16 @@ ST_FUNC void swirl_debug_eincl(SwirlState *s1);
 ST_FUNC void swirl_debug_putfile(SwirlState *s1, const char *filename);
 ST_FUNC void swirl_debug_funcstart(SwirlState *s1, Sym *sym);
 ST_FUNC void swirl_debug_funcend(SwirlState *s1, int size);
+#ifdef CONFIG_SWIRL_PEEPHOLE
+ST_FUNC void swirl_debug_remap(SwirlState *s1, const int *map);
+#endif
 ST_FUNC void swirl_debug_line(SwirlState *s1);
 
 ST_FUNC void swirlgen_init(SwirlState *s1);
 ST_FUNC int swirlgen_compile(SwirlState *s1);
 ST_FUNC void swirlgen_finish(SwirlState *s1);
+ST_FUNC void pch_save_syms(SwirlState *s1, CString *cs);
+ST_FUNC const int *pch_load_syms(SwirlState *s1, const int *p, const int *end);
 ST_FUNC void check_vstack(void);
 
 ST_INLN int is_float(int t);
@@ -1501,6 +1623,9 @@ ST_FUNC void gaddrof(void);
 ST_FUNC int gv(int rc);
 ST_FUNC void gv2(int rc1, int rc2);
 ST_FUNC void gen_op(int op);
+#if defined SWIRL_TARGET_X86_64 || defined SWIRL_TARGET_ARM64
+ST_FUNC int gen_divmagic(uint64_t d, int bits, int sgn, uint64_t *pm, int *ps);
+#endif
 ST_FUNC int type_size(CType *type, int *a);
 ST_FUNC void mk_pointer(CType *type);
 ST_FUNC void vstore(void);
@@ -1583,6 +1708,13 @@ ST_FUNC addr_t get_sym_addr(SwirlState *s, const char *name, int err, int forc);
 ST_FUNC void list_elf_symbols(SwirlState *s, void *ctx,
     void (*symbol_cb)(void *ctx, const char *name, const void *val));
 ST_FUNC int set_global_sym(SwirlState *s1, const char *name, Section *sec, addr_t offs);
+ST_FUNC Section *tls_section(SwirlState *s1, int bss);
+ST_FUNC addr_t tls_segment(SwirlState *s1, addr_t *psize, addr_t *palign);
+#ifdef R_DTPMOD
+ST_FUNC addr_t tls_dtpoff(SwirlState *s1, addr_t val);
+ST_FUNC addr_t tls_tpoff(SwirlState *s1, addr_t val);
+ST_FUNC addr_t tls_module(SwirlState *s1);
+#endif
 
 /* Browse each elem of type <type> in section <sec> starting at elem <startoff>
    using variable <elem> */
@@ -1606,7 +1738,10 @@ enum gotplt_entry {
     NO_GOTPLT_ENTRY,	/* never generate (eg. GLOB_DAT & JMP_SLOT relocs) */
     BUILD_GOT_ONLY,	/* only build GOT (eg. TPOFF relocs) */
     AUTO_GOTPLT_ENTRY,	/* generate if sym is UNDEF */
-    ALWAYS_GOTPLT_ENTRY	/* always generate (eg. PLTOFF relocs) */
+    ALWAYS_GOTPLT_ENTRY,	/* always generate (eg. PLTOFF relocs) */
+    TLS_IE_GOT_ENTRY,	/* GOT slot with the TP offset (eg. GOTTPOFF relocs) */
+    TLS_GD_GOT_ENTRY,	/* GOT slot pair for __tls_get_addr (eg. TLSGD relocs) */
+    TLS_LD_GOT_ENTRY	/* GOT slot pair for the module's TLS block (TLSLD) */
 };
 
 #if !defined(ELF_OBJ_ONLY) || defined(SWIRL_TARGET_MACHO)
@@ -1648,6 +1783,47 @@ ST_FUNC void o(unsigned int c);
 ST_FUNC void gen_vla_sp_save(int addr);
 ST_FUNC void gen_vla_sp_restore(int addr);
 ST_FUNC void gen_vla_alloc(CType *type, int align);
+#ifdef CONFIG_SWIRL_REGVARS
+ST_FUNC int gen_regvar(int c, int is_param);
+ST_FUNC void gen_regvar_free(int c);
+#endif
+#ifdef CONFIG_SWIRL_PEEPHOLE
+ST_FUNC int gen_peephole(int start, int end, int opt);
+#endif
+#ifdef CONFIG_SWIRL_RETSITE
+ST_FUNC void gen_ret_site(void);
+#endif
+#ifdef CONFIG_SWIRL_BITOPS
+ST_FUNC int gen_bitop(int op);
+#endif
+#ifdef CONFIG_SWIRL_SIMD
+ST_FUNC int gen_opv(int op, int t);
+#endif
+#ifdef CONFIG_SWIRL_STRUCT_COPY
+ST_FUNC void gen_struct_copy(int size);
+ST_FUNC void gen_struct_zero(int size);
+#endif
+/* memory orders, the values of __ATOMIC_RELAXED ... __ATOMIC_SEQ_CST */
+#define MO_RELAXED 0
+#define MO_CONSUME 1
+#define MO_ACQUIRE 2
+#define MO_RELEASE 3
+#define MO_ACQ_REL 4
+#define MO_SEQ_CST 5
+/* thread-local access models */
+#define TLS_LE 0 /* local-exec: TP offset known at link time */
+#define TLS_IE 1 /* initial-exec: TP offset in the GOT */
+#define TLS_GD 2 /* general-dynamic: __tls_get_addr */
+#ifdef CONFIG_SWIRL_THREAD_LOCAL
+ST_FUNC void gen_tls_addr(Sym *sym, int model);
+#endif
+#ifdef CONFIG_SWIRL_ATOMIC
+ST_FUNC void gen_atomic_load(int t, int order);
+ST_FUNC void gen_atomic_store(int t, int order);
+ST_FUNC int gen_atomic_rmw(int op, int t, int order);
+ST_FUNC void gen_atomic_cas(int t, int order);
+ST_FUNC void gen_atomic_fence(int order);
+#endif
 
 static inline uint16_t read16le(unsigned char *p) {
     return p[0] | (uint16_t)p[1] << 8;
@@ -1806,14 +1982,17 @@ ST_FUNC int swirl_tool_impdef(SwirlState *s, int argc, char **argv);
 #endif
 ST_FUNC void swirl_tool_cross(SwirlState *s, char **argv, int option);
 ST_FUNC void gen_makedeps(SwirlState *s, const char *target, const char *filename);
+#ifndef _WIN32
+ST_FUNC int swirl_tool_jobs(SwirlState *s, int *pret);
+#endif
 #endif
 
 /********************************************************/
 #undef ST_DATA
 #if ONE_SOURCE
-#define ST_DATA static
+#define ST_DATA static ST_TLS
 #else
-#define ST_DATA
+#define ST_DATA ST_TLS
 #endif
 /********************************************************/
 
@@ -1836,6 +2015,8 @@ ST_FUNC void gen_makedeps(SwirlState *s, const char *target, const char *filenam
 #define total_idents        SWIRL_STATE_VAR(total_idents)
 #define total_lines         SWIRL_STATE_VAR(total_lines)
 #define total_bytes         SWIRL_STATE_VAR(total_bytes)
+#define total_tokens        SWIRL_STATE_VAR(total_tokens)
+#define total_syms          SWIRL_STATE_VAR(total_syms)
 
 PUB_FUNC void swirl_enter_state(SwirlState *s1);
 PUB_FUNC void swirl_exit_state(void);
@@ -6,7 +6,7 @@
 #include "swirl.h"
 #ifdef CONFIG_SWIRL_ASM
 
-static Section *last_text_section; /* to handle .previous asm directive */
+static ST_TLS Section *last_text_section; /* to handle .previous asm directive */
 
 ST_FUNC int asm_get_local_label_name(SwirlState *s1, unsigned int n)
 {
@@ -338,6 +338,17 @@ ST_FUNC Section *find_section(SwirlState *s1, const char *name)
     return find_section_create (s1, name, 1);
 }
 
+/* return .tdata or .tbss, created on first use */
+ST_FUNC Section *tls_section(SwirlState *s1, int bss)
+{
+    const char *name = bss ? ".tbss" : ".tdata";
+    Section *sec = find_section_create(s1, name, 0);
+    if (!sec)
+        sec = new_section(s1, name, bss ? SHT_NOBITS : SHT_PROGBITS,
+                          SHF_ALLOC | SHF_WRITE | SHF_TLS);
+    return sec;
+}
+
 /* ------------------------------------------------------------------------- */
 
 ST_FUNC int put_elf_str(Section *s, const char *sym)
@@ -742,6 +753,7 @@ ST_FUNC void put_elf_reloca(Section *symtab, Section *s, unsigned long offset,
             s->reloc = sr;
     }
     rel = section_ptr_add(sr, sizeof(ElfW_Rel));
+    ++s1->total_relocs;
     rel->r_offset = offset;
     rel->r_info = ELFW(R_INFO)(symbol, type);
 #if SHT_RELX == SHT_RELA
@@ -939,6 +951,65 @@ ST_FUNC void relocate_syms(SwirlState *s1, Section *symtab, int do_resolve)
     }
 }
 
+/* start address, size and alignment of the TLS template (.tdata/.tbss) */
+ST_FUNC addr_t tls_segment(SwirlState *s1, addr_t *psize, addr_t *palign)
+{
+    addr_t start = -1, end = 0, align = 1;
+    Section *s;
+    int i;
+
+    for(i = 1; i < s1->nb_sections; i++) {
+        s = s1->sections[i];
+        if ((s->sh_flags & (SHF_ALLOC | SHF_TLS)) != (SHF_ALLOC | SHF_TLS))
+            continue;
+        if (s->sh_addr < start)
+            start = s->sh_addr;
+        if (s->sh_addr + s->data_offset > end)
+            end = s->sh_addr + s->data_offset;
+        if (s->sh_addralign > align)
+            align = s->sh_addralign;
+    }
+    if (start > end)
+        start = end;
+    *psize = end - start;
+    *palign = align;
+    return start;
+}
+
+#ifdef R_DTPMOD
+/* offset of a TLS address within the module's TLS block */
+ST_FUNC addr_t tls_dtpoff(SwirlState *s1, addr_t val)
+{
+    addr_t size, align;
+    return val - tls_segment(s1, &size, &align);
+}
+
+/* offset of a TLS address from the thread pointer, for the executable's
+   block: below the thread pointer on x86 (variant II), after the 16
+   byte TCB on arm64 (variant I) */
+ST_FUNC addr_t tls_tpoff(SwirlState *s1, addr_t val)
+{
+    addr_t size, align, start;
+    start = tls_segment(s1, &size, &align);
+#ifdef SWIRL_TARGET_ARM64
+    return val - start + ((16 + align - 1) & -align);
+#else
+    return val - start - ((size + align - 1) & -align);
+#endif
+}
+
+/* module id for __tls_get_addr: the executable is module 1, with -run
+   it is the swirlrun.c TLS descriptor */
+ST_FUNC addr_t tls_module(SwirlState *s1)
+{
+#ifdef SWIRL_IS_NATIVE
+    if (s1->output_type == SWIRL_OUTPUT_MEMORY)
+        return (addr_t)s1->run_tls;
+#endif
+    return 1;
+}
+#endif
+
 /* relocate a given section (CPU dependent) by applying the relocations
    in the associated relocation section */
 ST_FUNC void relocate_section(SwirlState *s1, Section *s)
@@ -1164,6 +1235,82 @@ static struct sym_attr * put_got_entry(SwirlState *s1, int dyn_reloc_type,
     return attr;
 }
 
+#ifdef R_DTPMOD
+/* Create the GOT slot for an initial-exec TLS access (the offset from the
+   thread pointer) or the slot pair for a general-dynamic one (module id and
+   offset in the module's TLS block, for __tls_get_addr).  Slots for symbols
+   defined in a dynamic executable or local to a DLL are completed in
+   fill_tls_got_entries. */
+static void put_tls_got_entry(SwirlState *s1, int gd, int sym_index)
+{
+    struct sym_attr *attr;
+    ElfW(Sym) *sym;
+    Section *symtab;
+    const char *name;
+    unsigned got_offset;
+    int idx;
+
+    attr = get_sym_attr(s1, sym_index, 1);
+    if (gd ? attr->tls_gd_offset : attr->tls_ie_offset)
+        return;
+    got_offset = s1->got->data_offset;
+    section_ptr_add(s1->got, (1 + gd) * PTR_SIZE);
+    if (gd)
+        attr->tls_gd_offset = got_offset;
+    else
+        attr->tls_ie_offset = got_offset;
+
+    sym = &((ElfW(Sym) *) symtab_section->data)[sym_index];
+    name = (char *) symtab_section->link->data + sym->st_name;
+    symtab = s1->dynsym;
+    idx = attr->dyn_index;
+    if (!symtab) {
+        /* -run or static executable: resolved by relocate() */
+        if (sym->st_shndx == SHN_UNDEF
+            && s1->output_type == SWIRL_OUTPUT_MEMORY
+#if defined SWIRL_IS_NATIVE && !defined SWIRL_TARGET_PE
+            /* else relocate_syms() says it is undefined */
+            && dlsym(RTLD_DEFAULT, &name[s1->leading_underscore])
+#endif
+            )
+            swirl_error_noabort("thread-local '%s' of a shared library "
+                                "is not supported with -run", name);
+        symtab = symtab_section;
+        idx = sym_index;
+    } else if (sym->st_shndx != SHN_UNDEF
+               && s1->output_type == SWIRL_OUTPUT_EXE) {
+        return;
+    } else if (ELFW(ST_BIND)(sym->st_info) == STB_LOCAL) {
+        idx = 0; /* this module */
+    } else if (0 == idx) {
+        idx = attr->dyn_index = set_elf_sym(s1->dynsym, 0, sym->st_size,
+            ELFW(ST_INFO)(ELFW(ST_BIND)(sym->st_info), STT_TLS), 0,
+            SHN_UNDEF, name);
+    }
+    if (gd) {
+        put_elf_reloc(symtab, s1->got, got_offset, R_DTPMOD, idx);
+        if (idx)
+            put_elf_reloc(symtab, s1->got, got_offset + PTR_SIZE,
+                          R_DTPOFF, idx);
+    } else {
+        put_elf_reloc(symtab, s1->got, got_offset, R_TPOFF, idx);
+    }
+}
+
+/* Create the GOT slot pair of local-dynamic accesses, for __tls_get_addr
+   to return the start of this module's TLS block.  Executables relax the
+   sequence to local-exec and need none. */
+static void put_tls_ld_got_entry(SwirlState *s1)
+{
+    if (s1->tls_ld_offset || s1->output_type == SWIRL_OUTPUT_EXE)
+        return;
+    s1->tls_ld_offset = s1->got->data_offset;
+    section_ptr_add(s1->got, 2 * PTR_SIZE);
+    put_elf_reloc(s1->dynsym ? s1->dynsym : symtab_section, s1->got,
+                  s1->tls_ld_offset, R_DTPMOD, 0);
+}
+#endif
+
 /* build GOT and PLT entries */
 static void build_got_entries_pass(SwirlState *s1, int pass)
 {
@@ -1192,6 +1339,21 @@ static void build_got_entries_pass(SwirlState *s1, int pass)
                 continue;
             }
 
+#ifdef R_DTPMOD
+            if (gotplt_entry >= TLS_IE_GOT_ENTRY) {
+                if (pass == 1) {
+                    if (!s1->got)
+                        build_got(s1);
+                    if (gotplt_entry == TLS_LD_GOT_ENTRY)
+                        put_tls_ld_got_entry(s1);
+                    else
+                        put_tls_got_entry(s1, gotplt_entry == TLS_GD_GOT_ENTRY,
+                                          sym_index);
+                }
+                continue;
+            }
+#endif
+
             /* Automatically create PLT/GOT [entry] if it is an undefined
 	       reference (resolved at runtime), or the symbol is absolute,
 	       probably created by swirl_add_symbol, and thus on 64-bit
@@ -1620,6 +1782,60 @@ static void fill_local_got_entries(SwirlState *s1)
     }
 }
 
+#ifdef R_DTPMOD
+/* Complete the TLS GOT slots of put_tls_got_entry once the TLS segment is
+   laid out: executables know all offsets, DLLs know the offsets of their
+   local symbols within their own TLS block. */
+static void fill_tls_got_entries(SwirlState *s1)
+{
+    struct sym_attr *attr;
+    ElfW(Sym) *sym;
+    ElfW_Rel *rel;
+    unsigned char *p;
+    int i;
+
+    for (i = 1; i < s1->nb_sym_attrs; i++) {
+        attr = &s1->sym_attrs[i];
+        if (0 == (attr->tls_ie_offset | attr->tls_gd_offset))
+            continue;
+        sym = &((ElfW(Sym) *) symtab_section->data)[i];
+        if (sym->st_shndx == SHN_UNDEF)
+            continue;
+        if (s1->output_type == SWIRL_OUTPUT_EXE) {
+            if (attr->tls_gd_offset) {
+                p = s1->got->data + attr->tls_gd_offset;
+                write64le(p, 1);
+                write64le(p + PTR_SIZE, tls_dtpoff(s1, sym->st_value));
+            }
+            if (attr->tls_ie_offset)
+                write64le(s1->got->data + attr->tls_ie_offset,
+                          tls_tpoff(s1, sym->st_value));
+        } else if (ELFW(ST_BIND)(sym->st_info) == STB_LOCAL) {
+            if (attr->tls_gd_offset)
+                write64le(s1->got->data + attr->tls_gd_offset + PTR_SIZE,
+                          tls_dtpoff(s1, sym->st_value));
+            if (attr->tls_ie_offset)
+                for_each_elem(s1->got->reloc, 0, rel, ElfW_Rel)
+                    if (rel->r_offset == s1->got->sh_addr + attr->tls_ie_offset)
+                        rel->r_addend = tls_dtpoff(s1, sym->st_value);
+        }
+    }
+}
+#endif
+
+/* TLS symbols of executables and DLLs are offsets in the TLS segment */
+static void tls_offset_syms(SwirlState *s1, Section *symtab)
+{
+    ElfW(Sym) *sym;
+    addr_t size, align, start;
+
+    start = tls_segment(s1, &size, &align);
+    for_each_elem(symtab, 1, sym, ElfW(Sym))
+        if (ELFW(ST_TYPE)(sym->st_info) == STT_TLS
+            && sym->st_shndx != SHN_UNDEF && sym->st_shndx < SHN_LORESERVE)
+            sym->st_value -= start;
+}
+
 /* Bind symbols of executable: resolve undefined symbols from exported symbols
    in shared libraries and export non local defined symbols to shared libraries
    if -rdynamic switch was given on command line */
@@ -1829,10 +2045,14 @@ static int layout_sections(SwirlState *s1, ElfW(Phdr) *phdr,
                            Section *interp,
                            struct ro_inf *roinf, int *sec_order)
 {
-    int i, file_offset;
+    int i, file_offset, tls_offset, tls_filesz;
+    addr_t tls_size, tls_align, tls_addr;
     Section *s;
 
     file_offset = 0;
+    tls_offset = tls_filesz = 0;
+    tls_addr = tls_segment(s1, &tls_size, &tls_align);
+    tls_size = 0;
     if (s1->output_format == SWIRL_OUTPUT_FORMAT_ELF)
         file_offset = sizeof(ElfW(Ehdr)) + phnum * sizeof(ElfW(Phdr));
 
@@ -1879,20 +2099,38 @@ static int layout_sections(SwirlState *s1, ElfW(Phdr) *phdr,
         for(j = 0; j < phfill; j++) {
 	    Section *relocplt = s1->got ? s1->got->relocplt : NULL;
 
-            ph->p_type = j == 2 ? PT_TLS : PT_LOAD;
+            if (j == 2) {
+                /* the TLS template, laid out in the RW segment */
+                ph->p_type = PT_TLS;
+                ph->p_flags = PF_R;
+                ph->p_offset = tls_offset;
+                ph->p_vaddr = ph->p_paddr = tls_addr;
+                ph->p_filesz = tls_filesz;
+                ph->p_memsz = tls_size;
+                ph->p_align = tls_align;
+                break;
+            }
+
+            ph->p_type = PT_LOAD;
             if (j == 0)
                 ph->p_flags = PF_R | PF_X;
             else
                 ph->p_flags = PF_R | PF_W;
-            ph->p_align = j == 2 ? 4 : s_align;
+            ph->p_align = s_align;
 
             /* Decide the layout of sections loaded in memory. This must
                be done before program headers are filled since they contain
                info about the layout. We do the following ordering: interp,
-               symbol tables, relocations, progbits, nobits */
+               symbol tables, relocations, tls progbits, tls nobits,
+               progbits, nobits */
             /* XXX: do faster and simpler sorting */
 	    f = -1;
-            for(k = 0; k < 7; k++) {
+            for(k = 0; k < 9; k++) {
+                if (k == 6 && tls_offset) {
+                    /* .tbss takes no room in the segment */
+                    addr = tls_addr + tls_filesz;
+                    file_offset = tls_offset + tls_filesz;
+                }
                 for(i = 1; i < s1->nb_sections; i++) {
                     s = s1->sections[i];
                     /* compute if section should be included */
@@ -1900,14 +2138,10 @@ static int layout_sections(SwirlState *s1, ElfW(Phdr) *phdr,
                         if ((s->sh_flags & (SHF_ALLOC | SHF_WRITE | SHF_TLS)) !=
                             SHF_ALLOC)
                             continue;
-                    } else if (j == 1) {
-                        if ((s->sh_flags & (SHF_ALLOC | SHF_WRITE | SHF_TLS)) !=
+                    } else {
+                        if ((s->sh_flags & (SHF_ALLOC | SHF_WRITE)) !=
                             (SHF_ALLOC | SHF_WRITE))
                             continue;
-                    } else  {
-                        if ((s->sh_flags & (SHF_ALLOC | SHF_WRITE | SHF_TLS)) !=
-                            (SHF_ALLOC | SHF_WRITE | SHF_TLS))
-                            continue;
                     }
                     if (s == interp) {
                         if (k != 0)
@@ -1923,8 +2157,11 @@ static int layout_sections(SwirlState *s1, ElfW(Phdr) *phdr,
                             continue;
                         else if (k != 3 && s == relocplt)
                             continue;
+                    } else if (s->sh_flags & SHF_TLS) {
+                        if (k != 4 + (s->sh_type == SHT_NOBITS))
+                            continue;
                     } else if (s->sh_type == SHT_NOBITS) {
-                        if (k != 6)
+                        if (k != 8)
                             continue;
                     } else if (s == data_ro_section ||
 #ifdef CONFIG_SWIRL_BCHECK
@@ -1932,13 +2169,13 @@ static int layout_sections(SwirlState *s1, ElfW(Phdr) *phdr,
 			       s == lbounds_section ||
 #endif
                                0) {
-                        if (k != 4)
+                        if (k != 6)
                             continue;
 			/* Align next section on page size.
 			   This is needed to remap roinf section ro. */
 			f = 1;
                     } else {
-                        if (k != 5)
+                        if (k != 7)
                             continue;
 		    }
                     *sec_order++ = i;
@@ -1947,11 +2184,22 @@ static int layout_sections(SwirlState *s1, ElfW(Phdr) *phdr,
                     tmp = addr;
 		    if (f-- == 0)
 			s->sh_addralign = PAGESIZE;
+                    if ((s->sh_flags & SHF_TLS) && 0 == tls_offset)
+                        /* the TLS block is aligned as its most aligned
+                           member */
+                        addr = (addr + tls_align - 1) & ~(tls_align - 1);
                     addr = (addr + s->sh_addralign - 1) &
                         ~(s->sh_addralign - 1);
                     file_offset += (int) ( addr - tmp );
                     s->sh_offset = file_offset;
                     s->sh_addr = addr;
+                    if (s->sh_flags & SHF_TLS) {
+                        if (0 == tls_offset)
+                            tls_offset = file_offset, tls_addr = addr;
+                        tls_size = addr + s->sh_size - tls_addr;
+                        if (s->sh_type != SHT_NOBITS)
+                            tls_filesz = tls_size;
+                    }
 
                     /* update program header infos */
                     if (ph->p_offset == 0) {
@@ -2364,7 +2612,7 @@ static void swirl_output_binary(SwirlState *s1, FILE *f,
 static int swirl_write_elf_file(SwirlState *s1, const char *filename, int phnum,
                               ElfW(Phdr) *phdr, int file_offset, int *sec_order)
 {
-    int fd, mode, file_type;
+    int fd, mode, file_type, phase;
     FILE *f;
 
     file_type = s1->output_type;
@@ -2372,10 +2620,12 @@ static int swirl_write_elf_file(SwirlState *s1, const char *filename, int phnum,
         mode = 0666;
     else
         mode = 0777;
+    phase = swirl_bench(s1, BENCH_OUTPUT);
     unlink(filename);
     fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC | O_BINARY, mode);
     if (fd < 0) {
         swirl_error_noabort("could not write '%s'", filename);
+        swirl_bench(s1, phase);
         return -1;
     }
     f = fdopen(fd, "wb");
@@ -2392,7 +2642,7 @@ static int swirl_write_elf_file(SwirlState *s1, const char *filename, int phnum,
     else
         swirl_output_binary(s1, f, sec_order);
     fclose(f);
-
+    swirl_bench(s1, phase);
     return 0;
 }
 
@@ -2622,7 +2872,7 @@ static int elf_output_file(SwirlState *s1, const char *filename)
 
     /* compute number of program headers */
     if (file_type == SWIRL_OUTPUT_DLL)
-        phnum = 3;
+        phnum = 3 + (i < s1->nb_sections);
     else if (s1->static_link)
         phnum = 3;
     else {
@@ -2683,8 +2933,17 @@ static int elf_output_file(SwirlState *s1, const char *filename)
         /* Perform relocation to GOT or PLT entries */
         if (file_type == SWIRL_OUTPUT_EXE && s1->static_link)
             fill_got(s1);
-        else if (s1->got)
+        else if (s1->got) {
             fill_local_got_entries(s1);
+#ifdef R_DTPMOD
+            fill_tls_got_entries(s1);
+#endif
+        }
+        if (phfill > 2) {
+            tls_offset_syms(s1, symtab_section);
+            if (dynamic)
+                tls_offset_syms(s1, s1->dynsym);
+        }
     }
     /* Create the ELF file with name 'filename' */
     ret = swirl_write_elf_file(s1, filename, phnum, phdr, file_offset, sec_order);
@@ -2740,6 +2999,14 @@ static int elf_output_obj(SwirlState *s1, const char *filename)
     int *sec_order;
     s1->nb_errors = 0;
 
+    /* -fcache-dir */
+    if (s1->cache_hit) {
+        if (swirl_copy_file(s1, s1->cache_obj, filename) == 0)
+            return 0;
+        swirl_error_noabort("could not write '%s'", filename);
+        return -1;
+    }
+
     /* Allocate strings for section names */
     alloc_sec_names(s1, 1);
 
@@ -2751,20 +3018,31 @@ static int elf_output_obj(SwirlState *s1, const char *filename)
     /* Create the ELF file with name 'filename' */
     ret = swirl_write_elf_file(s1, filename, 0, NULL, file_offset, sec_order);
     swirl_free(sec_order);
+    /* a hit would not repeat the warnings, so keep only clean objects */
+    if (ret == 0 && s1->cache_obj && !s1->nb_warnings)
+        swirl_copy_file(s1, filename, s1->cache_obj);
     return ret;
 }
 
 LIBSWIRLAPI int swirl_output_file(SwirlState *s, const char *filename)
 {
-    if (s->output_type == SWIRL_OUTPUT_OBJ)
-        return elf_output_obj(s, filename);
+    int ret, phase;
+
+    phase = swirl_bench(s, BENCH_RELOC);
+    if (s->pch_out.size)
+        ret = swirl_output_pch(s, filename);
+    else if (s->output_type == SWIRL_OUTPUT_OBJ)
+        ret = elf_output_obj(s, filename);
+    else
 #ifdef SWIRL_TARGET_PE
-    return  pe_output_file(s, filename);
+        ret = pe_output_file(s, filename);
 #elif SWIRL_TARGET_MACHO
-    return macho_output_file(s, filename);
+        ret = macho_output_file(s, filename);
 #else
-    return elf_output_file(s, filename);
+        ret = elf_output_file(s, filename);
 #endif
+    swirl_bench(s, phase);
+    return ret;
 }
 
 ST_FUNC ssize_t full_read(int fd, void *buf, size_t count) {
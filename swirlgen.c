@@ -21,18 +21,18 @@ ST_DATA Sym *define_stack;
 ST_DATA Sym *global_label_stack;
 ST_DATA Sym *local_label_stack;
 
-static Sym *sym_free_first;
-static void **sym_pools;
-static int nb_sym_pools;
+static ST_TLS Sym *sym_free_first;
+static ST_TLS void **sym_pools;
+static ST_TLS int nb_sym_pools;
 
-static Sym *all_cleanups, *pending_gotos;
-static int local_scope;
-static int in_sizeof;
-static int in_generic;
-static int section_sym;
+static ST_TLS Sym *all_cleanups, *pending_gotos;
+static ST_TLS int local_scope;
+static ST_TLS int in_sizeof;
+static ST_TLS int in_generic;
+static ST_TLS int section_sym;
 
 ST_DATA SValue *vtop;
-static SValue _vstack[1 + VSTACK_SIZE];
+static ST_TLS SValue _vstack[1 + VSTACK_SIZE];
 #define vstack (_vstack + 1)
 
 ST_DATA int const_wanted; /* true if constant wanted */
@@ -61,11 +61,25 @@ static int gjmp_acs(int t) { t = gjmp(t); CODE_OFF(); return t; }
 ST_DATA int global_expr;  /* true if compound literals must be allocated globally (used during initializers parsing */
 ST_DATA CType func_vt; /* current function return type (used by return instruction) */
 ST_DATA int func_var; /* true if current function is variadic (used by return instruction) */
+ST_DATA int func_regvars; /* true if locals of current function may live in registers */
 ST_DATA int func_vc;
-static int last_line_num, new_file, func_ind; /* debug info control */
+#ifdef CONFIG_SWIRL_TAILCALL
+ST_DATA int tail_call, func_addr_taken;
+static ST_TLS int in_return; /* the next unary() starts a return value */
+#endif
+#ifdef CONFIG_SWIRL_NOFRAME
+ST_DATA int func_noframe;
+#endif
+static ST_TLS int last_line_num, new_file, func_ind; /* debug info control */
+static ST_TLS unsigned debug_func_stab; /* stabs of the current function */
+static ST_TLS int func_asm; /* current function has asm or label addresses */
 ST_DATA const char *funcname;
 ST_DATA CType int_type, func_old_type, char_type, char_pointer_type;
-static CString initstr;
+static ST_TLS CString initstr;
+#ifdef CONFIG_SWIRL_REGVARS
+/* names that appear after '&' in the current function body */
+static ST_TLS int *regvar_excl, regvar_nb_excl;
+#endif
 
 #if PTR_SIZE == 4
 #define VT_SIZE_T (VT_INT | VT_UNSIGNED)
@@ -97,9 +111,9 @@ ST_DATA struct temp_local_variable {
 	short size;
 	short align;
 } arr_temp_local_vars[MAX_TEMP_LOCAL_VARIABLE_NUMBER];
-short nb_temp_local_vars;
+ST_DATA short nb_temp_local_vars;
 
-static struct scope {
+static ST_TLS struct scope {
     struct scope *prev;
     struct { int loc, num; } vla;
     struct { Sym *s; int n; } cl;
@@ -107,6 +121,37 @@ static struct scope {
     Sym *lstk, *llstk;
 } *cur_scope, *loop_scope, *root_scope;
 
+/* -O: a call being expanded in place by gen_inline_call() */
+static ST_TLS struct inline_call {
+    struct inline_call *prev;
+    InlineFunc *fn;
+    int ret_loc; /* local holding the return value, or 0 */
+    int ret_val; /* the return value was left on the value stack */
+    int tail; /* in 'return f(...);': its returns are the caller's */
+    int nb_hidden; /* inline_hidden[] before this call */
+} *cur_inline;
+
+/* identifiers which referred to locals of the callers */
+static ST_TLS struct inline_hidden {
+    TokenSym *ts;
+    Sym *sym, *tag, *label;
+} *inline_hidden;
+static ST_TLS int inline_nb_hidden;
+
+/* -O: statements which __builtin_expect moved to the end of the
+   function, see cold_add() */
+static ST_TLS struct cold_block {
+    struct cold_block *next;
+    TokenString *str;
+    int jmp; /* the jumps to the statement */
+    int back; /* where it goes on */
+    int scope; /* local_scope at the 'if' */
+    int nb_syms;
+    Sym *syms[1]; /* the locals visible at the 'if', innermost first */
+} *cold_blocks;
+static ST_TLS int cold_replay; /* generating them */
+static ST_TLS int expect_hint; /* __builtin_expect() in an 'if', see unary() */
+
 typedef struct {
     Section *sec;
     int local_offset;
@@ -164,16 +209,16 @@ static const struct {
     {   VT_VOID, "void:t27=27" },
 };
 
-static int debug_next_type;
+static ST_TLS int debug_next_type;
 
-static struct debug_hash {
+static ST_TLS struct debug_hash {
     int debug_type;
     Sym *type;
 } *debug_hash;
 
-static int n_debug_hash;
+static ST_TLS int n_debug_hash;
 
-static struct debug_info {
+static ST_TLS struct debug_info {
     int start;
     int end;
     int n_sym;
@@ -212,6 +257,7 @@ static int is_compatible_types(CType *type1, CType *type2);
 static int parse_btype(CType *type, AttributeDef *ad);
 static CType *type_decl(CType *type, AttributeDef *ad, int *v, int td);
 static void parse_expr_type(CType *type);
+static void parse_type(CType *type);
 static void init_putv(init_params *p, CType *type, unsigned long c);
 static void decl_initializer(init_params *p, CType *type, unsigned long c, int flags);
 static void block(int is_expr);
@@ -227,8 +273,18 @@ static void vpush(CType *type);
 static int gvtst(int inv, int t);
 static void gen_inline_functions(SwirlState *s);
 static void free_inline_functions(SwirlState *s);
+static InlineFunc *inline_find(SValue *sv);
+static void gen_inline_call(InlineFunc *fn, int tail);
 static void skip_or_save_block(TokenString **str);
+#ifdef CONFIG_SWIRL_REGVARS
+static void regvar_alloc(Sym *sym, AttributeDef *ad, int is_param);
+#endif
 static void gv_dup(void);
+#ifdef CONFIG_SWIRL_ATOMIC
+static void atomic_lv_load(void);
+static void atomic_lv_store(void);
+static void atomic_lv_modify(int op, int post);
+#endif
 static int get_temp_local_var(int size,int align);
 static void clear_temp_local_var_list();
 static void cast_error(CType *st, CType *dt);
@@ -239,7 +295,8 @@ ST_INLN int is_float(int t)
     return bt == VT_LDOUBLE
         || bt == VT_DOUBLE
         || bt == VT_FLOAT
-        || bt == VT_QFLOAT;
+        || bt == VT_QFLOAT
+        || bt == VT_QVEC;
 }
 
 static inline int is_integer_btype(int bt)
@@ -491,7 +548,7 @@ static void swirl_get_debug_info(SwirlState *s1, Sym *s, CString *result)
     CString str;
 
     for (;;) {
-        type = t->type.t & ~(VT_STORAGE | VT_CONSTANT | VT_VOLATILE);
+        type = t->type.t & ~(VT_STORAGE | VT_CONSTANT | VT_VOLATILE | VT_ATOMIC);
         if ((type & VT_BTYPE) != VT_BYTE)
             type &= ~VT_DEFSIGN;
         if (type == VT_PTR || type == (VT_PTR | VT_ARRAY))
@@ -581,7 +638,7 @@ static void swirl_get_debug_info(SwirlState *s1, Sym *s, CString *result)
         cstr_printf (result, "%d=", ++debug_next_type);
     t = s;
     for (;;) {
-        type = t->type.t & ~(VT_STORAGE | VT_CONSTANT | VT_VOLATILE);
+        type = t->type.t & ~(VT_STORAGE | VT_CONSTANT | VT_VOLATILE | VT_ATOMIC);
         if ((type & VT_BTYPE) != VT_BYTE)
             type &= ~VT_DEFSIGN;
         if (type == VT_PTR)
@@ -722,6 +779,7 @@ ST_FUNC void swirl_debug_funcstart(SwirlState *s1, Sym *sym)
     BufferedFile *f;
     if (!s1->do_debug)
         return;
+    debug_func_stab = stab_section->data_offset;
     debug_info_root = NULL;
     debug_info = NULL;
     swirl_debug_stabn(N_LBRAC, ind - func_ind);
@@ -736,6 +794,33 @@ ST_FUNC void swirl_debug_funcstart(SwirlState *s1, Sym *sym)
     swirl_debug_line(s1);
 }
 
+#ifdef CONFIG_SWIRL_PEEPHOLE
+static void swirl_debug_remap_info(struct debug_info *cur, const int *map)
+{
+    for (; cur; cur = cur->next) {
+        cur->start = map[cur->start];
+        cur->end = map[cur->end];
+        swirl_debug_remap_info(cur->child, map);
+    }
+}
+
+/* the code of the current function was moved: map[o] is the new
+   offset of the code that was at offset o */
+ST_FUNC void swirl_debug_remap(SwirlState *s1, const int *map)
+{
+    Stab_Sym *sym = (Stab_Sym *)(stab_section->data + debug_func_stab);
+    Stab_Sym *end = (Stab_Sym *)(stab_section->data + stab_section->data_offset);
+
+    for (; sym < end; sym++) {
+        if (sym->n_type == N_SLINE)
+            sym->n_value = map[sym->n_value];
+        else if (sym->n_type == N_SOL)
+            sym->n_value = func_ind + map[sym->n_value - func_ind];
+    }
+    swirl_debug_remap_info(debug_info_root, map);
+}
+#endif
+
 /* put function size */
 ST_FUNC void swirl_debug_funcend(SwirlState *s1, int size)
 {
@@ -778,6 +863,7 @@ ST_FUNC void swirlgen_init(SwirlState *s1)
 {
     vtop = vstack - 1;
     memset(vtop, 0, sizeof *vtop);
+    anon_sym = SYM_FIRST_ANOM;
 
     /* define some often used types */
     int_type.t = VT_INT;
@@ -800,13 +886,17 @@ ST_FUNC void swirlgen_init(SwirlState *s1)
 
 ST_FUNC int swirlgen_compile(SwirlState *s1)
 {
+    int n;
+
     cur_text_section = NULL;
     funcname = "";
-    anon_sym = SYM_FIRST_ANOM;
     section_sym = 0;
     const_wanted = 0;
     nocode_wanted = 0x80000000;
     local_scope = 0;
+    cur_inline = NULL;
+    cold_blocks = NULL;
+    expect_hint = -1;
 
     swirl_debug_start(s1);
 #ifdef SWIRL_TARGET_ARM
@@ -818,7 +908,9 @@ ST_FUNC int swirlgen_compile(SwirlState *s1)
     parse_flags = PARSE_FLAG_PREPROCESS | PARSE_FLAG_TOK_NUM | PARSE_FLAG_TOK_STR;
     next();
     decl(VT_CONST);
+    n = swirl_bench(s1, BENCH_INLINE);
     gen_inline_functions(s1);
+    swirl_bench(s1, n);
     check_vstack();
     /* end of translation unit info */
     swirl_debug_end(s1);
@@ -827,8 +919,23 @@ ST_FUNC int swirlgen_compile(SwirlState *s1)
 
 ST_FUNC void swirlgen_finish(SwirlState *s1)
 {
+    struct cold_block *cb;
+
     cstr_free(&initstr);
     free_inline_functions(s1);
+#ifdef CONFIG_SWIRL_REGVARS
+    swirl_free(regvar_excl);
+    regvar_excl = NULL;
+#endif
+    swirl_free(inline_hidden);
+    inline_hidden = NULL;
+    inline_nb_hidden = 0;
+    while ((cb = cold_blocks)) {
+        cold_blocks = cb->next;
+        tok_str_free(cb->str);
+        swirl_free(cb);
+    }
+    cold_replay = 0;
     sym_pop(&global_stack, NULL, 0);
     sym_pop(&local_stack, NULL, 0);
     /* free preprocessor macros */
@@ -912,7 +1019,7 @@ ST_FUNC void put_extern_sym2(Sym *sym, int sh_num,
             if ((t & (VT_BTYPE|VT_ASM_FUNC)) == VT_ASM_FUNC)
                 sym_type = STT_FUNC;
         } else {
-            sym_type = STT_OBJECT;
+            sym_type = t & VT_TLS ? STT_TLS : STT_OBJECT;
         }
         if (t & (VT_STATIC | VT_INLINE))
             sym_bind = STB_LOCAL;
@@ -950,7 +1057,7 @@ ST_FUNC void put_extern_sym2(Sym *sym, int sh_num,
         sym->c = put_elf_sym(symtab_section, value, size, info, other, sh_num, name);
 
         if (swirl_state->do_debug
-            && sym_type != STT_FUNC
+            && sym_type != STT_FUNC && sym_type != STT_TLS
             && sym->v < SYM_FIRST_ANOM)
             swirl_debug_extern_sym(swirl_state, sym, sh_num, sym_bind);
 
@@ -1020,6 +1127,7 @@ static Sym *__sym_malloc(void)
 static inline Sym *sym_malloc(void)
 {
     Sym *sym;
+    ++total_syms;
 #ifndef SYM_DEBUG
     sym = sym_free_first;
     if (!sym)
@@ -1169,7 +1277,9 @@ ST_FUNC void sym_pop(Sym **ptop, Sym *b, int keep)
                 ps = &ts->sym_struct;
             else
                 ps = &ts->sym_identifier;
-            *ps = s->prev_tok;
+            /* unless removed by an earlier sym_pop(.., keep) */
+            if (*ps == s)
+                *ps = s->prev_tok;
         }
 	if (!keep)
 	    sym_free(s);
@@ -1523,6 +1633,14 @@ static void merge_funcattr(struct FuncAttr *fa, struct FuncAttr *fa1)
       fa->func_ctor = 1;
     if (fa1->func_dtor)
       fa->func_dtor = 1;
+    if (fa1->func_alwinl)
+      fa->func_alwinl = 1;
+    if (fa1->func_noinline)
+      fa->func_noinline = 1;
+    if (fa1->func_cold)
+      fa->func_cold = 1;
+    if (fa1->func_rtwice)
+      fa->func_rtwice = 1;
 }
 
 /* Merge attributes.  */
@@ -1601,6 +1719,9 @@ static void patch_type(Sym *sym, CType *type)
         if ((type->t ^ sym->type.t) & VT_STATIC)
             swirl_warning("storage mismatch for redefinition of '%s'",
                 get_tok_str(sym->v, NULL));
+        if ((type->t ^ sym->type.t) & VT_TLS)
+            swirl_error("thread-local and non thread-local declarations of '%s'",
+                get_tok_str(sym->v, NULL));
     }
 }
 
@@ -2192,6 +2313,10 @@ ST_FUNC int gv(int rc)
         if (vtop->r & VT_MUSTBOUND) 
             gbound();
 #endif
+#ifdef CONFIG_SWIRL_ATOMIC
+        if ((vtop->type.t & VT_ATOMIC) && (vtop->r & VT_LVAL))
+            atomic_lv_load();
+#endif
 
         bt = vtop->type.t & VT_BTYPE;
 
@@ -2623,6 +2748,71 @@ static int gen_opic_lt(uint64_t a, uint64_t b)
     return (a ^ (uint64_t)1 << 63) < (b ^ (uint64_t)1 << 63);
 }
 
+#if defined SWIRL_TARGET_X86_64 || defined SWIRL_TARGET_ARM64
+/* find the multiplier 'm' and shift 's' to divide a 'bits' wide value
+   by the constant 'd' with a high multiply (Hacker's Delight, chap. 10).
+   'd' must not be 0, 1 or -1.  Signed: q = hi(x * m) (+ x if d > 0 and
+   m < 0, - x if d < 0 and m > 0) >> s, then add the sign bit of q.
+   Unsigned: q = hi(x * m) >> s, unless 1 is returned, in which case the
+   multiplier has 'bits' + 1 bits and q = ((x - t) / 2 + t) >> (s - 1)
+   with t = hi(x * m). */
+ST_FUNC int gen_divmagic(uint64_t d, int bits, int sgn, uint64_t *pm, int *ps)
+{
+    uint64_t mask = bits == 64 ? ~(uint64_t)0 : ((uint64_t)1 << bits) - 1;
+    uint64_t two = (uint64_t)1 << (bits - 1);
+    uint64_t ad, anc, nc, t, delta, q1, r1, q2, r2;
+    int p = bits - 1, a = 0;
+
+    d &= mask;
+    if (sgn) {
+        ad = d & two ? -d & mask : d;
+        t = two + (d >> (bits - 1));
+        anc = t - 1 - t % ad;
+        q1 = two / anc, r1 = two - q1 * anc;
+        q2 = two / ad, r2 = two - q2 * ad;
+        do {
+            p++;
+            q1 = 2 * q1 & mask, r1 = 2 * r1 & mask;
+            if (r1 >= anc)
+                q1++, r1 -= anc;
+            q2 = 2 * q2 & mask, r2 = 2 * r2 & mask;
+            if (r2 >= ad)
+                q2++, r2 -= ad;
+            delta = ad - r2;
+        } while (q1 < delta || (q1 == delta && r1 == 0));
+        q2++;
+        if (d & two)
+            q2 = -q2;
+    } else {
+        nc = mask - (-d & mask) % d;
+        q1 = two / nc, r1 = two - q1 * nc;
+        q2 = (two - 1) / d, r2 = (two - 1) - q2 * d;
+        do {
+            p++;
+            if (r1 >= nc - r1)
+                q1 = 2 * q1 + 1, r1 = 2 * r1 - nc;
+            else
+                q1 = 2 * q1, r1 = 2 * r1;
+            if (r2 + 1 >= d - r2) {
+                if (q2 >= two - 1)
+                    a = 1;
+                q2 = 2 * q2 + 1, r2 = 2 * r2 + 1 - d;
+            } else {
+                if (q2 >= two)
+                    a = 1;
+                q2 = 2 * q2, r2 = 2 * r2 + 1;
+            }
+            q1 &= mask, r1 &= mask, q2 &= mask, r2 &= mask;
+            delta = d - 1 - r2;
+        } while (p < 2 * bits && (q1 < delta || (q1 == delta && r1 == 0)));
+        q2++;
+    }
+    *pm = q2 & mask;
+    *ps = p - bits;
+    return a;
+}
+#endif
+
 /* handle integer constant optimizations and various machine
    independent opt */
 static void gen_opic(int op)
@@ -2732,6 +2922,11 @@ static void gen_opic(int op)
                             (l2 == -1 || (l2 == 0xFFFFFFFF && t2 != VT_LLONG))))) {
             /* filter out NOP operations like x*1, x-0, x&-1... */
             vtop--;
+        } else if (c2 && op == TOK_UMOD && l2 && (l2 & (l2 - 1)) == 0) {
+            /* unsigned modulo by a power of 2 is a mask */
+            vtop->c.i = l2 - 1;
+            op = '&';
+            goto general_case;
         } else if (c2 && (op == '*' || op == TOK_PDIV || op == TOK_UDIV)) {
             /* try to use shifts instead of muls or divs */
             if (l2 > 0 && (l2 & (l2 - 1)) == 0) {
@@ -2914,6 +3109,8 @@ static void type_to_str(char *buf, int buf_size,
         pstrcat(buf, buf_size, "volatile ");
     if (t & VT_CONSTANT)
         pstrcat(buf, buf_size, "const ");
+    if (t & VT_ATOMIC)
+        pstrcat(buf, buf_size, "_Atomic ");
 
     if (((t & VT_DEFSIGN) && bt == VT_BYTE)
         || ((t & VT_UNSIGNED)
@@ -2963,6 +3160,15 @@ static void type_to_str(char *buf, int buf_size,
         pstrcat(buf, buf_size, tstr);
         break;
     case VT_STRUCT:
+        if (IS_VECTOR(type->ref->type.t)) {
+            s = type->ref->next;
+            snprintf(buf1, sizeof(buf1), "__vector(%d) ",
+                     type->ref->c / type_size(&s->type, &v));
+            pstrcat(buf, buf_size, buf1);
+            type_to_str(buf1, sizeof(buf1), &s->type, NULL);
+            tstr = buf1;
+            goto add_tstr;
+        }
         tstr = "struct ";
         if (IS_UNION(t))
             tstr = "union ";
@@ -3012,6 +3218,8 @@ static void type_to_str(char *buf, int buf_size,
             pstrcat(buf1, buf_size, "const ");
         if (t & VT_VOLATILE)
             pstrcat(buf1, buf_size, "volatile ");
+        if (t & VT_ATOMIC)
+            pstrcat(buf1, buf_size, "_Atomic ");
         if (varstr)
             pstrcat(buf1, sizeof(buf1), varstr);
         type_to_str(buf, buf_size, &s->type, buf1);
@@ -3103,8 +3311,8 @@ static int compare_types(CType *type1, CType *type2, int unqualified)
     t2 = type2->t & VT_TYPE;
     if (unqualified) {
         /* strip qualifiers before comparing */
-        t1 &= ~(VT_CONSTANT | VT_VOLATILE);
-        t2 &= ~(VT_CONSTANT | VT_VOLATILE);
+        t1 &= ~(VT_CONSTANT | VT_VOLATILE | VT_ATOMIC);
+        t2 &= ~(VT_CONSTANT | VT_VOLATILE | VT_ATOMIC);
     }
 
     /* Default Vs explicit signedness only matters for char */
@@ -3193,8 +3401,8 @@ static int combine_types(CType *dest, SValue *op1, SValue *op2, int op)
                    pointed to types minus qualifs should be compatible */
                 type = *((pbt1 == VT_VOID) ? type1 : type2);
                 /* combine qualifs */
-                newquals = ((pt1->t | pt2->t) & (VT_CONSTANT | VT_VOLATILE));
-                if ((~pointed_type(&type)->t & (VT_CONSTANT | VT_VOLATILE))
+                newquals = ((pt1->t | pt2->t) & (VT_CONSTANT | VT_VOLATILE | VT_ATOMIC));
+                if ((~pointed_type(&type)->t & (VT_CONSTANT | VT_VOLATILE | VT_ATOMIC))
                     & newquals)
                   {
                     /* copy the pointer target symbol */
@@ -3259,6 +3467,240 @@ static int combine_types(CType *dest, SValue *op1, SValue *op2, int op)
     return ret;
 }
 
+/* ------------------------------------------------------------------------- */
+/* GCC vector extensions: vector_size types are structs with one field per
+   element, values of these types are always kept in memory */
+
+static int is_vector(CType *type)
+{
+    return (type->t & VT_BTYPE) == VT_STRUCT && IS_VECTOR(type->ref->type.t);
+}
+
+/* make 'type' a vector of 'size' bytes of its current type */
+static void mk_vector(CType *type, int size)
+{
+    Sym *s, *f, **pf;
+    int t, bt, esize, align, i;
+
+    t = type->t & (VT_BTYPE | VT_UNSIGNED | VT_DEFSIGN | VT_LONG);
+    bt = t & VT_BTYPE;
+    if (IS_ENUM(type->t) || (bt != VT_FLOAT && bt != VT_DOUBLE
+                             && (!is_integer_btype(bt) || bt == VT_BOOL)))
+        swirl_error("invalid vector type for attribute 'vector_size'");
+    esize = type_size(type, &align);
+    if (size <= 0 || size % esize || (size & (size - 1)))
+        swirl_error("invalid vector size %d", size);
+    /* vector types are unique.  Only their tags, not fields of
+       vector type. */
+    for (s = global_stack; s; s = s->prev)
+        if ((s->v & SYM_STRUCT) && s->type.t == VT_VECTOR
+            && s->r == size && s->next->type.t == t)
+            goto found;
+    s = sym_push2(&global_stack, anon_sym++ | SYM_STRUCT, VT_VECTOR, size);
+    s->r = size;
+    pf = &s->next;
+    for (i = 0; i < size; i += esize) {
+        f = sym_push2(&global_stack, SYM_FIELD, t, i);
+        *pf = f, pf = &f->next;
+    }
+found:
+    type->t = VT_VECTOR
+        | (type->t & (VT_STORAGE | VT_CONSTANT | VT_VOLATILE | VT_ATOMIC));
+    type->ref = s;
+}
+
+/* vector operand which can be accessed by element offsets */
+static int vec_stable(SValue *sv)
+{
+    int r = sv->r & (VT_VALMASK | VT_LVAL);
+    return r == (VT_LOCAL | VT_LVAL) || r == (VT_CONST | VT_LVAL);
+}
+
+#ifdef CONFIG_SWIRL_SIMD
+/* store the 128-bit vector register in vtop into a stack temporary */
+static void vec_spill(CType *type)
+{
+    int r = vtop->r, l;
+
+    l = get_temp_local_var(16, 16);
+    vset(&vtop->type, VT_LOCAL | VT_LVAL, l);
+    store(r, vtop);
+    vtop -= 2;
+    vset(type, VT_LOCAL | VT_LVAL, l);
+}
+#endif
+
+/* copy the vector in vtop into a stack temporary */
+static void vec_temp(void)
+{
+    CType type;
+    int size, align, l;
+
+    type = vtop->type;
+    size = type_size(&type, &align);
+#ifdef CONFIG_SWIRL_SIMD
+    if (size == 16) {
+        vtop->type.t = VT_QVEC;
+        gv(RC_FLOAT);
+        vec_spill(&type);
+        return;
+    }
+#endif
+    l = get_temp_local_var(size, align);
+    vset(&type, VT_LOCAL | VT_LVAL, l);
+    vswap();
+    vstore();
+    vpop();
+    vset(&type, VT_LOCAL | VT_LVAL, l);
+}
+
+/* replace the scalar in vtop by a vector of 'type' with all elements
+   set to it */
+static void vec_splat(CType *type)
+{
+    CType et;
+    int i, size, align, esize;
+
+    et = type->ref->next->type;
+    size = type_size(type, &align);
+    esize = type_size(&et, &i);
+    gen_cast(&et);
+    if (is_float(et.t)
+        || (vtop->r & (VT_VALMASK | VT_LVAL | VT_SYM)) != VT_CONST)
+        gv(RC_TYPE(et.t));
+    /* the vector first, to keep the temporary in use */
+    vset(type, VT_LOCAL | VT_LVAL, get_temp_local_var(size, align));
+    vswap();
+    for (i = 0; i < size; i += esize) {
+        vset(&et, VT_LOCAL | VT_LVAL, vtop[-1].c.i + i);
+        vpushv(vtop - 1);
+        vstore();
+        vpop();
+    }
+    vpop();
+}
+
+/* elementwise binary operation on vectors, a scalar operand is converted
+   to a vector first */
+static void gen_opvec(int op)
+{
+    CType type, et, rt;
+    int i, size, align, esize, cmp, shift;
+    SValue sv;
+
+    type = is_vector(&vtop[-1].type) ? vtop[-1].type : vtop->type;
+    type.t = VT_VECTOR;
+    et = type.ref->next->type;
+    size = type_size(&type, &align);
+    esize = type_size(&et, &i);
+    cmp = TOK_ISCOND(op);
+    shift = op == TOK_SHL || op == TOK_SAR;
+    if (op == TOK_LAND || op == TOK_LOR
+        || (is_float(et.t) && op != '+' && op != '-' && op != '*'
+            && op != '/' && !cmp))
+        swirl_error("invalid operands for binary operation");
+    if (is_vector(&vtop[-1].type) && is_vector(&vtop->type)) {
+        if (!compare_types(&vtop[-1].type, &vtop->type, 1))
+            type_incompatibility_error(&vtop[-1].type, &vtop->type,
+                "invalid operands for binary operation ('%s' and '%s')");
+    } else {
+        i = is_vector(&vtop->type) ? -1 : 0;
+        if (!is_integer_btype(vtop[i].type.t & VT_BTYPE)
+            && !is_float(vtop[i].type.t))
+            swirl_error("invalid operands for binary operation");
+        if (i) {
+            vswap();
+            vec_splat(&type);
+            vswap();
+        } else if (!shift) {
+            vec_splat(&type);
+        } else {
+            gen_cast_s(VT_INT);
+        }
+    }
+    if (et.t & VT_UNSIGNED) {
+        if (op == TOK_SAR)
+            op = TOK_SHR;
+        else if (op == '/')
+            op = TOK_UDIV;
+        else if (op == '%')
+            op = TOK_UMOD;
+        else if (op == TOK_LT)
+            op = TOK_ULT;
+        else if (op == TOK_GT)
+            op = TOK_UGT;
+        else if (op == TOK_LE)
+            op = TOK_ULE;
+        else if (op == TOK_GE)
+            op = TOK_UGE;
+    }
+    /* comparisons give vectors of signed integers, with all bits set
+       for true */
+    rt = type;
+    if (cmp) {
+        rt.t = esize == 1 ? VT_BYTE | VT_DEFSIGN : esize == 2 ? VT_SHORT :
+               esize == 4 ? VT_INT : VT_LLONG;
+        mk_vector(&rt, size);
+    }
+#ifdef CONFIG_SWIRL_SIMD
+    if (size == 16 && gen_opv(op, et.t)) {
+        vec_spill(&rt);
+        return;
+    }
+#endif
+    if (!is_vector(&vtop->type))
+        vec_splat(&type);
+    for (i = -1; i <= 0; i++)
+        if (!vec_stable(&vtop[i])) {
+            if (i)
+                vswap();
+            vec_temp();
+            if (i)
+                vswap();
+        }
+    vset(&rt, VT_LOCAL | VT_LVAL, get_temp_local_var(size, align));
+    rt = rt.ref->next->type;
+    for (i = 0; i < size; i += esize) {
+        vset(&rt, VT_LOCAL | VT_LVAL, vtop->c.i + i);
+        sv = vtop[-3], sv.type = et, sv.c.i += i;
+        vpushv(&sv);
+        sv = vtop[-3], sv.type = et, sv.c.i += i;
+        vpushv(&sv);
+        gen_op(op);
+        if (cmp) {
+            vpushi(0);
+            vswap();
+            gen_op('-');
+        }
+        vstore();
+        vpop();
+    }
+    vrott(3);
+    vpop();
+    vpop();
+}
+
+/* casts between vectors and values of the same size reinterpret them */
+static void gen_cast_vec(CType *type)
+{
+    int size, align;
+
+    size = type_size(type, &align);
+    if (size != type_size(&vtop->type, &align)
+        || (!is_vector(type) && !is_integer_btype(type->t & VT_BTYPE))
+        || (!is_vector(&vtop->type)
+            && !is_integer_btype(vtop->type.t & VT_BTYPE)))
+        cast_error(&vtop->type, type);
+    if (!is_vector(&vtop->type) || !(vtop->r & VT_LVAL)) {
+        vset(&vtop->type, VT_LOCAL | VT_LVAL,
+             get_temp_local_var(size, align));
+        vswap();
+        vstore();
+        vpop();
+    }
+    vtop->type = *type;
+}
+
 /* generic gen_op: handles types problems */
 ST_FUNC void gen_op(int op)
 {
@@ -3283,6 +3725,8 @@ redo:
 	    vswap();
 	}
 	goto redo;
+    } else if (is_vector(&vtop[-1].type) || is_vector(&vtop->type)) {
+        gen_opvec(op);
     } else if (!combine_types(&combtype, vtop - 1, vtop, op)) {
         swirl_error_noabort("invalid operand types for binary operation");
         vpop();
@@ -3406,7 +3850,7 @@ redo:
         }
     }
     // Make sure that we have converted to an rvalue:
-    if (vtop->r & VT_LVAL)
+    if ((vtop->r & VT_LVAL) && !is_vector(&vtop->type))
         gv(is_float(vtop->type.t & VT_BTYPE) ? RC_FLOAT : RC_INT);
 }
 
@@ -3497,6 +3941,17 @@ static void gen_cast(CType *type)
     /* bitfields first get cast to ints */
     if (vtop->type.t & VT_BITFIELD)
         gv(RC_INT);
+#ifdef CONFIG_SWIRL_ATOMIC
+    /* _Atomic objects must be read as a whole */
+    if ((vtop->type.t & VT_ATOMIC) && (vtop->r & VT_LVAL))
+        gv(RC_TYPE(vtop->type.t));
+#endif
+
+    if ((is_vector(type) || is_vector(&vtop->type))
+        && (type->t & VT_BTYPE) != VT_VOID) {
+        gen_cast_vec(type);
+        return;
+    }
 
     dbt = type->t & (VT_BTYPE | VT_UNSIGNED);
     sbt = vtop->type.t & (VT_BTYPE | VT_UNSIGNED);
@@ -3709,7 +4164,7 @@ again:
     }
 done:
     vtop->type = *type;
-    vtop->type.t &= ~ ( VT_CONSTANT | VT_VOLATILE | VT_ARRAY );
+    vtop->type.t &= ~ ( VT_CONSTANT | VT_VOLATILE | VT_ATOMIC | VT_ARRAY );
 }
 
 /* return type size as known at compile time. Put alignment at 'a' */
@@ -3770,6 +4225,9 @@ ST_FUNC int type_size(CType *type, int *a)
     } else if (bt == VT_QLONG || bt == VT_QFLOAT) {
         *a = 8;
         return 16;
+    } else if (bt == VT_QVEC) {
+        *a = 16;
+        return 16;
     } else {
         /* char, void, function, _Bool */
         *a = 1;
@@ -3861,7 +4319,8 @@ static void verify_assign_cast(CType *dt)
             break;
         for (qualwarn = lvl = 0;; ++lvl) {
             if (((type2->t & VT_CONSTANT) && !(type1->t & VT_CONSTANT)) ||
-                ((type2->t & VT_VOLATILE) && !(type1->t & VT_VOLATILE)))
+                ((type2->t & VT_VOLATILE) && !(type1->t & VT_VOLATILE)) ||
+                ((type2->t & VT_ATOMIC) && !(type1->t & VT_ATOMIC)))
                 qualwarn = 1;
             dbt = type1->t & (VT_BTYPE|VT_LONG);
             sbt = type2->t & (VT_BTYPE|VT_LONG);
@@ -3938,10 +4397,43 @@ ST_FUNC void vstore(void)
 #ifdef CONFIG_SWIRL_BCHECK
             if (vtop->r & VT_MUSTBOUND)
                 gbound(); /* check would be wrong after gaddrof() */
+#endif
+#ifdef CONFIG_SWIRL_SIMD
+            if (size == 16 && is_vector(&vtop->type)) {
+                /* move through a vector register */
+                vpushv(vtop - 1);
+                vtop->type.t = VT_QVEC;
+                gv(RC_FLOAT);
+                vswap();
+                if ((vtop->r & VT_VALMASK) == VT_LLOCAL) {
+                    vtop->type.t = VT_PTR;
+                    gaddrof();
+                    gv(RC_INT);
+                    vtop->r |= VT_LVAL;
+                }
+                vtop->type.t = VT_QVEC;
+                store(vtop[-1].r, vtop);
+                vtop -= 2;
+                return;
+            }
 #endif
             vtop->type.t = VT_PTR;
             gaddrof();
 
+#ifdef CONFIG_SWIRL_STRUCT_COPY
+            if (size <= CONFIG_SWIRL_STRUCT_COPY
+#ifdef CONFIG_SWIRL_BCHECK
+                && !swirl_state->do_bounds_check
+#endif
+                ) {
+                /* open coded */
+                vpushv(vtop - 1);
+                vtop->type.t = VT_PTR;
+                gaddrof();
+                gen_struct_copy(size);
+                return;
+            }
+#endif
             /* address of memcpy() */
 #ifdef SWIRL_ARM_EABI
             if(!(align & 7))
@@ -4020,6 +4512,10 @@ ST_FUNC void vstore(void)
         }
     } else if (dbt == VT_VOID) {
         --vtop;
+#ifdef CONFIG_SWIRL_ATOMIC
+    } else if (ft & VT_ATOMIC) {
+        atomic_lv_store();
+#endif
     } else {
             /* optimize char/short casts */
             delayed_cast = 0;
@@ -4093,9 +4589,20 @@ ST_FUNC void vstore(void)
 ST_FUNC void inc(int post, int c)
 {
     test_lvalue();
+#ifdef CONFIG_SWIRL_ATOMIC
+    if (vtop->type.t & VT_ATOMIC) {
+        vpushi(c - TOK_MID);
+        atomic_lv_modify('+', post);
+        return;
+    }
+#endif
     vdup(); /* save lvalue */
     if (post) {
-        gv_dup(); /* duplicate value */
+        if (is_vector(&vtop->type)) {
+            vec_temp();
+            vdup();
+        } else
+            gv_dup(); /* duplicate value */
         vrotb(3);
         vrotb(3);
     }
@@ -4187,6 +4694,18 @@ redo:
         case TOK_ALWAYS_INLINE2:
             ad->f.func_alwinl = 1;
             break;
+        case TOK_NOINLINE1:
+        case TOK_NOINLINE2:
+            ad->f.func_noinline = 1;
+            break;
+        case TOK_COLD1:
+        case TOK_COLD2:
+            ad->f.func_cold = 1;
+            break;
+        case TOK_RETURNS_TWICE1:
+        case TOK_RETURNS_TWICE2:
+            ad->f.func_rtwice = 1;
+            break;
         case TOK_SECTION1:
         case TOK_SECTION2:
             skip('(');
@@ -4283,6 +4802,12 @@ redo:
             ad->f.func_call = FUNC_FASTCALLW;
             break;            
 #endif
+        case TOK_VECTOR_SIZE1:
+        case TOK_VECTOR_SIZE2:
+            skip('(');
+            ad->vector_size = expr_const();
+            skip(')');
+            break;
         case TOK_MODE:
             skip('(');
             switch(tok) {
@@ -4988,6 +5513,20 @@ static int parse_btype(CType *type, AttributeDef *ad)
             t = type->t;
             next();
             break;
+        case TOK_ATOMIC:
+            next();
+            if (tok == '(') {
+                /* _Atomic(type-name) */
+                next();
+                parse_type(&type1);
+                skip(')');
+                type1.t |= VT_ATOMIC;
+                goto basic_type2;
+            }
+            type->t = t;
+            parse_btype_qualify(type, VT_ATOMIC);
+            t = type->t;
+            break;
         case TOK_SIGNED1:
         case TOK_SIGNED2:
         case TOK_SIGNED3:
@@ -5023,11 +5562,19 @@ static int parse_btype(CType *type, AttributeDef *ad)
             g = VT_TYPEDEF;
             goto storage;
        storage:
-            if (t & (VT_EXTERN|VT_STATIC|VT_TYPEDEF) & ~g)
+            if ((t & (VT_EXTERN|VT_STATIC|VT_TYPEDEF) & ~g)
+                || ((t & VT_TLS) && g == VT_TYPEDEF))
                 swirl_error("multiple storage classes");
             t |= g;
             next();
             break;
+        case TOK_THREAD_LOCAL1:
+        case TOK_THREAD_LOCAL2:
+            if (t & VT_TYPEDEF)
+                swirl_error("multiple storage classes");
+            t |= VT_TLS;
+            next();
+            break;
         case TOK_INLINE1:
         case TOK_INLINE2:
         case TOK_INLINE3:
@@ -5073,7 +5620,7 @@ static int parse_btype(CType *type, AttributeDef *ad)
             }
 
             t &= ~(VT_BTYPE|VT_LONG);
-            u = t & ~(VT_CONSTANT | VT_VOLATILE), t ^= u;
+            u = t & ~(VT_CONSTANT | VT_VOLATILE | VT_ATOMIC), t ^= u;
             type->t = (s->type.t & ~VT_TYPEDEF) | u;
             type->ref = s->type.ref;
             if (t)
@@ -5100,6 +5647,16 @@ the_end:
     if (bt == VT_LDOUBLE)
         t = (t & ~(VT_BTYPE|VT_LONG)) | (VT_DOUBLE|VT_LONG);
 #endif
+    if (ad->vector_size) {
+        type->t = t;
+        mk_vector(type, ad->vector_size);
+        ad->vector_size = 0;
+        t = type->t;
+    }
+    if ((t & VT_ATOMIC) && ((t & VT_BTYPE) == VT_STRUCT
+                            || (t & VT_BTYPE) == VT_LDOUBLE
+                            || (t & VT_BTYPE) == VT_FUNC))
+        swirl_error("_Atomic is not supported on this type");
     type->t = t;
     return type_found;
 }
@@ -5110,7 +5667,7 @@ static inline void convert_parameter_type(CType *pt)
 {
     /* remove const and volatile qualifiers (XXX: const could be used
        to indicate a const function parameter */
-    pt->t &= ~(VT_CONSTANT | VT_VOLATILE);
+    pt->t &= ~(VT_CONSTANT | VT_VOLATILE | VT_ATOMIC);
     /* array must be transformed to pointer according to ANSI C */
     pt->t &= ~VT_ARRAY;
     if ((pt->t & VT_BTYPE) == VT_FUNC) {
@@ -5337,6 +5894,9 @@ static CType *type_decl(CType *type, AttributeDef *ad, int *v, int td)
         case TOK_VOLATILE3:
             qualifiers |= VT_VOLATILE;
             goto redo;
+        case TOK_ATOMIC:
+            qualifiers |= VT_ATOMIC;
+            goto redo;
         case TOK_RESTRICT1:
         case TOK_RESTRICT2:
         case TOK_RESTRICT3:
@@ -5379,6 +5939,14 @@ static CType *type_decl(CType *type, AttributeDef *ad, int *v, int td)
     }
     post_type(post, ad, storage, 0);
     parse_attribute(ad);
+    if (ad->vector_size) {
+        /* applies to the base type of the declarator */
+        for (post = type; (post->t & VT_BTYPE) == VT_PTR
+                 || (post->t & VT_BTYPE) == VT_FUNC; post = &post->ref->type)
+            ;
+        mk_vector(post, ad->vector_size);
+        ad->vector_size = 0;
+    }
     type->t |= storage;
     return ret;
 }
@@ -5471,6 +6039,19 @@ static void parse_type(CType *type)
     type_decl(type, &ad, &n, TYPE_ABSTRACT);
 }
 
+/* second argument of __builtin_expect, saved by skip_or_save_block() */
+static void expect_value(TokenString *str)
+{
+    unget_tok(0);
+    begin_macro(str, 0);
+    next();
+    expr_eq();
+    if (tok != TOK_EOF)
+        expect(")");
+    end_macro();
+    next();
+}
+
 static void parse_builtin_params(int nc, const char *args)
 {
     char c, sep = '(';
@@ -5522,97 +6103,775 @@ static void parse_builtin_params(int nc, const char *args)
         nocode_wanted--;
 }
 
-ST_FUNC void unary(void)
+/* __builtin_popcount, clz, ctz, ffs and parity (and their l and ll
+   flavours) and __builtin_bswap16/32/64 on the value in vtop */
+static void gen_builtin_bits(int t)
 {
-    int n, t, align, size, r, sizeof_caller;
+    int k, ll, bits, n;
+    uint64_t v, w;
     CType type;
-    Sym *s;
-    AttributeDef ad;
-
-    /* generate line number info */
-    if (swirl_state->do_debug)
-        swirl_debug_line(swirl_state);
 
-    sizeof_caller = in_sizeof;
-    in_sizeof = 0;
+    if (t >= TOK_builtin_bswap16) {
+        k = 5;
+        ll = t == TOK_builtin_bswap64;
+    } else {
+        k = (t - TOK_builtin_popcount) / 3;
+        n = (t - TOK_builtin_popcount) % 3;
+        ll = n == 2 || (n == 1 && LONG_SIZE == 8);
+    }
+    bits = ll ? 64 : 32;
     type.ref = NULL;
-    /* XXX: GCC 2.95.3 does not generate a table although it should be
-       better here */
- tok_next:
-    switch(tok) {
-    case TOK_EXTENSION:
-        next();
-        goto tok_next;
-    case TOK_LCHAR:
-#ifdef SWIRL_TARGET_PE
-        t = VT_SHORT|VT_UNSIGNED;
-        goto push_tokc;
-#endif
-    case TOK_CINT:
-    case TOK_CCHAR: 
-	t = VT_INT;
- push_tokc:
-	type.t = t;
-	vsetc(&type, VT_CONST, &tokc);
-        next();
-        break;
-    case TOK_CUINT:
-        t = VT_INT | VT_UNSIGNED;
-        goto push_tokc;
-    case TOK_CLLONG:
-        t = VT_LLONG;
-	goto push_tokc;
-    case TOK_CULLONG:
-        t = VT_LLONG | VT_UNSIGNED;
-	goto push_tokc;
-    case TOK_CFLOAT:
-        t = VT_FLOAT;
-	goto push_tokc;
-    case TOK_CDOUBLE:
-        t = VT_DOUBLE;
-	goto push_tokc;
-    case TOK_CLDOUBLE:
-        t = VT_LDOUBLE;
-	goto push_tokc;
-    case TOK_CLONG:
-        t = (LONG_SIZE == 8 ? VT_LLONG : VT_INT) | VT_LONG;
-	goto push_tokc;
-    case TOK_CULONG:
-        t = (LONG_SIZE == 8 ? VT_LLONG : VT_INT) | VT_LONG | VT_UNSIGNED;
-	goto push_tokc;
-    case TOK___FUNCTION__:
-        if (!gnu_ext)
-            goto tok_identifier;
-        /* fall thru */
-    case TOK___FUNC__:
-        {
-            void *ptr;
-            int len;
-            /* special function name identifier */
-            len = strlen(funcname) + 1;
-            /* generate char[len] type */
-            type.t = VT_BYTE;
-            mk_pointer(&type);
-            type.t |= VT_ARRAY;
-            type.ref->c = len;
-            vpush_ref(&type, data_section, data_section->data_offset, len);
-            if (!NODATA_WANTED) {
-                ptr = section_ptr_add(data_section, len);
-                memcpy(ptr, funcname, len);
-            }
-            next();
+    if (t == TOK_builtin_bswap16) {
+        type.t = VT_SHORT | VT_UNSIGNED;
+        gen_cast(&type);
+    }
+    type.t = (ll ? VT_LLONG : VT_INT) | VT_UNSIGNED;
+    gen_cast(&type);
+
+    if ((vtop->r & (VT_VALMASK | VT_LVAL | VT_SYM)) == VT_CONST) {
+        v = vtop->c.i;
+        if (!ll)
+            v = (uint32_t)v;
+        switch (k) {
+        case 0: /* popcount */
+        case 4: /* parity */
+            for (n = 0; v; v &= v - 1)
+                n++;
+            v = k ? n & 1 : n;
+            break;
+        case 1: /* clz */
+            for (n = 0; n < bits && !(v >> (bits - 1 - n) & 1); n++)
+                ;
+            v = n;
+            break;
+        case 2: /* ctz */
+        case 3: /* ffs */
+            for (n = 0; n < bits && !(v >> n & 1); n++)
+                ;
+            v = k == 2 ? n : v ? n + 1 : 0;
+            break;
+        default: /* bswap */
+            for (n = 0, w = 0; n < bits; n += 8, v >>= 8)
+                w = w << 8 | (v & 255);
+            v = w;
+            break;
         }
-        break;
-    case TOK_LSTR:
-#ifdef SWIRL_TARGET_PE
-        t = VT_SHORT | VT_UNSIGNED;
-#else
-        t = VT_INT;
+        vtop->c.i = v;
+    } else
+#ifdef CONFIG_SWIRL_BITOPS
+    if (!gen_bitop(k < 5 ? TOK_builtin_popcount + k * 3
+                          : TOK_builtin_bswap32))
 #endif
-        goto str_init;
-    case TOK_STR:
-        /* string parsing */
-        t = VT_BYTE;
+    {
+        vpush_helper_func(TOK___popcountsi2 + k * 2 + ll);
+        vrott(2);
+        gfunc_call(1);
+        vpushi(0);
+        PUT_R_RET(vtop, type.t);
+    }
+    if (k < 5)
+        vtop->type.t = VT_INT;
+    else
+        vtop->type = type;
+    if (t == TOK_builtin_bswap16) {
+        vpushi(16);
+        gen_op(TOK_SHR);
+        type.t = VT_SHORT | VT_UNSIGNED;
+        gen_cast(&type);
+    }
+}
+
+#ifdef CONFIG_SWIRL_ATOMIC
+/* ------------------------------------------------------------------------- */
+/* atomics */
+
+/* the type the backend works with for an atomic object of type 'type':
+   an integer of 1, 2, 4 or 8 bytes, or with !ival also float or double
+   (for plain loads and stores) */
+static int atomic_btype(CType *type, int ival)
+{
+    int bt = type->t & VT_BTYPE;
+
+    if (type->t & VT_ARRAY)
+        bt = VT_VOID;
+    switch (bt) {
+    case VT_BOOL:
+        return VT_BYTE | VT_UNSIGNED;
+    case VT_LLONG:
+        if (PTR_SIZE == 4)
+            break;
+    case VT_BYTE:
+    case VT_SHORT:
+    case VT_INT:
+        return type->t & (VT_BTYPE | VT_UNSIGNED);
+    case VT_PTR:
+        return VT_SIZE_T & ~VT_LONG;
+    case VT_FLOAT:
+        return ival ? VT_INT : VT_FLOAT;
+    case VT_DOUBLE:
+        if (!ival)
+            return VT_DOUBLE;
+        if (PTR_SIZE == 8)
+            return VT_LLONG;
+        break;
+    }
+    swirl_error("unsupported type for atomic operation");
+    return 0;
+}
+
+/* make the pointer in vtop point to the backend type 't' */
+static void atomic_ptr(int t)
+{
+    CType type;
+
+    type.t = t;
+    type.ref = NULL;
+    mk_pointer(&type);
+    vtop->type = type;
+}
+
+/* make the pointer in vtop an lvalue of the backend type 't' */
+static void atomic_deref(int t)
+{
+    if ((vtop->type.t & VT_BTYPE) != VT_PTR)
+        expect("pointer");
+    atomic_ptr(t);
+    indir();
+}
+
+/* the unqualified type of the object pointed to by vtop */
+static void atomic_pointee(CType *type)
+{
+    if ((vtop->type.t & VT_BTYPE) != VT_PTR)
+        expect("pointer");
+    *type = *pointed_type(&vtop->type);
+    type->t &= VT_TYPE & ~(VT_CONSTANT | VT_VOLATILE | VT_ATOMIC);
+}
+
+/* parse ", memorder" of a builtin.  Orders not known at compile time
+   are taken as seq_cst */
+static int atomic_order(void)
+{
+    int order = MO_SEQ_CST;
+
+    skip(',');
+    expr_eq();
+    if ((vtop->r & (VT_VALMASK | VT_LVAL | VT_SYM)) == VT_CONST
+        && (uint64_t)vtop->c.i <= MO_SEQ_CST)
+        order = vtop->c.i;
+    vpop();
+    return order;
+}
+
+/* move vtop into a new local, which replaces it.  Returns its offset */
+static int vstash(void)
+{
+    CType type;
+    int size, align;
+
+    type = vtop->type;
+    type.t &= VT_TYPE & ~(VT_CONSTANT | VT_VOLATILE | VT_ATOMIC | VT_ARRAY);
+    size = type_size(&type, &align);
+    loc = (loc - size) & -align;
+    vset(&type, VT_LOCAL | VT_LVAL, loc);
+    vswap();
+    vstore();
+    vpop();
+    vset(&type, VT_LOCAL | VT_LVAL, loc);
+    return loc;
+}
+
+/* combine the old value vtop[-1] with the operand vtop */
+static void atomic_apply(int op)
+{
+    if (op == '=') {
+        vswap();
+        vpop();
+    } else if (op == '~') {
+        gen_op('&');
+        vpushi(-1);
+        gen_op('^');
+    } else {
+        gen_op(op);
+    }
+}
+
+/* *p = *p op v with a compare and swap loop, p (pointing to the integer
+   't') and v on the stack.  The arithmetic is done in 'type'.  Leaves
+   the new value, or the old one with 'post' */
+static void atomic_cas_loop(int op, CType *type, int t, int order, int post)
+{
+    CType it, pt, vt;
+    int lp, lv, lo, ln, lr, a, j, size, align;
+
+    if (nocode_wanted) {
+        vpop();
+        vpop();
+        vset(type, VT_CONST, 0);
+        return;
+    }
+    it.t = t;
+    it.ref = NULL;
+    pt = it;
+    mk_pointer(&pt);
+    lv = vstash();
+    vt = vtop->type;
+    vswap();
+    vtop->type = pt;
+    lp = vstash();
+    indir();
+    lo = vstash();
+    vpop();
+    vpop();
+    size = type_size(type, &align);
+    ln = loc = (loc - size) & -align;
+
+    save_regs(0);
+    a = ind;
+    /* new = old op v */
+    vset(type, VT_LOCAL | VT_LVAL, ln);
+    vset(type, VT_LOCAL | VT_LVAL, lo);
+    vset(&vt, VT_LOCAL | VT_LVAL, lv);
+    atomic_apply(op);
+    vstore();
+    vpop();
+    /* try to replace old by new, retry with what was there if it fails */
+    vset(&pt, VT_LOCAL | VT_LVAL, lp);
+    vset(&it, VT_LOCAL | VT_LVAL, lo);
+    vset(&it, VT_LOCAL | VT_LVAL, ln);
+    gen_atomic_cas(t, order);
+    lr = vstash();
+    vset(&it, VT_LOCAL | VT_LVAL, lo);
+    gen_op(TOK_EQ);
+    j = gvtst(0, 0);
+    vset(&it, VT_LOCAL | VT_LVAL, lo);
+    vset(&it, VT_LOCAL | VT_LVAL, lr);
+    vstore();
+    vpop();
+    gjmp_addr(a);
+    gsym(j);
+
+    vset(type, VT_LOCAL | VT_LVAL, post ? lo : ln);
+    gv(RC_TYPE(type->t));
+}
+
+/* *p op= v with p (pointing to the backend type of 'type') and v on the
+   stack, '=' is exchange and '~' nand.  Leaves the new value, or the old
+   one with 'post' */
+static void atomic_modify(int op, CType *type, int order, int post)
+{
+    int bt = type->t & VT_BTYPE, t = atomic_btype(type, 1);
+    CType it;
+    SValue sv;
+
+    it.t = t;
+    it.ref = NULL;
+    if (op == '=')
+        gen_cast(type);
+    if (op == '=' ? !is_float(bt)
+        : strchr("+-&|^~", op)
+          && is_integer_btype(vtop->type.t & VT_BTYPE)
+          && (bt == VT_PTR ? op == '+' || op == '-'
+              : is_integer_btype(bt) && bt != VT_BOOL)) {
+        gen_cast(&it);
+        if (!post && (vtop->r & (VT_VALMASK | VT_LVAL | VT_SYM)) != VT_CONST)
+            vstash();
+        sv = *vtop;
+        if (gen_atomic_rmw(op, t, order)) {
+            if (!post) {
+                vpushv(&sv);
+                atomic_apply(op);
+                gen_cast(&it);
+            }
+            vtop->type = *type;
+            return;
+        }
+    }
+    atomic_cas_loop(op, bt == VT_PTR ? &it : type, t, order, post);
+    vtop->type = *type;
+}
+
+/* compare and swap with p, the expected value and the desired one on the
+   stack.  Leaves the value that was in *p */
+static void atomic_cas(int t, int order)
+{
+    gen_atomic_cas(t, order);
+    vtop->type.t = t;
+}
+
+/* __atomic_compare_exchange with p, a pointer to the expected value and
+   the desired one on the stack: leaves whether the exchange was done,
+   and stores the value found in *expected if not */
+static void atomic_compare_exchange(int t, int order)
+{
+    CType pt, bt;
+    int le, lo, j;
+
+    pt = vtop[-1].type;
+    vswap();
+    le = vstash();
+    indir();
+    gv(RC_INT);
+    vswap();
+    atomic_cas(t, order);
+    lo = vstash();
+    vset(&pt, VT_LOCAL | VT_LVAL, le);
+    indir();
+    gen_op(TOK_EQ);
+    bt.t = VT_BOOL;
+    bt.ref = NULL;
+    gen_cast(&bt);
+    vstash();
+    save_regs(0);
+    vpushv(vtop);
+    j = gvtst(0, 0);
+    vset(&pt, VT_LOCAL | VT_LVAL, le);
+    indir();
+    vset(&vtop->type, VT_LOCAL | VT_LVAL, lo);
+    vstore();
+    vpop();
+    gsym(j);
+    gv(RC_INT);
+}
+
+/* a plain read of the _Atomic lvalue in vtop */
+static void atomic_lv_load(void)
+{
+    CType type;
+    int t;
+
+    type = vtop->type;
+    type.t &= ~(VT_CONSTANT | VT_VOLATILE | VT_ATOMIC);
+    t = atomic_btype(&type, 0);
+    gaddrof();
+    atomic_ptr(t);
+    gen_atomic_load(t, MO_SEQ_CST);
+    vtop->type = type;
+}
+
+/* a plain store of vtop to the _Atomic lvalue vtop[-1] */
+static void atomic_lv_store(void)
+{
+    CType type;
+    int t;
+
+    type = vtop[-1].type;
+    type.t &= ~(VT_CONSTANT | VT_VOLATILE | VT_ATOMIC);
+    t = atomic_btype(&type, 0);
+    gen_cast(&type);
+    vswap();
+#ifdef CONFIG_SWIRL_BCHECK
+    if (vtop->r & VT_MUSTBOUND)
+        gbound();
+#endif
+    gaddrof();
+    atomic_ptr(t);
+    vswap();
+    /* keep a copy as the value of the assignment */
+    if ((vtop->r & (VT_VALMASK | VT_LVAL | VT_SYM)) == VT_CONST)
+        vdup();
+    else if (is_float(type.t))
+        vstash(), vdup();
+    else
+        gv_dup();
+    vrott(3);
+    vtop->type.t = t;
+    gen_atomic_store(t, MO_SEQ_CST);
+}
+
+/* v op= w on the _Atomic lvalue v, with v and w on the stack.  Leaves
+   the new value, or the old one with 'post' */
+static void atomic_lv_modify(int op, int post)
+{
+    CType type;
+
+    type = vtop[-1].type;
+    if (type.t & VT_BITFIELD)
+        swirl_error("atomic bit-field");
+    type.t &= ~(VT_CONSTANT | VT_VOLATILE | VT_ATOMIC);
+    vswap();
+#ifdef CONFIG_SWIRL_BCHECK
+    if (vtop->r & VT_MUSTBOUND)
+        gbound();
+#endif
+    gaddrof();
+    atomic_ptr(atomic_btype(&type, 1));
+    vswap();
+    if ((type.t & VT_BTYPE) == VT_PTR && (op == '+' || op == '-')) {
+        if (!is_integer_btype(vtop->type.t & VT_BTYPE))
+            swirl_error("invalid operand types for binary operation");
+        vpushs(pointed_size(&type));
+        gen_op('*');
+    }
+    atomic_modify(op, &type, MO_SEQ_CST, post);
+}
+
+/* __atomic_xxx and __sync_xxx */
+static void parse_atomic(int t)
+{
+    static const char ops[] = "+-&|^~";
+    int k = t - TOK___atomic_load_n, order = MO_SEQ_CST, n, it, lv = 0;
+    CType type, itype;
+
+    next();
+    skip('(');
+    if (t == TOK___atomic_always_lock_free || t == TOK___atomic_is_lock_free) {
+        n = expr_const();
+        skip(',');
+        expr_eq();
+        vpop();
+        skip(')');
+        vpushi(n == 1 || n == 2 || n == 4 || n == PTR_SIZE);
+        vtop->type.t = VT_BOOL;
+        return;
+    }
+    if (t == TOK___atomic_thread_fence || t == TOK___atomic_signal_fence
+        || t == TOK___sync_synchronize) {
+        if (t != TOK___sync_synchronize) {
+            expr_eq();
+            if ((vtop->r & (VT_VALMASK | VT_LVAL | VT_SYM)) == VT_CONST
+                && (uint64_t)vtop->c.i <= MO_SEQ_CST)
+                order = vtop->c.i;
+            vpop();
+        }
+        /* a signal fence only needs to keep the compiler in line,
+           which we do anyway */
+        if (t != TOK___atomic_signal_fence && order != MO_RELAXED)
+            gen_atomic_fence(order);
+        goto done;
+    }
+
+    expr_eq();
+    atomic_pointee(&type);
+    if (t == TOK___atomic_test_and_set || t == TOK___atomic_clear)
+        type.t = VT_BYTE | VT_UNSIGNED;
+    else if (k < 4 || k >= 8) {
+        if (!is_integer_btype(type.t & VT_BTYPE)
+            && (type.t & VT_BTYPE) != VT_PTR)
+            expect("pointer to integer or pointer");
+    }
+    it = atomic_btype(&type, 1);
+    itype.t = it;
+    itype.ref = NULL;
+    atomic_ptr(it);
+
+    switch (t) {
+    case TOK___atomic_load_n:
+    case TOK___atomic_load:
+        if (t == TOK___atomic_load)
+            skip(','), expr_eq(), vswap();
+        order = atomic_order();
+        gen_atomic_load(it, order);
+        if (t == TOK___atomic_load)
+            goto store_ret;
+        vtop->type = type;
+        break;
+
+    case TOK___atomic_store_n:
+    case TOK___atomic_store:
+    case TOK___atomic_clear:
+    case TOK___sync_lock_release:
+        if (t == TOK___atomic_store_n) {
+            skip(',');
+            expr_eq();
+            gen_cast(&type);
+            gen_cast(&itype);
+        } else if (t == TOK___atomic_store) {
+            skip(',');
+            expr_eq();
+            atomic_deref(it);
+            gv(RC_INT);
+        } else {
+            vpushi(0);
+            gen_cast(&itype);
+        }
+        if (t == TOK___sync_lock_release)
+            order = MO_RELEASE;
+        else
+            order = atomic_order();
+        gen_atomic_store(it, order);
+        goto done;
+
+    case TOK___atomic_exchange_n:
+    case TOK___atomic_exchange:
+    case TOK___atomic_test_and_set:
+    case TOK___sync_lock_test_and_set:
+        if (t == TOK___atomic_test_and_set) {
+            vpushi(1);
+        } else {
+            skip(',');
+            expr_eq();
+        }
+        if (t == TOK___atomic_exchange) {
+            atomic_deref(it);
+            gv(RC_INT);
+            skip(',');
+            expr_eq();
+            vrott(3);
+            order = atomic_order();
+            atomic_modify('=', &itype, order, 1);
+        store_ret:
+            vswap();
+            atomic_deref(it);
+            vswap();
+            vstore();
+            vpop();
+            goto done;
+        }
+        if (t == TOK___sync_lock_test_and_set)
+            order = MO_ACQUIRE;
+        else
+            order = atomic_order();
+        atomic_modify('=', &type, order, 1);
+        if (t == TOK___atomic_test_and_set) {
+            vpushi(0);
+            gen_op(TOK_NE);
+        }
+        break;
+
+    case TOK___atomic_compare_exchange_n:
+    case TOK___atomic_compare_exchange:
+        skip(',');
+        expr_eq();
+        if ((vtop->type.t & VT_BTYPE) != VT_PTR)
+            expect("pointer");
+        atomic_ptr(it);
+        skip(',');
+        expr_eq();
+        if (t == TOK___atomic_compare_exchange) {
+            atomic_deref(it);
+            gv(RC_INT);
+        } else {
+            gen_cast(&type);
+            gen_cast(&itype);
+        }
+        skip(',');
+        expr_eq(); /* weak */
+        vpop();
+        order = atomic_order();
+        atomic_order(); /* the failure order can't be stronger */
+        atomic_compare_exchange(it, order);
+        vtop->type.t = VT_BOOL;
+        break;
+
+    case TOK___sync_bool_compare_and_swap:
+    case TOK___sync_val_compare_and_swap:
+        skip(',');
+        expr_eq();
+        gen_cast(&type);
+        gen_cast(&itype);
+        if (t == TOK___sync_bool_compare_and_swap)
+            lv = vstash();
+        skip(',');
+        expr_eq();
+        gen_cast(&type);
+        gen_cast(&itype);
+        while (tok == ',')
+            next(), expr_eq(), vpop();
+        atomic_cas(it, order);
+        if (t == TOK___sync_bool_compare_and_swap) {
+            vset(&itype, VT_LOCAL | VT_LVAL, lv);
+            gen_op(TOK_EQ);
+            break;
+        }
+        vtop->type = type;
+        break;
+
+    default:
+        /* fetch_op, op_fetch */
+        if (t >= TOK___sync_fetch_and_add) {
+            k = t - TOK___sync_fetch_and_add;
+            skip(',');
+            expr_eq();
+            while (tok == ',')
+                next(), expr_eq(), vpop();
+        } else {
+            k -= 8;
+            skip(',');
+            expr_eq();
+            order = atomic_order();
+        }
+        atomic_modify(ops[k % 6], &type, order, k < 6);
+        break;
+    }
+    skip(')');
+    return;
+done:
+    skip(')');
+    vpushi(0);
+    vtop->type.t = VT_VOID;
+}
+#endif /* CONFIG_SWIRL_ATOMIC */
+
+#ifdef CONFIG_SWIRL_THREAD_LOCAL
+/* replace the thread-local variable 's' on vtop by an lvalue at its
+   address in the current thread */
+static void tls_lvalue(Sym *s)
+{
+    SwirlState *s1 = swirl_state;
+    ElfSym *esym = elfsym(s);
+    CType type;
+    int model;
+
+    if (s1->output_type == SWIRL_OUTPUT_MEMORY
+        || s1->output_type == SWIRL_OUTPUT_DLL || s1->pic)
+        model = TLS_GD;
+    else if (esym && esym->st_shndx != SHN_UNDEF && !s->a.weak)
+        model = TLS_LE;
+    else
+        model = TLS_IE;
+    type = s->type;
+    type.t &= ~VT_STORAGE;
+    vpop();
+    gen_tls_addr(s, model);
+    mk_pointer(&type);
+    vtop->type = type;
+    indir();
+}
+#endif
+
+#ifdef CONFIG_SWIRL_TAILCALL
+/* whether 'return f(...);' can leave the function and jump to 'f',
+   which returns 'rt' in 'ret_nregs' registers.  The backend also
+   wants the arguments in registers and no address of a local taken. */
+static int tail_call_ok(CType *rt, int ret_nregs)
+{
+    int bt1, bt2, align;
+
+    if (!swirl_state->optimize || !swirl_state->sibling_calls
+        || nocode_wanted || func_var || ret_nregs <= 0 || cur_scope->cl.s)
+        return 0;
+#ifdef CONFIG_SWIRL_BCHECK
+    if (swirl_state->do_bounds_check)
+        return 0;
+#endif
+    bt1 = func_vt.t & VT_BTYPE;
+    bt2 = rt->t & VT_BTYPE;
+    if (bt1 == VT_VOID || bt2 == VT_VOID)
+        return bt1 == bt2;
+    if (is_compatible_unqualified_types(&func_vt, rt))
+        return 1;
+    /* int and unsigned, long and pointers are returned alike */
+    return (is_integer_btype(bt1) || bt1 == VT_PTR)
+        && (is_integer_btype(bt2) || bt2 == VT_PTR)
+        && type_size(&func_vt, &align) == type_size(rt, &align)
+        && type_size(rt, &align) >= 4;
+}
+
+/* whether a call to 's' needs the caller's frame to stay */
+static int call_keeps_frame(Sym *s)
+{
+    int i, v;
+
+    if (s->type.ref->f.func_rtwice)
+        return 1;
+    for (i = 0; i < 2; i++) {
+        v = i ? s->asm_label : s->v;
+        if (v == TOK_alloca)
+            return 1;
+        if (v >= TOK_IDENT && (strstr(get_tok_str(v, NULL), "setjmp")
+                               || strstr(get_tok_str(v, NULL), "vfork")))
+            return 1;
+    }
+    return 0;
+}
+#endif
+
+ST_FUNC void unary(void)
+{
+    int n, t, align, size, r, sizeof_caller;
+    CType type;
+    Sym *s;
+    AttributeDef ad;
+#ifdef CONFIG_SWIRL_TAILCALL
+    int tail = in_return;
+    in_return = 0;
+#endif
+
+    /* generate line number info */
+    if (swirl_state->do_debug)
+        swirl_debug_line(swirl_state);
+
+    sizeof_caller = in_sizeof;
+    in_sizeof = 0;
+    type.ref = NULL;
+    /* XXX: GCC 2.95.3 does not generate a table although it should be
+       better here */
+ tok_next:
+    switch(tok) {
+    case TOK_EXTENSION:
+        next();
+        goto tok_next;
+    case TOK_LCHAR:
+#ifdef SWIRL_TARGET_PE
+        t = VT_SHORT|VT_UNSIGNED;
+        goto push_tokc;
+#endif
+    case TOK_CINT:
+    case TOK_CCHAR: 
+	t = VT_INT;
+ push_tokc:
+	type.t = t;
+	vsetc(&type, VT_CONST, &tokc);
+        next();
+        break;
+    case TOK_CUINT:
+        t = VT_INT | VT_UNSIGNED;
+        goto push_tokc;
+    case TOK_CLLONG:
+        t = VT_LLONG;
+	goto push_tokc;
+    case TOK_CULLONG:
+        t = VT_LLONG | VT_UNSIGNED;
+	goto push_tokc;
+    case TOK_CFLOAT:
+        t = VT_FLOAT;
+	goto push_tokc;
+    case TOK_CDOUBLE:
+        t = VT_DOUBLE;
+	goto push_tokc;
+    case TOK_CLDOUBLE:
+        t = VT_LDOUBLE;
+	goto push_tokc;
+    case TOK_CLONG:
+        t = (LONG_SIZE == 8 ? VT_LLONG : VT_INT) | VT_LONG;
+	goto push_tokc;
+    case TOK_CULONG:
+        t = (LONG_SIZE == 8 ? VT_LLONG : VT_INT) | VT_LONG | VT_UNSIGNED;
+	goto push_tokc;
+    case TOK___FUNCTION__:
+        if (!gnu_ext)
+            goto tok_identifier;
+        /* fall thru */
+    case TOK___FUNC__:
+        {
+            void *ptr;
+            int len;
+            /* special function name identifier */
+            len = strlen(funcname) + 1;
+            /* generate char[len] type */
+            type.t = VT_BYTE;
+            mk_pointer(&type);
+            type.t |= VT_ARRAY;
+            type.ref->c = len;
+            vpush_ref(&type, data_section, data_section->data_offset, len);
+            if (!NODATA_WANTED) {
+                ptr = section_ptr_add(data_section, len);
+                memcpy(ptr, funcname, len);
+            }
+            next();
+        }
+        break;
+    case TOK_LSTR:
+#ifdef SWIRL_TARGET_PE
+        t = VT_SHORT | VT_UNSIGNED;
+#else
+        t = VT_INT;
+#endif
+        goto str_init;
+    case TOK_STR:
+        /* string parsing */
+        t = VT_BYTE;
         if (swirl_state->char_is_unsigned)
             t = VT_BYTE | VT_UNSIGNED;
     str_init:
@@ -5711,7 +6970,7 @@ ST_FUNC void unary(void)
         /* In order to force cast, we add zero, except for floating point
 	   where we really need an noop (otherwise -0.0 will be transformed
 	   into +0.0).  */
-	if (!is_float(vtop->type.t)) {
+	if (!is_float(vtop->type.t) && !is_vector(&vtop->type)) {
 	    vpushi(0);
 	    gen_op('+');
 	}
@@ -5745,14 +7004,65 @@ ST_FUNC void unary(void)
         break;
 
     case TOK_builtin_expect:
-	/* __builtin_expect is a no-op for now */
-	parse_builtin_params(0, "ee");
+        /* a constant expected value for the whole condition of an 'if'
+           decides which branch comes first (-O) */
+        n = expect_hint == -2;
+        expect_hint = -1;
+        next();
+        skip('(');
+        expr_eq();
+        skip(',');
+        if (vtop->r == VT_CMP && !nocode_wanted) {
+            /* don't move a comparison from the flags to a register
+               for an expected value which needs no code */
+            TokenString *str;
+            skip_or_save_block(&str);
+            nocode_wanted++;
+            expect_value(str);
+            t = (vtop->r & (VT_VALMASK | VT_LVAL | VT_SYM)) == VT_CONST;
+            if (!t)
+                vpop();
+            nocode_wanted--;
+            if (!t) {
+                gv(RC_INT);
+                expect_value(str);
+            }
+            tok_str_free(str);
+        } else {
+            expr_eq();
+        }
+        skip(')');
+        if (n && tok == ')'
+            && (vtop->r & (VT_VALMASK | VT_LVAL | VT_SYM)) == VT_CONST)
+            expect_hint = vtop->c.i != 0;
 	vpop();
         break;
+    case TOK_builtin_popcount:
+    case TOK_builtin_popcountl:
+    case TOK_builtin_popcountll:
+    case TOK_builtin_clz:
+    case TOK_builtin_clzl:
+    case TOK_builtin_clzll:
+    case TOK_builtin_ctz:
+    case TOK_builtin_ctzl:
+    case TOK_builtin_ctzll:
+    case TOK_builtin_ffs:
+    case TOK_builtin_ffsl:
+    case TOK_builtin_ffsll:
+    case TOK_builtin_parity:
+    case TOK_builtin_parityl:
+    case TOK_builtin_parityll:
+    case TOK_builtin_bswap16:
+    case TOK_builtin_bswap32:
+    case TOK_builtin_bswap64:
+        t = tok;
+	parse_builtin_params(0, "e");
+        gen_builtin_bits(t);
+        break;
     case TOK_builtin_types_compatible_p:
 	parse_builtin_params(0, "tt");
-	vtop[-1].type.t &= ~(VT_CONSTANT | VT_VOLATILE);
-	vtop[0].type.t &= ~(VT_CONSTANT | VT_VOLATILE);
+	vtop[-1].type.t &= ~(VT_CONSTANT | VT_VOLATILE | VT_ATOMIC);
+	vtop[0].type.t &= ~(VT_CONSTANT | VT_VOLATILE | VT_ATOMIC);
 	n = is_compatible_types(&vtop[-1].type, &vtop[0].type);
 	vtop -= 2;
 	vpushi(n);
@@ -5783,1214 +7093,2291 @@ ST_FUNC void unary(void)
 	    }
 	    skip(')');
 	}
-        break;
-    case TOK_builtin_constant_p:
-	parse_builtin_params(1, "e");
-	n = (vtop->r & (VT_VALMASK | VT_LVAL)) == VT_CONST &&
-            !((vtop->r & VT_SYM) && vtop->sym->a.addrtaken);
-	vtop--;
+        break;
+    case TOK_builtin_constant_p:
+	parse_builtin_params(1, "e");
+	n = (vtop->r & (VT_VALMASK | VT_LVAL)) == VT_CONST &&
+            !((vtop->r & VT_SYM) && vtop->sym->a.addrtaken);
+	vtop--;
+	vpushi(n);
+        break;
+    case TOK_builtin_frame_address:
+    case TOK_builtin_return_address:
+        {
+            int tok1 = tok;
+            int level;
+            next();
+            skip('(');
+            if (tok != TOK_CINT) {
+                swirl_error("%s only takes positive integers",
+                          tok1 == TOK_builtin_return_address ?
+                          "__builtin_return_address" :
+                          "__builtin_frame_address");
+            }
+            level = (uint32_t)tokc.i;
+            next();
+            skip(')');
+            type.t = VT_VOID;
+            mk_pointer(&type);
+            vset(&type, VT_LOCAL, 0);       /* local frame */
+            while (level--) {
+#ifdef SWIRL_TARGET_RISCV64
+                vpushi(2*PTR_SIZE);
+                gen_op('-');
+#endif
+                mk_pointer(&vtop->type);
+                indir();                    /* -> parent frame */
+            }
+            if (tok1 == TOK_builtin_return_address) {
+                // assume return address is just above frame pointer on stack
+#ifdef SWIRL_TARGET_ARM
+                vpushi(2*PTR_SIZE);
+                gen_op('+');
+#elif defined SWIRL_TARGET_RISCV64
+                vpushi(PTR_SIZE);
+                gen_op('-');
+#else
+                vpushi(PTR_SIZE);
+                gen_op('+');
+#endif
+                mk_pointer(&vtop->type);
+                indir();
+            }
+        }
+        break;
+#ifdef SWIRL_TARGET_RISCV64
+    case TOK_builtin_va_start:
+        parse_builtin_params(0, "ee");
+        r = vtop->r & VT_VALMASK;
+        if (r == VT_LLOCAL)
+            r = VT_LOCAL;
+        if (r != VT_LOCAL)
+            swirl_error("__builtin_va_start expects a local variable");
+        gen_va_start();
+	vstore();
+        break;
+#endif
+#ifdef SWIRL_TARGET_X86_64
+#ifdef SWIRL_TARGET_PE
+    case TOK_builtin_va_start:
+	parse_builtin_params(0, "ee");
+        r = vtop->r & VT_VALMASK;
+        if (r == VT_LLOCAL)
+            r = VT_LOCAL;
+        if (r != VT_LOCAL)
+            swirl_error("__builtin_va_start expects a local variable");
+        vtop->r = r;
+	vtop->type = char_pointer_type;
+	vtop->c.i += 8;
+	vstore();
+        break;
+#else
+    case TOK_builtin_va_arg_types:
+	parse_builtin_params(0, "t");
+	vpushi(classify_x86_64_va_arg(&vtop->type));
+	vswap();
+	vpop();
+	break;
+#endif
+#endif
+
+#ifdef SWIRL_TARGET_ARM64
+    case TOK_builtin_va_start: {
+	parse_builtin_params(0, "ee");
+        //xx check types
+        gen_va_start();
+        vpushi(0);
+        vtop->type.t = VT_VOID;
+        break;
+    }
+    case TOK_builtin_va_arg: {
+	parse_builtin_params(0, "et");
+	type = vtop->type;
+	vpop();
+        //xx check types
+        gen_va_arg(&type);
+        vtop->type = type;
+        break;
+    }
+    case TOK___arm64_clear_cache: {
+	parse_builtin_params(0, "ee");
+        gen_clear_cache();
+        vpushi(0);
+        vtop->type.t = VT_VOID;
+        break;
+    }
+#endif
+
+    /* pre operations */
+    case TOK_INC:
+    case TOK_DEC:
+        t = tok;
+        next();
+        unary();
+        inc(0, t);
+        break;
+    case '-':
+        next();
+        unary();
+	if (is_float(vtop->type.t)) {
+            gen_opif(TOK_NEG);
+	} else if (is_vector(&vtop->type)
+                   && is_float(vtop->type.ref->next->type.t)) {
+            /* keeps the sign of zeros */
+            vpushi(-1);
+            gen_op('*');
+	} else {
+            vpushi(0);
+            vswap();
+            gen_op('-');
+        }
+        break;
+    case TOK_LAND:
+        if (!gnu_ext)
+            goto tok_identifier;
+        next();
+        /* allow to take the address of a label */
+        if (tok < TOK_UIDENT)
+            expect("label identifier");
+        s = label_find(tok);
+        if (!s) {
+            s = label_push(&global_label_stack, tok, LABEL_FORWARD);
+        } else {
+            if (s->r == LABEL_DECLARED)
+                s->r = LABEL_FORWARD;
+        }
+        if (!s->type.t) {
+            s->type.t = VT_VOID;
+            mk_pointer(&s->type);
+            s->type.t |= VT_STATIC;
+        }
+        func_asm = 1;
+        vpushsym(&s->type, s);
+        next();
+        break;
+
+    case TOK_GENERIC:
+    {
+	CType controlling_type;
+	int has_default = 0;
+	int has_match = 0;
+	int learn = 0;
+	TokenString *str = NULL;
+	int saved_const_wanted = const_wanted;
+
+	next();
+	skip('(');
+	const_wanted = 0;
+	expr_type(&controlling_type, expr_eq);
+	controlling_type.t &= ~(VT_CONSTANT | VT_VOLATILE | VT_ATOMIC | VT_ARRAY);
+	if ((controlling_type.t & VT_BTYPE) == VT_FUNC)
+	  mk_pointer(&controlling_type);
+	const_wanted = saved_const_wanted;
+	for (;;) {
+	    learn = 0;
+	    skip(',');
+	    if (tok == TOK_DEFAULT) {
+		if (has_default)
+		    swirl_error("too many 'default'");
+		has_default = 1;
+		if (!has_match)
+		    learn = 1;
+		next();
+	    } else {
+	        AttributeDef ad_tmp;
+		int itmp;
+	        CType cur_type;
+
+                in_generic++;
+		parse_btype(&cur_type, &ad_tmp);
+                in_generic--;
+
+		type_decl(&cur_type, &ad_tmp, &itmp, TYPE_ABSTRACT);
+		if (compare_types(&controlling_type, &cur_type, 0)) {
+		    if (has_match) {
+		      swirl_error("type match twice");
+		    }
+		    has_match = 1;
+		    learn = 1;
+		}
+	    }
+	    skip(':');
+	    if (learn) {
+		if (str)
+		    tok_str_free(str);
+		skip_or_save_block(&str);
+	    } else {
+		skip_or_save_block(NULL);
+	    }
+	    if (tok == ')')
+		break;
+	}
+	if (!str) {
+	    char buf[60];
+	    type_to_str(buf, sizeof buf, &controlling_type, NULL);
+	    swirl_error("type '%s' does not match any association", buf);
+	}
+	begin_macro(str, 1);
+	next();
+	expr_eq();
+	if (tok != TOK_EOF)
+	    expect(",");
+	end_macro();
+        next();
+	break;
+    }
+    // special qnan , snan and infinity values
+    case TOK___NAN__:
+        n = 0x7fc00000;
+special_math_val:
 	vpushi(n);
+	vtop->type.t = VT_FLOAT;
+        next();
         break;
-    case TOK_builtin_frame_address:
-    case TOK_builtin_return_address:
-        {
-            int tok1 = tok;
-            int level;
+    case TOK___SNAN__:
+	n = 0x7f800001;
+	goto special_math_val;
+    case TOK___INF__:
+	n = 0x7f800000;
+	goto special_math_val;
+
+    default:
+#ifdef CONFIG_SWIRL_ATOMIC
+        if (tok >= TOK___atomic_load_n && tok <= TOK___sync_synchronize) {
+            parse_atomic(tok);
+            break;
+        }
+#endif
+    tok_identifier:
+        t = tok;
+        next();
+        if (t < TOK_UIDENT)
+            expect("identifier");
+        s = sym_find(t);
+        if (!s || IS_ASM_SYM(s)) {
+            const char *name = get_tok_str(t, NULL);
+            if (tok != '(')
+                swirl_error("'%s' undeclared", name);
+            /* for simple function calls, we tolerate undeclared
+               external reference to int() function */
+            if (swirl_state->warn_implicit_function_declaration
+#ifdef SWIRL_TARGET_PE
+                /* people must be warned about using undeclared WINAPI functions
+                   (which usually start with uppercase letter) */
+                || (name[0] >= 'A' && name[0] <= 'Z')
+#endif
+            )
+                swirl_warning("implicit declaration of function '%s'", name);
+            s = external_global_sym(t, &func_old_type);
+        }
+
+        r = s->r;
+        /* A symbol that has a register is a local register variable,
+           which starts out as VT_LOCAL value.  */
+        if ((r & VT_VALMASK) < VT_CONST)
+            r = (r & ~VT_VALMASK) | VT_LOCAL;
+
+        vset(&s->type, r, s->c);
+        /* Point to s as backpointer (even without r&VT_SYM).
+	   Will be used by at least the x86 inline asm parser for
+	   regvars.  */
+	vtop->sym = s;
+
+        if (r & VT_SYM) {
+            vtop->c.i = 0;
+        } else if (r == VT_CONST && IS_ENUM_VAL(s->type.t)) {
+            vtop->c.i = s->enum_val;
+        }
+#ifdef CONFIG_SWIRL_THREAD_LOCAL
+        if (s->type.t & VT_TLS)
+            tls_lvalue(s);
+#endif
+        break;
+    }
+    
+    /* post operations */
+    while (1) {
+        if (tok == TOK_INC || tok == TOK_DEC) {
+            inc(1, tok);
             next();
-            skip('(');
-            if (tok != TOK_CINT) {
-                swirl_error("%s only takes positive integers",
-                          tok1 == TOK_builtin_return_address ?
-                          "__builtin_return_address" :
-                          "__builtin_frame_address");
+        } else if (tok == '.' || tok == TOK_ARROW || tok == TOK_CDOUBLE) {
+            int qualifiers, cumofs = 0;
+            /* field */ 
+            if (tok == TOK_ARROW) 
+                indir();
+            qualifiers = vtop->type.t & (VT_CONSTANT | VT_VOLATILE);
+            test_lvalue();
+            gaddrof();
+            /* expect pointer on structure */
+            if ((vtop->type.t & VT_BTYPE) != VT_STRUCT)
+                expect("struct or union");
+            if (tok == TOK_CDOUBLE)
+                expect("field name");
+            next();
+            if (tok == TOK_CINT || tok == TOK_CUINT)
+                expect("field name");
+	    s = find_field(&vtop->type, tok, &cumofs);
+            if (!s)
+                swirl_error("field not found: %s",  get_tok_str(tok & ~SYM_FIELD, &tokc));
+            /* add field offset to pointer */
+            vtop->type = char_pointer_type; /* change type to 'char *' */
+            vpushi(cumofs + s->c);
+            gen_op('+');
+            /* change type to field type, and set to lvalue */
+            vtop->type = s->type;
+            vtop->type.t |= qualifiers;
+            /* an array is never an lvalue */
+            if (!(vtop->type.t & VT_ARRAY)) {
+                vtop->r |= VT_LVAL;
+#ifdef CONFIG_SWIRL_BCHECK
+                /* if bound checking, the referenced pointer must be checked */
+                if (swirl_state->do_bounds_check)
+                    vtop->r |= VT_MUSTBOUND;
+#endif
             }
-            level = (uint32_t)tokc.i;
             next();
+        } else if (tok == '[') {
+            next();
+            if (is_vector(&vtop->type)) {
+                /* vector elements are subscripted in memory */
+                CType type = vtop->type.ref->next->type;
+                type.t |= vtop->type.t & (VT_CONSTANT | VT_VOLATILE);
+                mk_pointer(&type);
+                gaddrof();
+                vtop->type = type;
+            }
+            gexpr();
+            gen_op('+');
+            indir();
+            skip(']');
+        } else if (tok == '(') {
+            SValue ret;
+            Sym *sa;
+            InlineFunc *fn;
+            int nb_args, ret_nregs, ret_align, regsize, variadic;
+
+            /* function call  */
+            if ((vtop->type.t & VT_BTYPE) != VT_FUNC) {
+                /* pointer test (no array accepted) */
+                if ((vtop->type.t & (VT_BTYPE | VT_ARRAY)) == VT_PTR) {
+                    vtop->type = *pointed_type(&vtop->type);
+                    if ((vtop->type.t & VT_BTYPE) != VT_FUNC)
+                        goto error_func;
+                } else {
+                error_func:
+                    expect("function pointer");
+                }
+            } else {
+                vtop->r &= ~VT_LVAL; /* no lvalue */
+            }
+            fn = inline_find(vtop);
+            if (fn) {
+#ifdef CONFIG_SWIRL_TAILCALL
+                gen_inline_call(fn, tail);
+#else
+                gen_inline_call(fn, 0);
+#endif
+                continue;
+            }
+#ifdef CONFIG_SWIRL_TAILCALL
+            /* alloca() memory is in the frame, setjmp() returns into it */
+            if ((vtop->r & VT_SYM) && call_keeps_frame(vtop->sym))
+                func_addr_taken = 1;
+#endif
+            /* get return type */
+            s = vtop->type.ref;
+            next();
+            sa = s->next; /* first parameter */
+            nb_args = regsize = 0;
+            ret.r2 = VT_CONST;
+            /* compute first implicit argument if a structure is returned */
+            if ((s->type.t & VT_BTYPE) == VT_STRUCT) {
+                variadic = (s->f.func_type == FUNC_ELLIPSIS);
+                ret_nregs = gfunc_sret(&s->type, variadic, &ret.type,
+                                       &ret_align, &regsize);
+                if (ret_nregs <= 0) {
+                    /* get some space for the returned structure */
+                    size = type_size(&s->type, &align);
+#ifdef SWIRL_TARGET_ARM64
+                /* On arm64, a small struct is return in registers.
+                   It is much easier to write it to memory if we know
+                   that we are allowed to write some extra bytes, so
+                   round the allocated space up to a power of 2: */
+                if (size < 16)
+                    while (size & (size - 1))
+                        size = (size | (size - 1)) + 1;
+#endif
+                    loc = (loc - size) & -align;
+                    ret.type = s->type;
+                    ret.r = VT_LOCAL | VT_LVAL;
+                    /* pass it as 'int' to avoid structure arg passing
+                       problems */
+                    vseti(VT_LOCAL, loc);
+#ifdef CONFIG_SWIRL_BCHECK
+                    if (swirl_state->do_bounds_check)
+                        --loc;
+#endif
+                    ret.c = vtop->c;
+                    if (ret_nregs < 0)
+                      vtop--;
+                    else
+                      nb_args++;
+                }
+            } else {
+                ret_nregs = 1;
+                ret.type = s->type;
+            }
+
+            if (ret_nregs > 0) {
+                /* return in register */
+                ret.c.i = 0;
+                PUT_R_RET(&ret, ret.type.t);
+            }
+            if (tok != ')') {
+                for(;;) {
+                    expr_eq();
+                    gfunc_param_typed(s, sa);
+                    nb_args++;
+                    if (sa)
+                        sa = sa->next;
+                    if (tok == ')')
+                        break;
+                    skip(',');
+                }
+            }
+            if (sa)
+                swirl_error("too few arguments to function");
             skip(')');
-            type.t = VT_VOID;
-            mk_pointer(&type);
-            vset(&type, VT_LOCAL, 0);       /* local frame */
-            while (level--) {
+#ifdef CONFIG_SWIRL_TAILCALL
+            if (tail && tok == ';')
+                tail_call = tail_call_ok(&s->type, ret_nregs);
+#endif
+            gfunc_call(nb_args);
+
+            if (ret_nregs < 0) {
+                vsetc(&ret.type, ret.r, &ret.c);
 #ifdef SWIRL_TARGET_RISCV64
-                vpushi(2*PTR_SIZE);
-                gen_op('-');
+                arch_transfer_ret_regs(1);
 #endif
-                mk_pointer(&vtop->type);
-                indir();                    /* -> parent frame */
-            }
-            if (tok1 == TOK_builtin_return_address) {
-                // assume return address is just above frame pointer on stack
-#ifdef SWIRL_TARGET_ARM
-                vpushi(2*PTR_SIZE);
-                gen_op('+');
-#elif defined SWIRL_TARGET_RISCV64
-                vpushi(PTR_SIZE);
-                gen_op('-');
+            } else {
+                /* return value */
+                for (r = ret.r + ret_nregs + !ret_nregs; r-- > ret.r;) {
+                    vsetc(&ret.type, r, &ret.c);
+                    vtop->r2 = ret.r2; /* Loop only happens when r2 is VT_CONST */
+                }
+
+                /* handle packed struct return */
+                if (((s->type.t & VT_BTYPE) == VT_STRUCT) && ret_nregs) {
+                    int addr, offset;
+
+                    size = type_size(&s->type, &align);
+                    /* We're writing whole regs often, make sure there's enough
+                       space.  Assume register size is power of 2.  */
+                    if (regsize > align)
+                      align = regsize;
+                    loc = (loc - size) & -align;
+                    addr = loc;
+                    offset = 0;
+                    for (;;) {
+                        vset(&ret.type, VT_LOCAL | VT_LVAL, addr + offset);
+                        vswap();
+                        vstore();
+                        vtop--;
+                        if (--ret_nregs == 0)
+                          break;
+                        offset += regsize;
+                    }
+                    vset(&s->type, VT_LOCAL | VT_LVAL, addr);
+                }
+
+                /* Promote char/short return values. This is matters only
+                   for calling function that were not compiled by SWIRL and
+                   only on some architectures.  For those where it doesn't
+                   matter we expect things to be already promoted to int,
+                   but not larger.  */
+                t = s->type.t & VT_BTYPE;
+                if (t == VT_BYTE || t == VT_SHORT || t == VT_BOOL) {
+#ifdef PROMOTE_RET
+                    vtop->r |= BFVAL(VT_MUSTCAST, 1);
 #else
-                vpushi(PTR_SIZE);
-                gen_op('+');
+                    vtop->type.t = VT_INT;
 #endif
-                mk_pointer(&vtop->type);
-                indir();
+                }
             }
+            if (s->f.func_noreturn)
+                CODE_OFF();
+        } else {
+            break;
         }
-        break;
-#ifdef SWIRL_TARGET_RISCV64
-    case TOK_builtin_va_start:
-        parse_builtin_params(0, "ee");
-        r = vtop->r & VT_VALMASK;
-        if (r == VT_LLOCAL)
-            r = VT_LOCAL;
-        if (r != VT_LOCAL)
-            swirl_error("__builtin_va_start expects a local variable");
-        gen_va_start();
-	vstore();
-        break;
-#endif
-#ifdef SWIRL_TARGET_X86_64
-#ifdef SWIRL_TARGET_PE
-    case TOK_builtin_va_start:
-	parse_builtin_params(0, "ee");
-        r = vtop->r & VT_VALMASK;
-        if (r == VT_LLOCAL)
-            r = VT_LOCAL;
-        if (r != VT_LOCAL)
-            swirl_error("__builtin_va_start expects a local variable");
-        vtop->r = r;
-	vtop->type = char_pointer_type;
-	vtop->c.i += 8;
-	vstore();
-        break;
-#else
-    case TOK_builtin_va_arg_types:
-	parse_builtin_params(0, "t");
-	vpushi(classify_x86_64_va_arg(&vtop->type));
-	vswap();
-	vpop();
-	break;
-#endif
-#endif
+    }
+}
 
-#ifdef SWIRL_TARGET_ARM64
-    case TOK_builtin_va_start: {
-	parse_builtin_params(0, "ee");
-        //xx check types
-        gen_va_start();
-        vpushi(0);
-        vtop->type.t = VT_VOID;
-        break;
+#ifndef precedence_parser /* original top-down parser */
+
+static void expr_prod(void)
+{
+    int t;
+
+    unary();
+    while ((t = tok) == '*' || t == '/' || t == '%') {
+        next();
+        unary();
+        gen_op(t);
     }
-    case TOK_builtin_va_arg: {
-	parse_builtin_params(0, "et");
-	type = vtop->type;
-	vpop();
-        //xx check types
-        gen_va_arg(&type);
-        vtop->type = type;
-        break;
+}
+
+static void expr_sum(void)
+{
+    int t;
+
+    expr_prod();
+    while ((t = tok) == '+' || t == '-') {
+        next();
+        expr_prod();
+        gen_op(t);
     }
-    case TOK___arm64_clear_cache: {
-	parse_builtin_params(0, "ee");
-        gen_clear_cache();
-        vpushi(0);
-        vtop->type.t = VT_VOID;
-        break;
+}
+
+static void expr_shift(void)
+{
+    int t;
+
+    expr_sum();
+    while ((t = tok) == TOK_SHL || t == TOK_SAR) {
+        next();
+        expr_sum();
+        gen_op(t);
+    }
+}
+
+static void expr_cmp(void)
+{
+    int t;
+
+    expr_shift();
+    while (((t = tok) >= TOK_ULE && t <= TOK_GT) ||
+           t == TOK_ULT || t == TOK_UGE) {
+        next();
+        expr_shift();
+        gen_op(t);
+    }
+}
+
+static void expr_cmpeq(void)
+{
+    int t;
+
+    expr_cmp();
+    while ((t = tok) == TOK_EQ || t == TOK_NE) {
+        next();
+        expr_cmp();
+        gen_op(t);
+    }
+}
+
+static void expr_and(void)
+{
+    expr_cmpeq();
+    while (tok == '&') {
+        next();
+        expr_cmpeq();
+        gen_op('&');
+    }
+}
+
+static void expr_xor(void)
+{
+    expr_and();
+    while (tok == '^') {
+        next();
+        expr_and();
+        gen_op('^');
+    }
+}
+
+static void expr_or(void)
+{
+    expr_xor();
+    while (tok == '|') {
+        next();
+        expr_xor();
+        gen_op('|');
+    }
+}
+
+static void expr_landor(int op);
+
+static void expr_land(void)
+{
+    expr_or();
+    if (tok == TOK_LAND)
+        expr_landor(tok);
+}
+
+static void expr_lor(void)
+{
+    expr_land();
+    if (tok == TOK_LOR)
+        expr_landor(tok);
+}
+
+# define expr_landor_next(op) op == TOK_LAND ? expr_or() : expr_land()
+#else /* defined precedence_parser */
+# define expr_landor_next(op) unary(), expr_infix(precedence(op) + 1)
+# define expr_lor() unary(), expr_infix(1)
+
+static int precedence(int tok)
+{
+    switch (tok) {
+        case TOK_LOR: return 1;
+        case TOK_LAND: return 2;
+	case '|': return 3;
+	case '^': return 4;
+	case '&': return 5;
+	case TOK_EQ: case TOK_NE: return 6;
+ relat: case TOK_ULT: case TOK_UGE: return 7;
+	case TOK_SHL: case TOK_SAR: return 8;
+	case '+': case '-': return 9;
+	case '*': case '/': case '%': return 10;
+	default:
+	    if (tok >= TOK_ULE && tok <= TOK_GT)
+	        goto relat;
+	    return 0;
+    }
+}
+static ST_TLS unsigned char prec[256];
+static void init_prec(void)
+{
+    int i;
+    for (i = 0; i < 256; i++)
+	prec[i] = precedence(i);
+}
+#define precedence(i) ((unsigned)i < 256 ? prec[i] : 0)
+
+static void expr_landor(int op);
+
+static void expr_infix(int p)
+{
+    int t = tok, p2;
+    while ((p2 = precedence(t)) >= p) {
+        if (t == TOK_LOR || t == TOK_LAND) {
+            expr_landor(t);
+        } else {
+            next();
+            unary();
+            if (precedence(tok) > p2)
+              expr_infix(p2 + 1);
+            gen_op(t);
+        }
+        t = tok;
     }
+}
 #endif
 
-    /* pre operations */
-    case TOK_INC:
-    case TOK_DEC:
-        t = tok;
-        next();
-        unary();
-        inc(0, t);
-        break;
-    case '-':
+/* Assuming vtop is a value used in a conditional context
+   (i.e. compared with zero) return 0 if it's false, 1 if
+   true and -1 if it can't be statically determined.  */
+static int condition_3way(void)
+{
+    int c = -1;
+    if ((vtop->r & (VT_VALMASK | VT_LVAL)) == VT_CONST &&
+	(!(vtop->r & VT_SYM) || !vtop->sym->a.weak)) {
+	vdup();
+        gen_cast_s(VT_BOOL);
+	c = vtop->c.i;
+	vpop();
+    }
+    return c;
+}
+
+static void expr_landor(int op)
+{
+    int t = 0, cc = 1, f = 0, i = op == TOK_LAND, c;
+    for(;;) {
+        c = f ? i : condition_3way();
+        if (c < 0)
+            save_regs(1), cc = 0;
+        else if (c != i)
+            nocode_wanted++, f = 1;
+        if (tok != op)
+            break;
+        if (c < 0)
+            t = gvtst(i, t);
+        else
+            vpop();
         next();
-        unary();
-	if (is_float(vtop->type.t)) {
-            gen_opif(TOK_NEG);
-	} else {
-            vpushi(0);
-            vswap();
-            gen_op('-');
-        }
-        break;
-    case TOK_LAND:
-        if (!gnu_ext)
-            goto tok_identifier;
+        expr_landor_next(op);
+    }
+    if (cc || f) {
+        vpop();
+        vpushi(i ^ f);
+        gsym(t);
+        nocode_wanted -= f;
+    } else {
+        gvtst_set(i, t);
+    }
+}
+
+static int is_cond_bool(SValue *sv)
+{
+    if ((sv->r & (VT_VALMASK | VT_LVAL | VT_SYM)) == VT_CONST
+        && (sv->type.t & VT_BTYPE) == VT_INT)
+        return (unsigned)sv->c.i < 2;
+    if (sv->r == VT_CMP)
+        return 1;
+    return 0;
+}
+
+static void expr_cond(void)
+{
+    int tt, u, r1, r2, rc, t1, t2, islv, c, g;
+    SValue sv;
+    CType type;
+    int ncw_prev;
+
+    expr_lor();
+    if (tok == '?') {
         next();
-        /* allow to take the address of a label */
-        if (tok < TOK_UIDENT)
-            expect("label identifier");
-        s = label_find(tok);
-        if (!s) {
-            s = label_push(&global_label_stack, tok, LABEL_FORWARD);
-        } else {
-            if (s->r == LABEL_DECLARED)
-                s->r = LABEL_FORWARD;
-        }
-        if (!s->type.t) {
-            s->type.t = VT_VOID;
-            mk_pointer(&s->type);
-            s->type.t |= VT_STATIC;
+	c = condition_3way();
+        g = (tok == ':' && gnu_ext);
+        tt = 0;
+        if (!g) {
+            if (c < 0) {
+                save_regs(1);
+                tt = gvtst(1, 0);
+            } else {
+                vpop();
+            }
+        } else if (c < 0) {
+            /* needed to avoid having different registers saved in
+               each branch */
+            save_regs(1);
+            gv_dup();
+            tt = gvtst(0, 0);
         }
-        vpushsym(&s->type, s);
-        next();
-        break;
 
-    case TOK_GENERIC:
-    {
-	CType controlling_type;
-	int has_default = 0;
-	int has_match = 0;
-	int learn = 0;
-	TokenString *str = NULL;
-	int saved_const_wanted = const_wanted;
+        ncw_prev = nocode_wanted;
+        if (c == 0)
+          nocode_wanted++;
+        if (!g)
+          gexpr();
 
-	next();
-	skip('(');
-	const_wanted = 0;
-	expr_type(&controlling_type, expr_eq);
-	controlling_type.t &= ~(VT_CONSTANT | VT_VOLATILE | VT_ARRAY);
-	if ((controlling_type.t & VT_BTYPE) == VT_FUNC)
-	  mk_pointer(&controlling_type);
-	const_wanted = saved_const_wanted;
-	for (;;) {
-	    learn = 0;
-	    skip(',');
-	    if (tok == TOK_DEFAULT) {
-		if (has_default)
-		    swirl_error("too many 'default'");
-		has_default = 1;
-		if (!has_match)
-		    learn = 1;
-		next();
-	    } else {
-	        AttributeDef ad_tmp;
-		int itmp;
-	        CType cur_type;
+        if (c < 0 && vtop->r == VT_CMP) {
+            t1 = gvtst(0, 0);
+            vpushi(0);
+            gvtst_set(0, t1);
+            gv(RC_INT);
+        }
 
-                in_generic++;
-		parse_btype(&cur_type, &ad_tmp);
-                in_generic--;
+        if ((vtop->type.t & VT_BTYPE) == VT_FUNC)
+          mk_pointer(&vtop->type);
+        sv = *vtop; /* save value to handle it later */
+        vtop--; /* no vpop so that FP stack is not flushed */
 
-		type_decl(&cur_type, &ad_tmp, &itmp, TYPE_ABSTRACT);
-		if (compare_types(&controlling_type, &cur_type, 0)) {
-		    if (has_match) {
-		      swirl_error("type match twice");
-		    }
-		    has_match = 1;
-		    learn = 1;
-		}
-	    }
-	    skip(':');
-	    if (learn) {
-		if (str)
-		    tok_str_free(str);
-		skip_or_save_block(&str);
-	    } else {
-		skip_or_save_block(NULL);
-	    }
-	    if (tok == ')')
-		break;
-	}
-	if (!str) {
-	    char buf[60];
-	    type_to_str(buf, sizeof buf, &controlling_type, NULL);
-	    swirl_error("type '%s' does not match any association", buf);
-	}
-	begin_macro(str, 1);
-	next();
-	expr_eq();
-	if (tok != TOK_EOF)
-	    expect(",");
-	end_macro();
-        next();
-	break;
-    }
-    // special qnan , snan and infinity values
-    case TOK___NAN__:
-        n = 0x7fc00000;
-special_math_val:
-	vpushi(n);
-	vtop->type.t = VT_FLOAT;
-        next();
-        break;
-    case TOK___SNAN__:
-	n = 0x7f800001;
-	goto special_math_val;
-    case TOK___INF__:
-	n = 0x7f800000;
-	goto special_math_val;
+        if (g) {
+            u = tt;
+        } else if (c < 0) {
+            u = gjmp(0);
+            gsym(tt);
+        } else
+          u = 0;
 
-    default:
-    tok_identifier:
-        t = tok;
-        next();
-        if (t < TOK_UIDENT)
-            expect("identifier");
-        s = sym_find(t);
-        if (!s || IS_ASM_SYM(s)) {
-            const char *name = get_tok_str(t, NULL);
-            if (tok != '(')
-                swirl_error("'%s' undeclared", name);
-            /* for simple function calls, we tolerate undeclared
-               external reference to int() function */
-            if (swirl_state->warn_implicit_function_declaration
-#ifdef SWIRL_TARGET_PE
-                /* people must be warned about using undeclared WINAPI functions
-                   (which usually start with uppercase letter) */
-                || (name[0] >= 'A' && name[0] <= 'Z')
-#endif
-            )
-                swirl_warning("implicit declaration of function '%s'", name);
-            s = external_global_sym(t, &func_old_type);
+        nocode_wanted = ncw_prev;
+        if (c == 1)
+          nocode_wanted++;
+        skip(':');
+        expr_cond();
+
+        if (c < 0 && is_cond_bool(vtop) && is_cond_bool(&sv)) {
+            if (sv.r == VT_CMP) {
+                t1 = sv.jtrue;
+                t2 = u;
+            } else {
+                t1 = gvtst(0, 0);
+                t2 = gjmp(0);
+                gsym(u);
+                vpushv(&sv);
+            }
+            gvtst_set(0, t1);
+            gvtst_set(1, t2);
+            nocode_wanted = ncw_prev;
+            //  swirl_warning("two conditions expr_cond");
+            return;
         }
 
-        r = s->r;
-        /* A symbol that has a register is a local register variable,
-           which starts out as VT_LOCAL value.  */
-        if ((r & VT_VALMASK) < VT_CONST)
-            r = (r & ~VT_VALMASK) | VT_LOCAL;
+        if ((vtop->type.t & VT_BTYPE) == VT_FUNC)
+          mk_pointer(&vtop->type);
 
-        vset(&s->type, r, s->c);
-        /* Point to s as backpointer (even without r&VT_SYM).
-	   Will be used by at least the x86 inline asm parser for
-	   regvars.  */
-	vtop->sym = s;
+        /* cast operands to correct type according to ISOC rules */
+        if (!combine_types(&type, &sv, vtop, '?'))
+          type_incompatibility_error(&sv.type, &vtop->type,
+            "type mismatch in conditional expression (have '%s' and '%s')");
+        /* keep structs lvalue by transforming `(expr ? a : b)` to `*(expr ? &a : &b)` so
+           that `(expr ? a : b).mem` does not error  with "lvalue expected" */
+        islv = (vtop->r & VT_LVAL) && (sv.r & VT_LVAL) && VT_STRUCT == (type.t & VT_BTYPE);
 
-        if (r & VT_SYM) {
-            vtop->c.i = 0;
-        } else if (r == VT_CONST && IS_ENUM_VAL(s->type.t)) {
-            vtop->c.i = s->enum_val;
+        /* now we convert second operand */
+        if (c != 1) {
+            gen_cast(&type);
+            if (islv) {
+                mk_pointer(&vtop->type);
+                gaddrof();
+            } else if (VT_STRUCT == (vtop->type.t & VT_BTYPE))
+              gaddrof();
         }
-        break;
-    }
-    
-    /* post operations */
-    while (1) {
-        if (tok == TOK_INC || tok == TOK_DEC) {
-            inc(1, tok);
-            next();
-        } else if (tok == '.' || tok == TOK_ARROW || tok == TOK_CDOUBLE) {
-            int qualifiers, cumofs = 0;
-            /* field */ 
-            if (tok == TOK_ARROW) 
-                indir();
-            qualifiers = vtop->type.t & (VT_CONSTANT | VT_VOLATILE);
-            test_lvalue();
-            gaddrof();
-            /* expect pointer on structure */
-            if ((vtop->type.t & VT_BTYPE) != VT_STRUCT)
-                expect("struct or union");
-            if (tok == TOK_CDOUBLE)
-                expect("field name");
-            next();
-            if (tok == TOK_CINT || tok == TOK_CUINT)
-                expect("field name");
-	    s = find_field(&vtop->type, tok, &cumofs);
-            if (!s)
-                swirl_error("field not found: %s",  get_tok_str(tok & ~SYM_FIELD, &tokc));
-            /* add field offset to pointer */
-            vtop->type = char_pointer_type; /* change type to 'char *' */
-            vpushi(cumofs + s->c);
-            gen_op('+');
-            /* change type to field type, and set to lvalue */
-            vtop->type = s->type;
-            vtop->type.t |= qualifiers;
-            /* an array is never an lvalue */
-            if (!(vtop->type.t & VT_ARRAY)) {
-                vtop->r |= VT_LVAL;
-#ifdef CONFIG_SWIRL_BCHECK
-                /* if bound checking, the referenced pointer must be checked */
-                if (swirl_state->do_bounds_check)
-                    vtop->r |= VT_MUSTBOUND;
-#endif
-            }
-            next();
-        } else if (tok == '[') {
-            next();
-            gexpr();
-            gen_op('+');
-            indir();
-            skip(']');
-        } else if (tok == '(') {
-            SValue ret;
-            Sym *sa;
-            int nb_args, ret_nregs, ret_align, regsize, variadic;
 
-            /* function call  */
-            if ((vtop->type.t & VT_BTYPE) != VT_FUNC) {
-                /* pointer test (no array accepted) */
-                if ((vtop->type.t & (VT_BTYPE | VT_ARRAY)) == VT_PTR) {
-                    vtop->type = *pointed_type(&vtop->type);
-                    if ((vtop->type.t & VT_BTYPE) != VT_FUNC)
-                        goto error_func;
-                } else {
-                error_func:
-                    expect("function pointer");
-                }
-            } else {
-                vtop->r &= ~VT_LVAL; /* no lvalue */
-            }
-            /* get return type */
-            s = vtop->type.ref;
-            next();
-            sa = s->next; /* first parameter */
-            nb_args = regsize = 0;
-            ret.r2 = VT_CONST;
-            /* compute first implicit argument if a structure is returned */
-            if ((s->type.t & VT_BTYPE) == VT_STRUCT) {
-                variadic = (s->f.func_type == FUNC_ELLIPSIS);
-                ret_nregs = gfunc_sret(&s->type, variadic, &ret.type,
-                                       &ret_align, &regsize);
-                if (ret_nregs <= 0) {
-                    /* get some space for the returned structure */
-                    size = type_size(&s->type, &align);
-#ifdef SWIRL_TARGET_ARM64
-                /* On arm64, a small struct is return in registers.
-                   It is much easier to write it to memory if we know
-                   that we are allowed to write some extra bytes, so
-                   round the allocated space up to a power of 2: */
-                if (size < 16)
-                    while (size & (size - 1))
-                        size = (size | (size - 1)) + 1;
-#endif
-                    loc = (loc - size) & -align;
-                    ret.type = s->type;
-                    ret.r = VT_LOCAL | VT_LVAL;
-                    /* pass it as 'int' to avoid structure arg passing
-                       problems */
-                    vseti(VT_LOCAL, loc);
-#ifdef CONFIG_SWIRL_BCHECK
-                    if (swirl_state->do_bounds_check)
-                        --loc;
-#endif
-                    ret.c = vtop->c;
-                    if (ret_nregs < 0)
-                      vtop--;
-                    else
-                      nb_args++;
-                }
-            } else {
-                ret_nregs = 1;
-                ret.type = s->type;
-            }
+        rc = RC_TYPE(type.t);
+        /* for long longs, we use fixed registers to avoid having
+           to handle a complicated move */
+        if (USING_TWO_WORDS(type.t))
+          rc = RC_RET(type.t);
 
-            if (ret_nregs > 0) {
-                /* return in register */
-                ret.c.i = 0;
-                PUT_R_RET(&ret, ret.type.t);
-            }
-            if (tok != ')') {
-                for(;;) {
-                    expr_eq();
-                    gfunc_param_typed(s, sa);
-                    nb_args++;
-                    if (sa)
-                        sa = sa->next;
-                    if (tok == ')')
-                        break;
-                    skip(',');
-                }
-            }
-            if (sa)
-                swirl_error("too few arguments to function");
-            skip(')');
-            gfunc_call(nb_args);
+        tt = r2 = 0;
+        if (c < 0) {
+            r2 = gv(rc);
+            tt = gjmp(0);
+        }
+        gsym(u);
+        nocode_wanted = ncw_prev;
 
-            if (ret_nregs < 0) {
-                vsetc(&ret.type, ret.r, &ret.c);
-#ifdef SWIRL_TARGET_RISCV64
-                arch_transfer_ret_regs(1);
-#endif
-            } else {
-                /* return value */
-                for (r = ret.r + ret_nregs + !ret_nregs; r-- > ret.r;) {
-                    vsetc(&ret.type, r, &ret.c);
-                    vtop->r2 = ret.r2; /* Loop only happens when r2 is VT_CONST */
-                }
+        /* this is horrible, but we must also convert first
+           operand */
+        if (c != 0) {
+            *vtop = sv;
+            gen_cast(&type);
+            if (islv) {
+                mk_pointer(&vtop->type);
+                gaddrof();
+            } else if (VT_STRUCT == (vtop->type.t & VT_BTYPE))
+              gaddrof();
+        }
 
-                /* handle packed struct return */
-                if (((s->type.t & VT_BTYPE) == VT_STRUCT) && ret_nregs) {
-                    int addr, offset;
+        if (c < 0) {
+            r1 = gv(rc);
+            move_reg(r2, r1, islv ? VT_PTR : type.t);
+            vtop->r = r2;
+            gsym(tt);
+        }
 
-                    size = type_size(&s->type, &align);
-                    /* We're writing whole regs often, make sure there's enough
-                       space.  Assume register size is power of 2.  */
-                    if (regsize > align)
-                      align = regsize;
-                    loc = (loc - size) & -align;
-                    addr = loc;
-                    offset = 0;
-                    for (;;) {
-                        vset(&ret.type, VT_LOCAL | VT_LVAL, addr + offset);
-                        vswap();
-                        vstore();
-                        vtop--;
-                        if (--ret_nregs == 0)
-                          break;
-                        offset += regsize;
-                    }
-                    vset(&s->type, VT_LOCAL | VT_LVAL, addr);
-                }
+        if (islv)
+          indir();
+    }
+}
 
-                /* Promote char/short return values. This is matters only
-                   for calling function that were not compiled by SWIRL and
-                   only on some architectures.  For those where it doesn't
-                   matter we expect things to be already promoted to int,
-                   but not larger.  */
-                t = s->type.t & VT_BTYPE;
-                if (t == VT_BYTE || t == VT_SHORT || t == VT_BOOL) {
-#ifdef PROMOTE_RET
-                    vtop->r |= BFVAL(VT_MUSTCAST, 1);
-#else
-                    vtop->type.t = VT_INT;
+static void expr_eq(void)
+{
+    int t;
+    
+    expr_cond();
+    if ((t = tok) == '=' || TOK_ASSIGN(t)) {
+        test_lvalue();
+        next();
+        if (t == '=') {
+            expr_eq();
+#ifdef CONFIG_SWIRL_ATOMIC
+        } else if (vtop->type.t & VT_ATOMIC) {
+            expr_eq();
+            atomic_lv_modify(TOK_ASSIGN_OP(t), 0);
+            return;
 #endif
-                }
-            }
-            if (s->f.func_noreturn)
-                CODE_OFF();
         } else {
-            break;
+            vdup();
+            expr_eq();
+            gen_op(TOK_ASSIGN_OP(t));
         }
+        vstore();
     }
 }
 
-#ifndef precedence_parser /* original top-down parser */
-
-static void expr_prod(void)
+ST_FUNC void gexpr(void)
 {
-    int t;
-
-    unary();
-    while ((t = tok) == '*' || t == '/' || t == '%') {
+    while (1) {
+        expr_eq();
+        if (tok != ',')
+            break;
+        vpop();
         next();
-        unary();
-        gen_op(t);
     }
 }
 
-static void expr_sum(void)
+/* parse a constant expression and return value in vtop.  */
+static void expr_const1(void)
 {
-    int t;
+    const_wanted++;
+    nocode_wanted += unevalmask + 1;
+    expr_cond();
+    nocode_wanted -= unevalmask + 1;
+    const_wanted--;
+}
 
-    expr_prod();
-    while ((t = tok) == '+' || t == '-') {
-        next();
-        expr_prod();
-        gen_op(t);
-    }
+/* parse an integer constant and return its value. */
+static inline int64_t expr_const64(void)
+{
+    int64_t c;
+    expr_const1();
+    if ((vtop->r & (VT_VALMASK | VT_LVAL | VT_SYM)) != VT_CONST)
+        expect("constant expression");
+    c = vtop->c.i;
+    vpop();
+    return c;
 }
 
-static void expr_shift(void)
+/* parse an integer constant and return its value.
+   Complain if it doesn't fit 32bit (signed or unsigned).  */
+ST_FUNC int expr_const(void)
 {
-    int t;
+    int c;
+    int64_t wc = expr_const64();
+    c = wc;
+    if (c != wc && (unsigned)c != wc)
+        swirl_error("constant exceeds 32 bit");
+    return c;
+}
 
-    expr_sum();
-    while ((t = tok) == TOK_SHL || t == TOK_SAR) {
-        next();
-        expr_sum();
-        gen_op(t);
+/* ------------------------------------------------------------------------- */
+/* return from function */
+
+#ifndef SWIRL_TARGET_ARM64
+static void gfunc_return(CType *func_type)
+{
+    if ((func_type->t & VT_BTYPE) == VT_STRUCT) {
+        CType type, ret_type;
+        int ret_align, ret_nregs, regsize;
+        ret_nregs = gfunc_sret(func_type, func_var, &ret_type,
+                               &ret_align, &regsize);
+        if (ret_nregs < 0) {
+#ifdef SWIRL_TARGET_RISCV64
+            arch_transfer_ret_regs(0);
+#endif
+        } else if (0 == ret_nregs) {
+            /* if returning structure, must copy it to implicit
+               first pointer arg location */
+            type = *func_type;
+            mk_pointer(&type);
+            vset(&type, VT_LOCAL | VT_LVAL, func_vc);
+            indir();
+            vswap();
+            /* copy structure value to pointer */
+            vstore();
+        } else {
+            /* returning structure packed into registers */
+            int size, addr, align, rc;
+            size = type_size(func_type,&align);
+            if ((vtop->r != (VT_LOCAL | VT_LVAL) ||
+                 (vtop->c.i & (ret_align-1)))
+                && (align & (ret_align-1))) {
+                loc = (loc - size) & -ret_align;
+                addr = loc;
+                type = *func_type;
+                vset(&type, VT_LOCAL | VT_LVAL, addr);
+                vswap();
+                vstore();
+                vpop();
+                vset(&ret_type, VT_LOCAL | VT_LVAL, addr);
+            }
+            vtop->type = ret_type;
+            rc = RC_RET(ret_type.t);
+            if (ret_nregs == 1)
+                gv(rc);
+            else {
+                for (;;) {
+                    vdup();
+                    gv(rc);
+                    vpop();
+                    if (--ret_nregs == 0)
+                      break;
+                    /* We assume that when a structure is returned in multiple
+                       registers, their classes are consecutive values of the
+                       suite s(n) = 2^n */
+                    rc <<= 1;
+                    vtop->c.i += regsize;
+                }
+            }
+        }
+    } else {
+        gv(RC_RET(func_type->t));
     }
+    vtop--; /* NOT vpop() because on x86 it would flush the fp stack */
 }
+#endif
 
-static void expr_cmp(void)
+static void check_func_return(void)
 {
-    int t;
-
-    expr_shift();
-    while (((t = tok) >= TOK_ULE && t <= TOK_GT) ||
-           t == TOK_ULT || t == TOK_UGE) {
-        next();
-        expr_shift();
-        gen_op(t);
+    if ((func_vt.t & VT_BTYPE) == VT_VOID)
+        return;
+    if (!strcmp (funcname, "main")
+        && (func_vt.t & VT_BTYPE) == VT_INT) {
+        /* main returns 0 by default */
+        vpushi(0);
+        gen_assign_cast(&func_vt);
+        gfunc_return(&func_vt);
+    } else {
+        swirl_warning("function might return no value: '%s'", funcname);
     }
 }
 
-static void expr_cmpeq(void)
+/* ------------------------------------------------------------------------- */
+/* switch/case */
+
+static int case_cmpi(const void *pa, const void *pb)
 {
-    int t;
+    int64_t a = (*(struct case_t**) pa)->v1;
+    int64_t b = (*(struct case_t**) pb)->v1;
+    return a < b ? -1 : a > b;
+}
 
-    expr_cmp();
-    while ((t = tok) == TOK_EQ || t == TOK_NE) {
-        next();
-        expr_cmp();
-        gen_op(t);
-    }
+static int case_cmpu(const void *pa, const void *pb)
+{
+    uint64_t a = (uint64_t)(*(struct case_t**) pa)->v1;
+    uint64_t b = (uint64_t)(*(struct case_t**) pb)->v1;
+    return a < b ? -1 : a > b;
 }
 
-static void expr_and(void)
+static void gtst_addr(int t, int a)
 {
-    expr_cmpeq();
-    while (tok == '&') {
-        next();
-        expr_cmpeq();
-        gen_op('&');
+    gsym_addr(gvtst(0, t), a);
+}
+
+/* lower the 'len' sorted case ranges at 'base' to an indirect jump
+   through a table in data_ro_section, if they are dense enough */
+#define CASE_TABLE_MIN      5 /* at least that many cases */
+#define CASE_TABLE_DENSITY  4 /* at most that many slots per case */
+
+static int gcase_table(struct case_t **base, int len, int *bsym)
+{
+    uint64_t n, i, lo, hi;
+    int e, j, hole, ll;
+    addr_t off, a;
+    Sym *tab, *text;
+    CType t;
+
+    n = (uint64_t)base[len - 1]->v2 - base[0]->v1;
+    if (len < CASE_TABLE_MIN || n >= (uint64_t)len * CASE_TABLE_DENSITY
+        || !swirl_state->jump_tables || nocode_wanted
+        || swirl_state->do_bounds_check)
+        return 0;
+    ll = (vtop->type.t & VT_BTYPE) == VT_LLONG;
+    /* idx = x - min; if (idx > max - min) goto default; */
+    gv_dup();
+    if (ll)
+        vpushll(base[0]->v1);
+    else
+        vpushi(base[0]->v1);
+    gen_op('-');
+    gv_dup();
+    if (ll)
+        vpushll(n);
+    else
+        vpushi(n);
+    gen_op(TOK_ULE);
+    e = gvtst(1, 0);
+    /* goto *table[idx]; */
+    n++;
+    off = section_add(data_ro_section, n * PTR_SIZE, PTR_SIZE);
+    t = char_pointer_type;
+    mk_pointer(&t);
+    tab = get_sym_ref(&t, data_ro_section, off, n * PTR_SIZE);
+    vpushsym(&t, tab);
+    vswap();
+    gen_op('+');
+    indir();
+    ggoto();
+    /* holes and out of range values */
+    gsym(e);
+    hole = ind;
+    *bsym = gjmp(*bsym);
+
+    text = get_sym_ref(&char_type, cur_text_section, 0, 0);
+    for (i = j = 0; i < n; i++, off += PTR_SIZE) {
+        lo = (uint64_t)base[j]->v1 - base[0]->v1;
+        hi = (uint64_t)base[j]->v2 - base[0]->v1;
+        a = i >= lo ? base[j]->sym : hole;
+        if (i == hi)
+            j++;
+#if PTR_SIZE == 8
+        greloca(data_ro_section, text, off, R_DATA_PTR, a);
+#else
+        greloc(data_ro_section, text, off, R_DATA_PTR);
+        *(addr_t *)(data_ro_section->data + off) = a;
+#endif
     }
+    return 1;
 }
 
-static void expr_xor(void)
+static void gcase(struct case_t **base, int len, int *bsym)
 {
-    expr_and();
-    while (tok == '^') {
-        next();
-        expr_and();
-        gen_op('^');
+    struct case_t *p;
+    int e;
+    int ll = (vtop->type.t & VT_BTYPE) == VT_LLONG;
+
+    if (gcase_table(base, len, bsym))
+        return;
+    while (len > 8) {
+        /* binary search */
+        p = base[len/2];
+        vdup();
+	if (ll)
+	    vpushll(p->v2);
+	else
+	    vpushi(p->v2);
+        gen_op(TOK_LE);
+        e = gvtst(1, 0);
+        vdup();
+	if (ll)
+	    vpushll(p->v1);
+	else
+	    vpushi(p->v1);
+        gen_op(TOK_GE);
+        gtst_addr(0, p->sym); /* v1 <= x <= v2 */
+        /* x < v1 */
+        gcase(base, len/2, bsym);
+        /* x > v2 */
+        gsym(e);
+        e = len/2 + 1;
+        base += e; len -= e;
+        if (gcase_table(base, len, bsym))
+            return;
+    }
+    /* linear scan */
+    while (len--) {
+        p = *base++;
+        vdup();
+	if (ll)
+	    vpushll(p->v2);
+	else
+	    vpushi(p->v2);
+        if (p->v1 == p->v2) {
+            gen_op(TOK_EQ);
+            gtst_addr(0, p->sym);
+        } else {
+            gen_op(TOK_LE);
+            e = gvtst(1, 0);
+            vdup();
+	    if (ll)
+	        vpushll(p->v1);
+	    else
+	        vpushi(p->v1);
+            gen_op(TOK_GE);
+            gtst_addr(0, p->sym);
+            gsym(e);
+        }
     }
+    *bsym = gjmp(*bsym);
 }
 
-static void expr_or(void)
+/* ------------------------------------------------------------------------- */
+/* __attribute__((cleanup(fn))) */
+
+static void try_call_scope_cleanup(Sym *stop)
 {
-    expr_xor();
-    while (tok == '|') {
-        next();
-        expr_xor();
-        gen_op('|');
-    }
-}
+    Sym *cls = cur_scope->cl.s;
 
-static void expr_landor(int op);
+    for (; cls != stop; cls = cls->ncl) {
+	Sym *fs = cls->next;
+	Sym *vs = cls->prev_tok;
 
-static void expr_land(void)
-{
-    expr_or();
-    if (tok == TOK_LAND)
-        expr_landor(tok);
+	vpushsym(&fs->type, fs);
+	vset(&vs->type, vs->r, vs->c);
+	vtop->sym = vs;
+        mk_pointer(&vtop->type);
+	gaddrof();
+	gfunc_call(1);
+    }
 }
 
-static void expr_lor(void)
+static void try_call_cleanup_goto(Sym *cleanupstate)
 {
-    expr_land();
-    if (tok == TOK_LOR)
-        expr_landor(tok);
-}
+    Sym *oc, *cc;
+    int ocd, ccd;
 
-# define expr_landor_next(op) op == TOK_LAND ? expr_or() : expr_land()
-#else /* defined precedence_parser */
-# define expr_landor_next(op) unary(), expr_infix(precedence(op) + 1)
-# define expr_lor() unary(), expr_infix(1)
+    if (!cur_scope->cl.s)
+	return;
 
-static int precedence(int tok)
-{
-    switch (tok) {
-        case TOK_LOR: return 1;
-        case TOK_LAND: return 2;
-	case '|': return 3;
-	case '^': return 4;
-	case '&': return 5;
-	case TOK_EQ: case TOK_NE: return 6;
- relat: case TOK_ULT: case TOK_UGE: return 7;
-	case TOK_SHL: case TOK_SAR: return 8;
-	case '+': case '-': return 9;
-	case '*': case '/': case '%': return 10;
-	default:
-	    if (tok >= TOK_ULE && tok <= TOK_GT)
-	        goto relat;
-	    return 0;
-    }
-}
-static unsigned char prec[256];
-static void init_prec(void)
-{
-    int i;
-    for (i = 0; i < 256; i++)
-	prec[i] = precedence(i);
-}
-#define precedence(i) ((unsigned)i < 256 ? prec[i] : 0)
+    /* search NCA of both cleanup chains given parents and initial depth */
+    ocd = cleanupstate ? cleanupstate->v & ~SYM_FIELD : 0;
+    for (ccd = cur_scope->cl.n, oc = cleanupstate; ocd > ccd; --ocd, oc = oc->ncl)
+      ;
+    for (cc = cur_scope->cl.s; ccd > ocd; --ccd, cc = cc->ncl)
+      ;
+    for (; cc != oc; cc = cc->ncl, oc = oc->ncl, --ccd)
+      ;
 
-static void expr_landor(int op);
+    try_call_scope_cleanup(cc);
+}
 
-static void expr_infix(int p)
+/* call 'func' for each __attribute__((cleanup(func))) */
+static void block_cleanup(struct scope *o)
 {
-    int t = tok, p2;
-    while ((p2 = precedence(t)) >= p) {
-        if (t == TOK_LOR || t == TOK_LAND) {
-            expr_landor(t);
+    int jmp = 0;
+    Sym *g, **pg;
+    for (pg = &pending_gotos; (g = *pg) && g->c > o->cl.n;) {
+        if (g->prev_tok->r & LABEL_FORWARD) {
+            Sym *pcl = g->next;
+            if (!jmp)
+                jmp = gjmp(0);
+            gsym(pcl->jnext);
+            try_call_scope_cleanup(o->cl.s);
+            pcl->jnext = gjmp(0);
+            if (!o->cl.n)
+                goto remove_pending;
+            g->c = o->cl.n;
+            pg = &g->prev;
         } else {
-            next();
-            unary();
-            if (precedence(tok) > p2)
-              expr_infix(p2 + 1);
-            gen_op(t);
+    remove_pending:
+            *pg = g->prev;
+            sym_free(g);
         }
-        t = tok;
     }
+    gsym(jmp);
+    try_call_scope_cleanup(o->cl.s);
 }
-#endif
 
-/* Assuming vtop is a value used in a conditional context
-   (i.e. compared with zero) return 0 if it's false, 1 if
-   true and -1 if it can't be statically determined.  */
-static int condition_3way(void)
-{
-    int c = -1;
-    if ((vtop->r & (VT_VALMASK | VT_LVAL)) == VT_CONST &&
-	(!(vtop->r & VT_SYM) || !vtop->sym->a.weak)) {
-	vdup();
-        gen_cast_s(VT_BOOL);
-	c = vtop->c.i;
-	vpop();
-    }
-    return c;
-}
+/* ------------------------------------------------------------------------- */
+/* VLA */
 
-static void expr_landor(int op)
+static void vla_restore(int loc)
 {
-    int t = 0, cc = 1, f = 0, i = op == TOK_LAND, c;
-    for(;;) {
-        c = f ? i : condition_3way();
-        if (c < 0)
-            save_regs(1), cc = 0;
-        else if (c != i)
-            nocode_wanted++, f = 1;
-        if (tok != op)
-            break;
-        if (c < 0)
-            t = gvtst(i, t);
-        else
-            vpop();
-        next();
-        expr_landor_next(op);
-    }
-    if (cc || f) {
-        vpop();
-        vpushi(i ^ f);
-        gsym(t);
-        nocode_wanted -= f;
-    } else {
-        gvtst_set(i, t);
-    }
+    if (loc)
+        gen_vla_sp_restore(loc);
 }
 
-static int is_cond_bool(SValue *sv)
+static void vla_leave(struct scope *o)
 {
-    if ((sv->r & (VT_VALMASK | VT_LVAL | VT_SYM)) == VT_CONST
-        && (sv->type.t & VT_BTYPE) == VT_INT)
-        return (unsigned)sv->c.i < 2;
-    if (sv->r == VT_CMP)
-        return 1;
-    return 0;
+    if (o->vla.num < cur_scope->vla.num)
+        vla_restore(o->vla.loc);
 }
 
-static void expr_cond(void)
-{
-    int tt, u, r1, r2, rc, t1, t2, islv, c, g;
-    SValue sv;
-    CType type;
-    int ncw_prev;
-
-    expr_lor();
-    if (tok == '?') {
-        next();
-	c = condition_3way();
-        g = (tok == ':' && gnu_ext);
-        tt = 0;
-        if (!g) {
-            if (c < 0) {
-                save_regs(1);
-                tt = gvtst(1, 0);
-            } else {
-                vpop();
-            }
-        } else if (c < 0) {
-            /* needed to avoid having different registers saved in
-               each branch */
-            save_regs(1);
-            gv_dup();
-            tt = gvtst(0, 0);
-        }
-
-        ncw_prev = nocode_wanted;
-        if (c == 0)
-          nocode_wanted++;
-        if (!g)
-          gexpr();
+/* ------------------------------------------------------------------------- */
+/* local scopes */
 
-        if (c < 0 && vtop->r == VT_CMP) {
-            t1 = gvtst(0, 0);
-            vpushi(0);
-            gvtst_set(0, t1);
-            gv(RC_INT);
-        }
+void new_scope(struct scope *o)
+{
+    /* copy and link previous scope */
+    *o = *cur_scope;
+    o->prev = cur_scope;
+    cur_scope = o;
 
-        if ((vtop->type.t & VT_BTYPE) == VT_FUNC)
-          mk_pointer(&vtop->type);
-        sv = *vtop; /* save value to handle it later */
-        vtop--; /* no vpop so that FP stack is not flushed */
+    /* record local declaration stack position */
+    o->lstk = local_stack;
+    o->llstk = local_label_stack;
 
-        if (g) {
-            u = tt;
-        } else if (c < 0) {
-            u = gjmp(0);
-            gsym(tt);
-        } else
-          u = 0;
+    ++local_scope;
 
-        nocode_wanted = ncw_prev;
-        if (c == 1)
-          nocode_wanted++;
-        skip(':');
-        expr_cond();
+    if (swirl_state->do_debug)
+        swirl_debug_stabn(N_LBRAC, ind - func_ind);
+}
 
-        if (c < 0 && is_cond_bool(vtop) && is_cond_bool(&sv)) {
-            if (sv.r == VT_CMP) {
-                t1 = sv.jtrue;
-                t2 = u;
-            } else {
-                t1 = gvtst(0, 0);
-                t2 = gjmp(0);
-                gsym(u);
-                vpushv(&sv);
-            }
-            gvtst_set(0, t1);
-            gvtst_set(1, t2);
-            nocode_wanted = ncw_prev;
-            //  swirl_warning("two conditions expr_cond");
-            return;
-        }
+void prev_scope(struct scope *o, int is_expr)
+{
+    int keep = is_expr || cold_blocks;
 
-        if ((vtop->type.t & VT_BTYPE) == VT_FUNC)
-          mk_pointer(&vtop->type);
+    vla_leave(o->prev);
 
-        /* cast operands to correct type according to ISOC rules */
-        if (!combine_types(&type, &sv, vtop, '?'))
-          type_incompatibility_error(&sv.type, &vtop->type,
-            "type mismatch in conditional expression (have '%s' and '%s')");
-        /* keep structs lvalue by transforming `(expr ? a : b)` to `*(expr ? &a : &b)` so
-           that `(expr ? a : b).mem` does not error  with "lvalue expected" */
-        islv = (vtop->r & VT_LVAL) && (sv.r & VT_LVAL) && VT_STRUCT == (type.t & VT_BTYPE);
+    if (o->cl.s != o->prev->cl.s)
+        block_cleanup(o->prev);
 
-        /* now we convert second operand */
-        if (c != 1) {
-            gen_cast(&type);
-            if (islv) {
-                mk_pointer(&vtop->type);
-                gaddrof();
-            } else if (VT_STRUCT == (vtop->type.t & VT_BTYPE))
-              gaddrof();
-        }
+    /* pop locally defined labels */
+    label_pop(&local_label_stack, o->llstk, is_expr);
 
-        rc = RC_TYPE(type.t);
-        /* for long longs, we use fixed registers to avoid having
-           to handle a complicated move */
-        if (USING_TWO_WORDS(type.t))
-          rc = RC_RET(type.t);
+    /* In the is_expr case (a statement expression is finished here),
+       vtop might refer to symbols on the local_stack.  Either via the
+       type or via vtop->sym.  We can't pop those nor any that in turn
+       might be referred to.  To make it easier we don't roll back
+       any symbols in that case; some upper level call to block() will
+       do that.  We do have to remove such symbols from the lookup
+       tables, though.  sym_pop will do that.  Statements waiting for
+       cold_flush() may refer to them as well.  */
 
-        tt = r2 = 0;
-        if (c < 0) {
-            r2 = gv(rc);
-            tt = gjmp(0);
-        }
-        gsym(u);
-        nocode_wanted = ncw_prev;
+#ifdef CONFIG_SWIRL_REGVARS
+    if (func_regvars && !keep) {
+        Sym *s;
+        for (s = local_stack; s != o->lstk; s = s->prev)
+            if (s->a.regvar)
+                gen_regvar_free(s->c);
+    }
+#endif
+    /* pop locally defined symbols */
+    pop_local_syms(&local_stack, o->lstk, keep, 0);
+    cur_scope = o->prev;
+    --local_scope;
 
-        /* this is horrible, but we must also convert first
-           operand */
-        if (c != 0) {
-            *vtop = sv;
-            gen_cast(&type);
-            if (islv) {
-                mk_pointer(&vtop->type);
-                gaddrof();
-            } else if (VT_STRUCT == (vtop->type.t & VT_BTYPE))
-              gaddrof();
-        }
+    if (swirl_state->do_debug)
+        swirl_debug_stabn(N_RBRAC, ind - func_ind);
+}
 
-        if (c < 0) {
-            r1 = gv(rc);
-            move_reg(r2, r1, islv ? VT_PTR : type.t);
-            vtop->r = r2;
-            gsym(tt);
-        }
+/* leave a scope via break/continue(/goto) */
+void leave_scope(struct scope *o)
+{
+    if (!o)
+        return;
+    try_call_scope_cleanup(o->cl.s);
+    vla_leave(o);
+}
 
-        if (islv)
-          indir();
+/* ------------------------------------------------------------------------- */
+/* call block from 'for do while' loops */
+
+static void lblock(int *bsym, int *csym)
+{
+    struct scope *lo = loop_scope, *co = cur_scope;
+    int *b = co->bsym, *c = co->csym;
+    if (csym) {
+        co->csym = csym;
+        loop_scope = co;
+    }
+    co->bsym = bsym;
+    block(0);
+    co->bsym = b;
+    if (csym) {
+        co->csym = c;
+        loop_scope = lo;
     }
 }
 
-static void expr_eq(void)
+/* -O: generate the condition of a loop at its bottom, after the body */
+static int loop_rotate_wanted(void)
 {
-    int t;
-    
-    expr_cond();
-    if ((t = tok) == '=' || TOK_ASSIGN(t)) {
-        test_lvalue();
-        next();
-        if (t == '=') {
-            expr_eq();
-        } else {
-            vdup();
-            expr_eq();
-            gen_op(TOK_ASSIGN_OP(t));
-        }
-        vstore();
-    }
+    return swirl_state->optimize && swirl_state->rotate_loops;
 }
 
-ST_FUNC void gexpr(void)
+/* save the tokens of a loop condition or step up to the ';' or ')'
+   which ends it.  'always' is set for a constant true condition. */
+static TokenString *loop_save_expr(int *always)
 {
-    while (1) {
-        expr_eq();
-        if (tok != ',')
-            break;
-        vpop();
+    TokenString *str = tok_str_alloc();
+    int level = 0, n = 0;
+
+    *always = tok >= TOK_CCHAR && tok <= TOK_CULONG && tokc.i != 0;
+    while (level > 0 || (tok != ';' && tok != ')')) {
+        if (tok == TOK_EOF)
+            swirl_error("unexpected end of file");
+        tok_str_add_tok(str);
+        if (tok == '(' || tok == '[' || tok == '{')
+            level++;
+        else if (tok == ')' || tok == ']' || tok == '}')
+            level--;
         next();
+        n++;
     }
+    if (n != 1)
+        *always = 0;
+    if (n == 0)
+        expect("expression");
+    tok_str_add(str, -1);
+    tok_str_add(str, 0);
+    return str;
 }
 
-/* parse a constant expression and return value in vtop.  */
-static void expr_const1(void)
+/* generate the expression saved by loop_save_expr() */
+static void loop_expr(TokenString *str, int end)
 {
-    const_wanted++;
-    nocode_wanted += unevalmask + 1;
-    expr_cond();
-    nocode_wanted -= unevalmask + 1;
-    const_wanted--;
+    unget_tok(0);
+    begin_macro(str, 1);
+    next();
+    gexpr();
+    if (tok != TOK_EOF)
+        skip(end);
+    end_macro();
+    next();
 }
 
-/* parse an integer constant and return its value. */
-static inline int64_t expr_const64(void)
+/* ------------------------------------------------------------------------- */
+/* -O: 'for (...; i < n; i++) d[i] = s[i];' and 'd[i] = c;' do what is
+   left with one memmove() or memset() ahead of the loop, which then
+   finds nothing to do.  The loop is still compiled as written, also to
+   copy overlapping buffers the way it does. */
+
+struct loop_pattern {
+    TokenString *i, *n, *d, *s;
+    int c, size, noalias;
+};
+
+static int loop_pattern_wanted(void)
 {
-    int64_t c;
-    expr_const1();
-    if ((vtop->r & (VT_VALMASK | VT_LVAL | VT_SYM)) != VT_CONST)
-        expect("constant expression");
-    c = vtop->c.i;
-    vpop();
-    return c;
+    return swirl_state->optimize
+        && swirl_state->loop_patterns
+        && !swirl_state->do_bounds_check
+        && !nocode_wanted;
 }
 
-/* parse an integer constant and return its value.
-   Complain if it doesn't fit 32bit (signed or unsigned).  */
-ST_FUNC int expr_const(void)
+/* read the next token into 'str' if it is 'c' */
+static int lp_skip(TokenString *str, int c)
 {
-    int c;
-    int64_t wc = expr_const64();
-    c = wc;
-    if (c != wc && (unsigned)c != wc)
-        swirl_error("constant exceeds 32 bit");
-    return c;
+    if (tok != c)
+        return 0;
+    tok_str_add_tok(str);
+    next();
+    return 1;
 }
 
-/* ------------------------------------------------------------------------- */
-/* return from function */
+/* read a variable or constant into 'str', and also alone into '*ps' */
+static void lp_save(TokenString *str, TokenString **ps)
+{
+    TokenString *s = tok_str_alloc();
+    tok_str_add_tok(s);
+    tok_str_add(s, -1);
+    tok_str_add(s, 0);
+    *ps = s;
+    lp_skip(str, tok);
+}
 
-#ifndef SWIRL_TARGET_ARM64
-static void gfunc_return(CType *func_type)
+/* type of the variable in 'tok', NULL if it is something else */
+static CType *lp_var(void)
 {
-    if ((func_type->t & VT_BTYPE) == VT_STRUCT) {
-        CType type, ret_type;
-        int ret_align, ret_nregs, regsize;
-        ret_nregs = gfunc_sret(func_type, func_var, &ret_type,
-                               &ret_align, &regsize);
-        if (ret_nregs < 0) {
-#ifdef SWIRL_TARGET_RISCV64
-            arch_transfer_ret_regs(0);
-#endif
-        } else if (0 == ret_nregs) {
-            /* if returning structure, must copy it to implicit
-               first pointer arg location */
-            type = *func_type;
-            mk_pointer(&type);
-            vset(&type, VT_LOCAL | VT_LVAL, func_vc);
-            indir();
-            vswap();
-            /* copy structure value to pointer */
-            vstore();
-        } else {
-            /* returning structure packed into registers */
-            int size, addr, align, rc;
-            size = type_size(func_type,&align);
-            if ((vtop->r != (VT_LOCAL | VT_LVAL) ||
-                 (vtop->c.i & (ret_align-1)))
-                && (align & (ret_align-1))) {
-                loc = (loc - size) & -ret_align;
-                addr = loc;
-                type = *func_type;
-                vset(&type, VT_LOCAL | VT_LVAL, addr);
-                vswap();
-                vstore();
-                vpop();
-                vset(&ret_type, VT_LOCAL | VT_LVAL, addr);
-            }
-            vtop->type = ret_type;
-            rc = RC_RET(ret_type.t);
-            if (ret_nregs == 1)
-                gv(rc);
-            else {
-                for (;;) {
-                    vdup();
-                    gv(rc);
-                    vpop();
-                    if (--ret_nregs == 0)
-                      break;
-                    /* We assume that when a structure is returned in multiple
-                       registers, their classes are consecutive values of the
-                       suite s(n) = 2^n */
-                    rc <<= 1;
-                    vtop->c.i += regsize;
-                }
-            }
-        }
+    Sym *s;
+
+    if (tok < TOK_UIDENT)
+        return NULL;
+    s = sym_find(tok);
+    if (!s || IS_ASM_SYM(s)
+        || (s->type.t & (VT_TYPEDEF | VT_VOLATILE | VT_ATOMIC))
+        || (s->type.t & VT_BTYPE) == VT_FUNC
+        || (s->r & (VT_VALMASK | VT_SYM)) == VT_CONST)
+        return NULL;
+    /* the stores to d[i] must not change i, n, d or s.  That is only
+       sure for arrays, parameters and locals whose address is not taken */
+    if (!(s->type.t & VT_ARRAY) && !s->a.regvar
+        && (s->r != (VT_LOCAL | VT_LVAL) || s->a.addrtaken))
+        return NULL;
+    return &s->type;
+}
+
+/* size of an int or long long, negated if unsigned.  Smaller types
+   are promoted to int. */
+static int lp_int_size(int t)
+{
+    int bt = t & VT_BTYPE;
+
+    if (t & VT_ARRAY)
+        return 0;
+    if (bt == VT_LLONG)
+        return t & VT_UNSIGNED ? -8 : 8;
+    if (bt == VT_INT)
+        return t & VT_UNSIGNED ? -4 : 4;
+    if (bt == VT_BYTE || bt == VT_SHORT || bt == VT_BOOL)
+        return 4;
+    return 0;
+}
+
+/* element type of the array or pointer 'type' if it can be copied
+   or set bytewise */
+static CType *lp_elem(CType *type)
+{
+    int bt;
+
+    if (!type || (type->t & VT_BTYPE) != VT_PTR)
+        return NULL;
+    type = pointed_type(type);
+    bt = type->t & VT_BTYPE;
+    if ((type->t & (VT_ARRAY | VT_VOLATILE | VT_ATOMIC))
+        || bt == VT_VOID || bt == VT_FUNC || bt == VT_STRUCT
+        || bt == VT_LDOUBLE || bt >= VT_QVEC)
+        return NULL;
+    return type;
+}
+
+/* i < n; i++) d[i] = s[i];  with n a variable or a constant */
+static int lp_match(TokenString *str, struct loop_pattern *lp)
+{
+    CType *dt, *et, *st;
+    int i, d, in, nn, brace, align;
+    uint64_t v;
+
+    i = tok;
+    dt = lp_var();
+    if (!dt || ((dt->t & VT_BTYPE) != VT_INT
+                && (dt->t & VT_BTYPE) != VT_LLONG))
+        return 0;
+    in = lp_int_size(dt->t);
+    lp_save(str, &lp->i);
+    if (!lp_skip(str, TOK_LT))
+        return 0;
+
+    /* the loop runs n - i times in the type of i */
+    if (tok >= TOK_CCHAR && tok <= TOK_CULONG) {
+        v = tokc.i;
+        if ((int64_t)v < 0
+            || (in == 4 && v > 0x7fffffff)
+            || (in == -4 && v > 0xffffffff))
+            return 0;
+    } else {
+        st = lp_var();
+        if (!st || !(nn = lp_int_size(st->t)))
+            return 0;
+        if (in < 0 ? -nn > -in || nn > -in : nn < 0 && -nn >= in)
+            return 0;
+    }
+    lp_save(str, &lp->n);
+    if (!lp_skip(str, ';'))
+        return 0;
+
+    if (lp_skip(str, TOK_INC)) {
+        if (!lp_skip(str, i))
+            return 0;
+    } else if (!lp_skip(str, i)) {
+        return 0;
+    } else if (lp_skip(str, TOK_A_ADD)) {
+        if (tok != TOK_CINT || tokc.i != 1 || !lp_skip(str, tok))
+            return 0;
+    } else if (!lp_skip(str, TOK_INC)) {
+        return 0;
+    }
+    if (!lp_skip(str, ')'))
+        return 0;
+
+    brace = lp_skip(str, '{');
+    d = tok;
+    dt = lp_var();
+    et = lp_elem(dt);
+    if (!et || (et->t & VT_CONSTANT))
+        return 0;
+    lp->size = type_size(et, &align);
+    lp_save(str, &lp->d);
+    if (!lp_skip(str, '[') || !lp_skip(str, i) || !lp_skip(str, ']')
+        || !lp_skip(str, '='))
+        return 0;
+
+    if (tok >= TOK_UIDENT) {
+        /* copy between elements of the same size and kind */
+        lp->noalias = (dt->t & VT_ARRAY) && tok != d;
+        st = lp_var();
+        if (st)
+            lp->noalias &= (st->t & VT_ARRAY) != 0;
+        st = lp_elem(st);
+        if (!st || type_size(st, &align) != lp->size
+            || (st->t & VT_BTYPE) != (et->t & VT_BTYPE))
+            return 0;
+        lp_save(str, &lp->s);
+        if (!lp_skip(str, '[') || !lp_skip(str, i) || !lp_skip(str, ']'))
+            return 0;
     } else {
-        gv(RC_RET(func_type->t));
+        /* a byte, or zero */
+        nn = lp_skip(str, '-');
+        if (tok < TOK_CCHAR || tok > TOK_CULONG)
+            return 0;
+        v = nn ? -tokc.i : tokc.i;
+        lp_skip(str, tok);
+        if (lp->size == 1 && (et->t & VT_BTYPE) == VT_BYTE)
+            lp->c = v & 0xff;
+        else if (v != 0)
+            return 0;
     }
-    vtop--; /* NOT vpop() because on x86 it would flush the fp stack */
+    if (!lp_skip(str, ';'))
+        return 0;
+    return !brace || lp_skip(str, '}');
 }
-#endif
 
-static void check_func_return(void)
+/* push the variable or constant saved by lp_save() */
+static void lp_push(TokenString *s)
 {
-    if ((func_vt.t & VT_BTYPE) == VT_VOID)
-        return;
-    if (!strcmp (funcname, "main")
-        && (func_vt.t & VT_BTYPE) == VT_INT) {
-        /* main returns 0 by default */
-        vpushi(0);
-        gen_assign_cast(&func_vt);
-        gfunc_return(&func_vt);
-    } else {
-        swirl_warning("function might return no value: '%s'", funcname);
+    unget_tok(0);
+    begin_macro(s, 0);
+    next();
+    unary();
+    end_macro();
+    next();
+}
+
+/* (n - i) * size */
+static void lp_len(struct loop_pattern *lp)
+{
+    lp_push(lp->n);
+    lp_push(lp->i);
+    gen_op('-');
+    gen_cast_s(VT_SIZE_T);
+    vpushs(lp->size);
+    gen_op('*');
+}
+
+/* &d[i] */
+static void lp_addr(TokenString *d, struct loop_pattern *lp)
+{
+    lp_push(d);
+    lp_push(lp->i);
+    gen_op('+');
+}
+
+static void loop_pattern(void)
+{
+    struct loop_pattern lp;
+    TokenString *str = tok_str_alloc();
+    int a;
+
+    memset(&lp, 0, sizeof lp);
+    if (lp_match(str, &lp)) {
+        /* if (i < n) { memmove(&d[i], &s[i], (n - i) * size); i = n; } */
+        lp_push(lp.i);
+        lp_push(lp.n);
+        gen_op(TOK_LT);
+        a = gvtst(1, 0);
+        if (lp.s && !lp.noalias) {
+            /* unless d lies within what s[i] would read before d[i] */
+            lp_push(lp.d);
+            gen_cast(&char_pointer_type);
+            lp_push(lp.s);
+            gen_cast(&char_pointer_type);
+            gen_op('-');
+            gen_cast_s(VT_SIZE_T);
+            lp_len(&lp);
+            gen_op(TOK_GE);
+            a = gvtst(1, a);
+        }
+        vpush_helper_func(lp.s ? lp.noalias ? TOK_memcpy : TOK_memmove
+                               : TOK_memset);
+        lp_addr(lp.d, &lp);
+        if (lp.s) {
+            lp_addr(lp.s, &lp);
+            lp_len(&lp);
+        } else {
+#ifdef SWIRL_TARGET_ARM
+            lp_len(&lp);
+            vpushi(lp.c);
+#else
+            vpushi(lp.c);
+            lp_len(&lp);
+#endif
+        }
+        gfunc_call(3);
+        lp_push(lp.i);
+        lp_push(lp.n);
+        vstore();
+        vpop();
+        gsym(a);
     }
+    if (lp.i)
+        tok_str_free(lp.i);
+    if (lp.n)
+        tok_str_free(lp.n);
+    if (lp.d)
+        tok_str_free(lp.d);
+    if (lp.s)
+        tok_str_free(lp.s);
+    /* put back what was read */
+    tok_str_add(str, 0);
+    unget_tok(0);
+    begin_macro(str, 1);
+    next();
 }
 
 /* ------------------------------------------------------------------------- */
-/* switch/case */
+/* -O: 'if' branches which __builtin_expect says are not taken go to the
+   end of the function, so that the rest falls through */
 
-static int case_cmpi(const void *pa, const void *pb)
+/* whether an 'if' starting here may move one of its branches */
+static int cold_wanted(void)
 {
-    int64_t a = (*(struct case_t**) pa)->v1;
-    int64_t b = (*(struct case_t**) pb)->v1;
-    return a < b ? -1 : a > b;
+    return swirl_state->optimize
+        && !swirl_state->do_debug
+        && !swirl_state->do_bounds_check
+        && !nocode_wanted
+        && !cur_inline
+        && vtop < vstack
+        && !local_label_stack
+        && !cur_scope->cl.s
+        && cur_scope->vla.num == root_scope->vla.num;
 }
 
-static int case_cmpu(const void *pa, const void *pb)
+/* save the statement that follows.  Not for those which do not end
+   with their first ';' or '}'. */
+static TokenString *cold_save(void)
 {
-    uint64_t a = (uint64_t)(*(struct case_t**) pa)->v1;
-    uint64_t b = (uint64_t)(*(struct case_t**) pb)->v1;
-    return a < b ? -1 : a > b;
+    TokenString *str;
+    int braces = tok == '{', level = 0, t;
+
+    if (tok == TOK_IF || tok == TOK_FOR || tok == TOK_WHILE
+        || tok == TOK_DO || tok == TOK_SWITCH || tok == ';')
+        return NULL;
+    str = tok_str_alloc();
+    do {
+        if (tok == TOK_EOF)
+            swirl_error("unexpected end of file");
+        tok_str_add_tok(str);
+        t = tok;
+        if (t == '(' || t == '[' || t == '{')
+            level++;
+        else if (t == ')' || t == ']' || t == '}')
+            level--;
+        next();
+    } while (level > 0 || t != (braces ? '}' : ';'));
+    tok_str_add(str, -1);
+    tok_str_add(str, 0);
+    return str;
 }
 
-static void gtst_addr(int t, int a)
+/* whether the statement 'str' can do without the loops, switches and
+   labels around it */
+static int cold_ok(TokenString *str)
 {
-    gsym_addr(gvtst(0, t), a);
+    const int *p;
+    CValue cv;
+    int t, q = 0;
+
+    for (p = str->str; (t = tok_str_get(&p, &cv)) != TOK_EOF;) {
+        if (t == TOK_BREAK || t == TOK_CONTINUE
+            || t == TOK_CASE || t == TOK_DEFAULT)
+            return 0;
+        if (t == '?')
+            q++;
+        else if (t == ':' && --q < 0)
+            return 0;
+    }
+    return 1;
 }
 
-static void gcase(struct case_t **base, int len, int *bsym)
+/* the next token at *pp, staying at the end */
+static int cold_tok(const int **pp)
 {
-    struct case_t *p;
-    int e;
-    int ll = (vtop->type.t & VT_BTYPE) == VT_LLONG;
-    while (len > 8) {
-        /* binary search */
-        p = base[len/2];
-        vdup();
-	if (ll)
-	    vpushll(p->v2);
-	else
-	    vpushi(p->v2);
-        gen_op(TOK_LE);
-        e = gvtst(1, 0);
-        vdup();
-	if (ll)
-	    vpushll(p->v1);
-	else
-	    vpushi(p->v1);
-        gen_op(TOK_GE);
-        gtst_addr(0, p->sym); /* v1 <= x <= v2 */
-        /* x < v1 */
-        gcase(base, len/2, bsym);
-        /* x > v2 */
-        gsym(e);
-        e = len/2 + 1;
-        base += e; len -= e;
+    const int *p;
+    CValue cv;
+    int t;
+
+    do {
+        p = *pp;
+        t = tok_str_get(pp, &cv);
+    } while (t == TOK_LINENUM);
+    if (t == TOK_EOF)
+        *pp = p;
+    return t;
+}
+
+/* skip the statement at *pp up to the closing 'end' */
+static void cold_skip(const int **pp, int end)
+{
+    int t, level = 0;
+
+    while ((t = cold_tok(pp)) != TOK_EOF) {
+        if (t == '(' || t == '[' || t == '{')
+            level++;
+        else if (t == ')' || t == ']' || t == '}')
+            level--;
+        if (level <= 0 && t == end)
+            break;
     }
-    /* linear scan */
-    while (len--) {
-        p = *base++;
-        vdup();
-	if (ll)
-	    vpushll(p->v2);
-	else
-	    vpushi(p->v2);
-        if (p->v1 == p->v2) {
-            gen_op(TOK_EQ);
-            gtst_addr(0, p->sym);
-        } else {
-            gen_op(TOK_LE);
-            e = gvtst(1, 0);
-            vdup();
-	    if (ll)
-	        vpushll(p->v1);
-	    else
-	        vpushi(p->v1);
-            gen_op(TOK_GE);
-            gtst_addr(0, p->sym);
-            gsym(e);
-        }
+}
+
+/* skip the statement at *pp, return whether it never goes on to
+   what follows (with no labels in there) */
+static int cold_jumps(const int **pp)
+{
+    const int *q = *pp;
+    int t = cold_tok(pp), j = 0;
+
+    switch (t) {
+    case '{':
+        for (;;) {
+            q = *pp;
+            t = cold_tok(&q);
+            if (t == '}' || t == TOK_EOF)
+                break;
+            j |= cold_jumps(pp);
+        }
+        *pp = q;
+        return j;
+    case TOK_IF:
+        cold_skip(pp, ')');
+        j = cold_jumps(pp);
+        q = *pp;
+        if (cold_tok(&q) != TOK_ELSE)
+            return 0;
+        *pp = q;
+        return cold_jumps(pp) & j;
+    case TOK_WHILE:
+    case TOK_FOR:
+    case TOK_SWITCH:
+        cold_skip(pp, ')');
+        cold_jumps(pp);
+        return 0;
+    case TOK_DO:
+        cold_jumps(pp);
+        cold_skip(pp, ';');
+        return 0;
     }
-    *bsym = gjmp(*bsym);
+    *pp = q;
+    cold_skip(pp, ';');
+    return t == TOK_RETURN || t == TOK_GOTO;
 }
 
-/* ------------------------------------------------------------------------- */
-/* __attribute__((cleanup(fn))) */
+/* generate the statement saved by cold_save() where it is, or the
+   statement that follows if none was saved */
+static void cold_stmt(TokenString *str)
+{
+    if (!str) {
+        block(0);
+        return;
+    }
+    unget_tok(0);
+    begin_macro(str, 1);
+    next();
+    block(0);
+    end_macro();
+    next();
+}
 
-static void try_call_scope_cleanup(Sym *stop)
+static Sym **sym_tok_ptr(Sym *s)
 {
-    Sym *cls = cur_scope->cl.s;
+    TokenSym *ts = table_ident[(s->v & ~SYM_STRUCT) - TOK_IDENT];
+    return s->v & SYM_STRUCT ? &ts->sym_struct : &ts->sym_identifier;
+}
 
-    for (; cls != stop; cls = cls->ncl) {
-	Sym *fs = cls->next;
-	Sym *vs = cls->prev_tok;
+/* whether the local 's' can be found by its name */
+static int cold_visible(Sym *s)
+{
+    Sym *p;
 
-	vpushsym(&fs->type, fs);
-	vset(&vs->type, vs->r, vs->c);
-	vtop->sym = vs;
-        mk_pointer(&vtop->type);
-	gaddrof();
-	gfunc_call(1);
-    }
+    if ((s->v & SYM_FIELD) || (s->v & ~SYM_STRUCT) >= SYM_FIRST_ANOM)
+        return 0;
+    for (p = *sym_tok_ptr(s); p && p != s; p = p->prev_tok)
+        ;
+    return p == s;
 }
 
-static void try_call_cleanup_goto(Sym *cleanupstate)
+/* have the statement 'str' generated by cold_flush(), reached by the
+   jumps 'jmp'.  Until then the locals are kept (see prev_scope()), and
+   with them the registers of regvars. */
+static struct cold_block *cold_add(TokenString *str, int jmp)
 {
-    Sym *oc, *cc;
-    int ocd, ccd;
+    struct cold_block *cb, **pcb;
+    Sym *s;
+    int n = 0;
 
-    if (!cur_scope->cl.s)
-	return;
+    for (s = local_stack; s; s = s->prev)
+        n += cold_visible(s);
+    cb = swirl_malloc(sizeof *cb + n * sizeof(Sym *));
+    for (n = 0, s = local_stack; s; s = s->prev)
+        if (cold_visible(s))
+            cb->syms[n++] = s;
+    cb->nb_syms = n;
+    cb->next = NULL;
+    cb->str = str;
+    cb->jmp = jmp;
+    cb->back = 0;
+    cb->scope = local_scope;
+    for (pcb = &cold_blocks; *pcb; pcb = &(*pcb)->next)
+        ;
+    *pcb = cb;
+    return cb;
+}
 
-    /* search NCA of both cleanup chains given parents and initial depth */
-    ocd = cleanupstate ? cleanupstate->v & ~SYM_FIELD : 0;
-    for (ccd = cur_scope->cl.n, oc = cleanupstate; ocd > ccd; --ocd, oc = oc->ncl)
-      ;
-    for (cc = cur_scope->cl.s; ccd > ocd; --ccd, cc = cc->ncl)
-      ;
-    for (; cc != oc; cc = cc->ncl, oc = oc->ncl, --ccd)
-      ;
+/* the statement of 'cb' goes on here */
+static void cold_end(struct cold_block *cb)
+{
+    const int *p = cb->str->str;
 
-    try_call_scope_cleanup(cc);
+    /* which is reached from there unless it returns */
+    cb->back = nocode_wanted && cold_jumps(&p) ? ind : gind();
 }
 
-/* call 'func' for each __attribute__((cleanup(func))) */
-static void block_cleanup(struct scope *o)
+/* the end of the function body, the cold blocks follow.  Where the
+   target can, it returns in place rather than jump over them. */
+static void cold_return(void)
 {
-    int jmp = 0;
-    Sym *g, **pg;
-    for (pg = &pending_gotos; (g = *pg) && g->c > o->cl.n;) {
-        if (g->prev_tok->r & LABEL_FORWARD) {
-            Sym *pcl = g->next;
-            if (!jmp)
-                jmp = gjmp(0);
-            gsym(pcl->jnext);
-            try_call_scope_cleanup(o->cl.s);
-            pcl->jnext = gjmp(0);
-            if (!o->cl.n)
-                goto remove_pending;
-            g->c = o->cl.n;
-            pg = &g->prev;
-        } else {
-    remove_pending:
-            *pg = g->prev;
-            sym_free(g);
+#ifdef CONFIG_SWIRL_RETSITE
+    gen_ret_site();
+    CODE_OFF();
+#else
+    rsym = gjmp(rsym);
+#endif
+}
+
+/* generate the statements of cold_add(), with the locals which were
+   visible then.  The function body has been parsed, its end jumps to
+   the epilogue. */
+static void cold_flush(void)
+{
+    struct cold_block *cb;
+    Sym *s, **ps;
+    int i, vla_loc = root_scope->vla.loc;
+
+    /* hide the parameters */
+    sym_pop(&local_stack, NULL, 1);
+    cold_replay = 1;
+    while ((cb = cold_blocks)) {
+        for (i = cb->nb_syms; i--;) {
+            s = cb->syms[i];
+            ps = sym_tok_ptr(s);
+            s->prev_tok = *ps;
+            *ps = s;
+        }
+        local_scope = cb->scope;
+        /* the stack pointer is not saved yet for a VLA in there */
+        root_scope->vla.loc = 0;
+        gsym(cb->jmp);
+        unget_tok(0);
+        begin_macro(cb->str, 1);
+        next();
+        block(0);
+        end_macro();
+        next();
+        gjmp_addr(cb->back);
+        for (i = 0; i < cb->nb_syms; i++) {
+            s = cb->syms[i];
+            *sym_tok_ptr(s) = s->prev_tok;
         }
+        /* blocks added meanwhile go after this one */
+        cold_blocks = cb->next;
+        swirl_free(cb);
     }
-    gsym(jmp);
-    try_call_scope_cleanup(o->cl.s);
+    cold_replay = 0;
+    local_scope = 0;
+    root_scope->vla.loc = vla_loc;
 }
 
 /* ------------------------------------------------------------------------- */
-/* VLA */
+/* -O: expansion of calls to small static functions */
 
-static void vla_restore(int loc)
+#define INLINE_MAX_TOKENS 40 /* larger bodies need always_inline */
+#define INLINE_MAX_PARAMS 8
+#define INLINE_MAX_DEPTH 4 /* calls expanded within expanded calls */
+
+/* whether the calls to 'sym' may be expanded */
+static int inline_wanted(Sym *sym)
 {
-    if (loc)
-        gen_vla_sp_restore(loc);
+    return swirl_state->optimize
+        && swirl_state->inline_functions
+        && !swirl_state->do_debug
+        && !swirl_state->do_bounds_check
+        && (sym->type.t & (VT_STATIC | VT_INLINE))
+        && !sym->type.ref->f.func_noinline
+        && sym->type.ref->f.func_type == FUNC_NEW;
 }
 
-static void vla_leave(struct scope *o)
+/* whether 'str', the body of 'sym', can be replayed at a call */
+static int inline_ok(Sym *sym, TokenString *str)
 {
-    if (o->vla.num < cur_scope->vla.num)
-        vla_restore(o->vla.loc);
-}
+    const int *p;
+    CValue cv;
+    Sym *sa;
+    int t, n = 0;
 
-/* ------------------------------------------------------------------------- */
-/* local scopes */
+    for (sa = sym->type.ref->next; sa; sa = sa->next)
+        if (++n > INLINE_MAX_PARAMS)
+            return 0;
+    n = 0;
+    for (p = str->str; (t = tok_str_get(&p, &cv)) != TOK_EOF;) {
+        if (t == TOK_LINENUM)
+            continue;
+        /* no recursion and nothing that needs a frame of its own */
+        if (t == sym->v || t == TOK_STATIC || t == TOK_LABEL
+            || t == TOK_ASM1 || t == TOK_ASM2 || t == TOK_ASM3
+            || t == TOK_alloca
+            || t == TOK_builtin_frame_address
+            || t == TOK_builtin_return_address)
+            return 0;
+        if (++n > INLINE_MAX_TOKENS && !sym->type.ref->f.func_alwinl)
+            return 0;
+    }
+    return 1;
+}
 
-void new_scope(struct scope *o)
+/* keep 'str', the body of 'sym' now generated, for the calls which
+   follow */
+static void inline_keep(Sym *sym, TokenString *str)
 {
-    /* copy and link previous scope */
-    *o = *cur_scope;
-    o->prev = cur_scope;
-    cur_scope = o;
+    InlineFunc *fn;
 
-    /* record local declaration stack position */
-    o->lstk = local_stack;
-    o->llstk = local_label_stack;
+    if (!inline_wanted(sym) || !inline_ok(sym, str)) {
+        tok_str_free(str);
+        return;
+    }
+    fn = swirl_malloc(sizeof *fn + strlen(file->filename));
+    strcpy(fn->filename, file->filename);
+    fn->sym = sym;
+    fn->func_str = str;
+    fn->expanded = 0;
+    fn->done = 1;
+    dynarray_add(&swirl_state->inline_fns, &swirl_state->nb_inline_fns, fn);
+    sym->type.ref->f.func_inl = 1;
+}
+
+/* the body to replay for a call to 'sv', or NULL */
+static InlineFunc *inline_find(SValue *sv)
+{
+    struct inline_call *ic;
+    InlineFunc *fn;
+    Sym *sym = sv->sym;
+    int i, n = 0;
+
+    if ((sv->r & (VT_VALMASK | VT_LVAL | VT_SYM)) != (VT_CONST | VT_SYM)
+        || sv->c.i
+        || sv->type.ref != sym->type.ref
+        || !sym->type.ref->f.func_inl
+        || nocode_wanted
+        || !inline_wanted(sym))
+        return NULL;
+    for (ic = cur_inline; ic; ic = ic->prev)
+        if (ic->fn->sym == sym || ++n == INLINE_MAX_DEPTH)
+            return NULL;
+    for (i = 0; i < swirl_state->nb_inline_fns; i++) {
+        fn = swirl_state->inline_fns[i];
+        if (fn->sym == sym)
+            return inline_ok(sym, fn->func_str) ? fn : NULL;
+    }
+    return NULL;
+}
 
-    ++local_scope;
+/* whether the argument on vtop can be bound to parameter 'sa' as a
+   constant: the body must not assign it or take its address */
+static int inline_const_arg(TokenString *str, Sym *sa)
+{
+    const int *p, *q;
+    CValue cv;
+    int t, n, prev = 0, v = sa->v & ~SYM_FIELD, bt = vtop->type.t & VT_BTYPE;
 
-    if (swirl_state->do_debug)
-        swirl_debug_stabn(N_LBRAC, ind - func_ind);
+    if ((vtop->r & (VT_VALMASK | VT_LVAL | VT_SYM)) != VT_CONST
+        || !(is_integer_btype(bt) || bt == VT_PTR)
+        || vtop->c.i != (int)vtop->c.i)
+        return 0;
+    for (p = str->str; (t = tok_str_get(&p, &cv)) != TOK_EOF;) {
+        if (t == TOK_LINENUM)
+            continue;
+        if (t == v) {
+            if (prev == '&' || prev == TOK_INC || prev == TOK_DEC)
+                return 0;
+            q = p;
+            do
+                n = tok_str_get(&q, &cv);
+            while (n == ')' || n == TOK_LINENUM);
+            if (n == '=' || TOK_ASSIGN(n) || n == TOK_INC || n == TOK_DEC)
+                return 0;
+        }
+        if (t != '(')
+            prev = t;
+    }
+    return 1;
 }
 
-void prev_scope(struct scope *o, int is_expr)
+/* whether 's' is bound in the caller rather than at file scope.  Not
+   sym_scope(): a typedef keeps its attributes there and anonymous enum
+   constants have the scope of their type, which is never set. */
+static int inline_caller_sym(Sym *s)
 {
-    vla_leave(o->prev);
-
-    if (o->cl.s != o->prev->cl.s)
-        block_cleanup(o->prev);
+    Sym *l;
+    for (l = local_stack; l; l = l->prev)
+        if (l == s)
+            return 1;
+    return 0;
+}
 
-    /* pop locally defined labels */
-    label_pop(&local_label_stack, o->llstk, is_expr);
+/* the body 'str' is replayed where the caller's locals and labels
+   would hide what its names referred to: put these aside */
+static void inline_hide(TokenString *str)
+{
+    struct inline_hidden *h;
+    const int *p;
+    CValue cv;
+    TokenSym *ts;
+    Sym *s, *st;
+    int t;
 
-    /* In the is_expr case (a statement expression is finished here),
-       vtop might refer to symbols on the local_stack.  Either via the
-       type or via vtop->sym.  We can't pop those nor any that in turn
-       might be referred to.  To make it easier we don't roll back
-       any symbols in that case; some upper level call to block() will
-       do that.  We do have to remove such symbols from the lookup
-       tables, though.  sym_pop will do that.  */
+    for (p = str->str; (t = tok_str_get(&p, &cv)) != TOK_EOF;) {
+        if (t < TOK_UIDENT)
+            continue;
+        ts = table_ident[t - TOK_IDENT];
+        for (s = ts->sym_identifier; s && inline_caller_sym(s); s = s->prev_tok)
+            ;
+        for (st = ts->sym_struct; st && inline_caller_sym(st); st = st->prev_tok)
+            ;
+        if (s == ts->sym_identifier && st == ts->sym_struct && !ts->sym_label)
+            continue;
+        if ((inline_nb_hidden & 15) == 0)
+            inline_hidden = swirl_realloc(inline_hidden,
+                (inline_nb_hidden + 16) * sizeof *inline_hidden);
+        h = &inline_hidden[inline_nb_hidden++];
+        h->ts = ts;
+        h->sym = ts->sym_identifier;
+        h->tag = ts->sym_struct;
+        h->label = ts->sym_label;
+        ts->sym_identifier = s;
+        ts->sym_struct = st;
+        ts->sym_label = NULL;
+    }
+}
 
-    /* pop locally defined symbols */
-    pop_local_syms(&local_stack, o->lstk, is_expr, 0);
-    cur_scope = o->prev;
-    --local_scope;
+static void inline_unhide(int n)
+{
+    struct inline_hidden *h;
 
-    if (swirl_state->do_debug)
-        swirl_debug_stabn(N_RBRAC, ind - func_ind);
+    while (inline_nb_hidden > n) {
+        h = &inline_hidden[--inline_nb_hidden];
+        h->ts->sym_identifier = h->sym;
+        h->ts->sym_struct = h->tag;
+        h->ts->sym_label = h->label;
+    }
 }
 
-/* leave a scope via break/continue(/goto) */
-void leave_scope(struct scope *o)
+/* 'return' in a body being expanded.  The value of the last statement
+   stays on the value stack, the others go to a local. */
+static void inline_return(int top)
 {
-    if (!o)
+    struct inline_call *ic = cur_inline;
+    int b = (func_vt.t & VT_BTYPE) != VT_VOID, size, align;
+
+    if (tok != ';') {
+        gexpr();
+        if (b) {
+            gen_assign_cast(&func_vt);
+        } else {
+            if (vtop->type.t != VT_VOID)
+                swirl_warning("void function returns a value");
+            vtop--;
+        }
+    } else if (b) {
+        swirl_warning("'return' with no value");
+        b = 0;
+    }
+    skip(';');
+    if (top && tok == '}' && !rsym && !ic->ret_loc
+        && cur_scope->cl.s == root_scope->cl.s
+        && cur_scope->vla.num == root_scope->vla.num
+        && (func_vt.t & VT_BTYPE) != VT_STRUCT) {
+        if (b) {
+            if ((vtop->r & (VT_VALMASK | VT_LVAL | VT_SYM)) != VT_CONST)
+                gv(RC_TYPE(func_vt.t));
+            ic->ret_val = 1;
+        }
         return;
-    try_call_scope_cleanup(o->cl.s);
-    vla_leave(o);
+    }
+    leave_scope(root_scope);
+    if (b) {
+        if (!ic->ret_loc) {
+            size = type_size(&func_vt, &align);
+            ic->ret_loc = loc = (loc - size) & -align;
+        }
+        vset(&func_vt, VT_LOCAL | VT_LVAL, ic->ret_loc);
+        vswap();
+        vstore();
+        vpop();
+    }
+    rsym = gjmp(rsym);
+    CODE_OFF();
 }
 
-/* ------------------------------------------------------------------------- */
-/* call block from 'for do while' loops */
-
-static void lblock(int *bsym, int *csym)
+/* expand the call to 'fn' on vtop, with '(' as the current token: the
+   arguments are bound to the parameters in a scope of their own and
+   the saved body is replayed as if it were a statement expression */
+static void gen_inline_call(InlineFunc *fn, int tail)
 {
-    struct scope *lo = loop_scope, *co = cur_scope;
-    int *b = co->bsym, *c = co->csym;
-    if (csym) {
-        co->csym = csym;
-        loop_scope = co;
+    struct inline_call ic;
+    struct scope o, b, *saved_root = root_scope, *saved_loop = loop_scope;
+    struct switch_t *saved_switch = cur_switch;
+    Sym *f = vtop->type.ref, *sa, *saved_labels = global_label_stack;
+    CType saved_vt = func_vt, type;
+    const char *saved_funcname = funcname;
+    int saved_rsym = rsym, saved_warn = swirl_state->warn_none;
+    int args[INLINE_MAX_PARAMS][2], n, size, align;
+
+    vpop();
+    next();
+    sa = f->next;
+    n = 0;
+    if (tok != ')') {
+        for (;;) {
+            expr_eq();
+            gfunc_param_typed(f, sa);
+            if (inline_const_arg(fn->func_str, sa)) {
+                args[n][0] = VT_CONST;
+                args[n][1] = vtop->c.i;
+            } else {
+                type = sa->type;
+                type.t &= ~VT_CONSTANT;
+                size = type_size(&type, &align);
+                loc = (loc - size) & -align;
+                args[n][0] = VT_LOCAL | VT_LVAL;
+                args[n][1] = loc;
+                vset(&type, VT_LOCAL | VT_LVAL, loc);
+                vswap();
+                vstore();
+            }
+            vpop();
+            sa = sa->next;
+            n++;
+            if (tok == ')')
+                break;
+            skip(',');
+        }
     }
-    co->bsym = bsym;
-    block(0);
-    co->bsym = b;
-    if (csym) {
-        co->csym = c;
-        loop_scope = lo;
+    if (sa)
+        swirl_error("too few arguments to function");
+    skip(')');
+
+    /* warn about the body only once */
+    if (fn->done || fn->expanded++)
+        swirl_state->warn_none = 1;
+    save_regs(0);
+    ic.prev = cur_inline;
+    ic.fn = fn;
+    ic.ret_loc = ic.ret_val = 0;
+    /* keeps the tail calls in the body */
+    ic.tail = tail && tok == ';'
+        && is_compatible_unqualified_types(&func_vt, &f->type);
+    ic.nb_hidden = inline_nb_hidden;
+    inline_hide(fn->func_str);
+    cur_inline = &ic;
+    new_scope(&o);
+    o.bsym = o.csym = NULL;
+    loop_scope = NULL;
+    cur_switch = NULL;
+    global_label_stack = NULL;
+    funcname = get_tok_str(fn->sym->v, NULL);
+    if (!ic.tail) {
+        root_scope = &o;
+        func_vt = f->type;
+        func_vt.t &= ~VT_CONSTANT;
+        rsym = 0;
+    }
+    for (sa = f->next, n = 0; sa; sa = sa->next, n++)
+        sym_push(sa->v & ~SYM_FIELD, &sa->type, args[n][0], args[n][1]);
+
+    unget_tok(0);
+    begin_macro(fn->func_str, 0);
+    next();
+    skip('{');
+    new_scope(&b);
+    while (tok != '}') {
+        decl(VT_LOCAL);
+        if (tok == TOK_RETURN && !ic.tail) {
+            next();
+            inline_return(1);
+        } else if (tok != '}') {
+            block(0);
+        }
+    }
+    prev_scope(&b, 0);
+    skip('}');
+    end_macro();
+    next();
+
+    if (!ic.tail)
+        gsym(rsym);
+    if (ic.ret_val) {
+        /* on the value stack already */
+    } else if ((func_vt.t & VT_BTYPE) == VT_VOID) {
+        vpushi(0);
+        vtop->type.t = VT_VOID;
+    } else {
+        if (!ic.ret_loc) {
+            size = type_size(&func_vt, &align);
+            ic.ret_loc = loc = (loc - size) & -align;
+        }
+        vset(&func_vt, VT_LOCAL | VT_LVAL, ic.ret_loc);
+        if ((func_vt.t & VT_BTYPE) != VT_STRUCT)
+            gv(RC_TYPE(func_vt.t));
     }
+    prev_scope(&o, 0);
+    label_pop(&global_label_stack, NULL, 0);
+    inline_unhide(ic.nb_hidden);
+    cur_inline = ic.prev;
+    root_scope = saved_root;
+    loop_scope = saved_loop;
+    cur_switch = saved_switch;
+    global_label_stack = saved_labels;
+    func_vt = saved_vt;
+    funcname = saved_funcname;
+    if (!ic.tail)
+        rsym = saved_rsym;
+    swirl_state->warn_none = saved_warn;
+    if (f->f.func_noreturn)
+        CODE_OFF();
 }
 
 static void block(int is_expr)
@@ -7014,31 +9401,73 @@ again:
     next();
 
     if (t == TOK_IF) {
+        TokenString *str = NULL;
+        struct cold_block *cb;
+
         skip('(');
+        expect_hint = tok == TOK_builtin_expect && cold_wanted() ? -2 : -1;
         gexpr();
+        e = expect_hint;
+        expect_hint = -1;
         skip(')');
-        a = gvtst(1, 0);
-        block(0);
-        if (tok == TOK_ELSE) {
-            d = gjmp(0);
-            gsym(a);
-            next();
-            block(0);
-            gsym(d); /* patch else jmp */
+        if ((vtop->r & (VT_VALMASK | VT_LVAL | VT_SYM)) == VT_CONST)
+            e = -1;
+        if (e == 0)
+            str = cold_save();
+        if (str && cold_ok(str)) {
+            /* unlikely: fall through to the else branch or what follows */
+            cb = cold_add(str, gvtst(0, 0));
+            if (tok == TOK_ELSE) {
+                next();
+                block(0);
+            }
+            cold_end(cb);
         } else {
-            gsym(a);
+            a = gvtst(1, 0);
+            cold_stmt(str);
+            str = NULL;
+            if (tok == TOK_ELSE) {
+                next();
+                if (e == 1)
+                    str = cold_save();
+                if (str && cold_ok(str)) {
+                    /* likely: the else branch goes to the end */
+                    cold_end(cold_add(str, a));
+                } else {
+                    d = gjmp(0);
+                    gsym(a);
+                    cold_stmt(str);
+                    gsym(d); /* patch else jmp */
+                }
+            } else {
+                gsym(a);
+            }
         }
 
     } else if (t == TOK_WHILE) {
-        d = gind();
         skip('(');
-        gexpr();
-        skip(')');
-        a = gvtst(1, 0);
-        b = 0;
-        lblock(&a, &b);
-        gjmp_addr(d);
-        gsym_addr(b, d);
+        if (loop_rotate_wanted()) {
+            /* goto e; d: body; b: e: if (cond) goto d; a: */
+            TokenString *str = loop_save_expr(&c);
+            skip(')');
+            e = c ? 0 : gjmp(0);
+            d = gind();
+            a = b = 0;
+            lblock(&a, &b);
+            gsym(b);
+            gsym(e);
+            loop_expr(str, ')');
+            gsym_addr(gvtst(0, 0), d);
+        } else {
+            d = gind();
+            gexpr();
+            skip(')');
+            a = gvtst(1, 0);
+            b = 0;
+            lblock(&a, &b);
+            gjmp_addr(d);
+            gsym_addr(b, d);
+        }
         gsym(a);
 
     } else if (t == '{') {
@@ -7071,9 +9500,15 @@ again:
         else if (!nocode_wanted)
             check_func_return();
 
+    } else if (t == TOK_RETURN && cur_inline && !cur_inline->tail) {
+        inline_return(0);
+
     } else if (t == TOK_RETURN) {
         b = (func_vt.t & VT_BTYPE) != VT_VOID;
         if (tok != ';') {
+#ifdef CONFIG_SWIRL_TAILCALL
+            in_return = 1;
+#endif
             gexpr();
             if (b) {
                 gen_assign_cast(&func_vt);
@@ -7090,9 +9525,11 @@ again:
         if (b)
             gfunc_return(&func_vt);
         skip(';');
-        /* jump unless last stmt in top-level block */
+        /* jump unless last stmt in top-level block, before the epilogue */
         if (tok != '}' || local_scope != 1)
             rsym = gjmp(rsym);
+        else if (cold_blocks)
+            cold_return();
         CODE_OFF();
 
     } else if (t == TOK_BREAK) {
@@ -7127,25 +9564,54 @@ again:
             }
         }
         skip(';');
+        if (loop_pattern_wanted())
+            loop_pattern();
         a = b = 0;
-        c = d = gind();
-        if (tok != ';') {
-            gexpr();
-            a = gvtst(1, 0);
-        }
-        skip(';');
-        if (tok != ')') {
-            e = gjmp(0);
+        if (loop_rotate_wanted()) {
+            /* goto e; d: body; b: step; e: if (cond) goto d; a: */
+            TokenString *cond = NULL, *step = NULL;
+            c = 1;
+            if (tok != ';')
+                cond = loop_save_expr(&c);
+            skip(';');
+            if (tok != ')')
+                step = loop_save_expr(&e);
+            skip(')');
+            e = c ? 0 : gjmp(0);
             d = gind();
-            gexpr();
-            vpop();
-            gjmp_addr(c);
+            lblock(&a, &b);
+            gsym(b);
+            if (step) {
+                loop_expr(step, ')');
+                vpop();
+            }
             gsym(e);
+            if (cond) {
+                loop_expr(cond, ';');
+                gsym_addr(gvtst(0, 0), d);
+            } else {
+                gjmp_addr(d);
+            }
+        } else {
+            c = d = gind();
+            if (tok != ';') {
+                gexpr();
+                a = gvtst(1, 0);
+            }
+            skip(';');
+            if (tok != ')') {
+                e = gjmp(0);
+                d = gind();
+                gexpr();
+                vpop();
+                gjmp_addr(c);
+                gsym(e);
+            }
+            skip(')');
+            lblock(&a, &b);
+            gjmp_addr(d);
+            gsym_addr(b, d);
         }
-        skip(')');
-        lblock(&a, &b);
-        gjmp_addr(d);
-        gsym_addr(b, d);
         gsym(a);
         prev_scope(&o, 0);
 
@@ -7277,6 +9743,7 @@ again:
         skip(';');
 
     } else if (t == TOK_ASM1 || t == TOK_ASM2 || t == TOK_ASM3) {
+        func_asm = 1;
         asm_instr();
 
     } else {
@@ -7337,8 +9804,11 @@ static void skip_or_save_block(TokenString **str)
 {
     int braces = tok == '{';
     int level = 0;
-    if (str)
+    if (str) {
       *str = tok_str_alloc();
+      if (braces)
+        pp_pragma_str = *str;
+    }
 
     while ((level > 0 || (tok != '}' && tok != ',' && tok != ';' && tok != ')'))) {
 	int t;
@@ -7351,6 +9821,8 @@ static void skip_or_save_block(TokenString **str)
 	if (str)
 	  tok_str_add_tok(*str);
 	t = tok;
+	if (t == '}' && level == 1)
+	  pp_pragma_str = NULL; /* not for what follows the block */
 	next();
 	if (t == '{' || t == '(') {
 	    level++;
@@ -7414,6 +9886,13 @@ static void init_putz(init_params *p, unsigned long c, int size)
     if (p->sec) {
         /* nothing to do because globals are already set to zero */
     } else {
+#ifdef CONFIG_SWIRL_STRUCT_COPY
+        if (size <= CONFIG_SWIRL_STRUCT_COPY) {
+            vset(&char_pointer_type, VT_LOCAL, c);
+            gen_struct_zero(size);
+            return;
+        }
+#endif
         vpush_helper_func(TOK_memset);
         vseti(VT_LOCAL, c);
 #ifdef SWIRL_TARGET_ARM
@@ -8130,6 +10609,12 @@ static void decl_initializer_alloc(CType *type, AttributeDef *ad, int r,
 	    }
 
             sym->a = ad->a;
+#ifdef CONFIG_SWIRL_REGVARS
+            /* regvar_scan() did not see the bodies of inlined calls,
+               and statements moved to the end keep to the stack */
+            if (func_regvars && !cur_inline && !cold_replay)
+                regvar_alloc(sym, ad, 0);
+#endif
         } else {
             /* push local reference */
             vset(type, r, addr);
@@ -8149,7 +10634,9 @@ static void decl_initializer_alloc(CType *type, AttributeDef *ad, int r,
         /* allocate symbol in corresponding section */
         sec = ad->section;
         if (!sec) {
-            if (type->t & VT_CONSTANT)
+            if (type->t & VT_TLS)
+                sec = tls_section(swirl_state, !has_init);
+            else if (type->t & VT_CONSTANT)
 		sec = data_ro_section;
             else if (has_init)
 		sec = data_section;
@@ -8186,7 +10673,7 @@ static void decl_initializer_alloc(CType *type, AttributeDef *ad, int r,
 #ifdef CONFIG_SWIRL_BCHECK
         /* handles bounds now because the symbol must be defined
            before for the relocation */
-        if (bcheck) {
+        if (bcheck && !(type->t & VT_TLS)) {
             addr_t *bounds_ptr;
 
             greloca(bounds_section, sym, bounds_section->data_offset, R_DATA_PTR, 0);
@@ -8213,6 +10700,9 @@ static void decl_initializer_alloc(CType *type, AttributeDef *ad, int r,
 
         vla_runtime_type_size(type, &a);
         gen_vla_alloc(type, a);
+#ifdef CONFIG_SWIRL_TAILCALL
+        func_addr_taken = 1;
+#endif
 #if defined SWIRL_TARGET_PE && defined SWIRL_TARGET_X86_64
         /* on _WIN64, because of the function args scratch area, the
            result of alloca differs from RSP and is returned in RAX.  */
@@ -8242,6 +10732,138 @@ static void decl_initializer_alloc(CType *type, AttributeDef *ad, int r,
 
 /* parse a function defined by symbol 'sym' and generate its code in
    'cur_text_section' */
+#ifdef CONFIG_SWIRL_REGVARS
+/* whether the scalar locals of 'sym' may be kept in registers (-O) */
+static int regvar_wanted(Sym *sym)
+{
+    return swirl_state->optimize
+        && !swirl_state->do_debug
+        && !swirl_state->do_bounds_check
+        && sym->type.ref->f.func_type != FUNC_ELLIPSIS;
+}
+
+/* look through the saved body of 'sym' for what rules that out */
+static void regvar_scan(Sym *sym, TokenString *str)
+{
+    const int *p;
+    CValue cv;
+    int t, amp, v, loops;
+
+    func_regvars = 0;
+    regvar_nb_excl = 0;
+    if (!regvar_wanted(sym))
+        return;
+    amp = v = loops = 0;
+    for (p = str->str; (t = tok_str_get(&p, &cv)) != TOK_EOF;) {
+        if (t == TOK_LINENUM)
+            continue;
+        if (v && t != TOK_ARROW && t != '[') {
+            if ((regvar_nb_excl & 15) == 0)
+                regvar_excl = swirl_realloc(regvar_excl,
+                    (regvar_nb_excl + 16) * sizeof *regvar_excl);
+            regvar_excl[regvar_nb_excl++] = v;
+        }
+        v = 0;
+        if (t == TOK_ASM1 || t == TOK_ASM2 || t == TOK_ASM3)
+            return;
+        if (t == TOK_FOR || t == TOK_WHILE || t == TOK_GOTO)
+            loops = 1;
+        if (t >= TOK_IDENT) {
+            /* values in registers do not survive longjmp */
+            if (strstr(table_ident[t - TOK_IDENT]->str, "setjmp"))
+                return;
+            if (amp)
+                v = t;
+        }
+        amp = t == '&' || (amp && t == '(');
+    }
+    /* without loops, the saves cost more than they gain */
+    func_regvars = loops;
+}
+
+/* try to keep local 'sym' in a register */
+static void regvar_alloc(Sym *sym, AttributeDef *ad, int is_param)
+{
+    int i, t = sym->type.t;
+
+    if (sym->r != (VT_LOCAL | VT_LVAL)
+        || (t & (VT_ARRAY | VT_VLA | VT_VOLATILE | VT_ATOMIC | VT_BITFIELD))
+        || !(is_integer_btype(t & VT_BTYPE) || (t & VT_BTYPE) == VT_PTR)
+        || (ad && ad->cleanup_func))
+        return;
+    for (i = 0; i < regvar_nb_excl; i++)
+        if (regvar_excl[i] == (sym->v & ~SYM_FIELD))
+            return;
+    if (gen_regvar(sym->c, is_param))
+        sym->a.regvar = 1;
+}
+#endif
+
+#ifdef CONFIG_SWIRL_NOFRAME
+/* whether 'sym' might do without a frame (-fomit-frame-pointer) */
+static int noframe_wanted(Sym *sym)
+{
+    return swirl_state->omit_frame_pointer
+        && !swirl_state->do_debug
+        && !swirl_state->do_backtrace
+        && !swirl_state->do_bounds_check
+        && sym->type.ref->f.func_type != FUNC_ELLIPSIS;
+}
+
+/* a leaf function has no calls in its saved body.  The backend
+   still drops the frame only if it sees none in the code either. */
+static void noframe_scan(Sym *sym, TokenString *str)
+{
+    const int *p;
+    CValue cv;
+    int t, prev = 0;
+
+    func_noframe = 0;
+    if (!noframe_wanted(sym))
+        return;
+    for (p = str->str; (t = tok_str_get(&p, &cv)) != TOK_EOF;) {
+        if (t == TOK_LINENUM)
+            continue;
+        if (t == TOK_ASM1 || t == TOK_ASM2 || t == TOK_ASM3
+            || t == TOK_builtin_frame_address
+            || t == TOK_builtin_return_address)
+            return;
+        if (t == '(' && prev >= TOK_UIDENT
+            && (prev < TOK_builtin_types_compatible_p
+                || prev > TOK___sync_synchronize))
+            return;
+        prev = t;
+    }
+    func_noframe = 1;
+}
+#endif
+
+#if defined CONFIG_SWIRL_REGVARS || defined CONFIG_SWIRL_NOFRAME
+/* whether to look at the body of 'sym' before generating its code */
+static int body_scan_wanted(Sym *sym)
+{
+#ifdef CONFIG_SWIRL_REGVARS
+    if (regvar_wanted(sym))
+        return 1;
+#endif
+#ifdef CONFIG_SWIRL_NOFRAME
+    if (noframe_wanted(sym))
+        return 1;
+#endif
+    return 0;
+}
+
+static void body_scan(Sym *sym, TokenString *str)
+{
+#ifdef CONFIG_SWIRL_REGVARS
+    regvar_scan(sym, str);
+#endif
+#ifdef CONFIG_SWIRL_NOFRAME
+    noframe_scan(sym, str);
+#endif
+}
+#endif
+
 static void gen_function(Sym *sym)
 {
     struct scope f = { 0 };
@@ -8262,6 +10884,7 @@ static void gen_function(Sym *sym)
 
     funcname = get_tok_str(sym->v, NULL);
     func_ind = ind;
+    func_asm = 0;
     func_vt = sym->type.ref->type;
     func_var = sym->type.ref->f.func_type == FUNC_ELLIPSIS;
 
@@ -8270,16 +10893,38 @@ static void gen_function(Sym *sym)
     /* push a dummy symbol to enable local sym storage */
     sym_push2(&local_stack, SYM_FIELD, 0, 0);
     local_scope = 1; /* for function parameters */
+#ifdef CONFIG_SWIRL_TAILCALL
+    func_addr_taken = 0;
+#endif
     gfunc_prolog(sym);
+#ifdef CONFIG_SWIRL_REGVARS
+    if (func_regvars) {
+        Sym *s;
+        for (s = local_stack; s && s->v != SYM_FIELD; s = s->prev)
+            regvar_alloc(s, NULL, 1);
+    }
+#endif
     local_scope = 0;
     rsym = 0;
     clear_temp_local_var_list();
     block(0);
+    if (cold_blocks) {
+        cold_return();
+        cold_flush();
+    }
     gsym(rsym);
     nocode_wanted = 0;
     /* reset local stack */
     pop_local_syms(&local_stack, NULL, 0, func_var);
+#ifdef CONFIG_SWIRL_TAILCALL
+    /* asm operands may be addresses of locals */
+    func_addr_taken |= func_asm;
+#endif
     gfunc_epilog();
+#ifdef CONFIG_SWIRL_PEEPHOLE
+    if (!func_asm)
+        ind = gen_peephole(func_ind, ind, swirl_state->optimize);
+#endif
     cur_text_section->data_offset = ind;
     local_scope = 0;
     label_pop(&global_label_stack, NULL, 0);
@@ -8293,6 +10938,10 @@ static void gen_function(Sym *sym)
     funcname = ""; /* for safety */
     func_vt.t = VT_VOID; /* for safety */
     func_var = 0; /* for safety */
+    func_regvars = 0;
+#ifdef CONFIG_SWIRL_NOFRAME
+    func_noframe = 0;
+#endif
     ind = 0; /* for safety */
     nocode_wanted = 0x80000000;
     check_vstack();
@@ -8300,6 +10949,20 @@ static void gen_function(Sym *sym)
     next();
 }
 
+/* where the code of 'sym' goes without a section attribute: with -O,
+   cold functions are kept apart from the others */
+static Section *func_text_section(Sym *sym)
+{
+#if !defined SWIRL_TARGET_PE && !defined SWIRL_TARGET_MACHO
+    if (sym->type.ref->f.func_cold && swirl_state->optimize) {
+        Section *sec = find_section(swirl_state, ".text.unlikely");
+        sec->sh_flags |= SHF_EXECINSTR;
+        return sec;
+    }
+#endif
+    return text_section;
+}
+
 static void gen_inline_functions(SwirlState *s)
 {
     Sym *sym;
@@ -8313,14 +10976,17 @@ static void gen_inline_functions(SwirlState *s)
         for (i = 0; i < s->nb_inline_fns; ++i) {
             fn = s->inline_fns[i];
             sym = fn->sym;
-            if (sym && (sym->c || !(sym->type.t & VT_INLINE))) {
+            if (sym && !fn->done && (sym->c || !(sym->type.t & VT_INLINE))) {
                 /* the function was used or forced (and then not internal):
                    generate its code and convert it to a normal function */
                 fn->sym = NULL;
                 swirl_debug_putfile(s, fn->filename);
+#if defined CONFIG_SWIRL_REGVARS || defined CONFIG_SWIRL_NOFRAME
+                body_scan(sym, fn->func_str);
+#endif
                 begin_macro(fn->func_str, 1);
                 next();
-                cur_text_section = text_section;
+                cur_text_section = func_text_section(sym);
                 gen_function(sym);
                 end_macro();
 
@@ -8519,14 +11185,36 @@ static int decl0(int l, int is_for_loop_init, Sym *func_sym)
                     fn = swirl_malloc(sizeof *fn + strlen(file->filename));
                     strcpy(fn->filename, file->filename);
                     fn->sym = sym;
+                    fn->expanded = fn->done = 0;
 		    skip_or_save_block(&fn->func_str);
                     dynarray_add(&swirl_state->inline_fns,
 				 &swirl_state->nb_inline_fns, fn);
+                    sym->type.ref->f.func_inl = 1;
                 } else {
                     /* compute text section */
                     cur_text_section = ad.section;
                     if (!cur_text_section)
-                        cur_text_section = text_section;
+                        cur_text_section = func_text_section(sym);
+                    if (inline_wanted(sym)
+#if defined CONFIG_SWIRL_REGVARS || defined CONFIG_SWIRL_NOFRAME
+                        || body_scan_wanted(sym)
+#endif
+                        ) {
+                        /* look at the body before generating code */
+                        TokenString *str;
+                        skip_or_save_block(&str);
+#if defined CONFIG_SWIRL_REGVARS || defined CONFIG_SWIRL_NOFRAME
+                        body_scan(sym, str);
+#endif
+                        unget_tok(0);
+                        begin_macro(str, 0);
+                        next();
+                        gen_function(sym);
+                        end_macro();
+                        next();
+                        inline_keep(sym, str);
+                        break;
+                    }
                     gen_function(sym);
                 }
                 break;
@@ -8569,6 +11257,16 @@ found:
 		    swirl_error("declaration of void object");
                 } else {
                     r = 0;
+                    if (type.t & VT_TLS) {
+                        if ((type.t & VT_BTYPE) == VT_FUNC
+                            || (l == VT_LOCAL
+                                && !(type.t & (VT_STATIC | VT_EXTERN))))
+                            swirl_error("'%s' cannot be thread-local",
+                                        get_tok_str(v, NULL));
+#ifndef CONFIG_SWIRL_THREAD_LOCAL
+                        swirl_error("thread-local storage not supported for this target");
+#endif
+                    }
                     if ((type.t & VT_BTYPE) == VT_FUNC) {
                         /* external function definition */
                         /* specific case for func_call attribute */
@@ -8635,6 +11333,220 @@ static void decl(int l)
     decl0(l, 0, NULL);
 }
 
+/* ------------------------------------------------------------------------- */
+/* precompiled headers: the global symbols (see also swirlpp.c) */
+
+/* Each symbol is saved as 9 ints, pointers to other symbols are saved
+   as their position (1..n) on the global stack */
+#define PCH_SYM_INTS 9
+
+struct pch_sym { Sym *sym; int i; };
+
+static int pch_sym_cmp(const void *a, const void *b)
+{
+    const Sym *x = ((const struct pch_sym *)a)->sym;
+    const Sym *y = ((const struct pch_sym *)b)->sym;
+    return x < y ? -1 : x > y;
+}
+
+static int pch_sym_index(struct pch_sym *tab, int n, Sym *s)
+{
+    struct pch_sym key, *e;
+    if (!s)
+        return 0;
+    key.sym = s;
+    e = bsearch(&key, tab, n, sizeof *tab, pch_sym_cmp);
+    /* type.ref of scalar types may be stale, these don't matter */
+    return e ? e->i : 0;
+}
+
+/* 'next' is the asm label of external symbols */
+static int pch_sym_has_next(Sym *s)
+{
+    return s->v >= SYM_FIRST_ANOM || IS_ENUM_VAL(s->type.t);
+}
+
+ST_FUNC void pch_save_syms(SwirlState *s1, CString *cs)
+{
+    struct pch_sym *tab;
+    Sym *s, **stk;
+    TokenSym *ts;
+    InlineFunc *fn;
+    int n, i, a, len, o;
+    int u[2];
+
+    /* symbols with code or data would need their sections, too */
+    for (i = 1; i < s1->nb_sections; i++)
+        if ((s1->sections[i]->sh_flags & SHF_ALLOC)
+            && s1->sections[i]->data_offset)
+            swirl_error("cannot precompile a header with code or data");
+
+    for (n = 0, s = global_stack; s; s = s->prev)
+        n++;
+    stk = swirl_malloc(n * sizeof *stk);
+    tab = swirl_malloc(n * sizeof *tab);
+    for (i = n, s = global_stack; s; s = s->prev)
+        stk[--i] = s;
+    for (i = 0; i < n; i++)
+        tab[i].sym = stk[i], tab[i].i = i + 1;
+    qsort(tab, n, sizeof *tab, pch_sym_cmp);
+
+    pch_put(cs, anon_sym);
+    pch_put(cs, n);
+    for (i = 0; i < n; i++) {
+        s = stk[i];
+        if (s->v < SYM_FIRST_ANOM && (s->r & VT_SYM) && s->c)
+            swirl_error("cannot precompile a header with code or data ('%s')",
+                get_tok_str(s->v, NULL));
+        a = 0;
+        memcpy(&a, &s->a, sizeof s->a);
+        memcpy(u, &s->enum_val, sizeof u);
+        pch_put(cs, s->v);
+        pch_put(cs, s->r);
+        pch_put(cs, a);
+        pch_put(cs, u[0]);
+        pch_put(cs, u[1]);
+        pch_put(cs, s->type.t);
+        pch_put(cs, pch_sym_index(tab, n, s->type.ref));
+        pch_put(cs, pch_sym_has_next(s)
+            ? pch_sym_index(tab, n, s->next) : s->asm_label);
+        pch_put(cs, pch_sym_index(tab, n, s->prev_tok));
+    }
+
+    /* identifiers and structs visible by name */
+    o = cs->size;
+    pch_put(cs, 0);
+    for (i = 0; i < tok_ident - TOK_IDENT; i++) {
+        ts = table_ident[i];
+        if (ts->sym_identifier || ts->sym_struct) {
+            pch_put(cs, i);
+            pch_put(cs, pch_sym_index(tab, n, ts->sym_identifier));
+            pch_put(cs, pch_sym_index(tab, n, ts->sym_struct));
+            ((int *)(cs->data + o))[0]++;
+        }
+    }
+
+    /* unused inline functions */
+    o = cs->size;
+    pch_put(cs, 0);
+    for (i = 0; i < s1->nb_inline_fns; i++) {
+        fn = s1->inline_fns[i];
+        if (!fn->sym || fn->done)
+            continue;
+        pch_put(cs, pch_sym_index(tab, n, fn->sym));
+        pch_put(cs, fn->func_str->len);
+        cstr_cat(cs, (char *)fn->func_str->str, fn->func_str->len * sizeof(int));
+        len = strlen(fn->filename) + 1;
+        pch_put(cs, len);
+        cstr_cat(cs, fn->filename, len);
+        while (cs->size & 3)
+            cstr_ccat(cs, 0);
+        ((int *)(cs->data + o))[0]++;
+    }
+    swirl_free(tab);
+    swirl_free(stk);
+}
+
+/* whether 'i' may index the n + 1 entries of the symbol table */
+#define PCH_SYM_OK(i, n) ((unsigned)(i) <= (unsigned)(n))
+
+/* NULL if what follows 'p' up to 'end' is not valid */
+ST_FUNC const int *pch_load_syms(SwirlState *s1, const int *p, const int *end)
+{
+    Sym *s, **tab;
+    TokenSym *ts;
+    InlineFunc *fn;
+    int n, k, i, v, len, flen;
+
+    if (end - p < 2)
+        return NULL;
+    anon_sym = *p++;
+    n = *p++;
+    /* the symbols from swirlgen_init() are there already */
+    for (k = 0, s = global_stack; s; s = s->prev)
+        k++;
+    if (anon_sym < SYM_FIRST_ANOM || n < k || n > (end - p) / PCH_SYM_INTS)
+        return NULL;
+    tab = swirl_malloc((n + 1) * sizeof *tab);
+    tab[0] = NULL;
+    for (i = k, s = global_stack; s; s = s->prev)
+        tab[i--] = s;
+    /* not in the token table until filled, also when the file is bad */
+    for (i = k + 1; i <= n; i++)
+        tab[i] = sym_push2(&global_stack, SYM_FIELD, 0, 0);
+
+    p += k * PCH_SYM_INTS;
+    for (i = k + 1; i <= n; i++, p += PCH_SYM_INTS) {
+        s = tab[i];
+        /* what sym_pop() looks up in the token table */
+        v = p[0] & SYM_FIELD ? TOK_IDENT : p[0] & ~SYM_STRUCT;
+        if (v < TOK_IDENT || (v >= tok_ident && v < SYM_FIRST_ANOM)
+            || !PCH_SYM_OK(p[6], n) || !PCH_SYM_OK(p[8], n))
+            goto bad;
+        s->v = p[0];
+        s->r = p[1];
+        memcpy(&s->a, &p[2], sizeof s->a);
+        memcpy(&s->enum_val, &p[3], sizeof s->enum_val);
+        s->type.t = p[5];
+        s->type.ref = tab[p[6]];
+        if (pch_sym_has_next(s)) {
+            if (!PCH_SYM_OK(p[7], n))
+                goto bad;
+            s->next = tab[p[7]];
+        } else {
+            if ((unsigned)p[7] >= (unsigned)tok_ident)
+                goto bad;
+            s->asm_label = p[7];
+        }
+        s->prev_tok = tab[p[8]];
+    }
+
+    if (p == end)
+        goto bad;
+    i = *p++;
+    if (i < 0 || i > (end - p) / 3)
+        goto bad;
+    for (; i > 0; i--, p += 3) {
+        if ((unsigned)p[0] >= (unsigned)(tok_ident - TOK_IDENT)
+            || !PCH_SYM_OK(p[1], n) || !PCH_SYM_OK(p[2], n))
+            goto bad;
+        ts = table_ident[p[0]];
+        ts->sym_identifier = tab[p[1]];
+        ts->sym_struct = tab[p[2]];
+    }
+
+    if (p == end)
+        goto bad;
+    for (i = *p++; i > 0; i--) {
+        if (end - p < 3)
+            goto bad;
+        len = p[1];
+        if (p[0] < 1 || p[0] > n || len < 1 || len > end - p - 3
+            || !pch_check_toks(p + 2, len))
+            goto bad;
+        flen = p[len + 2];
+        if (flen < 1 || (flen - 1) / 4 >= end - p - len - 3
+            || ((const char *)(p + len + 3))[flen - 1])
+            goto bad;
+        fn = swirl_malloc(sizeof *fn + flen);
+        fn->sym = tab[p[0]];
+        fn->expanded = fn->done = 0;
+        fn->func_str = tok_str_alloc();
+        tok_str_realloc(fn->func_str, len);
+        memcpy(fn->func_str->str, p + 2, len * sizeof(int));
+        fn->func_str->len = len;
+        p += len + 2;
+        memcpy(fn->filename, p + 1, p[0]);
+        p += 1 + (p[0] + 3) / 4;
+        dynarray_add(&s1->inline_fns, &s1->nb_inline_fns, fn);
+    }
+    swirl_free(tab);
+    return p;
+bad:
+    swirl_free(tab);
+    return NULL;
+}
+
 /* ------------------------------------------------------------------------- */
 #undef gjmp_addr
 #undef gjmp
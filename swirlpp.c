@@ -16,29 +16,48 @@ ST_DATA int ch, tok;
 ST_DATA CValue tokc;
 ST_DATA const int *macro_ptr;
 ST_DATA CString tokcstr; /* current parsed string, if any */
+ST_DATA TokenString *pp_pragma_str;
 
 /* display benchmark infos */
 ST_DATA int tok_ident;
 ST_DATA TokenSym **table_ident;
+ST_DATA unsigned pp_cache_hits, pp_cache_misses;
+ST_DATA unsigned tok_hash_size, tok_hash_lookups, tok_hash_probes;
 
 /* ------------------------------------------------------------------------- */
 
-static TokenSym *hash_ident[TOK_HASH_SIZE];
-static char token_buf[STRING_MAX_SIZE + 1];
-static CString cstr_buf;
-static CString macro_equal_buf;
-static TokenString tokstr_buf;
-static unsigned char isidnum_table[256 - CH_EOF];
-static int pp_debug_tok, pp_debug_symv;
-static int pp_once;
-static int pp_expr;
-static int pp_counter;
+static ST_TLS TokenSym **hash_ident;
+static ST_TLS unsigned hash_ident_mask;
+static ST_TLS char token_buf[STRING_MAX_SIZE + 1];
+static ST_TLS CString cstr_buf;
+static ST_TLS CString macro_equal_buf;
+static ST_TLS TokenString tokstr_buf;
+static ST_TLS unsigned char isidnum_table[256 - CH_EOF];
+static ST_TLS int pp_debug_tok, pp_debug_symv;
+static ST_TLS int pp_once;
+static ST_TLS int pp_expr;
+static ST_TLS int pp_counter;
+static ST_TLS int pp_hashing;
+static ST_TLS int pp_bench;
+static ST_TLS unsigned pp_defs_hash;
 static void tok_print(const char *msg, const int *str);
-
-static struct TinyAlloc *toksym_alloc;
-static struct TinyAlloc *tokstr_alloc;
-
-static TokenString *macro_stack;
+static int pch_mapped(const int *p);
+static void pch_unmap(void);
+static unsigned pch_hash(const char *p, int n);
+/* records in the include cache besides tokens, see tc_lex() */
+#define TC_COMMENT 1
+#define TC_RAW     2
+#define TC_SPACES  3
+#define TC_DIR     4
+static void tc_next(void);
+static void tc_skip(void);
+static int tc_raw(char *buf, int size);
+static int tc_open(SwirlState *s1, const char *filename);
+
+static ST_TLS struct TinyAlloc *toksym_alloc;
+static ST_TLS struct TinyAlloc *tokstr_alloc;
+
+static ST_TLS TokenString *macro_stack;
 
 static const char swirl_keywords[] = 
 #define DEF(id, str) str "\0"
@@ -437,10 +456,48 @@ static void add_char(CString *cstr, int c)
 }
 
 /* ------------------------------------------------------------------------- */
+/* hash 'len' bytes of 'str', 8 at a time */
+static inline unsigned tok_hash(const char *str, int len)
+{
+    uint64_t h, w;
+    int i;
+
+    h = len;
+    for (; len >= 8; str += 8, len -= 8) {
+        memcpy(&w, str, 8);
+        h = (h ^ w) * 0x9e3779b97f4a7c15ull;
+        h ^= h >> 32;
+    }
+    for (w = 0, i = 0; i < len; i++)
+        w |= (uint64_t)(unsigned char)str[i] << i * 8;
+    h = (h ^ w) * 0x9e3779b97f4a7c15ull;
+    h ^= h >> 29;
+    h *= 0xbf58476d1ce4e5b9ull;
+    return (unsigned)(h ^ h >> 32);
+}
+
+/* double the number of buckets of hash_ident */
+static void tok_hash_grow(void)
+{
+    TokenSym *ts, **pts;
+    int i;
+
+    hash_ident_mask = hash_ident_mask * 2 + 1;
+    swirl_free(hash_ident);
+    hash_ident = swirl_mallocz((hash_ident_mask + 1) * sizeof(TokenSym *));
+    /* backwards, so that the chains keep their order */
+    for (i = tok_ident - TOK_IDENT; --i >= 0;) {
+        ts = table_ident[i];
+        pts = &hash_ident[ts->hash & hash_ident_mask];
+        ts->hash_next = *pts;
+        *pts = ts;
+    }
+}
+
 /* allocate a new token */
-static TokenSym *tok_alloc_new(TokenSym **pts, const char *str, int len)
+static TokenSym *tok_alloc_new(unsigned h, const char *str, int len)
 {
-    TokenSym *ts, **ptable;
+    TokenSym *ts, **ptable, **pts;
     int i;
 
     if (tok_ident >= SYM_FIRST_ANOM) 
@@ -452,6 +509,9 @@ static TokenSym *tok_alloc_new(TokenSym **pts, const char *str, int len)
         ptable = swirl_realloc(table_ident, (i + TOK_ALLOC_INCR) * sizeof(TokenSym *));
         table_ident = ptable;
     }
+    /* keep the load factor at most 1 */
+    if (i > hash_ident_mask)
+        tok_hash_grow();
 
     ts = tal_realloc(toksym_alloc, 0, sizeof(TokenSym) + len);
     table_ident[i] = ts;
@@ -460,10 +520,12 @@ static TokenSym *tok_alloc_new(TokenSym **pts, const char *str, int len)
     ts->sym_label = NULL;
     ts->sym_struct = NULL;
     ts->sym_identifier = NULL;
+    ts->hash = h;
     ts->len = len;
-    ts->hash_next = NULL;
     memcpy(ts->str, str, len);
     ts->str[len] = '\0';
+    pts = &hash_ident[h & hash_ident_mask];
+    ts->hash_next = *pts;
     *pts = ts;
     return ts;
 }
@@ -471,29 +533,20 @@ static TokenSym *tok_alloc_new(TokenSym **pts, const char *str, int len)
 #define TOK_HASH_INIT 1
 #define TOK_HASH_FUNC(h, c) ((h) + ((h) << 5) + ((h) >> 27) + (c))
 
-
 /* find a token and add it if not found */
 ST_FUNC TokenSym *tok_alloc(const char *str, int len)
 {
-    TokenSym *ts, **pts;
-    int i;
-    unsigned int h;
-    
-    h = TOK_HASH_INIT;
-    for(i=0;i<len;i++)
-        h = TOK_HASH_FUNC(h, ((unsigned char *)str)[i]);
-    h &= (TOK_HASH_SIZE - 1);
+    TokenSym *ts;
+    unsigned h;
 
-    pts = &hash_ident[h];
-    for(;;) {
-        ts = *pts;
-        if (!ts)
-            break;
-        if (ts->len == len && !memcmp(ts->str, str, len))
+    h = tok_hash(str, len);
+    ++tok_hash_lookups;
+    for (ts = hash_ident[h & hash_ident_mask]; ts; ts = ts->hash_next) {
+        ++tok_hash_probes;
+        if (ts->hash == h && ts->len == len && !memcmp(ts->str, str, len))
             return ts;
-        pts = &(ts->hash_next);
     }
-    return tok_alloc_new(pts, str, len);
+    return tok_alloc_new(h, str, len);
 }
 
 ST_FUNC int tok_alloc_const(const char *str)
@@ -744,6 +797,52 @@ static void minp(void)
         handle_stray();
 }
 
+/* Return the first byte at or after 'p' that is one of c0..c5, 16 bytes
+   at a time with SSE2 or NEON.  Count the '\n' skipped if 'lines' is
+   given.  The loads are aligned and may read up to 15 bytes past the
+   CH_EOB: buffers have IO_BUF_PAD bytes more for that, and mapped files
+   are followed by the rest of their last page. */
+#if defined __GNUC__ && (defined __SSE2__ || defined __ARM_NEON) \
+    && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define LEX_SIMD
+typedef unsigned char lexv_t __attribute__((vector_size(16)));
+typedef unsigned long long lexw_t __attribute__((vector_size(16)));
+/* the number of 0xff bytes in 'l' */
+#define LEX_COUNT(l) \
+    (int)(((l) & 0x0101010101010101ull) * 0x0101010101010101ull >> 56)
+
+static inline uint8_t *lex_scan(uint8_t *p, int c0, int c1, int c2,
+                                int c3, int c4, int c5, int *lines)
+{
+    int i, n = ((size_t)p & 15) * 8;
+    unsigned long long m, l;
+    lexv_t v;
+    lexw_t w, x;
+
+    p -= n / 8;
+    for (;; p += 16) {
+        v = *(lexv_t *)p;
+        w = (lexw_t)((v == (uint8_t)c0) | (v == (uint8_t)c1)
+                   | (v == (uint8_t)c2) | (v == (uint8_t)c3)
+                   | (v == (uint8_t)c4) | (v == (uint8_t)c5));
+        x = (lexw_t)(v == '\n');
+        for (i = 0; i < 2; i++, n = n < 64 ? 0 : n - 64) {
+            if (n >= 64)
+                continue;
+            m = w[i] >> n << n;
+            l = x[i] >> n << n;
+            if (m) {
+                if (lines)
+                    *lines += LEX_COUNT(l & ((m & -m) - 1));
+                return p + i * 8 + __builtin_ctzll(m) / 8;
+            }
+            if (lines)
+                *lines += LEX_COUNT(l);
+        }
+    }
+}
+#endif
+
 /* single line C++ comments */
 static uint8_t *parse_line_comment(uint8_t *p)
 {
@@ -751,6 +850,9 @@ static uint8_t *parse_line_comment(uint8_t *p)
 
     p++;
     for(;;) {
+#ifdef LEX_SIMD
+        p = lex_scan(p, '\n', '\\', '\n', '\n', '\n', '\n', NULL);
+#endif
         c = *p;
     redo:
         if (c == '\n' || c == CH_EOF) {
@@ -789,6 +891,10 @@ static uint8_t *parse_comment(uint8_t *p)
     p++;
     for(;;) {
         /* fast skip loop */
+#ifdef LEX_SIMD
+        p = lex_scan(p, '*', '\\', '*', '*', '*', '*', &file->line_num);
+        c = *p;
+#else
         for(;;) {
             c = *p;
             if (c == '\n' || c == '*' || c == '\\')
@@ -799,6 +905,7 @@ static uint8_t *parse_comment(uint8_t *p)
                 break;
             p++;
         }
+#endif
         /* now we can handle all the cases */
         if (c == '\n') {
             file->line_num++;
@@ -888,8 +995,17 @@ static uint8_t *parse_pp_string(uint8_t *p,
                                 int sep, CString *str)
 {
     int c;
+#ifdef LEX_SIMD
+    uint8_t *q;
+#endif
     p++;
     for(;;) {
+#ifdef LEX_SIMD
+        q = lex_scan(p, sep, '\\', '\n', '\r', sep, sep, NULL);
+        if (str && q > p)
+            cstr_cat(str, (char *)p, q - p);
+        p = q;
+#endif
         c = *p;
         if (c == sep) {
             break;
@@ -953,6 +1069,10 @@ static void preprocess_skip(void)
     int a, start_of_line, c, in_warn_or_error;
     uint8_t *p;
 
+    if (file->tcp) {
+        tc_skip();
+        return;
+    }
     p = file->buf_ptr;
     a = 0;
 redo_start:
@@ -1034,7 +1154,11 @@ redo_start:
             break;
 _default:
         default:
+#ifdef LEX_SIMD
+            p = lex_scan(p + 1, '\n', '\\', '\"', '\'', '/', '#', NULL);
+#else
             p++;
+#endif
             break;
         }
         start_of_line = 0;
@@ -1328,6 +1452,14 @@ static inline void tok_get(int *t, const int **pp, CValue *cv)
     } while (0)
 #endif
 
+/* read one token from a saved token string, advancing *pp */
+ST_FUNC int tok_str_get(const int **pp, CValue *cv)
+{
+    int t;
+    TOK_GET(&t, pp, cv);
+    return t;
+}
+
 static int macro_is_equal(const int *a, const int *b)
 {
     CValue cv;
@@ -1385,7 +1517,8 @@ ST_FUNC void free_defines(Sym *b)
     while (define_stack != b) {
         Sym *top = define_stack;
         define_stack = top->prev;
-        tok_str_free_str(top->d);
+        if (!pch_mapped(top->d))
+            tok_str_free_str(top->d);
         define_undef(top);
         sym_free(top);
     }
@@ -1695,13 +1828,21 @@ static void pragma_parse(SwirlState *s1)
     } else if (tok == TOK_once) {
         search_cached_include(s1, file->filename, 1)->once = pp_once;
 
-    } else if (s1->output_type == SWIRL_OUTPUT_PREPROCESS) {
+    } else if (s1->output_type == SWIRL_OUTPUT_PREPROCESS || pp_hashing) {
         /* swirl -E: keep pragmas below unchanged */
         unget_tok(' ');
         unget_tok(TOK_PRAGMA);
         unget_tok('#');
         unget_tok(TOK_LINEFEED);
 
+    } else if (pp_pragma_str && (tok == TOK_pack || tok == TOK_comment)) {
+        /* in a function body that is saved: keep the pragma in
+           place so that it is applied when the body is parsed */
+        tok_str_add(pp_pragma_str, TOK_PPPRAGMA);
+        do
+            tok_str_add2(pp_pragma_str, tok, &tokc);
+        while (next(), tok != TOK_LINEFEED && tok != TOK_EOF);
+
     } else if (tok == TOK_pack) {
         /* This may be:
            #pragma pack(1) // set
@@ -1770,6 +1911,57 @@ pragma_err:
     return;
 }
 
+/* read "FILENAME" or <FILENAME> after #include up to the closing
+   char, which is returned.  Return 0 for a computed #include. */
+static int parse_include_name(char *buf, int size)
+{
+    int c;
+    char *q;
+
+    ch = file->buf_ptr[0];
+    /* XXX: incorrect if comments : use next_nomacro with a special mode */
+    skip_spaces();
+    if (ch == '<')
+        c = '>';
+    else if (ch == '\"')
+        c = ch;
+    else
+        return 0;
+    inp();
+    q = buf;
+    while (ch != c && ch != '\n' && ch != CH_EOF) {
+        if ((q - buf) < size - 1)
+            *q++ = ch;
+        if (ch == '\\') {
+            if (handle_stray_noerror() == 0)
+                --q;
+        } else
+            inp();
+    }
+    *q = '\0';
+    return c;
+}
+
+/* read the message of #error and #warning */
+static void parse_line_text(char *buf, int size)
+{
+    char *q;
+
+    ch = file->buf_ptr[0];
+    skip_spaces();
+    q = buf;
+    while (ch != '\n' && ch != CH_EOF) {
+        if ((q - buf) < size - 1)
+            *q++ = ch;
+        if (ch == '\\') {
+            if (handle_stray_noerror() == 0)
+                --q;
+        } else
+            inp();
+    }
+    *q = '\0';
+}
+
 /* is_bof is true if first non space token at beginning of file */
 ST_FUNC void preprocess(int is_bof)
 {
@@ -1806,35 +1998,11 @@ ST_FUNC void preprocess(int is_bof)
         break;
     case TOK_INCLUDE:
     case TOK_INCLUDE_NEXT:
-        ch = file->buf_ptr[0];
-        /* XXX: incorrect if comments : use next_nomacro with a special mode */
-        skip_spaces();
-        if (ch == '<') {
-            c = '>';
-            goto read_name;
-        } else if (ch == '\"') {
-            c = ch;
-        read_name:
-            inp();
-            q = buf;
-            while (ch != c && ch != '\n' && ch != CH_EOF) {
-                if ((q - buf) < sizeof(buf) - 1)
-                    *q++ = ch;
-                if (ch == '\\') {
-                    if (handle_stray_noerror() == 0)
-                        --q;
-                } else
-                    inp();
-            }
-            *q = '\0';
+        if (file->tcp)
+            c = tc_raw(buf, sizeof buf);
+        else if ((c = parse_include_name(buf, sizeof buf)))
             minp();
-#if 0
-            /* eat all spaces and comments after include */
-            /* XXX: slightly incorrect */
-            while (ch1 != '\n' && ch1 != CH_EOF)
-                inp();
-#endif
-        } else {
+        if (!c) {
 	    int len;
             /* computed #include : concatenate everything up to linefeed,
 	       the result must be one of the two accepted forms.
@@ -1900,7 +2068,7 @@ ST_FUNC void preprocess(int is_bof)
                 goto include_done;
             }
 
-            if (swirl_open(s1, buf1) < 0)
+            if (tc_open(s1, buf1) < 0)
                 continue;
             /* push previous file on stack */
             *s1->include_stack_ptr++ = file->prev;
@@ -2034,19 +2202,10 @@ include_done:
     case TOK_ERROR:
     case TOK_WARNING:
         c = tok;
-        ch = file->buf_ptr[0];
-        skip_spaces();
-        q = buf;
-        while (ch != '\n' && ch != CH_EOF) {
-            if ((q - buf) < sizeof(buf) - 1)
-                *q++ = ch;
-            if (ch == '\\') {
-                if (handle_stray_noerror() == 0)
-                    --q;
-            } else
-                inp();
-        }
-        *q = '\0';
+        if (file->tcp)
+            tc_raw(buf, sizeof buf);
+        else
+            parse_line_text(buf, sizeof buf);
         if (c == TOK_ERROR)
             swirl_error("#error %s", buf);
         else
@@ -2629,6 +2788,28 @@ static void parse_number(const char *p)
         }                                       \
         break;
 
+/* pop include file */
+static void end_include(SwirlState *s1)
+{
+    tok_flags &= ~TOK_FLAG_EOF;
+    /* test if previous '#endif' was after a #ifdef at
+       start of file */
+    if (tok_flags & TOK_FLAG_ENDIF) {
+#ifdef INC_DEBUG
+        printf("#endif %s\n", get_tok_str(file->ifndef_macro_saved, NULL));
+#endif
+        search_cached_include(s1, file->filename, 1)
+            ->ifndef_macro = file->ifndef_macro_saved;
+        tok_flags &= ~TOK_FLAG_ENDIF;
+    }
+
+    /* add end of include file debug info */
+    swirl_debug_eincl(swirl_state);
+    /* pop include stack */
+    swirl_close();
+    s1->include_stack_ptr--;
+}
+
 /* return next token without macro substitution */
 static inline void next_nomacro1(void)
 {
@@ -2679,27 +2860,13 @@ static inline void next_nomacro1(void)
                 /* no include left : end of file. */
                 tok = TOK_EOF;
             } else {
-                tok_flags &= ~TOK_FLAG_EOF;
-                /* pop include file */
-                
-                /* test if previous '#endif' was after a #ifdef at
-                   start of file */
-                if (tok_flags & TOK_FLAG_ENDIF) {
-#ifdef INC_DEBUG
-                    printf("#endif %s\n", get_tok_str(file->ifndef_macro_saved, NULL));
-#endif
-                    search_cached_include(s1, file->filename, 1)
-                        ->ifndef_macro = file->ifndef_macro_saved;
-                    tok_flags &= ~TOK_FLAG_ENDIF;
+                end_include(s1);
+                if (file->tcp) {
+                    tc_next();
+                    return;
                 }
-
-                /* add end of include file debug info */
-                swirl_debug_eincl(swirl_state);
-                /* pop include stack */
-                swirl_close();
-                s1->include_stack_ptr--;
                 p = file->buf_ptr;
-                if (p == file->buffer)
+                if (p == (file->map ? file->map : file->buffer))
                     tok_flags = TOK_FLAG_BOF|TOK_FLAG_BOL;
                 goto redo_no_start;
             }
@@ -2724,6 +2891,11 @@ maybe_newline:
             file->buf_ptr = p;
             preprocess(tok_flags & TOK_FLAG_BOF);
             p = file->buf_ptr;
+            if (file->tcp && !(parse_flags & PARSE_FLAG_LINEFEED)) {
+                /* #include of a cached file */
+                tc_next();
+                return;
+            }
             goto maybe_newline;
         } else {
             if (c == '#') {
@@ -2766,27 +2938,19 @@ maybe_newline:
     case '_':
     parse_ident_fast:
         p1 = p;
-        h = TOK_HASH_INIT;
-        h = TOK_HASH_FUNC(h, c);
         while (c = *++p, isidnum_table[c - CH_EOF] & (IS_ID|IS_NUM))
-            h = TOK_HASH_FUNC(h, c);
+            ;
         len = p - p1;
         if (c != '\\') {
-            TokenSym **pts;
-
-            /* fast case : no stray found, so we have the full token
-               and we have already hashed it */
-            h &= (TOK_HASH_SIZE - 1);
-            pts = &hash_ident[h];
-            for(;;) {
-                ts = *pts;
-                if (!ts)
-                    break;
-                if (ts->len == len && !memcmp(ts->str, p1, len))
+            /* fast case : no stray found, so we have the full token */
+            h = tok_hash((char *) p1, len);
+            ++tok_hash_lookups;
+            for (ts = hash_ident[h & hash_ident_mask]; ts; ts = ts->hash_next) {
+                ++tok_hash_probes;
+                if (ts->hash == h && ts->len == len && !memcmp(ts->str, p1, len))
                     goto token_found;
-                pts = &(ts->hash_next);
             }
-            ts = tok_alloc_new(pts, (char *) p1, len);
+            ts = tok_alloc_new(h, (char *) p1, len);
         token_found: ;
         } else {
             /* slower case */
@@ -3286,6 +3450,25 @@ static int next_argstream(Sym **nested_list, TokenString *ws_str)
                     sa->v = 0;
                 continue;
             }
+        } else if (file->tcp) {
+            /* see tc_next() */
+            p = file->tcp, t = CH_EOF;
+            while (p < file->tc_end) {
+                t = p[0];
+                if (!ws_str || !(t == ' ' || t == '\t' || t == TOK_LINEFEED
+                                 || t == TC_COMMENT || t == TC_SPACES))
+                    break;
+                file->line_num += p[1];
+                if (t == TC_SPACES) {
+                    p += 3, t = CH_EOF;
+                    continue;
+                }
+                if (t == TOK_LINEFEED)
+                    tok_flags |= TOK_FLAG_BOL;
+                tok_str_add(ws_str, t == TC_COMMENT ? ' ' : t);
+                p += 2, t = CH_EOF;
+            }
+            file->tcp = p;
         } else {
             ch = handle_eob();
             if (ws_str) {
@@ -3305,7 +3488,7 @@ static int next_argstream(Sym **nested_list, TokenString *ws_str)
                         ch = ' ';
                     }
                     if (ch == '\n')
-                        file->line_num++;
+                        file->line_num++, tok_flags |= TOK_FLAG_BOL;
                     if (!(ch == '\f' || ch == '\v' || ch == '\r'))
                         tok_str_add(ws_str, ch);
                     cinp();
@@ -3352,9 +3535,16 @@ static int macro_subst_tok(
     } else if (tok == TOK___DATE__ || tok == TOK___TIME__) {
         time_t ti;
         struct tm *tm;
+#ifndef _WIN32
+        struct tm tmbuf;
+#endif
 
         time(&ti);
-        tm = localtime(&ti);
+#ifdef _WIN32
+        tm = localtime(&ti); /* uses a per-thread buffer */
+#else
+        tm = localtime_r(&ti, &tmbuf);
+#endif
         if (tok == TOK___DATE__) {
             snprintf(buf, sizeof(buf), "%s %2d %d", 
                      ab_month_name[tm->tm_mon], tm->tm_mday, tm->tm_year + 1900);
@@ -3591,15 +3781,31 @@ static void next_nomacro(void)
             }
             tok = t;
         }
+    } else if (file->tcp) {
+        tc_next();
     } else {
         next_nomacro1();
     }
 }
 
+/* -bench: charge the tokens the parser reads to the preprocessor */
+static void next_bench(void)
+{
+    SwirlState *s1 = swirl_state;
+    int phase = swirl_bench(s1, BENCH_PP);
+    next();
+    swirl_bench(s1, phase);
+    ++total_tokens;
+}
+
 /* return next token with macro substitution */
 ST_FUNC void next(void)
 {
     int t;
+    if (pp_bench && swirl_state->bench_phase != BENCH_PP) {
+        next_bench();
+        return;
+    }
  redo:
     next_nomacro();
     t = tok;
@@ -3612,6 +3818,9 @@ ST_FUNC void next(void)
                 /* end of macro or unget token string */
                 end_macro();
                 goto redo;
+            } else if (t == TOK_PPPRAGMA) {
+                pragma_parse(swirl_state);
+                goto redo;
             } else if (t == '\\') {
                 if (!(parse_flags & PARSE_FLAG_ACCEPT_STRAYS))
                     swirl_error("stray '\\' in program");
@@ -3734,7 +3943,6 @@ static void swirl_predefs(SwirlState *s1, CString *cs, int is_asm)
 #endif
         , -1);
     }
-    cstr_printf(cs, "#define __BASE_FILE__ \"%s\"\n", file->filename);
 }
 
 ST_FUNC void preprocess_start(SwirlState *s1, int filetype)
@@ -3749,6 +3957,9 @@ ST_FUNC void preprocess_start(SwirlState *s1, int filetype)
     file->ifdef_stack_ptr = s1->ifdef_stack_ptr;
     pp_expr = 0;
     pp_counter = 0;
+    pp_hashing = 0;
+    pp_pragma_str = NULL;
+    pp_bench = s1->do_bench;
     pp_debug_tok = pp_debug_symv = 0;
     pp_once++;
     s1->pack_stack[0] = 0;
@@ -3762,6 +3973,12 @@ ST_FUNC void preprocess_start(SwirlState *s1, int filetype)
         swirl_predefs(s1, &cstr, is_asm);
         if (s1->cmdline_defs.size)
           cstr_cat(&cstr, s1->cmdline_defs.data, s1->cmdline_defs.size);
+        pp_defs_hash = pch_hash(cstr.data, cstr.size);
+        if (s1->pch_file && !is_asm) {
+            /* swirl_pch_load() restores these */
+            cstr_reset(&cstr);
+        }
+        cstr_printf(&cstr, "#define __BASE_FILE__ \"%s\"\n", file->filename);
         if (s1->cmdline_incl.size)
           cstr_cat(&cstr, s1->cmdline_incl.data, s1->cmdline_incl.size);
         //printf("%s\n", (char*)cstr.data);
@@ -3806,7 +4023,8 @@ ST_FUNC void swirlpp_new(SwirlState *s)
     tal_new(&toksym_alloc, TOKSYM_TAL_LIMIT, TOKSYM_TAL_SIZE);
     tal_new(&tokstr_alloc, TOKSTR_TAL_LIMIT, TOKSTR_TAL_SIZE);
 
-    memset(hash_ident, 0, TOK_HASH_SIZE * sizeof(TokenSym *));
+    hash_ident_mask = TOK_HASH_SIZE - 1;
+    hash_ident = swirl_mallocz(TOK_HASH_SIZE * sizeof(TokenSym *));
     memset(s->cached_includes_hash, 0, sizeof s->cached_includes_hash);
 
     cstr_new(&cstr_buf);
@@ -3846,10 +4064,14 @@ ST_FUNC void swirlpp_delete(SwirlState *s)
     n = tok_ident - TOK_IDENT;
     if (n > total_idents)
         total_idents = n;
+    if (hash_ident_mask >= tok_hash_size)
+        tok_hash_size = hash_ident_mask + 1;
     for(i = 0; i < n; i++)
         tal_free(toksym_alloc, table_ident[i]);
     swirl_free(table_ident);
     table_ident = NULL;
+    swirl_free(hash_ident);
+    hash_ident = NULL;
 
     /* free static buffers */
     cstr_free(&tokcstr);
@@ -3862,6 +4084,887 @@ ST_FUNC void swirlpp_delete(SwirlState *s)
     toksym_alloc = NULL;
     tal_delete(tokstr_alloc);
     tokstr_alloc = NULL;
+
+    pch_unmap();
+}
+
+/* ------------------------------------------------------------------------- */
+/* precompiled headers: 'swirl -c file.h' saves the state after the header,
+   'swirl -include-pch file.h.pch' starts from it instead of parsing the
+   header again.  The file is an array of ints with the identifiers,
+   macros and include guards, followed by the global symbols (see
+   pch_save_syms()).  Macro token strings are used from the mapped
+   file directly. */
+
+#ifndef _WIN32
+# include <sys/mman.h>
+#endif
+
+#define PCH_MAGIC 0x48435053 /* "SPCH" */
+
+static ST_TLS int *pch_map;
+static ST_TLS unsigned long pch_size;
+
+static int pch_mapped(const int *p)
+{
+    return pch_map && p >= pch_map && (char *)p < (char *)pch_map + pch_size;
+}
+
+static void pch_unmap(void)
+{
+    if (!pch_map)
+        return;
+#ifndef _WIN32
+    munmap(pch_map, pch_size);
+#else
+    swirl_free(pch_map);
+#endif
+    pch_map = NULL;
+}
+
+/* predefs and -D/-U options must be the same when using the header */
+static unsigned pch_hash(const char *p, int n)
+{
+    unsigned h = 2166136261u;
+    const char *v = SWIRL_VERSION;
+    while (*v)
+        h = (h ^ (unsigned char)*v++) * 16777619;
+    while (n--)
+        h = (h ^ (unsigned char)*p++) * 16777619;
+    return h;
+}
+
+ST_FUNC void pch_put(CString *cs, int v)
+{
+    cstr_cat(cs, (char *)&v, sizeof v);
+}
+
+/* length, then the string with its '\0', padded to ints */
+static void pch_put_str(CString *cs, const char *str, int len)
+{
+    pch_put(cs, len);
+    cstr_cat(cs, str, len + 1);
+    while (cs->size & 3)
+        cstr_ccat(cs, 0);
+}
+
+static int tok_str_len(const int *str)
+{
+    const int *p = str;
+    CValue cv;
+    int t;
+    do
+        TOK_GET(&t, &p, &cv);
+    while (t);
+    return p - str;
+}
+
+/* whether the 'len' ints at 'p' are a token string ending with 0 which
+   names known identifiers only */
+ST_FUNC int pch_check_toks(const int *p, int len)
+{
+    const int *e = p + len, *q;
+    int buf[5], n, t;
+    CValue cv;
+
+    while (p < e) {
+        /* TOK_GET reads up to 5 ints, do not go past the file */
+        n = e - p < 5 ? e - p : 5;
+        memset(buf, 0, sizeof buf);
+        memcpy(buf, p, n * sizeof(int));
+        q = buf;
+        TOK_GET(&t, &q, &cv);
+        if (t == 0)
+            return q - buf == 1 && p + 1 == e;
+        if (t >= tok_ident || q - buf < 1 || q - buf > e - p)
+            return 0;
+        p += q - buf;
+    }
+    return 0;
+}
+
+ST_FUNC void swirl_pch_save(SwirlState *s1)
+{
+    CString *cs = &s1->pch_out;
+    TokenSym *ts;
+    CachedInclude *e;
+    Sym *s, *a;
+    int i, n, o, nb_args, base_file;
+
+    base_file = tok_alloc_const("__BASE_FILE__");
+    cstr_reset(cs);
+    pch_put(cs, PCH_MAGIC);
+    pch_put(cs, pp_defs_hash);
+
+    pch_put(cs, tok_ident - TOK_IDENT);
+    for (i = 0; i < tok_ident - TOK_IDENT; i++) {
+        ts = table_ident[i];
+        pch_put_str(cs, ts->str, ts->len);
+    }
+
+    /* macros */
+    o = cs->size;
+    pch_put(cs, 0);
+    for (i = 0; i < tok_ident - TOK_IDENT; i++) {
+        s = table_ident[i]->sym_define;
+        if (!s || !s->d || s->v == base_file)
+            continue;
+        pch_put(cs, s->v);
+        pch_put(cs, s->type.t);
+        for (nb_args = 0, a = s->next; a; a = a->next)
+            nb_args++;
+        pch_put(cs, nb_args);
+        for (a = s->next; a; a = a->next) {
+            pch_put(cs, a->v);
+            pch_put(cs, a->type.t);
+        }
+        n = tok_str_len(s->d);
+        pch_put(cs, n);
+        cstr_cat(cs, (char *)s->d, n * sizeof(int));
+        ((int *)(cs->data + o))[0]++;
+    }
+
+    /* include guards and #pragma once */
+    pch_put(cs, s1->nb_cached_includes);
+    for (i = 0; i < s1->nb_cached_includes; i++) {
+        e = s1->cached_includes[i];
+        pch_put(cs, e->ifndef_macro);
+        pch_put(cs, e->once == pp_once);
+        pch_put_str(cs, e->filename, strlen(e->filename));
+    }
+
+    /* #pragma pack */
+    n = s1->pack_stack_ptr - s1->pack_stack;
+    pch_put(cs, n);
+    for (i = 0; i <= n; i++)
+        pch_put(cs, s1->pack_stack[i]);
+    pch_put(cs, pp_counter);
+
+    pch_save_syms(s1, cs);
+}
+
+ST_FUNC int swirl_output_pch(SwirlState *s1, const char *filename)
+{
+    FILE *f;
+    int ret;
+
+    f = fopen(filename, "wb");
+    ret = !f || fwrite(s1->pch_out.data, 1, s1->pch_out.size, f) != s1->pch_out.size;
+    if (f && fclose(f))
+        ret = 1;
+    if (ret) {
+        swirl_error_noabort("could not write '%s'", filename);
+        return -1;
+    }
+    if (s1->verbose)
+        printf("<- %s\n", filename);
+    return 0;
+}
+
+ST_FUNC void swirl_pch_load(SwirlState *s1)
+{
+    const char *filename = s1->pch_file;
+    const int *p, *end;
+    const char *str;
+    Sym *first, **ps;
+    CachedInclude *e;
+    int fd, i, n, len, v, t;
+
+    fd = open(filename, O_RDONLY | O_BINARY);
+    if (fd < 0)
+        swirl_error("could not open '%s'", filename);
+    pch_size = lseek(fd, 0, SEEK_END);
+#ifndef _WIN32
+    pch_map = mmap(NULL, pch_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (pch_map == MAP_FAILED)
+        pch_map = NULL;
+#else
+    pch_map = swirl_malloc(pch_size);
+    lseek(fd, 0, SEEK_SET);
+    if (full_read(fd, pch_map, pch_size) != pch_size)
+        pch_unmap();
+#endif
+    close(fd);
+    if (!pch_map)
+        swirl_error("could not read '%s'", filename);
+
+    p = pch_map;
+    end = p + pch_size / sizeof(int);
+    if (pch_size < 3 * sizeof(int) || p[0] != PCH_MAGIC)
+        goto bad;
+    if ((unsigned)p[1] != pp_defs_hash)
+        swirl_error("'%s' was compiled with different options", filename);
+    p += 2;
+
+    /* identifiers must get the same token numbers */
+    n = *p++;
+    if (n < tok_ident - TOK_IDENT || n > end - p)
+        goto bad;
+    for (i = 0; i < n; i++) {
+        if (p == end)
+            goto bad;
+        len = *p++;
+        if (len < 0 || len / 4 >= end - p)
+            goto bad;
+        str = (const char *)p;
+        p += (len + 4) / 4;
+        if (i < tok_ident - TOK_IDENT) {
+            if (table_ident[i]->len != len || memcmp(table_ident[i]->str, str, len))
+                goto bad;
+        } else if (tok_alloc(str, len)->tok != i + TOK_IDENT)
+            goto bad;
+    }
+
+    if (p == end)
+        goto bad;
+    for (n = *p++; n > 0; n--) {
+        if (end - p < 4)
+            goto bad;
+        v = p[0], t = p[1], i = p[2];
+        p += 3;
+        if (v < TOK_IDENT || v >= tok_ident || i < 0 || i > (end - p) / 2)
+            goto bad;
+        first = NULL, ps = &first;
+        for (; i > 0; i--, p += 2) {
+            if ((p[0] & ~SYM_FIELD) < TOK_IDENT
+                || (p[0] & ~SYM_FIELD) >= tok_ident)
+                goto bad;
+            *ps = sym_push2(&define_stack, p[0], p[1], 0);
+            ps = &(*ps)->next;
+        }
+        if (p == end)
+            goto bad;
+        len = *p++;
+        if (len < 1 || len > end - p || !pch_check_toks(p, len))
+            goto bad;
+        define_push(v, t, (int *)p, first);
+        p += len;
+    }
+
+    if (p == end)
+        goto bad;
+    for (n = *p++; n > 0; n--) {
+        if (end - p < 3)
+            goto bad;
+        len = p[2];
+        str = (const char *)(p + 3);
+        if ((p[0] && (p[0] < TOK_IDENT || p[0] >= tok_ident))
+            || len < 0 || len / 4 >= end - p - 3 || str[len])
+            goto bad;
+        e = search_cached_include(s1, str, 1);
+        e->ifndef_macro = p[0];
+        if (p[1])
+            e->once = pp_once;
+        p += 3 + (p[2] + 4) / 4;
+    }
+
+    if (p == end)
+        goto bad;
+    n = *p++;
+    if ((unsigned)n >= PACK_STACK_SIZE || n + 2 > end - p)
+        goto bad;
+    memcpy(s1->pack_stack, p, (n + 1) * sizeof(int));
+    s1->pack_stack_ptr = s1->pack_stack + n;
+    p += n + 1;
+    pp_counter = *p++;
+
+    p = pch_load_syms(s1, p, end);
+    if (p != end)
+        goto bad;
+    if (s1->gen_deps)
+        dynarray_add(&s1->target_deps, &s1->nb_target_deps,
+            swirl_strdup(filename));
+    return;
+bad:
+    swirl_error("'%s' is not a valid precompiled header", filename);
+}
+
+/* ------------------------------------------------------------------------- */
+/* include cache: files included by one compilation are kept as lexed
+   tokens for the next compilations in the same thread (swirl -c a.c b.c
+   ..., or a libswirl host compiling many sources), such that another
+   #include <stdio.h> replays tokens instead of scanning the text again.
+   The cache lives as long as the thread has a SwirlState.  Entries are
+   checked by file name, mtime, size and inode, and by a hash of the
+   contents when the file was modified less than a second before they
+   were lexed.  A file is lexed for the cache when it is included the
+   second time only, such that a single compilation doesn't pay for it.
+
+   tc_lex() lexes a file once with spaces, comments and line feeds, plus
+   the raw text after #include and #error which preprocess() reads by
+   characters.  Then tc_next() can return the same tokens as
+   next_nomacro1() for any parse_flags, and tc_skip() does the job of
+   preprocess_skip().  Files where both could differ (unknown directives,
+   strings with line feeds, ...) are not cached. */
+
+typedef struct TokenCache {
+    struct TokenCache *next;
+    time_t mtime;
+    off_t size;
+    ino_t ino;
+    time_t stamp; /* when the contents were lexed or last compared */
+    uint64_t hash[2]; /* of the contents */
+    int dollar; /* '$' in identifiers */
+    int lexed; /* else seen only once */
+    CString toks; /* records: token, line delta[, value] */
+    CString idents; /* identifier strings */
+    CString pos; /* identifier -> offset into 'idents' */
+    CString map; /* identifier -> token number in the current compilation */
+    int map_gen;
+    unsigned long bytes; /* counted in tc_size */
+    char filename[1];
+} TokenCache;
+
+#define TC_HASH_SIZE 256
+#define TC_MAX_SIZE (64 << 20) /* max. total size of the buffers */
+
+static ST_TLS TokenCache *tc_hash[TC_HASH_SIZE];
+static ST_TLS unsigned long tc_size;
+static ST_TLS CString tc_rev; /* token number -> identifier + 1, for tc_lex() */
+
+static void tc_clear(TokenCache *tc)
+{
+    tc_size -= tc->bytes;
+    tc->bytes = 0;
+    cstr_free(&tc->toks);
+    cstr_free(&tc->idents);
+    cstr_free(&tc->pos);
+    cstr_free(&tc->map);
+}
+
+/* free the cache of this thread when its last state goes away */
+ST_FUNC void pp_cache_free(void)
+{
+    TokenCache *tc;
+    int i;
+
+    for (i = 0; i < TC_HASH_SIZE; i++)
+        while ((tc = tc_hash[i])) {
+            tc_hash[i] = tc->next;
+            tc_clear(tc);
+            swirl_free(tc);
+        }
+    cstr_free(&tc_rev);
+}
+
+/* the record after 'p' */
+static const int *tc_skip_rec(const int *p)
+{
+    if (p[0] == TOK_PPNUM || p[0] == TOK_PPSTR)
+        return p + 3 + (p[2] + 4) / 4;
+    if (p[0] == TC_RAW)
+        return p + 4 + (p[3] + 4) / 4;
+    if (p[0] == TC_SPACES)
+        return p + 3;
+    if (p[0] == TC_DIR)
+        return p + 4;
+    return p + 2;
+}
+
+static void tc_put(CString *cs, int t, int *line)
+{
+    pch_put(cs, t);
+    pch_put(cs, file->line_num - *line);
+    *line = file->line_num;
+}
+
+/* put TC_SPACES before the run of 'n' spaces at 'ws', such that
+   tc_next() can skip it at once */
+static void tc_spaces(CString *cs, int ws, int n)
+{
+    int *p;
+
+    if (n < 2)
+        return;
+    pch_put(cs, 0), pch_put(cs, 0), pch_put(cs, 0);
+    p = (int *)(cs->data + ws);
+    memmove(p + 3, p, cs->size - ws - 3 * sizeof(int));
+    p[0] = TC_SPACES, p[1] = p[4], p[2] = n * 2;
+    p[4] = 0;
+}
+
+static void tc_error(void *opaque, const char *msg)
+{
+}
+
+static int tc_lex1(TokenCache *tc)
+{
+    CString *cs = &tc->toks;
+    uint8_t *q;
+    int t, c, i, *r, line, bol, sol, dir, incl, ws, n, d;
+    int ifs[64], nb_ifs;
+    char buf[1024];
+
+    parse_flags = PARSE_FLAG_SPACES | PARSE_FLAG_LINEFEED
+        | PARSE_FLAG_ACCEPT_STRAYS;
+    line = 1, sol = 1, dir = incl = 0, ws = n = 0, d = -1, nb_ifs = 0;
+    for (;;) {
+        q = file->buf_ptr;
+        bol = tok_flags & TOK_FLAG_BOL;
+        next_nomacro1();
+        t = tok;
+        if (t == TOK_EOF)
+            break;
+        if (t == TOK_LINEFEED) {
+            if (tok_flags & TOK_FLAG_EOF)
+                continue;
+            incl = 0;
+        } else if (t == ' ') {
+            /* tell comments from spaces, for tc_skip() */
+            while (q < file->buf_end) {
+                if (*q == '\f' || *q == '\v' || *q == '\r')
+                    q += 1;
+                else if (q[0] == '\\' && q[1] == '\n')
+                    q += 2;
+                else if (q[0] == '\\' && q[1] == '\r' && q[2] == '\n')
+                    q += 3;
+                else
+                    break;
+            }
+            if (*q == '/')
+                t = TC_COMMENT;
+        }
+        if (t == ' ' || t == '\t' || t == TC_COMMENT) {
+            if (file->line_num != line)
+                tc_spaces(cs, ws, n), n = 0;
+            if (n++ == 0)
+                ws = cs->size;
+            tc_put(cs, t, &line);
+            if (t == TC_COMMENT)
+                sol = 0;
+            continue;
+        }
+        tc_spaces(cs, ws, n), n = 0;
+        /* after #include "file", tok_flags may come from the included file */
+        if (incl && t != TOK_LINEFEED)
+            return 1;
+        if (dir) {
+            /* preprocess() skips the line of unknown directives by chars */
+            dir = 0;
+            switch (t) {
+            case TOK_IF: case TOK_IFDEF: case TOK_IFNDEF:
+                if (d >= 0) {
+                    if (nb_ifs == countof(ifs))
+                        return 1;
+                    ifs[nb_ifs++] = d;
+                }
+                break;
+            case TOK_ELIF: case TOK_ELSE: case TOK_ENDIF:
+                /* link the conditionals of one level for tc_skip() */
+                if (d >= 0 && nb_ifs) {
+                    r = (int *)(cs->data + ifs[nb_ifs - 1]);
+                    r[2] = (d - ifs[nb_ifs - 1]) / sizeof(int);
+                    if (t == TOK_ENDIF)
+                        --nb_ifs;
+                    else
+                        ifs[nb_ifs - 1] = d;
+                }
+                break;
+            case TOK_DEFINE: case TOK_UNDEF: case TOK_INCLUDE:
+            case TOK_INCLUDE_NEXT: case TOK_LINE: case TOK_ERROR:
+            case TOK_WARNING: case TOK_PRAGMA: case TOK_PPNUM:
+            case TOK_LINEFEED:
+                break;
+            default:
+                return 1;
+            }
+            dir = t;
+        } else if (bol && t == '#') {
+            dir = 1;
+            d = -1;
+            if (sol) {
+                /* a directive also for preprocess_skip() */
+                d = cs->size;
+                tc_put(cs, TC_DIR, &line);
+                pch_put(cs, 0);
+                pch_put(cs, line);
+                sol = 0;
+                continue;
+            }
+        } else if (bol && t == TOK_TWOSHARPS) {
+            return 1;
+        }
+        if (t == TOK_LINEFEED)
+            sol = 1;
+        else if (t != '\\')
+            sol = 0;
+
+        c = t;
+        if (t >= TOK_IDENT) {
+            i = t - TOK_IDENT;
+            while (tc_rev.size <= i * sizeof(int))
+                pch_put(&tc_rev, 0);
+            r = (int *)tc_rev.data + i;
+            if (!*r) {
+                *r = tc->pos.size / sizeof(int) + 1;
+                pch_put(&tc->pos, tc->idents.size / sizeof(int));
+                pch_put_str(&tc->idents, table_ident[i]->str, table_ident[i]->len);
+                pch_put(&tc->map, t);
+            }
+            c = TOK_IDENT + *r - 1;
+        }
+        tc_put(cs, c, &line);
+
+        if (t == TOK_PPNUM || t == TOK_PPSTR) {
+            /* preprocess_skip() counts lines in strings differently */
+            if (memchr(tokc.str.data, '\n', tokc.str.size))
+                return 1;
+            pch_put_str(cs, tokc.str.data, tokc.str.size - 1);
+        } else if (dir == TOK_INCLUDE || dir == TOK_INCLUDE_NEXT) {
+            c = parse_include_name(buf, sizeof buf);
+            if (c) {
+                /* preprocess_skip() would see strings or comments */
+                if (ch != c || strpbrk(buf, "\"'\\")
+                    || strstr(buf, "/*") || strstr(buf, "//"))
+                    return 1;
+                minp();
+                incl = 1;
+            }
+            goto raw;
+        } else if (dir == TOK_ERROR || dir == TOK_WARNING) {
+            c = 0;
+            parse_line_text(buf, sizeof buf);
+        raw:
+            if (c || dir == TOK_ERROR || dir == TOK_WARNING) {
+                tc_put(cs, TC_RAW, &line);
+                pch_put(cs, c);
+                pch_put_str(cs, buf, strlen(buf));
+            }
+        }
+        if (dir != 1)
+            dir = 0;
+    }
+    tc_spaces(cs, ws, n);
+    return 0;
+}
+
+/* lex the file just opened with swirl_open() into 'tc'. Return non zero
+   if it can't be cached. */
+static void tc_hash_file(uint64_t *h, const void *p, int size)
+{
+    h[0] = 0xcbf29ce484222325ull, h[1] = 0x84222325cbf29ce4ull;
+    swirl_hash(h, p, size);
+}
+
+static int tc_lex(SwirlState *s1, TokenCache *tc, int size)
+{
+    BufferedFile *bf = file;
+    void (*error_func)(void *opaque, const char *msg) = s1->error_func;
+    void *error_opaque = s1->error_opaque;
+    int nb_errors = s1->nb_errors;
+    int saved_tok = tok, saved_tok_flags = tok_flags;
+    int saved_parse_flags = parse_flags, saved_ch = ch;
+    CValue saved_tokc = tokc;
+    jmp_buf saved_jmp_buf;
+    int ret;
+
+    swirl_open_bf(s1, bf->filename, size);
+    tc->stamp = time(NULL);
+    ret = full_read(bf->fd, file->buffer, size) != size;
+    lseek(bf->fd, 0, SEEK_SET);
+    if (ret == 0) {
+        tc_hash_file(tc->hash, file->buffer, size);
+        memcpy(saved_jmp_buf, s1->error_jmp_buf, sizeof saved_jmp_buf);
+        s1->error_func = tc_error;
+        if (setjmp(s1->error_jmp_buf) == 0)
+            ret = tc_lex1(tc);
+        else
+            ret = 1;
+        memcpy(s1->error_jmp_buf, saved_jmp_buf, sizeof saved_jmp_buf);
+        s1->error_func = error_func;
+        s1->error_opaque = error_opaque;
+        s1->nb_errors = nb_errors;
+    }
+    while (file != bf)
+        swirl_close();
+    memset(tc_rev.data, 0, tc_rev.size);
+    tok = saved_tok, tokc = saved_tokc, ch = saved_ch;
+    tok_flags = saved_tok_flags, parse_flags = saved_parse_flags;
+    return ret;
+}
+
+/* A file written in the second it was lexed may have changed since
+   without changing its mtime or size.  Then compare the contents, as
+   long as the mtime is that recent.  Returns non zero if changed. */
+static int tc_changed(TokenCache *tc, struct stat *st)
+{
+    time_t now = time(NULL);
+    uint64_t h[2];
+    char *buf;
+    int ret;
+
+    if (st->st_mtime + 1 < tc->stamp)
+        return 0;
+    buf = swirl_malloc(st->st_size);
+    ret = full_read(file->fd, buf, st->st_size) != st->st_size;
+    lseek(file->fd, 0, SEEK_SET);
+    if (!ret)
+        tc_hash_file(h, buf, st->st_size);
+    swirl_free(buf);
+    if (ret)
+        return 1;
+    if (h[0] != tc->hash[0] || h[1] != tc->hash[1])
+        return 1;
+    tc->stamp = now;
+    return 0;
+}
+
+/* open an #include file, with tokens from the cache if possible */
+static int tc_open(SwirlState *s1, const char *filename)
+{
+    TokenCache *tc, **ptc;
+    BufferedFile *bf;
+    struct stat st;
+    const char *p;
+    unsigned h;
+
+    if (swirl_open(s1, filename) < 0)
+        return -1;
+    if ((parse_flags & PARSE_FLAG_ASM_FILE)
+        || fstat(file->fd, &st) < 0 || !S_ISREG(st.st_mode))
+        goto text;
+    for (h = 0, p = filename; *p; ++p)
+        h = h * 31 + (unsigned char)*p;
+    ptc = &tc_hash[h % TC_HASH_SIZE];
+    while ((tc = *ptc) && strcmp(tc->filename, filename))
+        ptc = &tc->next;
+    if (!tc) {
+        tc = swirl_mallocz(sizeof *tc + strlen(filename));
+        strcpy(tc->filename, filename);
+        *ptc = tc;
+    }
+    if (tc->mtime != st.st_mtime || tc->size != st.st_size
+        || tc->ino != st.st_ino
+        || tc->dollar != isidnum_table['$' - CH_EOF]
+        || (tc->lexed && tc->toks.size && tc_changed(tc, &st))) {
+        /* lex it only when it is included again */
+        ++pp_cache_misses;
+        for (bf = file->prev; bf; bf = bf->prev)
+            if (bf->tc == tc)
+                goto text; /* still replayed by an outer #include */
+        tc_clear(tc);
+        tc->mtime = st.st_mtime;
+        tc->size = st.st_size;
+        tc->ino = st.st_ino;
+        tc->dollar = isidnum_table['$' - CH_EOF];
+        tc->lexed = 0;
+        goto text;
+    } else if (tc->lexed) {
+        if (!tc->toks.size) {
+            /* not cacheable */
+            ++pp_cache_misses;
+            goto text;
+        }
+        ++pp_cache_hits;
+    } else {
+        ++pp_cache_misses;
+        tc->lexed = 1;
+        if (tc_size + st.st_size > TC_MAX_SIZE
+            || tc_lex(s1, tc, st.st_size)) {
+            tc_clear(tc);
+            goto text;
+        }
+        tc->bytes = tc->toks.size_allocated + tc->idents.size_allocated
+            + tc->pos.size_allocated + tc->map.size_allocated;
+        tc_size += tc->bytes;
+        tc->map_gen = pp_once;
+    }
+    if (tc->map_gen != pp_once) {
+        /* token numbers are new with each compilation */
+        memset(tc->map.data, 0, tc->map.size);
+        tc->map_gen = pp_once;
+    }
+    close(file->fd);
+    file->fd = -1;
+    file->tc = tc;
+    file->tcp = (const int *)tc->toks.data;
+    file->tc_end = file->tcp + tc->toks.size / sizeof(int);
+    total_bytes += st.st_size;
+    return 0;
+ text:
+    /* read from the file, not from the cache */
+    if (s1->mmap_input)
+        swirl_map(s1, file);
+    return 0;
+}
+
+/* the token number of identifier 'i' of the cached file */
+static int tc_ident(TokenCache *tc, int i)
+{
+    int *m = (int *)tc->map.data + i;
+    const int *p;
+
+    if (!*m) {
+        p = (const int *)tc->idents.data + ((int *)tc->pos.data)[i];
+        *m = tok_alloc((const char *)(p + 1), p[0])->tok;
+    }
+    return *m;
+}
+
+/* next_nomacro1() for cached files */
+static void tc_next(void)
+{
+    SwirlState *s1;
+    const int *p;
+    int t;
+
+ redo:
+    p = file->tcp;
+    if (p >= file->tc_end) {
+        s1 = swirl_state;
+        if ((parse_flags & PARSE_FLAG_LINEFEED)
+            && !(tok_flags & TOK_FLAG_EOF)) {
+            tok_flags |= TOK_FLAG_EOF;
+            tok = TOK_LINEFEED;
+            return;
+        } else if (!(parse_flags & PARSE_FLAG_PREPROCESS)) {
+            tok = TOK_EOF;
+        } else if (s1->ifdef_stack_ptr != file->ifdef_stack_ptr) {
+            swirl_error("missing #endif");
+        } else if (s1->include_stack_ptr == s1->include_stack) {
+            tok = TOK_EOF;
+        } else {
+            end_include(s1);
+            if (file->tcp)
+                goto redo;
+            next_nomacro1();
+            return;
+        }
+        tok_flags = 0;
+        return;
+    }
+
+    t = p[0];
+    file->line_num += p[1];
+    file->tcp = p + 2;
+    switch (t) {
+    case ' ':
+    case '\t':
+    case TC_COMMENT:
+        if (!(parse_flags & PARSE_FLAG_SPACES))
+            goto redo;
+        tok = t == TC_COMMENT ? ' ' : t;
+        return;
+    case TC_SPACES:
+        file->tcp = p + 3;
+        if (!(parse_flags & PARSE_FLAG_SPACES))
+            file->tcp += p[2];
+        goto redo;
+    case TOK_LINEFEED:
+        tok_flags |= TOK_FLAG_BOL;
+        if (!(parse_flags & PARSE_FLAG_LINEFEED))
+            goto redo;
+        tok = TOK_LINEFEED;
+        return;
+    case TC_DIR:
+        file->tcp = p + 4;
+        t = '#';
+        if ((tok_flags & TOK_FLAG_BOL)
+            && (parse_flags & PARSE_FLAG_PREPROCESS)) {
+            file->tc_dir = p;
+            file->tc_line = file->line_num;
+            goto directive;
+        }
+        break;
+    case '#':
+        if ((tok_flags & TOK_FLAG_BOL)
+            && (parse_flags & PARSE_FLAG_PREPROCESS)) {
+            file->tc_dir = NULL;
+        directive:
+            preprocess(tok_flags & TOK_FLAG_BOF);
+            if (parse_flags & PARSE_FLAG_LINEFEED) {
+                tok = TOK_LINEFEED;
+                return;
+            }
+            if (file->tcp)
+                goto redo;
+            next_nomacro1();
+            return;
+        }
+        break;
+    case '\\':
+        if (!(parse_flags & PARSE_FLAG_ACCEPT_STRAYS))
+            swirl_error("stray '\\' in program");
+        break;
+    case TOK_PPNUM:
+    case TOK_PPSTR:
+        cstr_reset(&tokcstr);
+        cstr_cat(&tokcstr, (const char *)(p + 3), p[2] + 1);
+        tokc.str.size = tokcstr.size;
+        tokc.str.data = tokcstr.data;
+        file->tcp = tc_skip_rec(p);
+        break;
+    case TC_RAW:
+        file->tcp = tc_skip_rec(p);
+        goto redo;
+    default:
+        if (t >= TOK_IDENT)
+            t = tc_ident(file->tc, t - TOK_IDENT);
+        break;
+    }
+    tok = t;
+    tok_flags = 0;
+}
+
+/* preprocess_skip() for cached files */
+static void tc_skip(void)
+{
+    const int *p, *q;
+    int a, start_of_line, t;
+
+    p = file->tc_dir;
+    if (p && p[2]) {
+        /* go to the next #elif, #else or #endif at once */
+        q = p + p[2];
+        file->line_num = file->tc_line + q[3] - p[3];
+        file->tcp = q + 4;
+        file->tc_dir = q;
+        file->tc_line = file->line_num;
+        next_nomacro();
+        return;
+    }
+    a = 0;
+    start_of_line = 1;
+    for (;;) {
+        p = file->tcp;
+        if (p >= file->tc_end)
+            expect("#endif");
+        t = p[0];
+        file->line_num += p[1];
+        file->tcp = tc_skip_rec(p);
+        if (t == TOK_LINEFEED) {
+            start_of_line = 1;
+        } else if ((t == '#' || t == TC_DIR) && start_of_line) {
+            if (t == TC_DIR)
+                file->tc_dir = p, file->tc_line = file->line_num;
+            next_nomacro();
+            if (a == 0 &&
+                (tok == TOK_ELSE || tok == TOK_ELIF || tok == TOK_ENDIF))
+                break;
+            if (tok == TOK_IF || tok == TOK_IFDEF || tok == TOK_IFNDEF)
+                a++;
+            else if (tok == TOK_ENDIF)
+                a--;
+            start_of_line = tok == TOK_LINEFEED;
+        } else if (t != ' ' && t != '\t' && t != '\\' && t != TC_SPACES) {
+            start_of_line = 0;
+        }
+    }
+}
+
+/* the text after #include or #error. Return the closing char of the
+   file name, or 0 */
+static int tc_raw(char *buf, int size)
+{
+    const int *p = file->tcp;
+
+    buf[0] = 0;
+    if (p >= file->tc_end || p[0] != TC_RAW)
+        return 0;
+    file->line_num += p[1];
+    pstrcpy(buf, size, (const char *)(p + 4));
+    file->tcp = tc_skip_rec(p);
+    return p[2];
 }
 
 /* ------------------------------------------------------------------------- */
@@ -4005,7 +5108,7 @@ ST_FUNC int swirl_preprocess(SwirlState *s1)
 
     if (s1->do_bench) {
 	/* for PP benchmarks */
-	do next(); while (tok != TOK_EOF);
+	do next(), ++total_tokens; while (tok != TOK_EOF);
 	return 0;
     }
 
@@ -4023,6 +5126,7 @@ ST_FUNC int swirl_preprocess(SwirlState *s1)
         next();
         if (tok == TOK_EOF)
             break;
+        ++total_tokens;
 
         level = s1->include_stack_ptr - iptr;
         if (level) {
@@ -4058,4 +5162,44 @@ ST_FUNC int swirl_preprocess(SwirlState *s1)
     return 0;
 }
 
+/* two lanes of FNV-1a, good enough for a 128 bit cache key */
+ST_FUNC void swirl_hash(uint64_t *h, const void *p, int n)
+{
+    const unsigned char *q = p;
+    uint64_t a = h[0], b = h[1];
+    while (n--) {
+        a = (a ^ *q) * 0x100000001b3ull;
+        b = (b ^ *q++ ^ (b >> 29)) * 0x9e3779b97f4a7c15ull;
+    }
+    h[0] = a, h[1] = b;
+}
+
+/* Hash the preprocessed token stream of the current file, together
+   with line numbers, file names and #pragma pack, i.e. everything
+   from the source that the object file may depend on. */
+ST_FUNC void swirl_preprocess_hash(SwirlState *s1, uint64_t *h)
+{
+    char name[1024];
+    const char *p;
+    int v[2];
+
+    parse_flags = PARSE_FLAG_PREPROCESS;
+    pp_hashing = 1;
+    name[0] = 0;
+    for (;;) {
+        next();
+        if (tok == TOK_EOF)
+            break;
+        if (strcmp(file->filename, name)) {
+            pstrcpy(name, sizeof name, file->filename);
+            swirl_hash(h, name, strlen(name) + 1);
+        }
+        v[0] = file->line_num, v[1] = *s1->pack_stack_ptr;
+        swirl_hash(h, v, sizeof v);
+        p = get_tok_str(tok, &tokc);
+        swirl_hash(h, p, strlen(p) + 1);
+    }
+    pp_hashing = 0;
+}
+
 /* ------------------------------------------------------------------------- */
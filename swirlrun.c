@@ -47,6 +47,60 @@ static void *win64_add_function_table(SwirlState *s1);
 static void win64_del_function_table(void *);
 #endif
 
+#ifdef CONFIG_SWIRL_THREAD_LOCAL
+#include <pthread.h>
+#undef free /* for the blocks of posix_memalign */
+
+/* -run has no static TLS: the GOT pairs of thread-local accesses point
+   to this descriptor, and __tls_get_addr gives each thread its own copy
+   of the TLS template on first use */
+typedef struct rt_tls {
+    pthread_key_t key;
+    void *image;
+    size_t size, align;
+} rt_tls;
+
+static void *rt_tls_get_addr(addr_t *ti)
+{
+    rt_tls *tls = (rt_tls *)ti[0];
+    char *p = pthread_getspecific(tls->key);
+    if (!p) {
+        if (posix_memalign((void **)&p, tls->align, tls->size + 1))
+            abort();
+        memcpy(p, tls->image, tls->size);
+        pthread_setspecific(tls->key, p);
+    }
+    return p + ti[1];
+}
+
+static void rt_tls_new(SwirlState *s1)
+{
+    rt_tls *tls;
+    addr_t size, align, start;
+
+    start = tls_segment(s1, &size, &align);
+    if (0 == size)
+        return;
+    tls = swirl_mallocz(sizeof *tls);
+    if (pthread_key_create(&tls->key, free))
+        swirl_error("swirlrun: could not create TLS key");
+    tls->image = (void *)start;
+    tls->size = size;
+    tls->align = align < sizeof(void *) ? sizeof(void *) : align;
+    s1->run_tls = tls;
+}
+
+static void rt_tls_free(SwirlState *s1)
+{
+    rt_tls *tls = s1->run_tls;
+    if (tls) {
+        free(pthread_getspecific(tls->key));
+        pthread_key_delete(tls->key);
+        swirl_free(tls);
+    }
+}
+#endif
+
 /* ------------------------------------------------------------- */
 /* Do all relocations (needed before using swirl_get_symbol())
    Returns -1 on error. */
@@ -107,6 +161,9 @@ ST_FUNC void swirl_run_free(SwirlState *s1)
 #endif
     }
     swirl_free(s1->runtime_mem);
+#ifdef CONFIG_SWIRL_THREAD_LOCAL
+    rt_tls_free(s1);
+#endif
 }
 
 static void run_cdtors(SwirlState *s1, const char *start, const char *end,
@@ -121,7 +178,7 @@ static void run_cdtors(SwirlState *s1, const char *start, const char *end,
 /* launch the compiled program with the given arguments */
 LIBSWIRLAPI int swirl_run(SwirlState *s1, int argc, char **argv)
 {
-    int (*prog_main)(int, char **, char **), ret;
+    int (*prog_main)(int, char **, char **), ret, phase;
 #ifdef CONFIG_SWIRL_BACKTRACE
     rt_context *rc = &g_rtctxt;
 #endif
@@ -142,8 +199,10 @@ LIBSWIRLAPI int swirl_run(SwirlState *s1, int argc, char **argv)
     if (s1->do_debug)
         swirl_add_symbol(s1, "exit", rt_exit);
 #endif
+    phase = swirl_bench(s1, BENCH_RELOC);
     if (swirl_relocate(s1, SWIRL_RELOCATE_AUTO) < 0)
         return -1;
+    swirl_bench(s1, phase);
     prog_main = (void*)get_sym_addr(s1, s1->runtime_main, 1, 1);
 
 #ifdef CONFIG_SWIRL_BACKTRACE
@@ -215,6 +274,10 @@ static int swirl_relocate_ex(SwirlState *s1, void *ptr, addr_t ptr_diff)
 #else
         swirl_add_runtime(s1);
 	resolve_common_syms(s1);
+#ifdef CONFIG_SWIRL_THREAD_LOCAL
+        if (find_elf_sym(symtab_section, "__tls_get_addr"))
+            swirl_add_symbol(s1, "__tls_get_addr", rt_tls_get_addr);
+#endif
         build_got_entries(s1);
 #endif
         if (s1->nb_errors)
@@ -225,13 +288,15 @@ static int swirl_relocate_ex(SwirlState *s1, void *ptr, addr_t ptr_diff)
 #ifdef _WIN64
     offset += sizeof (void*); /* space for function_table pointer */
 #endif
-    for (k = 0; k < 2; ++k) {
+    /* code, then the TLS template in one piece, then data */
+    for (k = 0; k < 3; ++k) {
         f = 0, addr = k ? mem : mem + ptr_diff;
         for(i = 1; i < s1->nb_sections; i++) {
             s = s1->sections[i];
             if (0 == (s->sh_flags & SHF_ALLOC))
                 continue;
-            if (k != !(s->sh_flags & SHF_EXECINSTR))
+            if (k != (s->sh_flags & SHF_EXECINSTR ? 0
+                      : s->sh_flags & SHF_TLS ? 1 : 2))
                 continue;
             align = s->sh_addralign - 1;
             if (++f == 1 && align < RUN_SECTION_ALIGNMENT)
@@ -260,6 +325,9 @@ static int swirl_relocate_ex(SwirlState *s1, void *ptr, addr_t ptr_diff)
 #ifdef SWIRL_TARGET_PE
     s1->pe_imagebase = mem;
 #endif
+#ifdef CONFIG_SWIRL_THREAD_LOCAL
+    rt_tls_new(s1);
+#endif
 
     /* relocate each section */
     for(i = 1; i < s1->nb_sections; i++) {
@@ -39,6 +39,9 @@
 
      DEF(TOK_GENERIC, "_Generic")
      DEF(TOK_STATIC_ASSERT, "_Static_assert")
+     DEF(TOK_ATOMIC, "_Atomic")
+     DEF(TOK_THREAD_LOCAL1, "_Thread_local")
+     DEF(TOK_THREAD_LOCAL2, "__thread") /* gcc keyword */
 
      DEF(TOK_FLOAT, "float")
      DEF(TOK_DOUBLE, "double")
@@ -136,6 +139,14 @@
      DEF(TOK_DESTRUCTOR2, "__destructor__")
      DEF(TOK_ALWAYS_INLINE1, "always_inline")
      DEF(TOK_ALWAYS_INLINE2, "__always_inline__")
+     DEF(TOK_NOINLINE1, "noinline")
+     DEF(TOK_NOINLINE2, "__noinline__")
+     DEF(TOK_COLD1, "cold")
+     DEF(TOK_COLD2, "__cold__")
+     DEF(TOK_RETURNS_TWICE1, "returns_twice")
+     DEF(TOK_RETURNS_TWICE2, "__returns_twice__")
+     DEF(TOK_VECTOR_SIZE1, "vector_size")
+     DEF(TOK_VECTOR_SIZE2, "__vector_size__")
 
      DEF(TOK_MODE, "__mode__")
      DEF(TOK_MODE_QI, "__QI__")
@@ -159,6 +170,67 @@
      DEF(TOK_builtin_frame_address, "__builtin_frame_address")
      DEF(TOK_builtin_return_address, "__builtin_return_address")
      DEF(TOK_builtin_expect, "__builtin_expect")
+     DEF(TOK_builtin_popcount, "__builtin_popcount")
+     DEF(TOK_builtin_popcountl, "__builtin_popcountl")
+     DEF(TOK_builtin_popcountll, "__builtin_popcountll")
+     DEF(TOK_builtin_clz, "__builtin_clz")
+     DEF(TOK_builtin_clzl, "__builtin_clzl")
+     DEF(TOK_builtin_clzll, "__builtin_clzll")
+     DEF(TOK_builtin_ctz, "__builtin_ctz")
+     DEF(TOK_builtin_ctzl, "__builtin_ctzl")
+     DEF(TOK_builtin_ctzll, "__builtin_ctzll")
+     DEF(TOK_builtin_ffs, "__builtin_ffs")
+     DEF(TOK_builtin_ffsl, "__builtin_ffsl")
+     DEF(TOK_builtin_ffsll, "__builtin_ffsll")
+     DEF(TOK_builtin_parity, "__builtin_parity")
+     DEF(TOK_builtin_parityl, "__builtin_parityl")
+     DEF(TOK_builtin_parityll, "__builtin_parityll")
+     DEF(TOK_builtin_bswap16, "__builtin_bswap16")
+     DEF(TOK_builtin_bswap32, "__builtin_bswap32")
+     DEF(TOK_builtin_bswap64, "__builtin_bswap64")
+     DEF(TOK___atomic_load_n, "__atomic_load_n")
+     DEF(TOK___atomic_store_n, "__atomic_store_n")
+     DEF(TOK___atomic_exchange_n, "__atomic_exchange_n")
+     DEF(TOK___atomic_compare_exchange_n, "__atomic_compare_exchange_n")
+     DEF(TOK___atomic_load, "__atomic_load")
+     DEF(TOK___atomic_store, "__atomic_store")
+     DEF(TOK___atomic_exchange, "__atomic_exchange")
+     DEF(TOK___atomic_compare_exchange, "__atomic_compare_exchange")
+     DEF(TOK___atomic_fetch_add, "__atomic_fetch_add")
+     DEF(TOK___atomic_fetch_sub, "__atomic_fetch_sub")
+     DEF(TOK___atomic_fetch_and, "__atomic_fetch_and")
+     DEF(TOK___atomic_fetch_or, "__atomic_fetch_or")
+     DEF(TOK___atomic_fetch_xor, "__atomic_fetch_xor")
+     DEF(TOK___atomic_fetch_nand, "__atomic_fetch_nand")
+     DEF(TOK___atomic_add_fetch, "__atomic_add_fetch")
+     DEF(TOK___atomic_sub_fetch, "__atomic_sub_fetch")
+     DEF(TOK___atomic_and_fetch, "__atomic_and_fetch")
+     DEF(TOK___atomic_or_fetch, "__atomic_or_fetch")
+     DEF(TOK___atomic_xor_fetch, "__atomic_xor_fetch")
+     DEF(TOK___atomic_nand_fetch, "__atomic_nand_fetch")
+     DEF(TOK___atomic_test_and_set, "__atomic_test_and_set")
+     DEF(TOK___atomic_clear, "__atomic_clear")
+     DEF(TOK___atomic_thread_fence, "__atomic_thread_fence")
+     DEF(TOK___atomic_signal_fence, "__atomic_signal_fence")
+     DEF(TOK___atomic_always_lock_free, "__atomic_always_lock_free")
+     DEF(TOK___atomic_is_lock_free, "__atomic_is_lock_free")
+     DEF(TOK___sync_fetch_and_add, "__sync_fetch_and_add")
+     DEF(TOK___sync_fetch_and_sub, "__sync_fetch_and_sub")
+     DEF(TOK___sync_fetch_and_and, "__sync_fetch_and_and")
+     DEF(TOK___sync_fetch_and_or, "__sync_fetch_and_or")
+     DEF(TOK___sync_fetch_and_xor, "__sync_fetch_and_xor")
+     DEF(TOK___sync_fetch_and_nand, "__sync_fetch_and_nand")
+     DEF(TOK___sync_add_and_fetch, "__sync_add_and_fetch")
+     DEF(TOK___sync_sub_and_fetch, "__sync_sub_and_fetch")
+     DEF(TOK___sync_and_and_fetch, "__sync_and_and_fetch")
+     DEF(TOK___sync_or_and_fetch, "__sync_or_and_fetch")
+     DEF(TOK___sync_xor_and_fetch, "__sync_xor_and_fetch")
+     DEF(TOK___sync_nand_and_fetch, "__sync_nand_and_fetch")
+     DEF(TOK___sync_bool_compare_and_swap, "__sync_bool_compare_and_swap")
+     DEF(TOK___sync_val_compare_and_swap, "__sync_val_compare_and_swap")
+     DEF(TOK___sync_lock_test_and_set, "__sync_lock_test_and_set")
+     DEF(TOK___sync_lock_release, "__sync_lock_release")
+     DEF(TOK___sync_synchronize, "__sync_synchronize")
      /*DEF(TOK_builtin_va_list, "__builtin_va_list")*/
 #if defined SWIRL_TARGET_PE && defined SWIRL_TARGET_X86_64
      DEF(TOK_builtin_va_start, "__builtin_va_start")
@@ -187,6 +259,19 @@
      DEF(TOK_option, "option")
 
 /* builtin functions or variables */
+     DEF(TOK___popcountsi2, "__popcountsi2")
+     DEF(TOK___popcountdi2, "__popcountdi2")
+     DEF(TOK___clzsi2, "__clzsi2")
+     DEF(TOK___clzdi2, "__clzdi2")
+     DEF(TOK___ctzsi2, "__ctzsi2")
+     DEF(TOK___ctzdi2, "__ctzdi2")
+     DEF(TOK___ffssi2, "__ffssi2")
+     DEF(TOK___ffsdi2, "__ffsdi2")
+     DEF(TOK___paritysi2, "__paritysi2")
+     DEF(TOK___paritydi2, "__paritydi2")
+     DEF(TOK___bswapsi2, "__bswapsi2")
+     DEF(TOK___bswapdi2, "__bswapdi2")
+     DEF(TOK___tls_get_addr, "__tls_get_addr")
 #ifndef SWIRL_ARM_EABI
      DEF(TOK_memcpy, "memcpy")
      DEF(TOK_memmove, "memmove")
@@ -266,9 +351,7 @@
      DEF(TOK___fixxfdi, "__fixxfdi")
 #endif
 
-#if defined SWIRL_TARGET_I386 || defined SWIRL_TARGET_X86_64
      DEF(TOK_alloca, "alloca")
-#endif
 
 #if defined SWIRL_TARGET_PE
      DEF(TOK___chkstk, "__chkstk")
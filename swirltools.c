@@ -482,3 +482,152 @@ ST_FUNC void gen_makedeps(SwirlState *s1, const char *target, const char *filena
 }
 
 /* -------------------------------------------------------------- */
+/* compile several files with -c in parallel (-j N) */
+
+#ifndef _WIN32
+#include <sys/wait.h>
+#include <signal.h>
+
+typedef struct JobOutput {
+    FILE *f; /* captured stdout or stderr of the child, while running */
+    char *text; /* the same when finished */
+    long len;
+} JobOutput;
+
+typedef struct SwirlJob {
+    pid_t pid;
+    JobOutput out, err;
+    int status; /* exit status, -1 while running */
+} SwirlJob;
+
+/* keep the output of a finished job in memory, such that only the
+   running jobs have files open */
+static void job_save(JobOutput *o)
+{
+    fseek(o->f, 0, SEEK_END);
+    o->len = ftell(o->f);
+    if (o->len < 0)
+        o->len = 0;
+    rewind(o->f);
+    o->text = swirl_malloc(o->len + 1);
+    o->len = fread(o->text, 1, o->len, o->f);
+    fclose(o->f);
+    o->f = NULL;
+}
+
+static void job_replay(JobOutput *o, FILE *to)
+{
+    fwrite(o->text, 1, o->len, to);
+    fflush(to);
+    swirl_free(o->text);
+    o->text = NULL;
+}
+
+static void job_output_free(JobOutput *o)
+{
+    if (o->f)
+        fclose(o->f);
+    swirl_free(o->text);
+}
+
+static void jobs_free(SwirlJob *jobs, int nb_jobs)
+{
+    int i;
+    for (i = 0; i < nb_jobs; ++i) {
+        job_output_free(&jobs[i].out);
+        job_output_free(&jobs[i].err);
+    }
+    swirl_free(jobs);
+}
+
+/* stop and reap the running jobs before giving up */
+static void jobs_kill(SwirlJob *jobs, int nb_jobs)
+{
+    int i;
+    for (i = 0; i < nb_jobs; ++i)
+        if (jobs[i].pid > 0 && jobs[i].status < 0)
+            kill(jobs[i].pid, SIGTERM);
+    for (i = 0; i < nb_jobs; ++i)
+        if (jobs[i].pid > 0 && jobs[i].status < 0)
+            while (waitpid(jobs[i].pid, NULL, 0) < 0 && errno == EINTR)
+                ;
+    jobs_free(jobs, nb_jobs);
+}
+
+/* Fork one process per input file, at most N at a time.  The output of
+   each is captured and replayed in command line order, such that the
+   diagnostics look the same as with the serial loop in main().  As there,
+   nothing is reported beyond the first file that failed.
+
+   Returns in the child the index of the file to compile, in the parent
+   -1 after all jobs are finished, with the exit status in *pret. */
+ST_FUNC int swirl_tool_jobs(SwirlState *s1, int *pret)
+{
+    SwirlJob *jobs, *j;
+    int max_jobs, next, flushed, running, st;
+    pid_t pid;
+
+    max_jobs = s1->nb_jobs;
+    if (max_jobs < 0)
+        max_jobs = sysconf(_SC_NPROCESSORS_ONLN);
+    jobs = swirl_mallocz(s1->nb_files * sizeof *jobs);
+    next = flushed = running = *pret = 0;
+    fflush(stdout);
+    fflush(stderr);
+
+    for (;;) {
+        while (!*pret && next < s1->nb_files && running < max_jobs) {
+            j = &jobs[next];
+            j->out.f = tmpfile();
+            j->err.f = tmpfile();
+            j->status = -1;
+            if (!j->out.f || !j->err.f) {
+                jobs_kill(jobs, next + 1);
+                swirl_error("could not create temporary file");
+            }
+            pid = fork();
+            if (pid < 0) {
+                jobs_kill(jobs, next + 1);
+                swirl_error("could not fork");
+            }
+            if (pid == 0) {
+                dup2(fileno(j->out.f), 1);
+                dup2(fileno(j->err.f), 2);
+                jobs_free(jobs, next + 1);
+                return next;
+            }
+            j->pid = pid;
+            ++next, ++running;
+        }
+        if (running == 0)
+            break;
+        pid = wait(&st);
+        if (pid < 0) {
+            if (errno == EINTR)
+                continue;
+            jobs_kill(jobs, next);
+            swirl_error("wait: %s", strerror(errno));
+        }
+        for (j = jobs + flushed; j < jobs + next; ++j)
+            if (j->pid == pid) {
+                j->status = WIFEXITED(st) ? WEXITSTATUS(st) : 1;
+                job_save(&j->out);
+                job_save(&j->err);
+                --running;
+                break;
+            }
+        /* replay what is complete, in order */
+        while (!*pret && flushed < next && jobs[flushed].status >= 0) {
+            j = &jobs[flushed++];
+            job_replay(&j->out, stdout);
+            job_replay(&j->err, stderr);
+            if (j->status)
+                *pret = 1;
+        }
+    }
+    jobs_free(jobs, next);
+    return -1;
+}
+#endif /* !_WIN32 */
+
+/* -------------------------------------------------------------- */
@@ -0,0 +1,36 @@
+/* contended atomic increments from several threads */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#define NTHREADS 4
+
+static atomic_long counter;
+static long sync_counter;
+static long loops;
+
+static void *worker(void *arg)
+{
+    long i;
+
+    for (i = 0; i < loops; i++) {
+        atomic_fetch_add_explicit(&counter, 1, memory_order_relaxed);
+        __sync_fetch_and_add(&sync_counter, 1);
+    }
+    return arg;
+}
+
+int main(int argc, char **argv)
+{
+    pthread_t t[NTHREADS];
+    int i;
+
+    loops = (argc > 1 ? atol(argv[1]) : 100) * 10000;
+    for (i = 0; i < NTHREADS; i++)
+        pthread_create(&t[i], NULL, worker, NULL);
+    for (i = 0; i < NTHREADS; i++)
+        pthread_join(t[i], NULL);
+    printf("%ld %ld\n", atomic_load(&counter), sync_counter);
+    return counter != NTHREADS * loops || sync_counter != NTHREADS * loops;
+}
@@ -0,0 +1,86 @@
+/* hot loops calling functions with bulky, never taken error paths
+   (speedtest-expect).  With -DNOHINT the paths are not marked unlikely. */
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef NOHINT
+# define unlikely(x) (x)
+#else
+# define unlikely(x) __builtin_expect(!!(x), 0)
+#endif
+
+#define N 4096
+
+static int a[N];
+static unsigned errs;
+
+#define REPORT(what, v) { \
+    fprintf(stderr, "%s:%d: %s %d %d %d\n", __FILE__, __LINE__, what, \
+            v, v * 3, v ^ 5); \
+    errs += v * 7 + 1; \
+    errs ^= errs >> 3; \
+    errs += v; \
+}
+
+#define STEP(name, op) \
+static int name(int x, int k) \
+{ \
+    if (unlikely(x < 0)) { \
+        REPORT("negative", x); \
+        x = -x; \
+    } \
+    x = x op k; \
+    if (unlikely(x > 1 << 28)) { \
+        REPORT("overflow", x); \
+        REPORT("step", k); \
+        REPORT("clamped", x & 0xfffff); \
+        x &= 0xfffff; \
+    } \
+    if (unlikely(k == 0x7fff)) \
+        REPORT("bad step", k); \
+    return x & 0xffffff; \
+}
+
+STEP(s0, +) STEP(s1, ^) STEP(s2, |) STEP(s3, +)
+STEP(s4, ^) STEP(s5, -) STEP(s6, +) STEP(s7, ^)
+STEP(t0, +) STEP(t1, ^) STEP(t2, |) STEP(t3, +)
+STEP(t4, ^) STEP(t5, -) STEP(t6, +) STEP(t7, ^)
+STEP(u0, +) STEP(u1, ^) STEP(u2, |) STEP(u3, +)
+STEP(u4, ^) STEP(u5, -) STEP(u6, +) STEP(u7, ^)
+STEP(v0, +) STEP(v1, ^) STEP(v2, |) STEP(v3, +)
+STEP(v4, ^) STEP(v5, -) STEP(v6, +) STEP(v7, ^)
+
+#define STEPS(s) \
+    x = s##0(x, k); \
+    x = s##1(x, i); \
+    x = s##2(x, k & 7); \
+    x = s##3(x, 3); \
+    x = s##4(x, k); \
+    x = s##5(x & 0xffff, i & 15); \
+    x = s##6(x, 1); \
+    x = s##7(x, k);
+
+static unsigned run(int k)
+{
+    unsigned s = 0;
+    int i;
+    for (i = 0; i < N; i++) {
+        int x = a[i];
+        STEPS(s) STEPS(t) STEPS(u) STEPS(v)
+        s += x;
+    }
+    return s;
+}
+
+int main(int argc, char **argv)
+{
+    int i, r = argc > 1 ? atoi(argv[1]) : 1000;
+    unsigned long acc = 0;
+
+    for (i = 0; i < N; i++)
+        a[i] = i * 17 & 0xffff;
+    for (i = 0; i < r; i++)
+        acc += run(i & 255);
+    printf("%lu %u\n", acc, errs);
+    return 0;
+}
@@ -0,0 +1,54 @@
+/* tiny static helpers in hot loops (speedtest-inline) */
+#include <stdio.h>
+#include <stdlib.h>
+
+#define N 4096
+
+struct item { int key, flags; struct item *next; };
+
+static struct item items[N];
+static int vals[N];
+
+static int min(int a, int b) { return a < b ? a : b; }
+static int max(int a, int b) { return a > b ? a : b; }
+static int clamp(int v, int lo, int hi) { return min(max(v, lo), hi); }
+static int key(const struct item *p) { return p->key; }
+static int has_flag(const struct item *p, int f) { return (p->flags >> f) & 1; }
+static struct item *next(const struct item *p) { return p->next; }
+
+static long clamp_all(void)
+{
+    long s = 0;
+    int i;
+    for (i = 0; i < N; i++)
+        s += clamp(vals[i], -1000, 1000);
+    return s;
+}
+
+static long walk(const struct item *p)
+{
+    long s = 0;
+    for (; p; p = next(p))
+        if (has_flag(p, 2))
+            s += key(p);
+    return s;
+}
+
+int main(int argc, char **argv)
+{
+    int i, r = argc > 1 ? atoi(argv[1]) : 1000;
+    unsigned long acc = 0;
+
+    for (i = 0; i < N; i++) {
+        vals[i] = (i * 7919) % 4001 - 2000;
+        items[i].key = i;
+        items[i].flags = i * 3;
+        items[i].next = i + 1 < N ? &items[i + 1] : NULL;
+    }
+    for (i = 0; i < r; i++) {
+        acc += clamp_all();
+        acc += walk(items);
+    }
+    printf("%lu\n", acc);
+    return 0;
+}
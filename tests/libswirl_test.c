@@ -47,10 +47,58 @@ char my_program[] =
 "    return 0;\n"
 "}\n";
 
+static void set_paths(SwirlState *s, int argc, char **argv)
+{
+    int i;
+    for (i = 1; i < argc; ++i) {
+        char *a = argv[i];
+        if (a[0] == '-') {
+            if (a[1] == 'B')
+                swirl_set_lib_path(s, a+2);
+            else if (a[1] == 'I')
+                swirl_add_include_path(s, a+2);
+            else if (a[1] == 'L')
+                swirl_add_library_path(s, a+2);
+        }
+    }
+}
+
+/* a header rewritten between compilations, within the same second and
+   with the same size, must not come from the include cache */
+static int rewritten(int argc, char **argv)
+{
+    const char *name = "libswirl_test.h";
+    SwirlState *s;
+    FILE *f;
+    int i, (*get)(void);
+
+    for (i = 1; i <= 4; ++i) {
+        f = fopen(name, "w");
+        if (!f)
+            return 1;
+        fprintf(f, "#define V %d\n", i);
+        fclose(f);
+        s = swirl_new();
+        set_paths(s, argc, argv);
+        swirl_set_output_type(s, SWIRL_OUTPUT_MEMORY);
+        if (swirl_compile_string(s, "#include \"libswirl_test.h\"\n"
+                                    "int get(void) { return V; }\n") == -1
+            || swirl_relocate(s, SWIRL_RELOCATE_AUTO) < 0
+            || !(get = swirl_get_symbol(s, "get")))
+            return 1;
+        if (get() != i) {
+            fprintf(stderr, "%s: got %d, not %d\n", name, get(), i);
+            return 1;
+        }
+        swirl_delete(s);
+    }
+    remove(name);
+    return 0;
+}
+
 int main(int argc, char **argv)
 {
     SwirlState *s;
-    int i;
     int (*func)(int);
 
     s = swirl_new();
@@ -68,17 +116,7 @@ int main(int argc, char **argv)
     assert(swirl_get_error_opaque(s) == stderr);
 
     /* if swirllib.h and libswirl1.a are not installed, where can we find them */
-    for (i = 1; i < argc; ++i) {
-        char *a = argv[i];
-        if (a[0] == '-') {
-            if (a[1] == 'B')
-                swirl_set_lib_path(s, a+2);
-            else if (a[1] == 'I')
-                swirl_add_include_path(s, a+2);
-            else if (a[1] == 'L')
-                swirl_add_library_path(s, a+2);
-        }
-    }
+    set_paths(s, argc, argv);
 
     /* MUST BE CALLED before any compilation */
     swirl_set_output_type(s, SWIRL_OUTPUT_MEMORY);
@@ -103,6 +141,10 @@ int main(int argc, char **argv)
     /* run the code */
     func(32);
 
+    /* with 's' alive, the include cache is kept between these */
+    if (rewritten(argc, argv))
+        return 1;
+
     /* delete the state */
     swirl_delete(s);
 
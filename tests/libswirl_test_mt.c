@@ -230,6 +230,13 @@ void time_swirl(int n, const char *src)
     }
 }
 
+/* compile swirl.c n times per thread, to see how that scales */
+TF_TYPE(thread_test_time, vn)
+{
+    time_swirl((size_t)vn, g_argv[1]);
+    return 0;
+}
+
 static unsigned getclock_ms(void)
 {
 #ifdef _WIN32
@@ -243,8 +250,8 @@ static unsigned getclock_ms(void)
 
 int main(int argc, char **argv)
 {
-    int n;
-    unsigned t;
+    int n, k;
+    unsigned t, t1;
 
     g_argc = argc;
     g_argv = argv;
@@ -280,7 +287,18 @@ int main(int argc, char **argv)
     printf("compiling swirl.c 10 times\n"), fflush(stdout);
     t = getclock_ms();
     time_swirl(10, argv[1]);
-    printf(" (%u ms)\n", getclock_ms() - t), fflush(stdout);
+    printf(" (%u ms)\n", t1 = getclock_ms() - t), fflush(stdout);
+#endif
+#if 1
+    for (k = 2; k <= 4; k *= 2) {
+        printf("compiling swirl.c 10 times in %d threads\n", k), fflush(stdout);
+        t = getclock_ms();
+        for (n = 0; n < k; ++n)
+            create_thread(thread_test_time, 10 / k + (n < 10 % k));
+        wait_threads(n);
+        t = getclock_ms() - t;
+        printf(" (%u ms, %.2fx)\n", t, (double)t1 / (t ? t : 1)), fflush(stdout);
+    }
 #endif
     return 0;
 }
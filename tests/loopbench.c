@@ -0,0 +1,91 @@
+/* loop kernels for register allocation of locals (speedtest-regvars) */
+#include <stdio.h>
+#include <stdlib.h>
+
+#define N 4096
+#define M 64
+
+static int a[N], b[N];
+static double x[M][M], y[M][M], z[M][M];
+static char sieve[65536];
+static unsigned char text[N];
+
+static long dot(const int *p, const int *q, int n)
+{
+    long s = 0;
+    int i;
+    for (i = 0; i < n; i++)
+        s += (long)p[i] * q[i];
+    return s;
+}
+
+static void matmul(int n)
+{
+    int i, j, k;
+    for (i = 0; i < n; i++)
+        for (j = 0; j < n; j++) {
+            double s = 0;
+            for (k = 0; k < n; k++)
+                s += x[i][k] * y[k][j];
+            z[i][j] = s;
+        }
+}
+
+static int primes(int n)
+{
+    int i, j, c = 0;
+    for (i = 2; i < n; i++)
+        sieve[i] = 1;
+    for (i = 2; i < n; i++)
+        if (sieve[i]) {
+            c++;
+            for (j = i + i; j < n; j += i)
+                sieve[j] = 0;
+        }
+    return c;
+}
+
+static unsigned crc32(const unsigned char *p, int n)
+{
+    unsigned crc = ~0u;
+    int k;
+    while (n--) {
+        crc ^= *p++;
+        for (k = 0; k < 8; k++)
+            crc = crc >> 1 ^ (0xedb88320 & -(crc & 1));
+    }
+    return ~crc;
+}
+
+static int count(const unsigned char *s, const unsigned char *e, int c)
+{
+    int n = 0;
+    while (s < e)
+        n += *s++ == c;
+    return n;
+}
+
+int main(int argc, char **argv)
+{
+    int i, j, r = argc > 1 ? atoi(argv[1]) : 10;
+    unsigned long acc = 0;
+
+    for (i = 0; i < N; i++) {
+        a[i] = i * 7 + 1;
+        b[i] = i ^ 0x55;
+        text[i] = i * 13;
+    }
+    for (i = 0; i < M; i++)
+        for (j = 0; j < M; j++)
+            x[i][j] = i + j, y[i][j] = i - j;
+    for (i = 0; i < r; i++) {
+        acc += dot(a, b, N);
+        matmul(M);
+        acc += (long)z[i % M][3];
+        acc += primes(sizeof sieve);
+        acc += crc32(text, N);
+        acc += count(text, text + N, i & 255);
+    }
+    printf("%lu\n", acc);
+    return 0;
+}
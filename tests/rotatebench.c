@@ -0,0 +1,73 @@
+/* short loops where the back-edge is a good part of the work
+   (speedtest-rotate).  Each round runs 4 * N inner iterations. */
+#include <stdio.h>
+#include <stdlib.h>
+
+#define N 4096
+#define M 64
+
+struct node { struct node *next; int v; };
+
+static int a[N];
+static char str[N + 1];
+static struct node nodes[N];
+static unsigned char x[M], y[M];
+
+static int sum(const int *p, int n)
+{
+    int i, s = 0;
+    for (i = 0; i < n; i++)
+        s += p[i];
+    return s;
+}
+
+static int length(const char *s)
+{
+    int n = 0;
+    while (*s)
+        s++, n++;
+    return n;
+}
+
+static int walk(const struct node *p)
+{
+    int s = 0;
+    while (p) {
+        s += p->v;
+        p = p->next;
+    }
+    return s;
+}
+
+static unsigned mix(void)
+{
+    int i, j;
+    unsigned s = 0;
+    for (i = 0; i < M; i++)
+        for (j = 0; j < M; j++)
+            s += x[i] ^ y[j];
+    return s;
+}
+
+int main(int argc, char **argv)
+{
+    int i, r = argc > 1 ? atoi(argv[1]) : 1000;
+    unsigned long acc = 0;
+
+    for (i = 0; i < N; i++) {
+        a[i] = i * 7 + 1;
+        str[i] = 'a' + i % 26;
+        nodes[i].v = i;
+        nodes[i].next = i + 1 < N ? &nodes[i + 1] : NULL;
+    }
+    for (i = 0; i < M; i++)
+        x[i] = i * 3, y[i] = i * 5;
+    for (i = 0; i < r; i++) {
+        acc += sum(a, N);
+        acc += length(str);
+        acc += walk(nodes);
+        acc += mix();
+    }
+    printf("%lu\n", acc);
+    return 0;
+}
@@ -0,0 +1,78 @@
+/* copies and clears of small structs (speedtest-struct).  With -DCALL
+   they go through memmove and memset as they used to. */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define N 1024
+
+struct kv { long k, v; };
+struct rec { int id, flags; double x, y, z; char name[24]; };
+
+static struct kv kvs[N], out[N];
+static struct rec recs[N];
+
+#ifdef CALL
+static void *(*volatile move)(void *, const void *, size_t) = memmove;
+static void *(*volatile set)(void *, int, size_t) = memset;
+# define COPY(d, s) move(&(d), &(s), sizeof (d))
+#else
+# define COPY(d, s) ((d) = (s))
+#endif
+
+static void shuffle(int r)
+{
+    int i;
+    for (i = 0; i < N; i++)
+        COPY(out[(i * 7 + r) % N], kvs[i]);
+}
+
+static long scan(int k)
+{
+    struct rec t;
+    long s = 0;
+    int i;
+    for (i = 0; i < N; i++) {
+        COPY(t, recs[i]);
+        if (t.id == k)
+            s += t.name[3];
+    }
+    return s;
+}
+
+static long zero(int n)
+{
+    long s = 0;
+    int i;
+    for (i = 0; i < n; i++) {
+#ifdef CALL
+        struct rec t;
+        set(&t, 0, sizeof t);
+#else
+        struct rec t = { 0 };
+#endif
+        t.flags = i;
+        s += t.flags + t.id;
+    }
+    return s;
+}
+
+int main(int argc, char **argv)
+{
+    int i, r = argc > 1 ? atoi(argv[1]) : 1000;
+    unsigned long acc = 0;
+
+    for (i = 0; i < N; i++) {
+        kvs[i].k = i, kvs[i].v = i * 3;
+        recs[i].id = i & 63;
+        sprintf(recs[i].name, "rec%d", i);
+    }
+    for (i = 0; i < r; i++) {
+        shuffle(i);
+        acc += out[i % N].v;
+        acc += scan(i & 63);
+        acc += zero(N);
+    }
+    printf("%lu\n", acc);
+    return 0;
+}
@@ -0,0 +1,38 @@
+/* switch dispatch benchmark: a 256 opcode interpreter loop over
+   random byte code */
+#include <stdio.h>
+#include <stdlib.h>
+
+#define OP(n) case n: acc = acc * 31 + n; break;
+#define OP4(n) OP(n) OP(n + 1) OP(n + 2) OP(n + 3)
+#define OP16(n) OP4(n) OP4(n + 4) OP4(n + 8) OP4(n + 12)
+#define OP64(n) OP16(n) OP16(n + 16) OP16(n + 32) OP16(n + 48)
+
+static unsigned char code[65536];
+
+static unsigned run(const unsigned char *p, int n)
+{
+    unsigned acc = 0;
+
+    while (n--) {
+        switch (*p++) {
+        OP64(0) OP64(64) OP64(128) OP64(192)
+        }
+    }
+    return acc;
+}
+
+int main(int argc, char **argv)
+{
+    unsigned seed = 1, acc = 0;
+    int i, n = argc > 1 ? atoi(argv[1]) : 1000;
+
+    for (i = 0; i < sizeof code; i++) {
+        seed = seed * 1103515245 + 12345;
+        code[i] = seed >> 16;
+    }
+    for (i = 0; i < n; i++)
+        acc += run(code, sizeof code);
+    printf("%u\n", acc);
+    return 0;
+}
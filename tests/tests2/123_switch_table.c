@@ -0,0 +1,125 @@
+#include <stdio.h>
+
+/* dense switches, lowered to jump tables */
+
+int dense(int x)
+{
+    switch (x) {
+    case 0: return 10;
+    case 1: return 11;
+    case 2: return 12;
+    case 4: return 14;
+    case 5 ... 7: return 15;
+    case 9: return 19;
+    case 10: return 20;
+    default: return -1;
+    }
+}
+
+/* two dense clusters around a far away case */
+long long clusters(long long x)
+{
+    switch (x) {
+    case -3: return 1;
+    case -2: return 2;
+    case -1: return 3;
+    case 0: return 4;
+    case 1: return 5;
+    case 3: return 6;
+    case 1000: return 7;
+    case 0x100000000LL: return 8;
+    case 0x100000001LL: return 9;
+    case 0x100000002LL: return 10;
+    case 0x100000003LL: return 11;
+    case 0x100000005LL: return 12;
+    }
+    return 0;
+}
+
+unsigned wrap(unsigned x)
+{
+    switch (x) {
+    case 0xfffffffa: return 1;
+    case 0xfffffffb: return 2;
+    case 0xfffffffc: return 3;
+    case 0xfffffffd: return 4;
+    case 0xffffffff: return 5;
+    case 0: return 6;
+    }
+    return 0;
+}
+
+int fallthrough(unsigned char c)
+{
+    int r = 0;
+    switch (c) {
+    case 'a': r = 1;
+    case 'b': r += 2; break;
+    case 'c': r = 3; break;
+    case 'd': r = 4; break;
+    case 'e': r = 5; break;
+    case 'f': r = 6; break;
+    case 200 ... 255: r = 7; break;
+    }
+    return r;
+}
+
+enum op { OP_PUSH, OP_ADD, OP_SUB, OP_MUL, OP_DUP, OP_JNZ, OP_DEC, OP_SWAP, OP_OVER, OP_END };
+
+/* a tiny interpreter: switch in a loop, nested switch, continue */
+int run(const unsigned char *code)
+{
+    int stack[16], *sp = stack, pc = 0, t;
+
+    for (;;) {
+        switch (code[pc++]) {
+        case OP_PUSH: *sp++ = code[pc++]; continue;
+        case OP_ADD: sp--; sp[-1] += sp[0]; break;
+        case OP_SUB: sp--; sp[-1] -= sp[0]; break;
+        case OP_MUL: sp--; sp[-1] *= sp[0]; break;
+        case OP_DUP: *sp = sp[-1]; sp++; break;
+        case OP_JNZ:
+            t = code[pc++];
+            switch (*--sp) {
+            case 0: break;
+            default: pc = t; break;
+            }
+            break;
+        case OP_DEC: sp[-1]--; break;
+        case OP_SWAP: t = sp[-1]; sp[-1] = sp[-2]; sp[-2] = t; break;
+        case OP_OVER: *sp = sp[-2]; sp++; break;
+        case OP_END: return sp[-1];
+        default: return -1;
+        }
+    }
+}
+
+int main(void)
+{
+    static const unsigned char fact[] = {
+        OP_PUSH, 1, OP_PUSH, 6,
+        /* 4: */ OP_DUP, OP_JNZ, 9, OP_SWAP, OP_END,
+        /* 9: */ OP_SWAP, OP_OVER, OP_MUL, OP_SWAP, OP_DEC,
+        OP_PUSH, 1, OP_JNZ, 4
+    };
+    static const unsigned char bad[] = { OP_PUSH, 1, 42 };
+    long long i;
+    unsigned u;
+
+    for (i = -3; i < 13; i++)
+        printf("%d ", dense(i));
+    printf("\n");
+    for (i = -5; i < 3; i++)
+        printf("%lld ", clusters(i));
+    for (i = 0xffffffffLL; i < 0x100000008LL; i++)
+        printf("%lld ", clusters(i));
+    printf("%lld\n", clusters(1000));
+    for (u = 0xfffffff8; u != 2; u++)
+        printf("%u ", wrap(u));
+    printf("\n");
+    for (i = 0; i < 256; i++)
+        printf("%d", fallthrough(i));
+    printf("\n");
+    printf("%d %d\n", run(fact), run(bad));
+    return 0;
+}
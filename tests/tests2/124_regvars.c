@@ -0,0 +1,108 @@
+/* -O1: scalar locals in callee saved registers */
+#include <stdio.h>
+#include <setjmp.h>
+
+static int sum(const int *a, int n)
+{
+    int i, s = 0;
+    for (i = 0; i < n; i++)
+        s += a[i];
+    return s;
+}
+
+static long mix(long a, char c, unsigned char uc, short s, unsigned short us)
+{
+    long x = a * 3;
+    char d = c + 1;
+    unsigned char e = uc + 1;
+    int i;
+    for (i = 0; i < 2; i++)
+        x += d + e + s + us;
+    return x;
+}
+
+static int byref(int n)
+{
+    int i, v = 0;
+    int *p = &v;
+    for (i = 0; i < n; i++)
+        *p += i;
+    return v;
+}
+
+/* more candidates than registers, and registers reused in
+   sibling scopes */
+static int many(int a, int b)
+{
+    int c = a + b, d = a - b, e = a * b, f = a | b, g = a ^ b, h = a & b;
+    int i, r = 0;
+    for (i = 0; i < 3; i++) {
+        int t = c + d;
+        r += t + e + f + g + h;
+    }
+    while (a-- > 0) {
+        long u = a * 2;
+        r += u;
+    }
+    return r;
+}
+
+static int fact(int n)
+{
+    int r = 1;
+    while (n > 1)
+        r *= n--;
+    return r;
+}
+
+static char *find(char *s, int c)
+{
+    for (; *s; s++)
+        if (*s == c)
+            return s;
+    return 0;
+}
+
+static jmp_buf jb;
+
+static int jump(int n)
+{
+    volatile int i = 0;
+    int k = 0;
+    if (setjmp(jb))
+        return i * 100 + k;
+    for (k = 0; k < n; k++)
+        i++;
+    longjmp(jb, 1);
+    return -1;
+}
+
+static int packed(void)
+{
+    int i, n = 0;
+#pragma pack(push, 1)
+    struct { char c; int i; } s;
+#pragma pack(pop)
+    struct { char c; int i; } t;
+    for (i = 0; i < 2; i++)
+        n += sizeof s + sizeof t;
+    return n;
+}
+
+int main(void)
+{
+    int a[10], i;
+    char str[] = "register";
+
+    for (i = 0; i < 10; i++)
+        a[i] = i * i;
+    printf("%d\n", sum(a, 10));
+    printf("%ld\n", mix(7, 127, 255, -3, 65535));
+    printf("%d\n", byref(5));
+    printf("%d\n", many(4, 3));
+    printf("%d\n", fact(10));
+    printf("%s\n", find(str, 's'));
+    printf("%d\n", jump(5));
+    printf("%d\n", packed());
+    return 0;
+}
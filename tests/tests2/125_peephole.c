@@ -0,0 +1,75 @@
+/* -O1: peephole pass over jumps, reloads and jump tables */
+#include <stdio.h>
+
+static int classify(int c)
+{
+    switch (c) {
+    case 0: return 10;
+    case 1: return 11;
+    case 2: return 12;
+    case 3: return 13;
+    case 4: return 14;
+    case 5: return 15;
+    case 7: return 17;
+    default: return -1;
+    }
+}
+
+static int fcmp(double a, double b, float f)
+{
+    int r = 0;
+    if (a < b) r |= 1;
+    if (a == b) r |= 2;
+    if (!(a >= b)) r |= 4;
+    if (f != (float)a) r |= 8;
+    return r;
+}
+
+static int walk(int n)
+{
+    int i = 0, s = 0;
+again:
+    if (i >= n)
+        goto done;
+    s += i & 1 ? i : -i;
+    i++;
+    goto again;
+done:
+    return s;
+}
+
+static long chain(long a, long b)
+{
+    long t = a;
+    a = b;
+    b = t;
+    t = a;
+    return a * 100 + b + (t == a);
+}
+
+static int nest(int x)
+{
+    int r = 0;
+    while (x > 0) {
+        if (x & 1) {
+            if (x & 2)
+                r += 3;
+            else
+                r += 1;
+        } else {
+            do { r += 2; } while (0);
+        }
+        x--;
+    }
+    return r > 10 ? r : r < 5 ? -r : 0;
+}
+
+int main(void)
+{
+    int i;
+    for (i = -1; i < 9; i++)
+        printf("%d ", classify(i));
+    printf("\n%d %d %d\n", fcmp(1, 2, 1), fcmp(2, 2, 2), fcmp(0.0 / 0.0, 1, 3));
+    printf("%d %ld %d %d %d\n", walk(10), chain(3, 4), nest(9), nest(3), nest(0));
+    return 0;
+}
@@ -0,0 +1,51 @@
+/* multiply, divide and modulo by constants */
+#include <stdio.h>
+#include <limits.h>
+
+#define F(name, ty, op, c) static ty name(ty x) { return x op c; }
+F(sdiv3, int, /, 3)
+F(sdiv7, int, /, 7)
+F(sdivm8, int, /, -8)
+F(smod10, int, %, 10)
+F(smodm7, int, %, -7)
+F(udiv7, unsigned, /, 7u)
+F(udiv10, unsigned, /, 10u)
+F(umod1000, unsigned, %, 1000u)
+F(umod64, unsigned, %, 64u)
+F(udivbig, unsigned, /, 0xfffffffeu)
+F(ldiv1000, long long, /, 1000)
+F(lmodm3, long long, %, -3)
+F(ldiv16, long long, /, 16)
+F(uldiv7, unsigned long long, /, 7)
+F(ulmod10, unsigned long long, %, 10)
+F(uldivbig, unsigned long long, /, 0x8000000000000001ull)
+F(mul9, int, *, 9)
+F(mul20, int, *, 20)
+F(mul45, long long, *, 45)
+F(mul7, int, *, 7)
+F(mulm5, long long, *, -5)
+
+static int vals[] = { 0, 1, -1, 7, -7, 99, -100, 12345, INT_MAX, INT_MIN };
+static long long lvals[] = { 0, 1, -1, 999, -1001, 123456789012345LL,
+                             LLONG_MAX, LLONG_MIN };
+
+int main(void)
+{
+    int i;
+    for (i = 0; i < sizeof vals / sizeof *vals; i++) {
+        int x = vals[i];
+        unsigned u = x;
+        printf("%d %d %d %d %d | %u %u %u %u %u | %d %d %d\n",
+               sdiv3(x), sdiv7(x), sdivm8(x), smod10(x), smodm7(x),
+               udiv7(u), udiv10(u), umod1000(u), umod64(u), udivbig(u),
+               mul9(x >> 8), mul20(x >> 8), mul7(x >> 8));
+    }
+    for (i = 0; i < sizeof lvals / sizeof *lvals; i++) {
+        long long x = lvals[i];
+        unsigned long long u = x;
+        printf("%lld %lld %lld | %llu %llu %llu | %lld %lld\n",
+               ldiv1000(x), lmodm3(x), ldiv16(x),
+               uldiv7(u), ulmod10(u), uldivbig(u), mul45(x >> 16), mulm5(x >> 16));
+    }
+    return 0;
+}
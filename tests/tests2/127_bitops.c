@@ -0,0 +1,66 @@
+/* __builtin_popcount, clz, ctz, ffs, parity and bswap */
+#include <stdio.h>
+
+/* folded at compile time */
+static int folded[] = {
+    __builtin_popcount(0xf0f0), __builtin_clz(1), __builtin_ctz(0x80),
+    __builtin_ffs(0), __builtin_ffsll(1ULL << 40), __builtin_parity(7),
+    __builtin_clzll(0x100000000ULL), __builtin_bswap16(0x1234),
+};
+static unsigned long long folded_swap = __builtin_bswap64(0x0102030405060708ULL);
+
+static unsigned int v32[] = {
+    1, 2, 3, 0x80, 0xff, 0x1234, 0x80000000u, 0xffffffffu, 0xdeadbeefu,
+    0x55555555u, 0x7fffffffu, 0x00010000u
+};
+
+static unsigned long long v64[] = {
+    1, 0x100000000ULL, 0x8000000000000000ULL, 0xffffffffffffffffULL,
+    0x0123456789abcdefULL, 0xdeadbeef00000000ULL, 0x00000000cafef00dULL,
+    0x5555555555555555ULL
+};
+
+int main(void)
+{
+    int i;
+    volatile unsigned int x;
+    volatile unsigned long long y;
+    volatile unsigned long z;
+    volatile unsigned short s;
+
+    for (i = 0; i < sizeof folded / sizeof *folded; i++)
+        printf("%d ", folded[i]);
+    printf("%llx\n", folded_swap);
+
+    for (i = 0; i < sizeof v32 / sizeof *v32; i++) {
+        x = v32[i];
+        printf("%08x: %2d %2d %2d %2d %d %08x\n", x,
+               __builtin_popcount(x), __builtin_clz(x), __builtin_ctz(x),
+               __builtin_ffs(x), __builtin_parity(x), __builtin_bswap32(x));
+        s = x;
+        printf("  %04x %d\n", __builtin_bswap16(s),
+               (int)sizeof __builtin_bswap16(s));
+        z = x;
+        printf("  %2d %2d %2d %2d %d\n", __builtin_popcountl(z),
+               __builtin_clzl(z) - (int)(sizeof z * 8 - 32),
+               __builtin_ctzl(z), __builtin_ffsl(z), __builtin_parityl(z));
+    }
+    for (i = 0; i < sizeof v64 / sizeof *v64; i++) {
+        y = v64[i];
+        printf("%016llx: %2d %2d %2d %2d %d %016llx\n", y,
+               __builtin_popcountll(y), __builtin_clzll(y),
+               __builtin_ctzll(y), __builtin_ffsll(y),
+               __builtin_parityll(y), __builtin_bswap64(y));
+    }
+    x = 0;
+    y = 0;
+    printf("%d %d %d %d\n", __builtin_ffs(x), __builtin_ffsll(y),
+           __builtin_popcount(x), __builtin_parityll(y));
+
+    /* in expressions, with other values live */
+    x = 0xf00f;
+    y = 0x1234;
+    printf("%d\n", __builtin_popcount(x) * 100 + __builtin_ctz(x)
+           + __builtin_clzll(y) * __builtin_ffs(x + 1));
+    return 0;
+}
@@ -0,0 +1,143 @@
+/* _Atomic, <stdatomic.h>, __atomic and __sync builtins */
+#include <stdio.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#define NTHREADS 4
+#define NLOOPS 100000
+
+_Atomic int gi = 5;
+_Atomic(unsigned char) guc = 250;
+_Atomic short gs = -3;
+_Atomic long gl = 1L << 20;
+_Atomic double gd = 1.5;
+_Atomic float gf = 2.0f;
+_Atomic _Bool gb;
+int arr[4] = { 10, 20, 30, 40 };
+_Atomic(int *) gp = arr;
+atomic_flag fl = ATOMIC_FLAG_INIT;
+
+/* shared counters for the threaded part */
+atomic_int c_inc;
+atomic_long c_fetch;
+int c_sync;
+int c_cas;
+int c_lock;
+atomic_flag lock = ATOMIC_FLAG_INIT;
+_Atomic double c_dbl;
+
+static void *worker(void *arg)
+{
+    int i, old;
+
+    for (i = 0; i < NLOOPS; i++) {
+        c_inc++;
+        atomic_fetch_add_explicit(&c_fetch, 2, memory_order_relaxed);
+        __sync_fetch_and_add(&c_sync, 1);
+        old = __atomic_load_n(&c_cas, __ATOMIC_RELAXED);
+        while (!__atomic_compare_exchange_n(&c_cas, &old, old + 3, 1,
+                                            __ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+            ;
+        while (atomic_flag_test_and_set_explicit(&lock, memory_order_acquire))
+            ;
+        c_lock++;
+        atomic_flag_clear_explicit(&lock, memory_order_release);
+        if ((i & 15) == 0)
+            c_dbl += 0.5;
+    }
+    return arg;
+}
+
+static void threads(void)
+{
+    pthread_t t[NTHREADS];
+    int i;
+
+    for (i = 0; i < NTHREADS; i++)
+        pthread_create(&t[i], NULL, worker, NULL);
+    for (i = 0; i < NTHREADS; i++)
+        pthread_join(t[i], NULL);
+    printf("%d %ld %d %d %d %g\n", atomic_load(&c_inc), atomic_load(&c_fetch),
+           c_sync, c_cas, c_lock, c_dbl);
+}
+
+int main(void)
+{
+    int e, r;
+    long el;
+    signed char sc = -1;
+    int x = 7;
+    double d, o;
+
+    printf("%d %d %d %ld %g %g\n", gi, guc, gs, gl, gd, gf);
+    gi += 3; guc += 10; gs -= 2; gl *= 3; gd += 0.25; gf *= 4;
+    printf("%d %d %d %ld %g %g\n", gi, guc, gs, gl, gd, gf);
+    r = gi++; printf("%d %d\n", r, gi);
+    r = ++gi; printf("%d %d\n", r, gi);
+    r = gi--; printf("%d %d\n", r, gi);
+    r = (gi <<= 2); printf("%d %d\n", r, gi);
+    r = (gi /= 3); printf("%d %d\n", r, gi);
+    r = (gi %= 5); printf("%d %d\n", r, gi);
+    r = (gi |= 0x30); printf("%d %d\n", r, gi);
+    r = (gi &= 0x1f); printf("%d %d\n", r, gi);
+    r = (gi ^= 0xff); printf("%d %d\n", r, gi);
+    gb = 5; printf("%d\n", gb);
+    gb += 1; printf("%d\n", gb);
+    printf("%d\n", *gp);
+    printf("%d\n", *(gp += 2));
+    gp++; printf("%d\n", *gp);
+    gp -= 3; printf("%d\n", *gp);
+    gs = x; printf("%d\n", gs);
+    printf("%d\n", gi + guc * gs);
+
+    printf("%d\n", atomic_fetch_add(&gi, 100));
+    printf("%d\n", atomic_fetch_sub_explicit(&gi, 1, memory_order_relaxed));
+    printf("%d\n", atomic_load(&gi));
+    atomic_store(&gi, 42); printf("%d\n", gi);
+    printf("%d\n", atomic_exchange(&gi, 43));
+    printf("%d\n", gi);
+    e = 1;
+    r = atomic_compare_exchange_strong(&gi, &e, 99); printf("%d %d %d\n", r, e, gi);
+    r = atomic_compare_exchange_strong(&gi, &e, 99); printf("%d %d %d\n", r, e, gi);
+    el = 0;
+    r = __atomic_compare_exchange_n(&gl, &el, 5, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+    printf("%d %ld %ld\n", r, el, gl);
+    printf("%d\n", __atomic_fetch_and(&guc, 0x0f, __ATOMIC_SEQ_CST));
+    printf("%d\n", __atomic_or_fetch(&guc, 0xf0, __ATOMIC_SEQ_CST));
+    printf("%d\n", __atomic_xor_fetch(&guc, 0xff, __ATOMIC_RELEASE));
+    printf("%d\n", __atomic_nand_fetch(&gs, 6, __ATOMIC_SEQ_CST));
+    printf("%d\n", __atomic_fetch_nand(&gs, 6, __ATOMIC_SEQ_CST));
+    printf("%d\n", __sync_fetch_and_add(&sc, 1));
+    printf("%d\n", __sync_sub_and_fetch(&sc, 3));
+    printf("%d\n", __sync_val_compare_and_swap(&sc, -2, 9));
+    r = __sync_bool_compare_and_swap(&sc, -2, 9); printf("%d %d\n", r, sc);
+    r = __sync_bool_compare_and_swap(&sc, 9, 11); printf("%d %d\n", r, sc);
+    printf("%d\n", __sync_lock_test_and_set(&x, 3));
+    __sync_lock_release(&x); printf("%d\n", x);
+    __sync_synchronize();
+    atomic_thread_fence(memory_order_acquire);
+    atomic_thread_fence(memory_order_seq_cst);
+    atomic_signal_fence(memory_order_seq_cst);
+    r = atomic_flag_test_and_set(&fl); printf("%d\n", r);
+    r = atomic_flag_test_and_set(&fl); printf("%d\n", r);
+    atomic_flag_clear(&fl);
+    r = atomic_flag_test_and_set(&fl); printf("%d\n", r);
+
+    /* generic forms on a double */
+    d = 3.25;
+    __atomic_store(&gd, &d, __ATOMIC_SEQ_CST);
+    __atomic_load(&gd, &o, __ATOMIC_SEQ_CST);
+    printf("%g\n", o);
+    d = 7.5;
+    __atomic_exchange(&gd, &d, &o, __ATOMIC_SEQ_CST);
+    printf("%g %g\n", o, gd);
+    o = 7.5; d = 1.0;
+    r = __atomic_compare_exchange(&gd, &o, &d, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+    printf("%d %g\n", r, gd);
+    printf("%d %d %d\n", (int)__atomic_always_lock_free(sizeof(int), 0),
+           (int)atomic_is_lock_free(&gi), (int)sizeof(gi++));
+    printf("%d\n", gi);
+
+    threads();
+    return 0;
+}
@@ -0,0 +1,71 @@
+/* __thread and _Thread_local variables */
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+
+__thread int counter = 10;
+_Thread_local long long big = 0x123456789abcLL;
+__thread char name[16] = "main";
+__thread int zeroed[100];
+static __thread struct { short s; double d; } pair = { 3, 2.5 };
+extern __thread int counter;
+
+static int *main_counter;
+
+static int bump(int n)
+{
+    static __thread int calls;
+    int i;
+    for (i = 0; i < n; i++)
+        counter++, zeroed[i % 100] += i;
+    return ++calls;
+}
+
+static void *worker(void *arg)
+{
+    int id = (int)(long)arg, sum = 0, i, r;
+
+    /* every thread starts from the initial image */
+    r = counter == 10 && big == 0x123456789abcLL && !strcmp(name, "main")
+        && pair.s == 3 && pair.d == 2.5 && &counter != main_counter;
+    for (i = 0; i < 100; i++)
+        sum += zeroed[i];
+    r = r && sum == 0;
+
+    sprintf(name, "worker%d", id);
+    big += id;
+    pair.d *= id;
+    bump(1000 * id);
+    bump(id);
+    if (counter != 10 + 1001 * id || name[6] != '0' + id)
+        r = 0;
+    return (void *)(long)(r && bump(0) == 3 && big == 0x123456789abcLL + id
+                          && pair.d == 2.5 * id);
+}
+
+int main(void)
+{
+    pthread_t th[4];
+    void *ret;
+    int i, *p;
+
+    main_counter = &counter;
+    strcpy(name, "main thread");
+    i = bump(5);
+    printf("%d %d\n", i, bump(7));
+    printf("%d %lld %s %d %d %.1f\n", counter, big, name,
+           zeroed[3], zeroed[6], pair.s + pair.d);
+
+    for (i = 0; i < 4; i++)
+        pthread_create(&th[i], NULL, worker, (void *)(long)i);
+    for (i = 0; i < 4; i++) {
+        pthread_join(th[i], &ret);
+        printf("thread %d: %s\n", i, ret ? "ok" : "failed");
+    }
+
+    /* unchanged by the other threads */
+    p = &counter;
+    *p += 100;
+    printf("%d %lld %s %d %d\n", counter, big, name, zeroed[3], bump(0));
+    return 0;
+}
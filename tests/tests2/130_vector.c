@@ -0,0 +1,107 @@
+/* GCC vector extensions: __attribute__((vector_size(N))) */
+extern int printf(const char *, ...);
+typedef int v4si __attribute__((vector_size(16)));
+typedef float v4sf __attribute__((vector_size(16)));
+typedef double v2df __attribute__((vector_size(16)));
+typedef unsigned char v16qu __attribute__((vector_size(16)));
+typedef short v8hi __attribute__((vector_size(16)));
+typedef long long v2di __attribute__((vector_size(16)));
+typedef unsigned v4su __attribute__((vector_size(16)));
+typedef int v2si __attribute__((vector_size(8)));
+typedef double v4df __attribute__((vector_size(32)));
+
+v4si add(v4si a, v4si b) { return a + b; }
+v4sf fma4(v4sf a, v4sf b, v4sf c) { return a * b + c; }
+v2si small(v2si a, int k) { return (a << k) - a; }
+v4df wide(v4df a, v4df b) { return a * b - 1; }
+
+/* structs with fields of vector type, then a vector comparison */
+struct vs1 { char c; v4si v; };
+struct vs2 { long x, y; v4si v; };
+static v4si self_eq(v4si a) { return a == a; }
+
+static void pi(const char *s, v4si v) { printf("%s: %d %d %d %d\n", s, v[0], v[1], v[2], v[3]); }
+static void pf(const char *s, v4sf v) { printf("%s: %g %g %g %g\n", s, v[0], v[1], v[2], v[3]); }
+
+int main(void)
+{
+    v4si a = {1, 2, 3, 4}, b = {10, -20, 30, -40}, c;
+    v4sf x = {1.5f, 2.5f, -3.0f, 0.0f}, y = {2, 2, 2, 2};
+    v2df d = {1.0, -2.0}, e;
+    v16qu q = {1,2,3,4,5,6,7,8,9,10,11,12,13,14,15,255};
+    v8hi h = {1, -2, 3, -4, 5, -6, 7, -8};
+    v2di l = {1LL << 40, -5};
+    v4su u = {1, 0x80000000u, 7, 0xffffffffu};
+    int i, k = 3;
+
+    pi("add", add(a, b));
+    pi("sub", a - b);
+    pi("mul", a * b);
+    pi("div", b / a);
+    pi("mod", b % a);
+    pi("and", a & b);
+    pi("or", a | b);
+    pi("xor", a ^ b);
+    pi("shl", a << 2);
+    pi("shlk", a << k);
+    pi("sar", b >> 1);
+    pi("sark", b >> k);
+    pi("shlv", a << a);
+    pi("neg", -a);
+    pi("not", ~a);
+    pi("scal", a + 1);
+    pi("scal2", 100 - a);
+    pi("lt", a < b);
+    pi("le", a <= 2);
+    pi("eq", a == 3);
+    pi("ne", a != 3);
+    pi("gt", a > b);
+    pi("ge", a >= b);
+    pf("fma", fma4(x, y, x));
+    pf("fdiv", x / y);
+    pf("fneg", -x);
+    pf("fsub", 1.0f - x);
+    pi("flt", x < y);
+    pi("fge", x >= y);
+    pi("fne", x != y);
+    e = d * d - 1.0;
+    printf("d: %g %g\n", e[0], e[1]);
+    c = (v4si)(d < 0.0);
+    pi("dlt", c);
+    q = q + q;
+    q >>= 1;
+    for (i = 0; i < 16; i++) printf("%d ", q[i]);
+    printf("\n");
+    h = h * h + h;
+    h = h >> 1;
+    for (i = 0; i < 8; i++) printf("%d ", h[i]);
+    printf("\n");
+    l = l * 3 + (l >> 2);
+    printf("%lld %lld\n", l[0], l[1]);
+    u = u >> 1;
+    printf("%u %u %u %u\n", u[0], u[1], u[2], u[3]);
+    pi("ucmp", (v4su){5, 6, 7, 8} > (v4su){6, 6, 0xffffffffu, 1});
+    a[2] = 99;
+    a += b;
+    a++;
+    pi("a", a);
+    c = a++;
+    pi("c", c);
+    pi("a", a);
+    {
+        v2si s = {3, -7};
+        v4df w = {1, 2, 3, 4}, z;
+        s = small(s, 2);
+        z = wide(w, w);
+        printf("%d %d %g %g %g %g\n", s[0], s[1], z[0], z[1], z[2], z[3]);
+    }
+    printf("%d %d %d %d\n", (int)sizeof(v4si), (int)__alignof__(v4si),
+           (int)sizeof(v2si), (int)sizeof(v4df));
+    {
+        struct vs1 s1 = { 1, {5, 6, 7, 8} };
+        struct vs2 s2 = { 2, 3, {9, 9, 9, 9} };
+        pi("eq", self_eq(s1.v) + s2.v);
+        printf("%d %d\n", (int)sizeof s1, (int)sizeof s2);
+    }
+    return 0;
+}
@@ -0,0 +1,194 @@
+/* 'return f(...);' as a jump (with -O) */
+extern int printf(const char *, ...);
+extern void *alloca(unsigned long);
+extern char *strcpy(char *, const char *);
+
+#define DEEP 3000000 /* too deep for the stack with real calls */
+
+static long sum(long n, long acc)
+{
+    if (n == 0)
+        return acc;
+    return sum(n - 1, acc + n);
+}
+
+int is_odd(unsigned n);
+int is_even(unsigned n)
+{
+    if (n == 0)
+        return 1;
+    return is_odd(n - 1);
+}
+int is_odd(unsigned n)
+{
+    if (n == 0)
+        return 0;
+    return is_even(n - 1);
+}
+
+/* a state machine in continuation style */
+typedef int (*state)(const char *s, int n);
+static int st_a(const char *s, int n);
+static int st_b(const char *s, int n);
+static state next_state(char c) { return c == 'a' ? st_a : st_b; }
+static int st_a(const char *s, int n)
+{
+    if (!*s)
+        return n;
+    return next_state(s[1])(s + 1, n + 1);
+}
+static int st_b(const char *s, int n)
+{
+    if (!*s)
+        return -n;
+    return next_state(s[1])(s + 1, n + 2);
+}
+static int count_down(int n, state f)
+{
+    if (n == 0)
+        return f("abba", 0);
+    return count_down(n - 1, f);
+}
+
+static double dsum(double x, int n)
+{
+    if (n == 0)
+        return x;
+    return dsum(x + 0.5, n - 1);
+}
+
+struct pair { long a, b; };
+static struct pair fib(long n, long a, long b)
+{
+    struct pair p;
+    if (n == 0) {
+        p.a = a, p.b = b;
+        return p;
+    }
+    return fib(n - 1, b, (a + b) % 1000003);
+}
+
+static long double ld(long double x, int n)
+{
+    if (n == 0)
+        return x;
+    return ld(x * 2, n - 1);
+}
+
+static unsigned to_unsigned(int n) { return n * 2u; }
+static int narrow(int n) { return to_unsigned(n); }
+
+/* callee saved registers are restored before the jump */
+static long loops(long n, long acc)
+{
+    long i;
+    for (i = 0; i < 3; i++)
+        acc += i * n;
+    if (n == 0)
+        return acc;
+    return loops(n - 1, acc % 1000);
+}
+
+static int peek(int *p) { return *p + 1; }
+static int addr_taken(int x)
+{
+    return peek(&x);
+}
+static int addr_taken_later(int n, int *p)
+{
+    int x = n;
+    if (p)
+        return peek(p);
+    return addr_taken_later(n - 1, &x);
+}
+static int use_alloca(int n)
+{
+    char *p = alloca(16);
+    strcpy(p, "xyz");
+    return peek((int *)p) - *(int *)p + n;
+}
+static int vla(int n)
+{
+    int a[n];
+    a[0] = n;
+    return peek(a);
+}
+
+static int cleaned;
+static void cleanup(int *p) { cleaned += *p; }
+static int with_cleanup(int n)
+{
+    int c __attribute__((cleanup(cleanup))) = n;
+    return peek(&cleaned);
+}
+
+static int say(const char *s, int n)
+{
+    return printf("%s %d\n", s, n);
+}
+
+static void vcount(int n, int *out);
+static void vstep(int n, int *out) { *out += 1; return vcount(n - 1, out); }
+static void vcount(int n, int *out)
+{
+    if (n > 0)
+        return vstep(n, out);
+}
+
+static int twice_calls;
+static int __attribute__((returns_twice, noinline)) twice(void)
+{
+    return twice_calls++;
+}
+static int with_twice(int x)
+{
+    int local = x + twice();
+    return narrow(local);
+}
+
+/* last: the libc header may hide __attribute__ from what follows */
+#include <setjmp.h>
+
+/* longjmp() comes back into the frame setjmp() saved */
+static jmp_buf jb;
+int jump_back(int x)
+{
+    volatile int pad[8] = { 0 }; /* over a frame left too early */
+    longjmp(jb, pad[0] + 1);
+    return x;
+}
+int with_setjmp(int x)
+{
+    int local = x * 3;
+    if (setjmp(jb))
+        return local + 1;
+    return jump_back(x);
+}
+
+int main(void)
+{
+    struct pair p;
+    int i, k = 0;
+
+    printf("%ld\n", sum(DEEP, 0));
+    printf("%d %d\n", is_even(DEEP), is_odd(DEEP));
+    printf("%d\n", count_down(DEEP, st_a));
+    printf("%g\n", dsum(0, DEEP));
+    p = fib(DEEP, 0, 1);
+    printf("%ld %ld\n", p.a, p.b);
+    printf("%Lg\n", ld(1, 100));
+    printf("%d\n", narrow(21));
+    for (i = 0; i < 3; i++)
+        k += loops(DEEP, i);
+    printf("%d\n", k);
+    printf("%d %d %d %d\n", addr_taken(1), addr_taken_later(5, 0),
+           use_alloca(7), vla(9));
+    k = with_cleanup(4);
+    printf("%d %d\n", k, cleaned);
+    printf("%d\n", say("chars", 5));
+    k = 0;
+    vcount(DEEP, &k);
+    printf("%d\n", k);
+    printf("%d %d\n", with_setjmp(5), with_twice(3));
+    return 0;
+}
@@ -0,0 +1,122 @@
+/* -fomit-frame-pointer: leaf functions with their locals below %rsp */
+extern int printf(const char *, ...);
+extern void qsort(void *, unsigned long, unsigned long,
+                  int (*)(const void *, const void *));
+
+struct pt { int x, y; };
+struct big { long a[4]; };
+
+static int cmp(const void *a, const void *b)
+{
+    int x = *(const int *)a, y = *(const int *)b;
+    return x < y ? -1 : x > y;
+}
+
+static int getx(const struct pt *p) { return p->x; }
+static void sety(struct pt *p, int y) { p->y = y; }
+
+static long many(long a, long b, long c, long d, long e, long f,
+                 long g, long h, int i)
+{
+    return a + b * 2 + c * 3 + d * 4 + e * 5 + f * 6 + g * 7 + h * 8 - i;
+}
+
+static double poly(double x, float y)
+{
+    double t = x * y;
+    return t * t + 1;
+}
+
+static long double ld(long double x) { long double y = x / 3; return y * 2; }
+
+/* conversions through the red zone, where the locals are */
+static long long f4(long double a, long long k)
+{
+    long long r = (long long)a;
+    return r + k;
+}
+static double f5(float f, unsigned u, double d)
+{
+    long double x = f, y = u;
+    d += (double)(x + y);
+    return d + (float)(x * 2);
+}
+
+static struct pt mkpt(int x, int y) { struct pt p; p.x = x; p.y = y; return p; }
+
+static struct big mkbig(long v)
+{
+    struct big b;
+    b.a[0] = v, b.a[1] = v + 1, b.a[2] = v * 2, b.a[3] = -v;
+    return b;
+}
+
+static int name(int c)
+{
+    switch (c) {
+    case 0: return 'a';
+    case 1: return 'b';
+    case 2: return 'c';
+    case 3: return 'd';
+    case 4: return 'e';
+    case 5: return 'f';
+    default: return '?';
+    }
+}
+
+static unsigned hash(const char *s)
+{
+    unsigned h = 5381;
+    while (*s)
+        h = h * 33 + *s++;
+    return h;
+}
+
+/* too big for the red zone: keeps its frame */
+static long wide(int n)
+{
+    long a[32];
+    int i;
+    for (i = 0; i < 32; i++)
+        a[i] = i * n;
+    return a[n & 31] + a[31];
+}
+
+/* not leaf functions */
+static int vla(int n)
+{
+    int a[n], i;
+    for (i = 0; i < n; i++)
+        a[i] = i * i;
+    return a[n - 1];
+}
+
+static int fact(int n)
+{
+    return n <= 1 ? 1 : n * fact(n - 1);
+}
+
+int main(void)
+{
+    int v[] = { 5, -2, 9, 0, 3, 3, -7 };
+    struct pt p = { 4, 5 };
+    struct big b;
+    int i;
+
+    qsort(v, 7, sizeof *v, cmp);
+    for (i = 0; i < 7; i++)
+        printf("%d ", v[i]);
+    printf("\n");
+    sety(&p, 11);
+    printf("%d %d\n", getx(&p), p.y);
+    printf("%ld\n", many(1, 2, 3, 4, 5, 6, 7, 8, 9));
+    printf("%g %Lg\n", poly(1.5, 2.0f), ld(4.5L));
+    p = mkpt(-3, 8);
+    b = mkbig(6);
+    printf("%d %d %ld %ld %ld %ld\n", p.x, p.y, b.a[0], b.a[1], b.a[2], b.a[3]);
+    for (i = -1; i < 7; i++)
+        printf("%c", name(i));
+    printf("\n%u %ld %d %d\n", hash("frame"), wide(5), vla(6), fact(6));
+    printf("%lld %g\n", f4(2.5L, 10), f5(1.5f, 4000000000u, 0.25));
+    return 0;
+}
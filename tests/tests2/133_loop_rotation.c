@@ -0,0 +1,202 @@
+/* -O: while and for loops with the condition at the bottom */
+#include <stdio.h>
+
+static int evals;
+static int lt(int a, int b) { evals++; return a < b; }
+
+static int sum_for(int n)
+{
+    int i, s = 0;
+    for (i = 0; lt(i, n); i++)
+        s += i;
+    return s;
+}
+
+static int sum_while(int n)
+{
+    int s = 0;
+    while (lt(0, n))
+        s += n--;
+    return s;
+}
+
+static int jumps(int n)
+{
+    int i, s = 0;
+    for (i = 0; i < n; i++) {
+        if (i & 1)
+            continue;
+        if (i == 40)
+            break;
+        s += i;
+    }
+    while (n-- > 0) {
+        if (n % 3 == 0)
+            continue;
+        if (n == 2)
+            break;
+        s += n;
+    }
+    return s * 1000 + n;
+}
+
+static int commas(int n)
+{
+    int i, j, s = 0;
+    for (i = 0, j = n; s += 1, i < j; i++, j--)
+        s += j - i;
+    while (i--, j++, i > 0)
+        s++;
+    return s;
+}
+
+static int nested(int n)
+{
+    int i, j, k = 0;
+    for (i = 0; i < n; i++)
+        for (j = i; j < n; j++) {
+            if (j == 7)
+                break;
+            while (k < i * j)
+                k += 3;
+        }
+    return k;
+}
+
+static int stmt_expr(int n)
+{
+    int s = 0;
+    while (({ int t = n; n--; t > 0; }))
+        s += n;
+    for (n = 0; ({ int u = n * n; u < 50; }); n = ({ n + 2; }))
+        s += n;
+    return s;
+}
+
+static int constants(void)
+{
+    int s = 0;
+    for (;;)
+        if (++s == 5)
+            break;
+    while (1)
+        if (s++ > 10)
+            break;
+    for (; 1; s++)
+        if (s > 20)
+            break;
+    while (0)
+        s = -1;
+    for (; 0;)
+        s = -2;
+    return s;
+}
+
+static int empty(int n)
+{
+    int i;
+    for (i = 0; i < n; i++)
+        ;
+    while (--n > 3)
+        ;
+    return i * 10 + n;
+}
+
+static int with_goto(int n)
+{
+    int s = 0;
+    goto inside;
+    while (n > 0) {
+        s += 10;
+inside:
+        s++;
+        n--;
+    }
+    return s;
+}
+
+static int decl_scope(int n)
+{
+    int s = 0;
+    for (int i = 0, j = 1; i < n; i++, j *= 2) {
+        int k = i * j;
+        s += k;
+    }
+    for (int i = n; i; i--) {
+        int vla[i];
+        vla[i - 1] = i;
+        s += vla[i - 1];
+    }
+    return s;
+}
+
+static int in_switch(int n)
+{
+    int s = 0, i;
+    for (i = 0; i < n; i++) {
+        switch (i % 4) {
+        case 0:
+            continue;
+        case 1:
+            s += 1;
+            break;
+        default:
+            s += 10;
+        }
+        s += 100;
+    }
+    return s;
+}
+
+#define LOOP(v, n) for (v = 0; v < (n); v++)
+static int from_macro(int n)
+{
+    int i, j, s = 0;
+    LOOP(i, n) LOOP(j, i) s += j;
+    return s;
+}
+
+static int dead(int n)
+{
+    if (n)
+        return n;
+    return -1;
+    while (n < 10)
+        n++;
+    return n;
+}
+
+static int lines(void)
+{
+    int l = 0, i;
+    for (i = 0; i < __LINE__ - 160; i++)
+        l++;
+    while (l < __LINE__)
+        l += 3;
+    return l;
+}
+
+int main(void)
+{
+    int r;
+
+    r = sum_for(10);
+    printf("%d %d\n", r, evals);
+    r = sum_while(10);
+    printf("%d %d\n", r, evals);
+    r = sum_for(0);
+    printf("%d %d\n", r, evals);
+    printf("%d %d\n", jumps(100), jumps(1));
+    printf("%d %d\n", commas(7), commas(0));
+    printf("%d %d\n", nested(5), nested(12));
+    printf("%d\n", stmt_expr(4));
+    printf("%d\n", constants());
+    printf("%d %d\n", empty(6), empty(0));
+    printf("%d %d\n", with_goto(3), with_goto(0));
+    printf("%d\n", decl_scope(5));
+    printf("%d\n", in_switch(10));
+    printf("%d\n", from_macro(6));
+    printf("%d\n", dead(3));
+    printf("%d\n", lines());
+    return 0;
+}
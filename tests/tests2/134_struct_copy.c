@@ -0,0 +1,96 @@
+/* struct assignment and clearing of small structs without memmove/memset */
+#include <stdio.h>
+#include <string.h>
+
+#define S(n) struct s##n { unsigned char a[n]; }
+S(1); S(2); S(3); S(5); S(7); S(8); S(12); S(15); S(16); S(17);
+S(24); S(31); S(33); S(48); S(63); S(64); S(65); S(100); S(127);
+S(128); S(129); S(200);
+
+static unsigned sum;
+
+static void fill(void *p, int n, int k)
+{
+    unsigned char *c = p;
+    int i;
+    for (i = 0; i < n; i++)
+        c[i] = i * 7 + k;
+}
+
+static void check(const char *what, void *p, void *q, int n)
+{
+    unsigned char *c = p;
+    int i;
+    if (memcmp(p, q, n))
+        printf("%s %d: differs\n", what, n);
+    for (i = 0; i < n; i++)
+        sum = sum * 31 + c[i];
+}
+
+#define T(n) { \
+    struct s##n a, b, c, *p = &b, *q = &c; \
+    unsigned char guard[2][n + 2]; \
+    fill(&a, n, n); \
+    b = a; check("local", &a, &b, n); \
+    *q = *p; check("pointer", &a, &c, n); \
+    fill(&c, n, 1); *p = c; check("from local", &b, &c, n); \
+    *p = *p; check("self", &b, &c, n); \
+    memset(guard, 0x55, sizeof guard); \
+    *(struct s##n *)(guard[0] + 1) = a; \
+    check("unaligned", guard[0] + 1, &a, n); \
+    if (guard[0][0] != 0x55 || guard[0][n + 1] != 0x55) \
+        printf("%d: wrote outside\n", n); \
+    { struct s##n z = {0}; memset(&a, 0, n); check("zero", &z, &a, n); } \
+}
+
+struct kv { long k, v; };
+struct mixed { char c; short s; int i; long long l; double d; char tail[3]; };
+
+static struct kv swap(struct kv x)
+{
+    struct kv y;
+    y.k = x.v, y.v = x.k;
+    return y;
+}
+
+static struct mixed make(int n)
+{
+    struct mixed m = { n, n * 2, n * 3, n * 4LL, n / 2.0, "ab" };
+    return m;
+}
+
+struct packed { char c; int i; long long l; } __attribute__((packed));
+struct with_bits { unsigned a:3, b:17; char s[9]; };
+
+int main(void)
+{
+    struct kv tab[8], t;
+    struct mixed m, ms[3];
+    struct packed pk1 = { 1, 2, 3 }, pk2;
+    struct with_bits wb1 = { 5, 1000, "bits" }, wb2;
+    int i;
+
+    T(1) T(2) T(3) T(5) T(7) T(8) T(12) T(15) T(16) T(17)
+    T(24) T(31) T(33) T(48) T(63) T(64) T(65) T(100) T(127)
+    T(128) T(129) T(200)
+    printf("%08x\n", sum);
+
+    for (i = 0; i < 8; i++)
+        tab[i].k = i, tab[i].v = i * i;
+    for (i = 7; i > 0; i--)
+        tab[i] = tab[i - 1];
+    t = swap(tab[7]);
+    printf("%ld %ld %ld\n", tab[7].k, t.k, t.v);
+
+    m = make(5);
+    ms[0] = ms[1] = ms[2] = m;
+    printf("%d %d %d %lld %g %s\n", ms[2].c, ms[1].s, ms[0].i, ms[2].l,
+           ms[1].d, ms[0].tail);
+    m = (struct mixed){ .i = 9 };
+    printf("%d %d %s\n", m.c, m.i, m.tail);
+
+    pk2 = pk1;
+    wb2 = wb1;
+    printf("%d %d %lld %u %u %s\n", pk2.c, pk2.i, pk2.l, wb2.a, wb2.b, wb2.s);
+    return 0;
+}
@@ -0,0 +1,147 @@
+/* -O: calls to small static functions expanded in place */
+extern int printf(const char *, ...);
+
+struct point { int x, y; };
+
+static int calls;
+
+static int min(int a, int b) { return a < b ? a : b; }
+static inline int max(int a, int b) { if (a > b) return a; return b; }
+static int getx(const struct point *p) { return p->x; }
+static void bump(int *v) { (*v)++; }
+static int has_bit(unsigned f, int n) { return (f >> n) & 1; }
+static int count(int v) { calls++; return v; }
+
+/* parameters are copies, assigned or not */
+static int twice(int x) { x *= 2; return x; }
+static int through_ptr(int x) { int *p = &x; *p += 1; return x; }
+static int nothing(int x) { return 0; }
+
+/* the body sees its own names, not those of the caller */
+static int g = 7;
+static int get_g(void) { return g; }
+static int local_x(int n) { int x = n * 3; return x; }
+typedef int T;
+enum { E = 7 };
+struct tag { int a; };
+static int use_t(int n) { T t = n; return t; }
+static int use_e(int n) { return n + E; }
+static int use_tag(void) { return sizeof(struct tag); }
+
+static struct point swap(struct point p)
+{
+    struct point q;
+    q.x = p.y, q.y = p.x;
+    return q;
+}
+
+static int classify(int v)
+{
+    switch (v) {
+    case 0: return 10;
+    case 1: return 20;
+    }
+    return v < 0 ? -1 : 30;
+}
+
+static int sum_to(int n)
+{
+    int i, s = 0;
+    for (i = 0; i < n; i++) {
+        if (i == 6)
+            break;
+        if (i & 1)
+            continue;
+        s += i;
+    }
+    return s;
+}
+
+static int jump(int n)
+{
+    int s = 0;
+again:
+    s += n;
+    if (--n > 0)
+        goto again;
+    return s;
+}
+
+static int vla(int n) { int a[n]; a[n - 1] = n; return a[n - 1] + 1; }
+static int stmt_expr(int x) { return ({ int y = x * 2; y + 1; }); }
+static void set(int *p, int v) { if (!p) return; *p = v; }
+static unsigned char low(int v) { return v; }
+static long long mul(long long a, long long b) { return a * b; }
+static double half(double d) { return d / 2; }
+static const char *name(void) { return __func__; }
+
+static int cleaned;
+static void cleanup(int *p) { cleaned += *p; }
+static int with_cleanup(int n)
+{
+    int c __attribute__((cleanup(cleanup))) = n;
+    return n + 1;
+}
+
+/* recursion is left alone */
+static int fact(int n) { return n <= 1 ? 1 : n * fact(n - 1); }
+static int is_even(int n);
+static int is_odd(int n) { return n ? is_even(n - 1) : 0; }
+static int is_even(int n) { return n ? is_odd(n - 1) : 1; }
+
+/* calls in tail position stay jumps */
+static void down(int n, int *out);
+static void step(int n, int *out) { *out += 1; return down(n - 1, out); }
+static void down(int n, int *out) { if (n > 0) return step(n, out); }
+
+static inline __attribute__((always_inline)) int big(int a)
+{
+    int s = 0;
+    s += a * 1; s += a * 2; s += a * 3; s += a * 4; s += a * 5;
+    s += a * 6; s += a * 7; s += a * 8; s += a * 9; s += a * 10;
+    return s;
+}
+
+static __attribute__((noinline)) int kept(int a) { return a + 1; }
+
+int main(void)
+{
+    struct point p = { 3, 4 }, q;
+    int g = 100, i, s = 0, v = 0;
+
+    for (i = 0; i < 10; i++)
+        s += min(i, 5) + max(i, 3);
+    bump(&s);
+    printf("%d %d %d %d\n", s, getx(&p), has_bit(10, 1), has_bit(10, 2));
+    printf("%d %d %d %d\n", twice(21), twice(g), through_ptr(1), nothing(count(1)));
+    printf("%d %d %d %d\n", get_g(), g, local_x(2), calls);
+    {
+        typedef char T;
+        enum { E = 100 };
+        struct tag { char b[40]; };
+        T c = 1;
+        printf("%d %d %d %d %d\n", use_t(300), use_e(1), use_tag(),
+               (int)sizeof(T) + c, E);
+    }
+    q = swap(p);
+    printf("%d %d %d\n", q.x, q.y, swap(q).x);
+    printf("%d %d %d %d\n", classify(0), classify(1), classify(-5), classify(9));
+    printf("%d %d %d %d\n", sum_to(10), jump(4), vla(3), stmt_expr(4));
+    set(&v, 9);
+    set(0, 1);
+    printf("%d %d %lld %g %s\n", v, low(300), mul(1 << 20, 1 << 20), half(3), name());
+    i = with_cleanup(4);
+    printf("%d %d\n", i, cleaned);
+    printf("%d %d %d\n", fact(6), is_even(10), is_odd(7));
+    v = 0;
+    down(3000000, &v);
+    printf("%d\n", v);
+    printf("%d %d\n", big(2), kept(1));
+    if (0 && count(1))
+        printf("never\n");
+    if (v || count(2))
+        printf("%d\n", calls);
+    s = min(max(count(8), 2), 5) * 10 + min(1, 2);
+    printf("%d %d\n", s, calls);
+    return 0;
+}
@@ -0,0 +1,184 @@
+/* -O: branches __builtin_expect says are unlikely are laid out at the
+   end of the function; the results must not change */
+extern int printf(const char *, ...);
+
+#define likely(x) __builtin_expect(!!(x), 1)
+#define unlikely(x) __builtin_expect(!!(x), 0)
+
+static int errors;
+
+static int __attribute__((cold, noinline)) fail(const char *what, int v)
+{
+    printf("fail %s %d\n", what, v);
+    return ++errors;
+}
+
+static int check(int v)
+{
+    if (unlikely(v < 0))
+        return fail("negative", v);
+    if (unlikely(v > 100)) {
+        fail("large", v);
+        v = 100;
+    }
+    return v;
+}
+
+static int pick(int v)
+{
+    int r;
+    if (likely(v & 1))
+        r = v * 3;
+    else
+        r = -v;
+    if (unlikely(v == 4))
+        r = 44;
+    else if (v == 6)
+        r = 66;
+    else
+        r += 1;
+    return r;
+}
+
+/* cold block using locals of several scopes, some shadowed */
+static int scopes(int n)
+{
+    int i, s = 0, x = 5;
+    for (i = 0; i < n; i++) {
+        int x = i * 2;
+        if (unlikely(i % 7 == 3)) {
+            int t = x + s;
+            s = t ^ x;
+        }
+        s += x;
+    }
+    return s + x;
+}
+
+static int with_goto(const char *p)
+{
+    int n = 0;
+    while (*p) {
+        if (unlikely(*p == '!'))
+            goto out;
+        n++, p++;
+    }
+    return n;
+out:
+    return -n;
+}
+
+/* break/continue/case must stay where they are */
+static int loops(int n)
+{
+    int i, s = 0;
+    for (i = 0; i < n; i++) {
+        if (unlikely(i == 50))
+            break;
+        if (unlikely(i & 8))
+            continue;
+        switch (i & 3) {
+        case 0:
+            if (unlikely(i == 16)) {
+            case 3:
+                s += 1000;
+            }
+            break;
+        default:
+            s += i;
+        }
+    }
+    return s;
+}
+
+static long nested(long a, long b)
+{
+    long r = 0;
+    if (unlikely(a > b)) {
+        if (unlikely(a > 2 * b))
+            return a - b;
+        if (likely(b))
+            r = a / b;
+        else
+            r = -1;
+    } else if (unlikely(a == b)) {
+        r = 7;
+    } else {
+        r = b - a;
+    }
+    return r * 10;
+}
+
+static int calls;
+
+static long counted(long v)
+{
+    calls++;
+    return v;
+}
+
+static int values(int v)
+{
+    int r = __builtin_expect(v, 3);
+    if (__builtin_expect(v > 10, 0) ? v : 0)
+        r++;
+    if (unlikely(v == 2) && v)
+        r += 100;
+    if (__builtin_expect(v, 0) + 1 == 3)
+        r += 1000;
+    if (__builtin_expect(v > 4, counted(v & 1)))
+        r += 10000;
+    return r;
+}
+
+/* the hot path leaves with the epilogue, the cold block comes after */
+static __attribute__((noinline)) int hot(int v)
+{
+    if (unlikely(v < 0)) {
+        fail("hot", v);
+        v = 0;
+    }
+    return v + 1;
+}
+
+static int layout(void)
+{
+#if defined __SWIRLC__ && defined __x86_64__
+    const unsigned char *p = (const unsigned char *)hot;
+    int i;
+    for (i = 0; i < 100; i++) {
+        if (p[i] == 0xc3) /* ret */
+            return 1;
+        if (p[i] == 0xe8 || p[i] == 0xe9) /* call, jmp */
+            return 0;
+    }
+    return 0;
+#else
+    return 1;
+#endif
+}
+
+int main(void)
+{
+    int i;
+    long s;
+
+    i = check(5);
+    i = i * 1000 + check(-3);
+    printf("%d %d\n", i, check(500));
+    for (i = 0; i < 8; i++)
+        printf("%d ", pick(i));
+    printf("\n%d %d %d\n", scopes(0), scopes(10), scopes(30));
+    printf("%d %d\n", with_goto("hello"), with_goto("he!llo"));
+    printf("%d %d %d\n", loops(10), loops(30), loops(100));
+    for (s = 0, i = 0; i < 30; i++)
+        s = s * 3 + nested(i % 9, i % 5);
+    printf("%ld %ld %ld\n", s, nested(3, 0), nested(9, 2));
+    for (i = 0; i < 14; i += 2)
+        printf("%d ", values(i));
+    printf("\ncalls %d errors %d\n", calls, errors);
+    i = hot(4);
+    i = i * 10 + hot(-4);
+    printf("%d layout %d\n", i, layout());
+    return 0;
+}
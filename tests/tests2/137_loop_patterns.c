@@ -0,0 +1,147 @@
+/* -O: byte copy and fill loops done by memmove/memset, with the results
+   of the loops as written */
+#include <stdio.h>
+#include <string.h>
+
+static unsigned sum;
+
+static void show(const char *what, const void *p, int n)
+{
+    const unsigned char *c = p;
+    int i;
+    printf("%s:", what);
+    for (i = 0; i < n; i++)
+        printf(" %d", c[i]);
+    printf("\n");
+}
+
+static void copy(char *d, const char *s, int n)
+{
+    int i;
+    for (i = 0; i < n; i++)
+        d[i] = s[i];
+    sum = sum * 31 + i;
+}
+
+static void fill(unsigned char *p, unsigned long n, int *last)
+{
+    unsigned long i;
+    for (i = 0; i < n; ++i)
+        p[i] = 0xab;
+    *last = i;
+}
+
+static int shorts(short *d, short *s, long n)
+{
+    long i = 2;
+    for (; i < n; i += 1) {
+        d[i] = s[i];
+    }
+    return i;
+}
+
+static int zero(double *d, int n)
+{
+    int i;
+    for (i = 0; i < n; i++)
+        d[i] = 0;
+    return i;
+}
+
+static int signs(int from, unsigned n)
+{
+    unsigned char buf[8];
+    int i;
+    memset(buf, 1, sizeof buf);
+    for (i = from; i < 8; i++)
+        buf[i] = -1;
+    show("signs", buf, 8);
+    for (i = from; i < n && i < 8; i++)
+        buf[i] = 2;
+    return i;
+}
+
+/* the stores might change the bound: left alone */
+int gn = 4;
+static int global_n(char *d)
+{
+    int i;
+    for (i = 0; i < gn; i++)
+        d[i] = 0;
+    return i;
+}
+static int taken_n(void)
+{
+    int i, n = 4;
+    char *d = (char *)&n;
+    for (i = 0; i < n; i++)
+        d[i] = 0;
+    return i;
+}
+
+int main(void)
+{
+    char a[20], b[20];
+    unsigned char c[16];
+    short s1[6] = { 1, 2, 3, 4, 5, 6 }, s2[6] = { 0 };
+    double dd[4] = { 1, 2, 3, 4 };
+    char *p;
+    int i, j, last;
+
+    for (i = 0; i < 20; i++)
+        a[i] = i + 1;
+    copy(b, a, 20);
+    show("copy", b, 20);
+    copy(b, a, 0);
+    copy(b, a, -5);
+
+    /* overlapping: the loop smears forwards, memmove would not */
+    copy(a + 1, a, 10);
+    show("smear", a, 20);
+    copy(b, b + 3, 10);
+    show("down", b, 20);
+    copy(b, b, 20);
+    show("same", b, 20);
+
+    memset(c, 0, sizeof c);
+    fill(c, 10, &last);
+    show("fill", c, 16);
+    printf("last %d\n", last);
+    fill(c, 0, &last);
+    printf("last %d\n", last);
+
+    printf("shorts %d\n", shorts(s2, s1, 6));
+    show("shorts", s2, sizeof s2);
+    i = zero(dd, 3);
+    printf("zero %d %g %g\n", i, dd[2], dd[3]);
+
+    printf("signs %d\n", signs(3, 6));
+    printf("signs %d\n", signs(-2, 2));
+
+    /* arrays, constant bound, loop variable declared in the loop */
+    for (j = 0; j < 16; j++)
+        c[j] = j * 3;
+    for (int k = 4; k < 12; k++)
+        b[k] = c[k];
+    show("array", b, 20);
+    for (j = 0; j < 16; j++)
+        c[j] = 'x';
+    show("chars", c, 16);
+
+    /* not matched: different index, side effects, wider stride */
+    p = a;
+    for (i = 0; i < 10; i++)
+        p[i] = p[i + 1];
+    for (i = 0, j = 3; i < 5; i++)
+        b[i] = a[j++];
+    for (i = 0; i < 10; i += 2)
+        b[i] = 0;
+    show("other", a, 20);
+    show("other", b, 20);
+    printf("%d %d %08x\n", i, j, sum);
+
+    i = global_n((char *)&gn);
+    printf("gn %d %d\n", i, gn);
+    printf("taken %d\n", taken_n());
+    return 0;
+}
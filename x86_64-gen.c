@@ -40,6 +40,7 @@ enum {
     TREG_RAX = 0,
     TREG_RCX = 1,
     TREG_RDX = 2,
+    TREG_RBX = 3,
     TREG_RSP = 4,
     TREG_RSI = 6,
     TREG_RDI = 7,
@@ -48,6 +49,10 @@ enum {
     TREG_R9  = 9,
     TREG_R10 = 10,
     TREG_R11 = 11,
+    TREG_R12 = 12,
+    TREG_R13 = 13,
+    TREG_R14 = 14,
+    TREG_R15 = 15,
 
     TREG_XMM0 = 16,
     TREG_XMM1 = 17,
@@ -87,6 +92,32 @@ enum {
 /* define if return values need to be extended explicitely
    at caller side (for interfacing with non-SWIRL compilers) */
 #define PROMOTE_RET
+
+#ifndef SWIRL_TARGET_PE
+/* with -O, scalar locals may live in callee saved registers */
+#define CONFIG_SWIRL_REGVARS
+/* with -O, functions are cleaned up after code generation */
+#define CONFIG_SWIRL_PEEPHOLE
+/* with -O, calls in tail position may be jumps */
+#define CONFIG_SWIRL_TAILCALL
+/* with -fomit-frame-pointer, small leaf functions get no frame */
+#define CONFIG_SWIRL_NOFRAME
+/* returns may get their own copy of the epilogue */
+#define CONFIG_SWIRL_RETSITE
+#endif
+
+/* __builtin_popcount & co are open coded */
+#define CONFIG_SWIRL_BITOPS
+/* atomic operations are open coded */
+#define CONFIG_SWIRL_ATOMIC
+/* 128-bit vector operations use SSE2 */
+#define CONFIG_SWIRL_SIMD
+/* struct copies and clears up to that size are open coded */
+#define CONFIG_SWIRL_STRUCT_COPY 128
+/* thread-local variables (ELF only) */
+#if !defined SWIRL_TARGET_PE && !defined SWIRL_TARGET_MACHO
+# define CONFIG_SWIRL_THREAD_LOCAL
+#endif
 /******************************************************/
 #else /* ! TARGET_DEFS_ONLY */
 /******************************************************/
@@ -130,17 +161,21 @@ ST_DATA const int reg_classes[NB_REGS] = {
     /* st0 */ RC_ST0
 };
 
-static unsigned long func_sub_sp_offset;
-static int func_ret_sub;
+static ST_TLS unsigned long func_sub_sp_offset;
+#ifdef CONFIG_SWIRL_NOFRAME
+/* sib bytes of the disp(%rbp) operands, to rebase them on %rsp */
+static ST_TLS int *noframe_sites, nb_noframe_sites;
+#endif
+static ST_TLS int func_ret_sub;
 
 #if defined(CONFIG_SWIRL_BCHECK)
-static addr_t func_bound_offset;
-static unsigned long func_bound_ind;
+static ST_TLS addr_t func_bound_offset;
+static ST_TLS unsigned long func_bound_ind;
 ST_DATA int func_bound_add_epilog;
 #endif
 
 #ifdef SWIRL_TARGET_PE
-static int func_scratch, func_alloca;
+static ST_TLS int func_scratch, func_alloca;
 #endif
 
 /* XXX: make it faster ? */
@@ -164,6 +199,15 @@ ST_FUNC void o(unsigned int c)
     }
 }
 
+/* pushes and scratch in the red zone below %rsp need a frame, the
+   locals of a frameless function live there */
+static void gen_rsp_scratch(void)
+{
+#ifdef CONFIG_SWIRL_NOFRAME
+    func_noframe = 0;
+#endif
+}
+
 ST_FUNC void gen_le16(int v)
 {
     g(v);
@@ -296,6 +340,22 @@ static void gen_modrm_impl(int op_reg, int r, Sym *sym, int c, int is_got)
 	    }
 	}
     } else if ((r & VT_VALMASK) == VT_LOCAL) {
+#ifdef CONFIG_SWIRL_NOFRAME
+        if (func_noframe && !nocode_wanted) {
+            /* disp(%rbp) the long way, same size as disp(%rsp) */
+            if ((nb_noframe_sites & 63) == 0)
+                noframe_sites = swirl_realloc(noframe_sites,
+                    (nb_noframe_sites + 64) * sizeof *noframe_sites);
+            o((c == (char)c ? 0x44 : 0x84) | op_reg);
+            noframe_sites[nb_noframe_sites++] = ind;
+            g(0x25);
+            if (c == (char)c)
+                g(c);
+            else
+                gen_le32(c);
+            return;
+        }
+#endif
         /* currently, we use only ebp as base */
         if (c == (char)c) {
             /* short reference */
@@ -334,6 +394,77 @@ static void gen_modrm64(int opcode, int op_reg, int r, Sym *sym, int c)
 }
 
 
+#ifdef CONFIG_SWIRL_REGVARS
+#define NB_REGVARS 5
+#define REGVAR_SAVE_SIZE 9 /* push %rbx; push %r12 ... push %r15 */
+static const unsigned char regvar_regs[NB_REGVARS] = {
+    TREG_RBX, TREG_R12, TREG_R13, TREG_R14, TREG_R15
+};
+/* frame offset of the local held by each register, 0 if free */
+static ST_TLS int regvar_loc[NB_REGVARS];
+/* registers 0 .. regvar_used - 1 must be saved by the function */
+static ST_TLS int regvar_used;
+
+static int regvar_find(int c)
+{
+    int i;
+    for (i = 0; i < regvar_used; i++)
+        if (regvar_loc[i] == c)
+            return regvar_regs[i];
+    return -1;
+}
+
+/* keep the local at frame offset 'c' in a callee saved register.  For
+   parameters, load it from its stack slot. */
+ST_FUNC int gen_regvar(int c, int is_param)
+{
+    int i, r;
+    for (i = 0; i < NB_REGVARS; i++)
+        if (regvar_loc[i] == 0)
+            break;
+    if (i == NB_REGVARS)
+        return 0;
+    regvar_loc[i] = c;
+    if (i >= regvar_used)
+        regvar_used = i + 1;
+    r = regvar_regs[i];
+    if (is_param)
+        gen_modrm64(0x8b, r, VT_LOCAL, NULL, c); /* mov c(%rbp), r */
+    return 1;
+}
+
+/* fill 0 .. 9 bytes with one nop instruction */
+static void gen_nops(int n)
+{
+    static const unsigned char nops[] =
+        "\x90" "\x66\x90" "\x0f\x1f\x00" "\x0f\x1f\x40\x00"
+        "\x0f\x1f\x44\x00\x00" "\x66\x0f\x1f\x44\x00\x00"
+        "\x0f\x1f\x80\x00\x00\x00\x00"
+        "\x0f\x1f\x84\x00\x00\x00\x00\x00"
+        "\x66\x0f\x1f\x84\x00\x00\x00\x00\x00";
+    const unsigned char *p = nops + n * (n - 1) / 2;
+    while (n--)
+        g(*p++);
+}
+
+/* reload the saved registers, before 'leave' */
+static void gen_regvar_restore(void)
+{
+    int i;
+    for (i = 0; i < regvar_used; i++) /* mov -8*(i+1)(%rbp), reg */
+        gen_modrm64(0x8b, regvar_regs[i], VT_LOCAL, NULL, -8 * (i + 1));
+}
+
+/* the local at 'c' goes out of scope */
+ST_FUNC void gen_regvar_free(int c)
+{
+    int i;
+    for (i = 0; i < regvar_used; i++)
+        if (regvar_loc[i] == c)
+            regvar_loc[i] = 0;
+}
+#endif
+
 /* load 'r' from value 'sv' */
 void load(int r, SValue *sv)
 {
@@ -371,6 +502,29 @@ void load(int r, SValue *sv)
 #endif
 
     v = fr & VT_VALMASK;
+#ifdef CONFIG_SWIRL_REGVARS
+    if (v == VT_LOCAL && (fr & VT_LVAL) && regvar_used) {
+        int rv = regvar_find(fc), b = 0;
+        if (rv >= 0) {
+            if ((ft & VT_TYPE) == VT_BYTE || (ft & VT_TYPE) == VT_BOOL)
+                b = 0xbe0f;   /* movsbl */
+            else if ((ft & VT_TYPE) == (VT_BYTE | VT_UNSIGNED))
+                b = 0xb60f;   /* movzbl */
+            else if ((ft & VT_TYPE) == VT_SHORT)
+                b = 0xbf0f;   /* movswl */
+            else if ((ft & VT_TYPE) == (VT_SHORT | VT_UNSIGNED))
+                b = 0xb70f;   /* movzwl */
+            if (b) {
+                orex(0, rv, r, b);
+                o(0xc0 + REG_VALUE(rv) + REG_VALUE(r) * 8);
+            } else {
+                orex(is64_type(ft), r, rv, 0x89);
+                o(0xc0 + REG_VALUE(r) + REG_VALUE(rv) * 8); /* mov rv, r */
+            }
+            return;
+        }
+    }
+#endif
     if (fr & VT_LVAL) {
         int b, ll;
         if (v == VT_LLOCAL) {
@@ -418,6 +572,9 @@ void load(int r, SValue *sv)
         } else if ((ft & VT_BTYPE) == VT_DOUBLE) {
             b = 0x7e0ff3; /* movq */
             r = REG_VALUE(r);
+        } else if ((ft & VT_BTYPE) == VT_QVEC) {
+            b = 0x6f0ff3; /* movdqu */
+            r = REG_VALUE(r);
         } else if ((ft & VT_BTYPE) == VT_LDOUBLE) {
             b = 0xdb, r = 5; /* fldt */
         } else if ((ft & VT_TYPE) == VT_BYTE || (ft & VT_TYPE) == VT_BOOL) {
@@ -472,6 +629,9 @@ void load(int r, SValue *sv)
                 gen_le32(fc);
             }
         } else if (v == VT_LOCAL) {
+#ifdef CONFIG_SWIRL_TAILCALL
+            func_addr_taken = 1;
+#endif
             orex(1,0,r,0x8d); /* lea xxx(%ebp), r */
             gen_modrm(r, VT_LOCAL, sv->sym, fc);
         } else if (v == VT_CMP) {
@@ -503,6 +663,7 @@ void load(int r, SValue *sv)
             if ((r >= TREG_XMM0) && (r <= TREG_XMM7)) {
                 if (v == TREG_ST0) {
                     /* gen_cvt_ftof(VT_DOUBLE); */
+                    gen_rsp_scratch();
                     o(0xf0245cdd); /* fstpl -0x10(%rsp) */
                     /* movsd -0x10(%rsp),%xmmN */
                     o(0x100ff2);
@@ -512,6 +673,8 @@ void load(int r, SValue *sv)
                     assert((v >= TREG_XMM0) && (v <= TREG_XMM7));
                     if ((ft & VT_BTYPE) == VT_FLOAT) {
                         o(0x100ff3);
+                    } else if ((ft & VT_BTYPE) == VT_QVEC) {
+                        o(0x280f); /* movaps */
                     } else {
                         assert((ft & VT_BTYPE) == VT_DOUBLE);
                         o(0x100ff2);
@@ -521,6 +684,7 @@ void load(int r, SValue *sv)
             } else if (r == TREG_ST0) {
                 assert((v >= TREG_XMM0) && (v <= TREG_XMM7));
                 /* gen_cvt_ftof(VT_LDOUBLE); */
+                gen_rsp_scratch();
                 /* movsd %xmmN,-0x10(%rsp) */
                 o(0x110ff2);
                 o(0x44 + REG_VALUE(r)*8); /* %xmmN */
@@ -555,6 +719,18 @@ void store(int r, SValue *v)
     ft &= ~(VT_VOLATILE | VT_CONSTANT);
     bt = ft & VT_BTYPE;
 
+#ifdef CONFIG_SWIRL_REGVARS
+    if (fr == VT_LOCAL && (v->r & VT_LVAL) && regvar_used) {
+        int rv = regvar_find(fc);
+        if (rv >= 0) {
+            /* the high bits of narrower types are never read */
+            orex(is64_type(bt), rv, r, 0x89);
+            o(0xc0 + REG_VALUE(rv) + REG_VALUE(r) * 8); /* mov r, rv */
+            return;
+        }
+    }
+#endif
+
 #ifndef SWIRL_TARGET_PE
     /* we need to access the variable via got */
     if (fr == VT_CONST && (v->r & VT_SYM)) {
@@ -576,6 +752,11 @@ void store(int r, SValue *v)
         o(pic);
         o(0xd60f); /* movq */
         r = REG_VALUE(r);
+    } else if (bt == VT_QVEC) {
+        o(0xf3);
+        o(pic);
+        o(0x7f0f); /* movdqu */
+        r = REG_VALUE(r);
     } else if (bt == VT_LDOUBLE) {
         o(0xc0d9); /* fld %st(0) */
         o(pic);
@@ -613,12 +794,22 @@ void store(int r, SValue *v)
     }
 }
 
+/* whether the function in vtop can be called with a relocation */
+static int gcall_direct(void)
+{
+    return (vtop->r & (VT_VALMASK | VT_LVAL)) == VT_CONST &&
+	((vtop->r & VT_SYM) && (vtop->c.i-4) == (int)(vtop->c.i-4));
+}
+
 /* 'is_jmp' is '1' if it is a jump */
 static void gcall_or_jmp(int is_jmp)
 {
     int r;
-    if ((vtop->r & (VT_VALMASK | VT_LVAL)) == VT_CONST &&
-	((vtop->r & VT_SYM) && (vtop->c.i-4) == (int)(vtop->c.i-4))) {
+#ifdef CONFIG_SWIRL_NOFRAME
+    if (!is_jmp)
+        func_noframe = 0;
+#endif
+    if (gcall_direct()) {
         /* constant symbolic case -> simple relocation */
 #ifdef SWIRL_TARGET_PE
         greloca(cur_text_section, vtop->sym, ind + 1, R_X86_64_PC32, (int)(vtop->c.i-4));
@@ -1090,6 +1281,8 @@ static X86_64_Mode classify_x86_64_inner(CType *ty)
       
     case VT_STRUCT:
         f = ty->ref;
+        if (IS_VECTOR(f->type.t))
+            return x86_64_mode_sse;
 
         mode = x86_64_mode_none;
         for (f = f->next; f; f = f->next)
@@ -1116,7 +1309,9 @@ static X86_64_Mode classify_x86_64_arg(CType *ty, CType *ret, int *psize, int *p
         size = type_size(ty, &align);
         *psize = (size + 7) & ~7;
         *palign = (align + 7) & ~7;
-    
+        if (*palign > 16)
+            *palign = 16; /* stack arguments are at most 16-byte aligned */
+
         if (size > 16) {
             mode = x86_64_mode_memory;
         } else {
@@ -1147,7 +1342,12 @@ static X86_64_Mode classify_x86_64_arg(CType *ty, CType *ret, int *psize, int *p
                 break;
 
             case x86_64_mode_sse:
-                if (size > 8) {
+                if (size == 16 && (ty->t & VT_BTYPE) == VT_STRUCT
+                    && IS_VECTOR(ty->ref->type.t)) {
+                    /* __m128 and friends go in one register */
+                    *reg_count = 1;
+                    ret_t = VT_QVEC;
+                } else if (size > 8) {
                     *reg_count = 2;
                     ret_t = VT_QFLOAT;
                 } else {
@@ -1206,6 +1406,73 @@ static int arg_prepare_reg(int idx) {
       return arg_regs[idx];
 }
 
+#ifdef CONFIG_SWIRL_TAILCALL
+/* calls in tail position, see gfunc_epilog() */
+static ST_TLS int *tail_sites, nb_tail_sites;
+
+/* room for the register restores and 'leave' before the call */
+#define TAIL_SITE_SIZE (1 + (func_regvars ? NB_REGVARS * 4 : 0))
+
+static void gen_tail_site(void)
+{
+    int n;
+    if (!gcall_direct()) {
+        /* the address may be in the frame */
+        load(TREG_R11, vtop);
+        vtop->r = TREG_R11;
+    }
+    if ((nb_tail_sites & 15) == 0)
+        tail_sites = swirl_realloc(tail_sites,
+            (nb_tail_sites + 16) * sizeof *tail_sites);
+    tail_sites[nb_tail_sites++] = ind;
+    for (n = TAIL_SITE_SIZE; n > 0; n -= 9)
+        gen_nops(n < 9 ? n : 9);
+}
+#endif
+
+#ifdef CONFIG_SWIRL_RETSITE
+/* returns which leave the function in place, see gfunc_epilog() */
+static ST_TLS int *ret_sites, nb_ret_sites;
+
+/* room for the register restores, 'leave' and 'ret' */
+#define RET_SITE_SIZE (2 + (func_regvars ? NB_REGVARS * 4 : 0))
+
+ST_FUNC void gen_ret_site(void)
+{
+    int n;
+    if (nocode_wanted)
+        return;
+    if ((nb_ret_sites & 15) == 0)
+        ret_sites = swirl_realloc(ret_sites,
+            (nb_ret_sites + 16) * sizeof *ret_sites);
+    ret_sites[nb_ret_sites++] = ind;
+    for (n = RET_SITE_SIZE; n > 0; n -= 9)
+        gen_nops(n < 9 ? n : 9);
+}
+
+/* put the epilogue at the sites of gen_ret_site(), only 'ret' if the
+   function has no frame */
+static void gen_ret_sites(int noframe)
+{
+    int i, end, saved_ind = ind;
+
+    for (i = 0; i < nb_ret_sites; i++) {
+        ind = ret_sites[i];
+        end = ind + RET_SITE_SIZE;
+        if (!noframe) {
+            gen_regvar_restore();
+            o(0xc9); /* leave */
+        }
+        o(0xc3); /* ret */
+        while (ind < end)
+            gen_nops(end - ind < 9 ? end - ind : 9);
+    }
+    ind = saved_ind;
+    swirl_free(ret_sites);
+    ret_sites = NULL, nb_ret_sites = 0;
+}
+#endif
+
 /* Generate function call. The function address is pushed first, then
    all the parameters in call order. This functions pops all the
    parameters and the function address. */
@@ -1218,6 +1485,11 @@ void gfunc_call(int nb_args)
     int nb_sse_args = 0;
     int sse_reg, gen_reg;
     char *onstack = swirl_malloc((nb_args + 1) * sizeof (char));
+#ifdef CONFIG_SWIRL_TAILCALL
+    int tail = tail_call;
+
+    tail_call = 0;
+#endif
 
 #ifdef CONFIG_SWIRL_BCHECK
     if (swirl_state->do_bounds_check)
@@ -1404,6 +1676,10 @@ void gfunc_call(int nb_args)
 
     if (vtop->type.ref->f.func_type != FUNC_NEW) /* implies FUNC_OLD or FUNC_ELLIPSIS */
         oad(0xb8, nb_sse_args < 8 ? nb_sse_args : 8); /* mov nb_sse_args, %eax */
+#ifdef CONFIG_SWIRL_TAILCALL
+    if (tail && !args_size)
+        gen_tail_site();
+#endif
     gcall_or_jmp(0);
     if (args_size)
         gadd_sp(args_size);
@@ -1417,6 +1693,534 @@ static void push_arg_reg(int i) {
     gen_modrm64(0x89, arg_regs[i], VT_LOCAL, NULL, loc);
 }
 
+#ifdef CONFIG_SWIRL_PEEPHOLE
+/* ------------------------------------------------------------------------- */
+/* -O: rewrite the code of a function once it is complete */
+
+typedef struct PeepInsn {
+    int pos, npos;      /* offset before and after rewriting */
+    int target;         /* jumps: index of the target instruction */
+    unsigned char len;  /* length before ... */
+    unsigned char nlen; /* ... and after, 0 if removed */
+    unsigned char kind, cc, flags;
+    unsigned char rep[3]; /* new code if PEEP_REP */
+} PeepInsn;
+
+#define PEEP_INSN  0
+#define PEEP_JMP8  1
+#define PEEP_JMP32 2
+#define PEEP_JCC8  3
+#define PEEP_JCC32 4
+
+#define PEEP_TARGET 1 /* something may jump here */
+#define PEEP_RELOC  2 /* has a relocation */
+#define PEEP_RIP    4 /* %rip relative */
+#define PEEP_CALL   8 /* call rel32 */
+#define PEEP_REP   16 /* replaced by 'rep' */
+
+/* relocation counts when the function was started */
+static ST_TLS addr_t peep_text_rel, peep_data_rel;
+/* instruction index by offset in the function [start, end] */
+static ST_TLS int *peep_idx, peep_start, peep_end;
+
+static void peep_mark_relocs(void)
+{
+    peep_text_rel = cur_text_section->reloc
+        ? cur_text_section->reloc->data_offset : 0;
+    peep_data_rel = data_ro_section->reloc
+        ? data_ro_section->reloc->data_offset : 0;
+}
+
+/* one byte opcodes: modrm byte and immediate size */
+#define PM 1  /* modrm */
+#define PN 2  /* no modrm */
+#define PB 4  /* imm8 */
+#define PZ 8  /* imm16/32 */
+#define PS 16 /* see below */
+static const unsigned char peep_optab[256] = {
+#define PA PM,PM,PM,PM,PN|PB,PN|PZ,0,0,PM,PM,PM,PM,PN|PB,PN|PZ,0,0
+    PA, PA, PA, PA,
+#undef PA
+#define PA PN,PN,PN,PN,PN,PN,PN,PN,PN,PN,PN,PN,PN,PN,PN,PN
+    PA, PA,                                                     /* 40 */
+    0,0,0,PM,0,0,0,0,PN|PZ,PM|PZ,PN|PB,PM|PB,0,0,0,0,           /* 60 */
+#undef PA
+#define PA PN|PB,PN|PB,PN|PB,PN|PB,PN|PB,PN|PB,PN|PB,PN|PB
+    PA, PA,                                                     /* 70 */
+    PM|PB,PM|PZ,0,PM|PB,PM,PM,PM,PM,PM,PM,PM,PM,PM,PM,PM,PM,    /* 80 */
+    PN,PN,PN,PN,PN,PN,PN,PN,PN,PN,0,0,PN,PN,0,0,                /* 90 */
+    0,0,0,0,0,0,0,0,PN|PB,PN|PZ,0,0,0,0,0,0,                    /* a0 */
+    PA, PN|PS,PN|PS,PN|PS,PN|PS,PN|PS,PN|PS,PN|PS,PN|PS,        /* b0 */
+#undef PA
+    PM|PB,PM|PB,PN|PS,PN,0,0,PM|PB,PM|PZ,0,PN,0,0,PN,PN|PB,0,0, /* c0 */
+    PM,PM,PM,PM,0,0,0,0,PM,PM,PM,PM,PM,PM,PM,PM,                /* d0 */
+    0,0,0,0,0,0,0,0,PN|PS,PN|PS,0,PN|PB,0,0,0,0,                /* e0 */
+    0,0,0,0,PN,0,PM|PS,PM|PS,0,0,0,0,0,0,PM,PM,                 /* f0 */
+};
+
+/* length of the instruction at 'p', 0 if not known.  Good for what
+   this file emits, inline asm aside. */
+static int peep_insn_len(const unsigned char *p, unsigned char *flags)
+{
+    const unsigned char *q = p;
+    int op, rex = 0, o16 = 0, modrm = 1, imm = 0, m, mod, c;
+
+    while (*q == 0x66 || *q == 0x67 || *q == 0xf0 || *q == 0xf2
+           || *q == 0xf3 || *q == 0x2e || *q == 0x3e || *q == 0x64
+           || *q == 0x65)
+        o16 |= *q++ == 0x66;
+    if ((*q & 0xf0) == 0x40)
+        rex = *q++;
+    op = *q++;
+    if (op == 0x0f) {
+        op = *q++;
+        if (op == 0x38)
+            q++;
+        else if (op == 0x3a)
+            q++, imm = 1;
+        else if ((op & 0xf0) == 0x80)
+            modrm = 0, imm = 4;
+        else if (op == 0x05 || op == 0x0b || op == 0x31 || op == 0xa2
+                 || (op & 0xf8) == 0xc8)
+            modrm = 0;
+        else if ((op >= 0x70 && op <= 0x73) || op == 0xa4 || op == 0xac
+                 || op == 0xba || op == 0xc2 || (op >= 0xc4 && op <= 0xc6))
+            imm = 1;
+    } else {
+        c = peep_optab[op];
+        if (!c)
+            return 0;
+        modrm = c & PM;
+        imm = c & PB ? 1 : c & PZ ? (o16 ? 2 : 4) : 0;
+        if (c & PS) {
+            if (op >= 0xb8 && op <= 0xbf)
+                imm = rex & 8 ? 8 : o16 ? 2 : 4;
+            else if (op == 0xc2)
+                imm = 2;
+            else if (op == 0xe8 || op == 0xe9)
+                imm = 4, *flags |= op == 0xe8 ? PEEP_CALL : 0;
+            else if (((*q >> 3) & 7) < 2) /* test $imm */
+                imm = op == 0xf6 ? 1 : o16 ? 2 : 4;
+        }
+    }
+    if (modrm) {
+        m = *q++, mod = m >> 6;
+        if (mod != 3) {
+            if ((m & 7) == 4) {
+                if (mod == 0 && (*q & 7) == 5)
+                    q += 4;
+                q++;
+            } else if (mod == 0 && (m & 7) == 5) {
+                *flags |= PEEP_RIP;
+                q += 4;
+            }
+            q += mod == 1 ? 1 : mod == 2 ? 4 : 0;
+        }
+    }
+    return q + imm - p;
+}
+
+/* index of the instruction that starts at 'pos', -1 if none */
+static int peep_find(PeepInsn *in, int pos)
+{
+    int k;
+    if (pos < peep_start || pos > peep_end)
+        return -1;
+    k = peep_idx[pos - peep_start];
+    return in[k].pos == pos ? k : -1;
+}
+
+/* index of the instruction that contains 'pos' */
+static int peep_at(int pos)
+{
+    return peep_idx[pos - peep_start];
+}
+
+/* look at (fix = 0) or move (fix = 1) the relocations made by the
+   function: the ones in its code and jump tables that point into it */
+static int peep_relocs(PeepInsn *in, int n, int start, int end, int fix)
+{
+    Section *secs[2], *sr;
+    addr_t from[2], a;
+    ElfW_Rel *rel;
+    ElfW(Sym) *sym;
+    int i, k;
+
+    secs[0] = cur_text_section, from[0] = peep_text_rel;
+    secs[1] = data_ro_section, from[1] = peep_data_rel;
+    for (i = 0; i < 2; i++) {
+        sr = secs[i]->reloc;
+        if (!sr)
+            continue;
+        for_each_elem(sr, from[i] / sizeof *rel, rel, ElfW_Rel) {
+            if (i == 0 && rel->r_offset >= start && rel->r_offset < end) {
+                k = peep_at(rel->r_offset);
+                if (fix)
+                    rel->r_offset += start + in[k].npos - in[k].pos;
+                else
+                    in[k].flags |= PEEP_RELOC;
+            }
+            sym = &((ElfW(Sym) *)symtab_section->data)[ELFW(R_SYM)(rel->r_info)];
+            if (sym->st_shndx != cur_text_section->sh_num)
+                continue;
+            if (sym->st_value > start && sym->st_value < end)
+                return -1; /* a label */
+            a = sym->st_value + rel->r_addend;
+            if (a < start || a >= end)
+                continue;
+            /* case of a jump table */
+            k = peep_find(in, a);
+            if (k < 0 || ELFW(R_TYPE)(rel->r_info) != R_DATA_PTR)
+                return -1;
+            if (fix)
+                rel->r_addend = start + in[k].npos - sym->st_value;
+            else
+                in[k].flags |= PEEP_TARGET;
+        }
+    }
+    return 0;
+}
+
+/* unchanged so far and free of relocations */
+static int peep_plain(PeepInsn *p)
+{
+    return p->nlen == p->len && p->kind == PEEP_INSN
+        && !(p->flags & (PEEP_RELOC | PEEP_REP));
+}
+
+/* [prefix] [rex] op modrm [sib] disp with a disp(%rbp) or disp(%rsp)
+   operand: return the offset of [sib] disp, 0 if not such an
+   instruction */
+static int peep_mem(const unsigned char *p, int len, int *pre, int *op, int *reg, int *w)
+{
+    int k = 0, rex = 0, m, sib = 0;
+    *pre = 0;
+    if (p[0] == 0x66 || p[0] == 0xf2 || p[0] == 0xf3)
+        *pre = p[k++];
+    if ((p[k] & 0xf0) == 0x40)
+        rex = p[k++];
+    *op = p[k++];
+    if (*op == 0x0f)
+        *op = 0x0f00 | p[k++];
+    m = p[k++];
+    if ((m & 0xc7) == 0x44 || (m & 0xc7) == 0x84) {
+        if ((p[k] != 0x24 && p[k] != 0x25) || (rex & 2))
+            return 0;
+        sib = 1;
+    } else if ((m & 0xc7) != 0x45 && (m & 0xc7) != 0x85)
+        return 0;
+    if ((rex & 1) || k + sib + ((m & 0xc0) == 0x40 ? 1 : 4) != len)
+        return 0;
+    *reg = ((m >> 3) & 7) | (rex & 4) << 1;
+    *w = rex & 8;
+    return k;
+}
+
+/* [rex] mov %src, %dst */
+static int peep_movrr(const unsigned char *p, int len, int *src, int *dst, int *w)
+{
+    int k = 0, rex = 0, r, b;
+    if ((p[0] & 0xf0) == 0x40)
+        rex = p[k++];
+    if (len != k + 2 || (p[k + 1] & 0xc0) != 0xc0)
+        return 0;
+    r = ((p[k + 1] >> 3) & 7) | (rex & 4) << 1;
+    b = (p[k + 1] & 7) | (rex & 1) << 3;
+    if (p[k] == 0x89)
+        *src = r, *dst = b;
+    else if (p[k] == 0x8b)
+        *src = b, *dst = r;
+    else
+        return 0;
+    *w = rex & 8;
+    return 1;
+}
+
+/* [41] push/pop %r: return r, -1 if not */
+static int peep_pushpop(const unsigned char *p, int len, int op)
+{
+    if (len == 1 && (p[0] & 0xf8) == op)
+        return p[0] & 7;
+    if (len == 2 && p[0] == 0x41 && (p[1] & 0xf8) == op)
+        return 8 + (p[1] & 7);
+    return -1;
+}
+
+static void peep_rep_mov(PeepInsn *p, int src, int dst, int w)
+{
+    int k = 0, rex = 0x40 | w | (src & 8) >> 1 | (dst & 8) >> 3;
+    if (rex != 0x40)
+        p->rep[k++] = rex;
+    p->rep[k++] = 0x89;
+    p->rep[k++] = 0xc0 | (src & 7) << 3 | (dst & 7);
+    p->nlen = k;
+    p->flags |= PEEP_REP;
+}
+
+/* rewrite instruction i, looking at i + 1 */
+static void peep_insn(const unsigned char *code, PeepInsn *in, int i)
+{
+    PeepInsn *a = &in[i], *b = &in[i + 1];
+    const unsigned char *pa = code + a->pos, *pb = code + b->pos;
+    int ka, kb, prea, preb, opa, opb, ra, rb, wa, wb;
+
+    if (peep_plain(a)) {
+        /* nops */
+        if ((a->len == 1 && pa[0] == 0x90)
+            || (pa[0] == 0x66 && (pa[1] == 0x90 || (pa[1] == 0x0f && pa[2] == 0x1f)))
+            || (pa[0] == 0x0f && pa[1] == 0x1f)) {
+            a->nlen = 0;
+            return;
+        }
+        /* mov %r, %r (64 bit) */
+        if (peep_movrr(pa, a->len, &ra, &rb, &wa) && ra == rb && wa) {
+            a->nlen = 0;
+            return;
+        }
+    }
+    if (!peep_plain(a) || b->kind != PEEP_INSN
+        || !peep_plain(b) || (b->flags & PEEP_TARGET))
+        goto jumps;
+
+    /* store or load, then load from the same slot */
+    ka = peep_mem(pa, a->len, &prea, &opa, &ra, &wa);
+    kb = peep_mem(pb, b->len, &preb, &opb, &rb, &wb);
+    if (ka && kb && a->len - ka == b->len - kb
+        && !memcmp(pa + ka, pb + kb, a->len - ka)) {
+        if (prea == 0 && (opa == 0x89 || opa == 0x8b)
+            && preb == 0 && opb == 0x8b && wa == wb) {
+            if (ra == rb)
+                b->nlen = 0;
+            else
+                peep_rep_mov(b, ra, rb, wa);
+        } else if (ra == rb
+            && ((prea == 0x66 && opa == 0x0fd6 && preb == 0xf3 && opb == 0x0f7e)
+             || (prea == 0x66 && opa == 0x0f7e && preb == 0x66 && opb == 0x0f6e))) {
+            /* movq/movd %xmm */
+            b->nlen = 0;
+        }
+        return;
+    }
+
+    /* mov %a, %b; mov %b, %a */
+    if (peep_movrr(pa, a->len, &ra, &rb, &wa)
+        && peep_movrr(pb, b->len, &opa, &opb, &wb)
+        && wa == wb && opa == rb && opb == ra) {
+        b->nlen = 0;
+        return;
+    }
+
+    /* push %a; pop %b */
+    ra = peep_pushpop(pa, a->len, 0x50);
+    rb = peep_pushpop(pb, b->len, 0x58);
+    if (ra >= 0 && rb >= 0 && (ra == rb || a->len + b->len >= 3)) {
+        /* the code must not grow */
+        if (ra == rb)
+            a->nlen = 0;
+        else
+            peep_rep_mov(a, ra, rb, 8);
+        b->nlen = 0;
+        return;
+    }
+    return;
+
+ jumps:
+    /* jcc 1f; jmp 2f; 1: -> jncc 2f */
+    if (a->kind == PEEP_JCC32 && a->nlen && a->target == i + 2
+        && (b->kind == PEEP_JMP8 || b->kind == PEEP_JMP32)
+        && b->nlen && !(b->flags & PEEP_TARGET)) {
+        a->cc ^= 1;
+        a->target = b->target;
+        b->nlen = 0;
+    }
+}
+
+static void peep_layout(PeepInsn *in, int n)
+{
+    int i, pos = 0;
+    for (i = 0; i < n; i++) {
+        in[i].npos = pos;
+        pos += in[i].nlen;
+    }
+    in[n].npos = pos;
+}
+
+/* Pass over the code of the function [start, end): with 'opt', drop
+   redundant reloads, moves, nops and jumps and thread jumps to jumps.
+   Then turn the jumps that reach into short ones, and move jump
+   targets, relocations and line info accordingly.  Returns the new
+   end. */
+ST_FUNC int gen_peephole(int start, int end, int opt)
+{
+    unsigned char *code = cur_text_section->data;
+    PeepInsn *in, *p;
+    int n, i, k, t, d, changed, pass, *map, *jumps, nj = 0;
+
+    in = swirl_malloc((end - start + 1) * (sizeof *in + 2 * sizeof(int)));
+    peep_idx = (int *)(in + (end - start + 1));
+    jumps = peep_idx + (end - start + 1);
+    peep_start = start, peep_end = end;
+    for (n = 0, i = start; i < end; i += p->len, n++) {
+        p = &in[n];
+        p->pos = i;
+        p->flags = 0;
+        p->len = p->nlen = peep_insn_len(code + i, &p->flags);
+        if (!p->len || i + p->len > end)
+            goto fail;
+        for (k = 0; k < p->len; k++)
+            peep_idx[i - start + k] = n;
+        p->kind = PEEP_INSN;
+        p->target = -1;
+        if (code[i] == 0xeb)
+            p->kind = PEEP_JMP8;
+        else if (code[i] == 0xe9)
+            p->kind = PEEP_JMP32;
+        else if ((code[i] & 0xf0) == 0x70)
+            p->kind = PEEP_JCC8, p->cc = code[i] & 15;
+        else if (code[i] == 0x0f && (code[i + 1] & 0xf0) == 0x80)
+            p->kind = PEEP_JCC32, p->cc = code[i + 1] & 15;
+        else
+            continue;
+        jumps[nj++] = n;
+    }
+    in[n].pos = end;
+    in[n].len = in[n].nlen = 0;
+    in[n].kind = PEEP_INSN;
+    in[n].flags = 0;
+    peep_idx[end - start] = n;
+    if (peep_relocs(in, n, start, end, 0))
+        goto fail;
+
+    for (i = 0; i < n; i++)
+        if ((in[i].flags & (PEEP_RIP | PEEP_CALL))
+            && !(in[i].flags & PEEP_RELOC))
+            goto fail;
+    for (k = t = 0; k < nj; k++) {
+        p = &in[jumps[k]];
+        if (p->flags & PEEP_RELOC) {
+            if (p->kind != PEEP_JMP32)
+                goto fail;
+            p->kind = PEEP_INSN; /* jmp to a symbol */
+            continue;
+        }
+        if (p->kind == PEEP_JMP8 || p->kind == PEEP_JCC8)
+            d = (signed char)code[p->pos + p->len - 1];
+        else
+            d = read32le(code + p->pos + p->len - 4);
+        p->target = peep_find(in, p->pos + p->len + d);
+        if (p->target < 0)
+            goto fail;
+        in[p->target].flags |= PEEP_TARGET;
+        jumps[t++] = jumps[k];
+    }
+    nj = t;
+
+    changed = 0;
+    if (opt) {
+        for (i = 0; i < n; i++)
+            peep_insn(code, in, i);
+
+        /* jumps to jumps */
+        for (k = 0; k < nj; k++) {
+            p = &in[jumps[k]];
+            if ((p->kind != PEEP_JMP32 && p->kind != PEEP_JCC32) || !p->nlen)
+                continue;
+            for (pass = 0, t = p->target; pass < 8 && t < n && in[t].nlen
+                 && (in[t].kind == PEEP_JMP8 || in[t].kind == PEEP_JMP32);
+                 pass++)
+                t = in[t].target;
+            changed |= p->target != t;
+            p->target = t;
+        }
+
+        /* jumps to the next instruction */
+        pass = 0;
+        do {
+            peep_layout(in, n);
+            t = 0;
+            for (k = 0; k < nj; k++) {
+                p = &in[jumps[k]];
+                if (p->nlen && in[p->target].npos == p->npos + p->nlen)
+                    p->nlen = 0, t = 1;
+            }
+        } while (t && ++pass < 8);
+        for (i = 0; i < n; i++)
+            changed |= in[i].nlen != in[i].len || (in[i].flags & PEEP_REP);
+    }
+
+    /* short jumps, unless -mno-relax.  Code only shrinks, so a jump
+       that reaches once keeps reaching. */
+    for (t = !swirl_state->norelax; t; ) {
+        peep_layout(in, n);
+        t = 0;
+        for (k = 0; k < nj; k++) {
+            p = &in[jumps[k]];
+            if ((p->kind != PEEP_JMP32 && p->kind != PEEP_JCC32) || !p->nlen)
+                continue;
+            d = in[p->target].npos - (p->npos + 2);
+            if (d == (signed char)d) {
+                p->kind = p->kind == PEEP_JMP32 ? PEEP_JMP8 : PEEP_JCC8;
+                p->nlen = 2;
+                t = changed = 1;
+            }
+        }
+    }
+    if (!changed)
+        goto fail;
+    for (k = 0; k < nj; k++) {
+        p = &in[jumps[k]];
+        d = in[p->target].npos - (p->npos + p->nlen);
+        if (p->nlen == 2 && d != (signed char)d)
+            goto fail;
+    }
+
+    /* compact in place: the code only moves down */
+    for (i = 0; i < n; i = k) {
+        p = &in[i];
+        t = start + p->npos;
+        for (k = i; k < n && in[k].kind == PEEP_INSN && in[k].nlen
+             && in[k].nlen == in[k].len && !(in[k].flags & PEEP_REP); k++)
+            ;
+        if (k > i) {
+            memmove(code + t, code + p->pos, in[k].pos - p->pos);
+            continue;
+        }
+        k = i + 1;
+        if (!p->nlen)
+            continue;
+        if (p->flags & PEEP_REP) {
+            memcpy(code + t, p->rep, p->nlen);
+            continue;
+        }
+        d = in[p->target].npos - (p->npos + p->nlen);
+        if (p->kind == PEEP_JMP8 || p->kind == PEEP_JCC8) {
+            code[t] = p->kind == PEEP_JMP8 ? 0xeb : 0x70 | p->cc;
+            code[t + 1] = d;
+        } else {
+            if (p->kind == PEEP_JMP32)
+                code[t] = 0xe9;
+            else
+                code[t] = 0x0f, code[t + 1] = 0x80 | p->cc;
+            write32le(code + t + p->nlen - 4, d);
+        }
+    }
+    peep_relocs(in, n, start, end, 1);
+    if (swirl_state->do_debug) {
+        map = peep_idx;
+        for (i = 0; i <= end - start; i++) {
+            p = &in[peep_idx[i]];
+            d = i + start - p->pos;
+            map[i] = p->npos + (d < p->nlen ? d : p->nlen);
+        }
+        swirl_debug_remap(swirl_state, map);
+    }
+    end = start + in[n].npos;
+ fail:
+    swirl_free(in);
+    return end;
+}
+#endif
+
 /* generate function prolog of type 't' */
 void gfunc_prolog(Sym *func_sym)
 {
@@ -1431,8 +2235,20 @@ void gfunc_prolog(Sym *func_sym)
     addr = PTR_SIZE * 2;
     loc = 0;
     ind += FUNC_PROLOG_SIZE;
+#ifdef CONFIG_SWIRL_REGVARS
+    /* room for the pushes of the registers, below %rbp */
+    memset(regvar_loc, 0, sizeof regvar_loc);
+    regvar_used = 0;
+    if (func_regvars) {
+        loc -= NB_REGVARS * 8;
+        ind += REGVAR_SAVE_SIZE;
+    }
+#endif
     func_sub_sp_offset = ind;
     func_ret_sub = 0;
+#ifdef CONFIG_SWIRL_PEEPHOLE
+    peep_mark_relocs();
+#endif
 
     if (func_var) {
         int seen_reg_num, seen_sse_num, seen_stack_size;
@@ -1519,7 +2335,15 @@ void gfunc_prolog(Sym *func_sym)
         case x86_64_mode_sse:
 	    if (swirl_state->nosse)
 	        swirl_error("SSE disabled but floating point arguments used");
-            if (sse_param_index + reg_count <= 8) {
+            if (sse_param_index + reg_count <= 8 && size == 16
+                && reg_count == 1) {
+                /* a vector in one register */
+                loc = (loc - 16) & -16;
+                param_addr = loc;
+                o(0x7f0ff3); /* movdqu */
+                gen_modrm(sse_param_index, VT_LOCAL, NULL, param_addr);
+                ++sse_param_index;
+            } else if (sse_param_index + reg_count <= 8) {
                 /* save arguments passed by register */
                 loc -= reg_count * 8;
                 param_addr = loc;
@@ -1573,11 +2397,66 @@ void gfunc_prolog(Sym *func_sym)
 /* generate function epilog */
 void gfunc_epilog(void)
 {
-    int v, saved_ind;
+    int v, saved_ind, i;
 
 #ifdef CONFIG_SWIRL_BCHECK
     if (swirl_state->do_bounds_check)
         gen_bounds_epilog();
+#endif
+#ifdef CONFIG_SWIRL_NOFRAME
+    /* a leaf function whose locals fit in the red zone below %rsp:
+       %rbp would point 8 bytes below the return address */
+    v = func_noframe && loc >= -120 && !regvar_used;
+    for (i = 0; i < nb_noframe_sites && v; i++) {
+        unsigned char *p = cur_text_section->data + noframe_sites[i];
+        p[0] = 0x24; /* (%rbp) -> (%rsp) */
+        if ((p[-1] & 0xc0) == 0x40)
+            p[1] -= 8;
+        else
+            write32le(p + 1, read32le(p + 1) - 8);
+    }
+    swirl_free(noframe_sites);
+    noframe_sites = NULL, nb_noframe_sites = 0;
+    func_noframe = 0;
+#ifdef CONFIG_SWIRL_RETSITE
+    gen_ret_sites(v);
+#endif
+    if (v) {
+        o(0xc3); /* ret */
+        saved_ind = ind;
+        ind = func_sub_sp_offset - FUNC_PROLOG_SIZE;
+        if (func_regvars)
+            ind -= REGVAR_SAVE_SIZE;
+        while (ind < func_sub_sp_offset)
+            gen_nops(func_sub_sp_offset - ind < 9 ? func_sub_sp_offset - ind : 9);
+        ind = saved_ind;
+        return;
+    }
+#endif
+#ifdef CONFIG_SWIRL_TAILCALL
+    /* calls in tail position leave the function first, unless the
+       callee might see its frame */
+    for (i = 0; i < nb_tail_sites && !func_addr_taken; i++) {
+        unsigned char *p;
+        saved_ind = ind;
+        ind = tail_sites[i];
+        v = ind + TAIL_SITE_SIZE - 1;
+        gen_regvar_restore();
+        while (ind < v)
+            gen_nops(v - ind < 9 ? v - ind : 9);
+        o(0xc9); /* leave */
+        p = cur_text_section->data + ind;
+        if (p[0] == 0xe8)
+            p[0] = 0xe9; /* call -> jmp */
+        else
+            p[2] += 0x10; /* call *%r11 -> jmp *%r11 */
+        ind = saved_ind;
+    }
+    swirl_free(tail_sites);
+    tail_sites = NULL, nb_tail_sites = 0;
+#endif
+#ifdef CONFIG_SWIRL_REGVARS
+    gen_regvar_restore();
 #endif
     o(0xc9); /* leave */
     if (func_ret_sub == 0) {
@@ -1591,6 +2470,20 @@ void gfunc_epilog(void)
     v = (-loc + 15) & -16;
     saved_ind = ind;
     ind = func_sub_sp_offset - FUNC_PROLOG_SIZE;
+#ifdef CONFIG_SWIRL_REGVARS
+    if (func_regvars) {
+        ind -= REGVAR_SAVE_SIZE;
+        o(0xe5894855);  /* push %rbp, mov %rsp, %rbp */
+        for (i = 0; i < regvar_used; i++)
+            orex(0, regvar_regs[i], 0, 0x50 + REG_VALUE(regvar_regs[i]));
+        v -= regvar_used * 8;
+        o(0xec8148);  /* sub rsp, stacksize */
+        gen_le32(v);
+        gen_nops(func_sub_sp_offset - ind);
+        ind = saved_ind;
+        return;
+    }
+#endif
     o(0xe5894855);  /* push %rbp, mov %rsp, %rbp */
     o(0xec8148);  /* sub rsp, stacksize */
     gen_le32(v);
@@ -1664,6 +2557,160 @@ ST_FUNC int gjmp_cond(int op, int t)
         return t;
 }
 
+/* op $n, r for shl (4), shr (5) and sar (7) */
+static void gen_shifti(int ll, int opc, int r, int n)
+{
+    if (n) {
+        orex(ll, r, 0, 0xc1);
+        o(0xc0 | (opc << 3) | REG_VALUE(r));
+        g(n);
+    }
+}
+
+/* op r2, r for mov (0x89), add (0x01) and sub (0x29) */
+static void gen_oprr(int ll, int opc, int r, int r2)
+{
+    orex(ll, r, r2, opc);
+    o(0xc0 + REG_VALUE(r) + REG_VALUE(r2) * 8);
+}
+
+static void gen_movi(int r, uint64_t c)
+{
+    if (c == (uint32_t)c) {
+        orex(0, r, 0, 0xb8 + REG_VALUE(r)); /* zero extends */
+        gen_le32(c);
+    } else if (c == (int32_t)c) {
+        orex(1, r, 0, 0xc7);
+        o(0xc0 + REG_VALUE(r));
+        gen_le32(c);
+    } else {
+        orex(1, r, 0, 0xb8 + REG_VALUE(r));
+        gen_le64(c);
+    }
+}
+
+/* imul $c, r, r */
+static void gen_imuli(int ll, int r, int c)
+{
+    orex(ll, r, r, c == (char)c ? 0x6b : 0x69);
+    o(0xc0 | REG_VALUE(r) * 9);
+    if (c == (char)c)
+        g(c);
+    else
+        gen_le32(c);
+}
+
+/* r *= c with lea and shifts for c = (1|3|5|9) * (1|3|5|9) << n */
+static void gen_mulc(int ll, int r, int64_t c)
+{
+    int n = 0, f[2], nf = 0, i;
+    int64_t v = c;
+
+    if (v > 0) {
+        while (!(v & 1))
+            v >>= 1, n++;
+        for (i = 9; i > 1 && nf < 2; i = i == 9 ? 5 : i - 2)
+            while (nf < 2 && v % i == 0)
+                v /= i, f[nf++] = i;
+    }
+    if (v != 1 || nf == 0) {
+        gen_imuli(ll, r, c);
+        return;
+    }
+    for (i = 0; i < nf; i++) {
+        /* lea (r,r,f-1), r */
+        if (ll || REX_BASE(r))
+            o(0x40 | ll << 3 | REX_BASE(r) * 7);
+        o(0x8d);
+        o((REG_VALUE(r) == 5 ? 0x44 : 0x04) | REG_VALUE(r) << 3);
+        o((f[i] == 3 ? 0x40 : f[i] == 5 ? 0x80 : 0xc0) | REG_VALUE(r) * 9);
+        if (REG_VALUE(r) == 5)
+            g(0);
+    }
+    gen_shifti(ll, 4, r, n);
+}
+
+/* x / d and x % d with a high multiply for a constant d.  The
+   dividend is taken in %rcx, %rax and %rdx are scratch. */
+static int gen_divmodc(int op, int ll, int uu)
+{
+    int bits = ll ? 64 : 32, s, k, a, r;
+    int64_t d = vtop->c.i;
+    uint64_t m, ad;
+
+    if (!ll)
+        d = uu ? (int64_t)(uint32_t)d : (int64_t)(int32_t)d;
+    ad = uu || d > 0 ? d : -d;
+    if (d == 0 || d == 1
+        || (!uu && (d == -1 || ad == (uint64_t)1 << (bits - 1))))
+        return 0;
+    vswap();
+    gv(RC_RCX);
+    vswap();
+    vtop--;
+    save_reg(TREG_RAX);
+    save_reg(TREG_RDX);
+    if (!uu && (ad & (ad - 1)) == 0) {
+        /* (x + (x < 0 ? 2^k - 1 : 0)) >> k */
+        for (k = 0; (uint64_t)1 << k != ad; k++)
+            ;
+        gen_oprr(ll, 0x89, TREG_RAX, TREG_RCX);
+        gen_shifti(ll, 7, TREG_RAX, bits - 1);
+        gen_shifti(ll, 5, TREG_RAX, bits - k);
+        gen_oprr(ll, 0x01, TREG_RAX, TREG_RCX);
+        gen_shifti(ll, 7, TREG_RAX, k);
+        if (d < 0) {
+            orex(ll, TREG_RAX, 0, 0xf7);
+            o(0xd8); /* neg %rax */
+        }
+        r = TREG_RAX;
+    } else if (uu) {
+        a = gen_divmagic(d, bits, 0, &m, &s);
+        gen_movi(TREG_RAX, m);
+        orex(ll, TREG_RCX, 0, 0xf7);
+        o(0xe1); /* mul %rcx */
+        if (a) {
+            gen_oprr(ll, 0x89, TREG_RAX, TREG_RCX);
+            gen_oprr(ll, 0x29, TREG_RAX, TREG_RDX);
+            gen_shifti(ll, 5, TREG_RAX, 1);
+            gen_oprr(ll, 0x01, TREG_RAX, TREG_RDX);
+            gen_shifti(ll, 5, TREG_RAX, s - 1);
+            r = TREG_RAX;
+        } else {
+            gen_shifti(ll, 5, TREG_RDX, s);
+            r = TREG_RDX;
+        }
+    } else {
+        gen_divmagic(d, bits, 1, &m, &s);
+        gen_movi(TREG_RAX, ll ? m : (uint32_t)m);
+        orex(ll, TREG_RCX, 0, 0xf7);
+        o(0xe9); /* imul %rcx */
+        if (d > 0 && (int64_t)(m << (64 - bits)) < 0)
+            gen_oprr(ll, 0x01, TREG_RDX, TREG_RCX);
+        if (d < 0 && (int64_t)(m << (64 - bits)) > 0)
+            gen_oprr(ll, 0x29, TREG_RDX, TREG_RCX);
+        gen_shifti(ll, 7, TREG_RDX, s);
+        gen_oprr(ll, 0x89, TREG_RAX, TREG_RDX);
+        gen_shifti(ll, 5, TREG_RAX, bits - 1);
+        gen_oprr(ll, 0x01, TREG_RDX, TREG_RAX);
+        r = TREG_RDX;
+    }
+    if (op == '%' || op == TOK_UMOD) {
+        /* x - q * d */
+        if (d == (int32_t)d || !ll) {
+            gen_imuli(ll, r, d);
+        } else {
+            gen_movi(r ^ (TREG_RAX ^ TREG_RDX), d);
+            orex(ll, r ^ (TREG_RAX ^ TREG_RDX), r, 0xaf0f);
+            o(0xc0 + REG_VALUE(r ^ (TREG_RAX ^ TREG_RDX)) + REG_VALUE(r) * 8);
+        }
+        gen_oprr(ll, 0x29, TREG_RCX, r);
+        r = TREG_RCX;
+    }
+    vtop->r = r;
+    return 1;
+}
+
 /* generate an integer binary operation */
 void gen_opi(int op)
 {
@@ -1725,6 +2772,14 @@ void gen_opi(int op)
         opc = 1;
         goto gen_op8;
     case '*':
+        if (cc && (!ll || (int)vtop->c.i == vtop->c.i)) {
+            vswap();
+            r = gv(RC_INT);
+            vswap();
+            gen_mulc(ll, r, ll ? vtop->c.i : (int)vtop->c.i);
+            vtop--;
+            break;
+        }
         gv2(RC_INT, RC_INT);
         r = vtop[-1].r;
         fr = vtop[0].r;
@@ -1768,6 +2823,8 @@ void gen_opi(int op)
     case TOK_PDIV:
         uu = 0;
     divmod:
+        if (cc && gen_divmodc(op, ll, uu))
+            break;
         /* first operand must be in eax */
         /* XXX: need better constraint for second operand */
         gv2(RC_RAX, RC_RCX);
@@ -2030,6 +3087,7 @@ void gen_cvt_itof(int t)
     if ((t & VT_BTYPE) == VT_LDOUBLE) {
         save_reg(TREG_ST0);
         gv(RC_INT);
+        gen_rsp_scratch();
         if ((vtop->type.t & VT_BTYPE) == VT_LLONG) {
             /* signed long long to float/double/long double (unsigned case
                is handled generically) */
@@ -2084,6 +3142,7 @@ void gen_cvt_ftof(int t)
             o(0xc0 + REG_VALUE(vtop->r)*9);
         } else if (tbt == VT_LDOUBLE) {
             save_reg(RC_ST0);
+            gen_rsp_scratch();
             /* movss %xmm0,-0x10(%rsp) */
             o(0x110ff3);
             o(0x44 + REG_VALUE(vtop->r)*8);
@@ -2100,6 +3159,7 @@ void gen_cvt_ftof(int t)
             o(0xc0 + REG_VALUE(vtop->r)*9);
         } else if (tbt == VT_LDOUBLE) {
             save_reg(RC_ST0);
+            gen_rsp_scratch();
             /* movsd %xmm0,-0x10(%rsp) */
             o(0x110ff2);
             o(0x44 + REG_VALUE(vtop->r)*8);
@@ -2111,6 +3171,7 @@ void gen_cvt_ftof(int t)
         int r;
         gv(RC_ST0);
         r = get_reg(RC_FLOAT);
+        gen_rsp_scratch();
         if (tbt == VT_DOUBLE) {
             o(0xf0245cdd); /* fstpl -0x10(%rsp) */
             /* movsd -0x10(%rsp),%xmm0 */
@@ -2182,6 +3243,437 @@ ST_FUNC void gen_cvt_csti(int t)
         );
 }
 
+/* __builtin_popcount, clz, ctz, ffs, parity or bswap32 ('op' is the
+   int flavour) on the int or long long in vtop.  Returns 0 to have
+   it done by libswirl1. */
+ST_FUNC int gen_bitop(int op)
+{
+    int r, r2, ll;
+
+    if (op == TOK_builtin_popcount && !swirl_state->popcnt)
+        return 0;
+    ll = (vtop->type.t & VT_BTYPE) == VT_LLONG;
+    r = gv(RC_INT);
+    if (op == TOK_builtin_bswap32) {
+        orex(ll, r, 0, 0x0f);
+        o(0xc8 + REG_VALUE(r)); /* bswap r */
+        return 1;
+    }
+    r2 = get_reg(RC_INT);
+    switch (op) {
+    case TOK_builtin_popcount:
+        o(0xf3);
+        orex(ll, r, r2, 0xb80f); /* popcnt r, r2 */
+        break;
+    case TOK_builtin_clz:
+        if (swirl_state->lzcnt) {
+            o(0xf3);
+            orex(ll, r, r2, 0xbd0f); /* lzcnt r, r2 */
+            break;
+        }
+        orex(ll, r, r2, 0xbd0f); /* bsr r, r2 */
+        o(0xc0 + REG_VALUE(r) + REG_VALUE(r2) * 8);
+        o(0xf083 + REG_VALUE(r2) * 0x100); /* xor $31/63, r2 */
+        g(ll ? 63 : 31);
+        vtop->r = r2;
+        return 1;
+    case TOK_builtin_ctz:
+        o(0xf3);
+        orex(ll, r, r2, 0xbc0f); /* tzcnt r, r2, which is bsf on old cpus */
+        break;
+    case TOK_builtin_ffs:
+        orex(ll, r, r, 0xbc0f); /* bsf r, r */
+        o(0xc0 + REG_VALUE(r) * 9);
+        o(0xb8 + REG_VALUE(r2)); /* mov $-1, r2 */
+        gen_le32(-1);
+        o(0x440f); /* cmove r2, r */
+        o(0xc0 + REG_VALUE(r2) + REG_VALUE(r) * 8);
+        o(0xc0ff + REG_VALUE(r) * 0x100); /* inc r */
+        vtop->r = r;
+        return 1;
+    default: /* parity */
+        if (ll) {
+            gen_oprr(1, 0x89, r2, r);
+            gen_shifti(1, 5, r2, 32);
+            gen_oprr(0, 0x31, r, r2); /* xor r2, r */
+        }
+        gen_oprr(0, 0x89, r2, r);
+        gen_shifti(0, 5, r2, 16);
+        gen_oprr(0, 0x31, r, r2);
+        gen_oprr(0, 0x89, r2, r);
+        gen_shifti(0, 5, r2, 8);
+        gen_oprr(0, 0x31, r, r2); /* PF is the parity of the low byte */
+        o(0x9b0f); /* setnp r2 */
+        o(0xc0 + REG_VALUE(r2));
+        o(0xb60f); /* movzbl r2, r2 */
+        o(0xc0 + REG_VALUE(r2) * 9);
+        vtop->r = r2;
+        return 1;
+    }
+    o(0xc0 + REG_VALUE(r) + REG_VALUE(r2) * 8);
+    vtop->r = r2;
+    return 1;
+}
+
+/* ------------------------------------------------------------ */
+/* SSE2 forms of the vector_size operations on 128-bit vectors with
+   elements of type 't'.  vtop[-1] is a vector, vtop another one or the
+   int count of a shift.  Returns 0 if there is no short sequence. */
+
+/* 66 0f opc, with xmm 'r' as destination */
+static void sse_op(int pd, int opc, int r, int r2)
+{
+    if (pd)
+        o(0x66);
+    o(0x0f | opc << 8);
+    o(0xc0 + REG_VALUE(r) * 8 + REG_VALUE(r2));
+}
+
+ST_FUNC int gen_opv(int op, int t)
+{
+    static const unsigned char add[] = { 0xfc, 0xfd, 0xfe, 0xd4 };
+    static const unsigned char sub[] = { 0xf8, 0xf9, 0xfa, 0xfb };
+    static const unsigned char shl[] = { 0, 0xf1, 0xf2, 0xf3 };
+    static const unsigned char shr[] = { 0, 0xd1, 0xd2, 0xd3 };
+    static const unsigned char sar[] = { 0, 0xe1, 0xe2, 0 };
+    int bt = t & VT_BTYPE, sz, opc = 0, swap = 0, inv = 0, cmp = -1;
+    int r, r2, s, c, scalar;
+
+    if (swirl_state->nosse)
+        return 0;
+    sz = bt == VT_BYTE ? 0 : bt == VT_SHORT ? 1 :
+         bt == VT_INT || bt == VT_FLOAT ? 2 : 3;
+    scalar = (vtop->type.t & VT_BTYPE) != VT_STRUCT;
+    if (scalar != (op == TOK_SHL || op == TOK_SHR || op == TOK_SAR))
+        return 0;
+    if (is_float(bt)) {
+        switch (op) {
+        case '+': opc = 0x58; break;
+        case '-': opc = 0x5c; break;
+        case '*': opc = 0x59; break;
+        case '/': opc = 0x5e; break;
+        case TOK_EQ: cmp = 0; break;
+        case TOK_NE: cmp = 4; break;
+        case TOK_GT: swap = 1; /* fall through */
+        case TOK_LT: cmp = 1; break;
+        case TOK_GE: swap = 1; /* fall through */
+        case TOK_LE: cmp = 2; break;
+        default: return 0;
+        }
+        if (cmp >= 0)
+            opc = 0xc2; /* cmpps/pd */
+    } else {
+        switch (op) {
+        case '+': opc = add[sz]; break;
+        case '-': opc = sub[sz]; break;
+        case '*': opc = sz == 1 ? 0xd5 : sz == 2 ? 0xf4 : 0; break;
+        case '&': opc = 0xdb; break;
+        case '|': opc = 0xeb; break;
+        case '^': opc = 0xef; break;
+        case TOK_SHL: opc = shl[sz]; break;
+        case TOK_SHR: opc = shr[sz]; break;
+        case TOK_SAR: opc = sar[sz]; break;
+        case TOK_NE: inv = 1; /* fall through */
+        case TOK_EQ: opc = 0x74; break;
+        case TOK_GE: inv = 1; /* fall through */
+        case TOK_LT: swap = 1, opc = 0x64; break;
+        case TOK_LE: inv = 1; /* fall through */
+        case TOK_GT: opc = 0x64; break;
+        }
+        if (opc == 0x74 || opc == 0x64)
+            opc = sz < 3 ? opc + sz : 0; /* pcmpeq/pcmpgt */
+        if (!opc)
+            return 0;
+    }
+
+    if (swap)
+        vswap();
+    vtop[-1].type.t = VT_QVEC;
+    if (scalar && (vtop->r & (VT_VALMASK | VT_LVAL | VT_SYM)) == VT_CONST) {
+        /* shift by an immediate */
+        c = vtop->c.i;
+        vtop--;
+        r = gv(RC_FLOAT);
+        o(0x66);
+        o(0x0f | (0x70 + sz) << 8);
+        o((op == TOK_SHL ? 0xf0 : op == TOK_SHR ? 0xd0 : 0xe0) + REG_VALUE(r));
+        g(c < 8 << sz ? c : op == TOK_SAR ? (8 << sz) - 1 : 8 << sz);
+        return 1;
+    }
+    if (scalar) {
+        gv2(RC_FLOAT, RC_INT);
+        r = vtop[-1].r;
+        r2 = get_reg(RC_FLOAT);
+        o(0x6e0f66); /* movd */
+        o(0xc0 + REG_VALUE(r2) * 8 + REG_VALUE(vtop->r));
+    } else {
+        vtop->type.t = VT_QVEC;
+        gv2(RC_FLOAT, RC_FLOAT);
+        r = vtop[-1].r;
+        r2 = vtop->r;
+    }
+    if (opc == 0xf4 && sz == 2) {
+        /* 32-bit multiply from two pmuludq */
+        s = get_reg(RC_FLOAT);
+        sse_op(1, 0x6f, s, r); /* movdqa */
+        sse_op(1, 0xf4, r, r2); /* pmuludq */
+        o(0xd0730f66 + REG_VALUE(s) * 0x1000000); /* psrlq $32 */
+        g(32);
+        o(0xd0730f66 + REG_VALUE(r2) * 0x1000000);
+        g(32);
+        sse_op(1, 0xf4, s, r2);
+        sse_op(1, 0x70, r, r); /* pshufd $8 */
+        g(8);
+        sse_op(1, 0x70, s, s);
+        g(8);
+        sse_op(1, 0x62, r, s); /* punpckldq */
+    } else {
+        sse_op(!is_float(bt) || bt == VT_DOUBLE, opc, r, r2);
+        if (cmp >= 0)
+            g(cmp);
+    }
+    if (inv) {
+        s = get_reg(RC_FLOAT);
+        sse_op(1, 0x76, s, s); /* pcmpeqd: all ones */
+        sse_op(1, 0xef, r, s); /* pxor */
+    }
+    vtop--;
+    return 1;
+}
+
+/* ------------------------------------------------------------ */
+/* atomic operations on the object of type 't' (a char, short, int or
+   long long for all but plain loads and stores) pointed to by vtop[-1],
+   or by vtop for loads.  The pointer goes to %rcx, the operand to %rdx
+   and the expected value of cmpxchg to %rax */
+
+/* [lock] opc %dl/%dx/%edx/%rdx, (%rcx) */
+static void gen_atomic_insn(int opc, int t)
+{
+    int bt = t & VT_BTYPE;
+
+    if (opc != 0x86) /* xchg with memory is always locked */
+        o(0xf0);
+    if (bt == VT_SHORT)
+        o(0x66);
+    if (bt != VT_BYTE)
+        opc += opc > 0xff ? 0x100 : 1;
+    orex(bt == VT_LLONG, TREG_RCX, TREG_RDX, opc);
+    o(0x11);
+}
+
+/* the pointer in vtop is replaced by the old value in 'r' */
+static void gen_atomic_result(int r, int t)
+{
+    vtop->r = r;
+    vtop->r2 = VT_CONST;
+    vtop->type.t = VT_INT;
+    if ((t & VT_BTYPE) == VT_BYTE || (t & VT_BTYPE) == VT_SHORT)
+        gen_cvt_csti(t);
+    vtop->type.t = t;
+}
+
+ST_FUNC void gen_atomic_load(int t, int order)
+{
+    /* plain loads are acquire loads on x86 */
+    indir();
+    gv(is_float(t) ? RC_FLOAT : RC_INT);
+}
+
+ST_FUNC void gen_atomic_store(int t, int order)
+{
+    if (order == MO_SEQ_CST && !is_float(t)) {
+        gv2(RC_RCX, RC_RDX);
+        gen_atomic_insn(0x86, t); /* xchg */
+        vtop -= 2;
+        return;
+    }
+    vswap();
+    indir();
+    vswap();
+    vstore();
+    vpop();
+    gen_atomic_fence(order);
+}
+
+ST_FUNC int gen_atomic_rmw(int op, int t, int order)
+{
+    if (op != '=' && op != '+' && op != '-')
+        return 0; /* the caller loops with cmpxchg */
+    gv2(RC_RCX, RC_RDX);
+    if (op == '-') {
+        orex((t & VT_BTYPE) == VT_LLONG, TREG_RDX, 0, 0xf7);
+        o(0xda); /* neg %rdx */
+    }
+    gen_atomic_insn(op == '=' ? 0x86 : 0xc00f, t); /* xchg or xadd */
+    vtop--;
+    gen_atomic_result(TREG_RDX, t);
+    return 1;
+}
+
+ST_FUNC void gen_atomic_cas(int t, int order)
+{
+    vrotb(3);
+    gv(RC_RCX);
+    vrotb(3);
+    gv(RC_RAX);
+    vrotb(3);
+    gv(RC_RDX);
+    gen_atomic_insn(0xb00f, t); /* cmpxchg */
+    vtop -= 2;
+    gen_atomic_result(TREG_RAX, t);
+}
+
+ST_FUNC void gen_atomic_fence(int order)
+{
+    /* only stores followed by loads can be reordered */
+    if (order == MO_SEQ_CST)
+        o(0xf0ae0f); /* mfence */
+}
+
+/* op with register 'r' and the memory 'c' bytes after the address in
+   'sv', a local variable or a register */
+static void gen_mem_op(int pfx, int ll, int op, int r, SValue *sv, int c)
+{
+    int b = sv->r;
+
+    if (pfx)
+        o(pfx);
+    orex(ll, b, r, op);
+    if (b == VT_LOCAL) {
+        gen_modrm(r, VT_LOCAL, NULL, sv->c.i + c);
+        return;
+    }
+    /* no %rsp, %rbp, %r12 or %r13 in RC_INT, hence no sib */
+    r = REG_VALUE(r) << 3 | REG_VALUE(b);
+    if (c == 0)
+        g(r);
+    else if (c == (char)c)
+        g(0x40 | r), g(c);
+    else
+        g(0x80 | r), gen_le32(c);
+}
+
+/* move 'n' (1, 2, 4, 8 or 16) bytes at 'c' through register 'r' */
+static void gen_move(int n, int r, SValue *d, SValue *s, int c)
+{
+    if (n == 16) {
+        gen_mem_op(0xf3, 0, 0x6f0f, r, s, c); /* movdqu */
+        gen_mem_op(0xf3, 0, 0x7f0f, r, d, c);
+    } else {
+        gen_mem_op(n == 2 ? 0x66 : 0, n == 8, n == 1 ? 0xb60f : 0x8b, r, s, c);
+        gen_mem_op(n == 2 ? 0x66 : 0, n == 8, n == 1 ? 0x88 : 0x89, r, d, c);
+    }
+}
+
+/* copy 'size' bytes with the widest moves that fit, the last one
+   overlapping the one before if needed.  s == NULL clears with the
+   zero in 'r'. */
+static void gen_moves(int size, int r, int x, SValue *d, SValue *s)
+{
+    int n, c;
+
+    for (n = 16; n > size; n >>= 1)
+        ;
+    if (n == 16)
+        r = x;
+    for (c = 0; c < size; c += n) {
+        if (c + n > size)
+            c = size - n;
+        if (s)
+            gen_move(n, r, d, s, c);
+        else if (n == 16)
+            gen_mem_op(0xf3, 0, 0x7f0f, r, d, c);
+        else
+            gen_mem_op(n == 2 ? 0x66 : 0, n == 8, n == 1 ? 0x88 : 0x89, r, d, c);
+    }
+}
+
+/* copy 'size' bytes from the address in vtop to the address in
+   vtop[-1] and pop both */
+ST_FUNC void gen_struct_copy(int size)
+{
+    int r, x = 0;
+
+    /* locals are addressed through %rbp */
+    if (vtop[-1].r != VT_LOCAL) {
+        vswap();
+        gv(RC_INT);
+        vswap();
+    }
+    if (vtop->r != VT_LOCAL)
+        gv(RC_INT);
+    r = get_reg(RC_INT);
+    if (size >= 16)
+        x = get_reg(RC_FLOAT);
+    gen_moves(size, r, x, vtop - 1, vtop);
+    vtop -= 2;
+}
+
+/* clear 'size' bytes at the address in vtop and pop it */
+ST_FUNC void gen_struct_zero(int size)
+{
+    int r;
+
+    if (vtop->r != VT_LOCAL)
+        gv(RC_INT);
+    if (size >= 16) {
+        r = get_reg(RC_FLOAT);
+        o(0x66);
+        orex(0, r, r, 0xef0f);
+        o(0xc0 + REG_VALUE(r) * 9); /* pxor %xmm, %xmm */
+    } else {
+        r = get_reg(RC_INT);
+        orex(0, r, r, 0x31);
+        o(0xc0 + REG_VALUE(r) * 9); /* xor %e, %e */
+    }
+    gen_moves(size, r, r, vtop, NULL);
+    vtop--;
+}
+
+#ifdef CONFIG_SWIRL_THREAD_LOCAL
+/* push the address of the thread-local 'sym' in this thread */
+ST_FUNC void gen_tls_addr(Sym *sym, int model)
+{
+    int r;
+
+    if (model == TLS_GD) {
+        /* the exact sequence is required for linker relaxation */
+        save_regs(0);
+#ifdef CONFIG_SWIRL_NOFRAME
+        func_noframe = 0;
+#endif
+        o(0x3d8d4866); /* data16 lea sym@tlsgd(%rip),%rdi */
+        greloca(cur_text_section, sym, ind, R_X86_64_TLSGD, -4);
+        gen_le32(0);
+        o(0xe8486666); /* data16 data16 rex64 call __tls_get_addr@plt */
+        greloca(cur_text_section, external_helper_sym(TOK___tls_get_addr),
+                ind, R_X86_64_PLT32, -4);
+        gen_le32(0);
+        r = TREG_RAX;
+    } else {
+        r = get_reg(RC_INT);
+        o(0x64); /* mov %fs:0,%r */
+        orex(1, 0, r, 0x8b);
+        o(0x04 | REG_VALUE(r) << 3);
+        o(0x25);
+        gen_le32(0);
+        if (model == TLS_IE) {
+            orex(1, 0, r, 0x03); /* add sym@gottpoff(%rip),%r */
+            o(0x05 | REG_VALUE(r) << 3);
+            greloca(cur_text_section, sym, ind, R_X86_64_GOTTPOFF, -4);
+        } else {
+            orex(1, r, r, 0x8d); /* lea sym@tpoff(%r),%r */
+            o(0x80 | REG_VALUE(r) << 3 | REG_VALUE(r));
+            greloca(cur_text_section, sym, ind, R_X86_64_TPOFF32, 0);
+        }
+        gen_le32(0);
+    }
+    vpushi(0);
+    vtop->r = r;
+}
+#endif
+
 /* computed goto support */
 void ggoto(void)
 {
@@ -2211,6 +3703,9 @@ ST_FUNC void gen_vla_result(int addr) {
 /* Subtract from the stack pointer, and push the resulting value onto the stack */
 ST_FUNC void gen_vla_alloc(CType *type, int align) {
     int use_call = 0;
+#ifdef CONFIG_SWIRL_NOFRAME
+    func_noframe = 0;
+#endif
 
 #if defined(CONFIG_SWIRL_BCHECK)
     use_call = swirl_state->do_bounds_check;
@@ -9,6 +9,9 @@
 #define R_GLOB_DAT  R_X86_64_GLOB_DAT
 #define R_COPY      R_X86_64_COPY
 #define R_RELATIVE  R_X86_64_RELATIVE
+#define R_DTPMOD    R_X86_64_DTPMOD64
+#define R_DTPOFF    R_X86_64_DTPOFF64
+#define R_TPOFF     R_X86_64_TPOFF64
 
 #define R_NUM       R_X86_64_NUM
 
@@ -47,6 +50,9 @@ int code_reloc (int reloc_type)
         case R_X86_64_TLSLD:
         case R_X86_64_DTPOFF32:
         case R_X86_64_TPOFF32:
+        case R_X86_64_DTPMOD64:
+        case R_X86_64_DTPOFF64:
+        case R_X86_64_TPOFF64:
             return 0;
 
         case R_X86_64_PC32:
@@ -69,6 +75,11 @@ int gotplt_entry_type (int reloc_type)
         case R_X86_64_JUMP_SLOT:
         case R_X86_64_COPY:
         case R_X86_64_RELATIVE:
+        case R_X86_64_DTPOFF32:
+        case R_X86_64_TPOFF32:
+        case R_X86_64_DTPMOD64:
+        case R_X86_64_DTPOFF64:
+        case R_X86_64_TPOFF64:
             return NO_GOTPLT_ENTRY;
 
 	/* The following relocs wouldn't normally need GOT or PLT
@@ -82,7 +93,11 @@ int gotplt_entry_type (int reloc_type)
             return AUTO_GOTPLT_ENTRY;
 
         case R_X86_64_GOTTPOFF:
-            return BUILD_GOT_ONLY;
+            return TLS_IE_GOT_ENTRY;
+        case R_X86_64_TLSGD:
+            return TLS_GD_GOT_ENTRY;
+        case R_X86_64_TLSLD:
+            return TLS_LD_GOT_ENTRY;
 
         case R_X86_64_GOT32:
         case R_X86_64_GOT64:
@@ -91,10 +106,6 @@ int gotplt_entry_type (int reloc_type)
         case R_X86_64_GOTOFF64:
         case R_X86_64_GOTPCREL:
         case R_X86_64_GOTPCRELX:
-        case R_X86_64_TLSGD:
-        case R_X86_64_TLSLD:
-        case R_X86_64_DTPOFF32:
-        case R_X86_64_TPOFF32:
         case R_X86_64_REX_GOTPCRELX:
         case R_X86_64_PLT32:
         case R_X86_64_PLTOFF64:
@@ -290,7 +301,9 @@ void relocate(SwirlState *s1, ElfW_Rel *rel, int type, unsigned char *ptr, addr_
             add64le(ptr, s1->got->sh_addr - addr + rel->r_addend);
             break;
         case R_X86_64_GOTTPOFF:
-            add32le(ptr, val - s1->got->sh_addr);
+            /* initial-exec: the GOT slot holds the TP offset */
+            add32le(ptr, s1->got->sh_addr - addr + rel->r_addend +
+                         get_sym_attr(s1, sym_index, 0)->tls_ie_offset);
             break;
         case R_X86_64_GOT32:
             /* we load the got offset */
@@ -316,20 +329,20 @@ void relocate(SwirlState *s1, ElfW_Rel *rel, int type, unsigned char *ptr, addr_
                     /* lea -4(%rax),%rax */
                     0x48, 0x8d, 0x80, 0x00, 0x00, 0x00, 0x00 };
 
-                if (memcmp (ptr-4, expect, sizeof(expect)) == 0) {
-                    ElfW(Sym) *sym;
-                    Section *sec;
-                    int32_t x;
+                ElfW(Sym) *sym = &((ElfW(Sym) *)symtab_section->data)[sym_index];
 
+                /* relax to local-exec when the executable defines it */
+                if (s1->output_type == SWIRL_OUTPUT_EXE
+                    && sym->st_shndx != SHN_UNDEF
+                    && memcmp (ptr-4, expect, sizeof(expect)) == 0) {
                     memcpy(ptr-4, replace, sizeof(replace));
                     rel[1].r_info = ELFW(R_INFO)(0, R_X86_64_NONE);
-                    sym = &((ElfW(Sym) *)symtab_section->data)[sym_index];
-                    sec = s1->sections[sym->st_shndx];
-                    x = sym->st_value - sec->sh_addr - sec->data_offset;
-                    add32le(ptr + 8, x);
+                    add32le(ptr + 8, tls_tpoff(s1, sym->st_value));
+                } else {
+                    /* general-dynamic: the GOT pair for __tls_get_addr */
+                    add32le(ptr, s1->got->sh_addr - addr + rel->r_addend +
+                                 get_sym_attr(s1, sym_index, 0)->tls_gd_offset);
                 }
-                else
-                    swirl_error("unexpected R_X86_64_TLSGD pattern");
             }
             break;
         case R_X86_64_TLSLD:
@@ -344,26 +357,43 @@ void relocate(SwirlState *s1, ElfW_Rel *rel, int type, unsigned char *ptr, addr_
                     0x66, 0x66, 0x66, 0x64, 0x48, 0x8b, 0x04, 0x25,
                     0x00, 0x00, 0x00, 0x00 };
 
-                if (memcmp (ptr-3, expect, sizeof(expect)) == 0) {
+                /* relax to local-exec in an executable, elsewhere the
+                   __tls_get_addr call gets the module's GOT pair */
+                if (s1->output_type == SWIRL_OUTPUT_EXE) {
+                    if (memcmp (ptr-3, expect, sizeof(expect)))
+                        swirl_error("unexpected R_X86_64_TLSLD pattern");
                     memcpy(ptr-3, replace, sizeof(replace));
                     rel[1].r_info = ELFW(R_INFO)(0, R_X86_64_NONE);
+                } else {
+                    add32le(ptr, s1->got->sh_addr - addr + rel->r_addend +
+                                 s1->tls_ld_offset);
                 }
-                else
-                    swirl_error("unexpected R_X86_64_TLSLD pattern");
             }
             break;
         case R_X86_64_DTPOFF32:
+            /* relative to the TP once TLSLD is relaxed */
+            if (s1->output_type == SWIRL_OUTPUT_EXE)
+                add32le(ptr, tls_tpoff(s1, val));
+            else
+                add32le(ptr, tls_dtpoff(s1, val));
+            break;
         case R_X86_64_TPOFF32:
-            {
-                ElfW(Sym) *sym;
-                Section *sec;
-                int32_t x;
-
-                sym = &((ElfW(Sym) *)symtab_section->data)[sym_index];
-                sec = s1->sections[sym->st_shndx];
-                x = val - sec->sh_addr - sec->data_offset;
-                add32le(ptr, x);
-            }
+            if (s1->output_type != SWIRL_OUTPUT_EXE)
+                swirl_error("local-exec TLS access needs an executable, "
+                            "recompile with -fPIC");
+            add32le(ptr, tls_tpoff(s1, val));
+            break;
+        case R_X86_64_DTPMOD64:
+            write64le(ptr, tls_module(s1));
+            break;
+        case R_X86_64_DTPOFF64:
+            add64le(ptr, tls_dtpoff(s1, val));
+            break;
+        case R_X86_64_TPOFF64:
+            if (s1->output_type != SWIRL_OUTPUT_EXE)
+                swirl_error("initial-exec TLS access needs an executable, "
+                            "recompile with -fPIC");
+            write64le(ptr, tls_tpoff(s1, val));
             break;
         case R_X86_64_NONE:
             break;